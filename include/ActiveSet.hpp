@@ -0,0 +1,164 @@
+#pragma once
+
+#include <BooleanField.hpp>
+
+#include <algorithm>
+
+/**
+ * @brief Tracks the blocks of a grid that an iterative stencil pass must process again, so that it skips the stable regions.
+ * A pass processes the active blocks and activates the cells it modifies for the next pass, activating a cell activating the blocks
+ * of its neighbors too since their stencils read it. Not thread safe, the cells are activated by a single thread
+ *
+ */
+class ActiveSet
+{
+public:
+	ActiveSet() = delete;
+
+	/**
+	 * @brief Construct the active set of a grid
+	 *
+	 * @param width, height     the number of cells along the width and the height of the grid
+	 * @param block_size        the number of cells along the side of a block
+	 * @param active            true if all the blocks are active for the first pass
+	 */
+	ActiveSet(const int width, const int height, const int block_size = 8, const bool active = true)
+		: _width(width), _height(height), _block_size(block_size),
+		  _current(blocks(width, block_size), blocks(height, block_size), active),
+		  _next(_current.width(), _current.height(), false)
+	{
+	}
+
+	/**
+	 * @brief Get the number of cells along the side of a block
+	 *
+	 */
+	int block_size() const
+	{
+		return _block_size;
+	}
+
+	/**
+	 * @brief Get the number of blocks
+	 *
+	 */
+	int block_number() const
+	{
+		return _current.width() * _current.height();
+	}
+
+	/**
+	 * @brief Get the number of blocks of the current pass
+	 *
+	 */
+	int active_blocks() const
+	{
+		return _current.count();
+	}
+
+	/**
+	 * @brief Tells if the current pass has nothing to process
+	 *
+	 */
+	bool empty() const
+	{
+		return active_blocks() == 0;
+	}
+
+	/**
+	 * @brief Get the index of the block of a cell, the blocks being numbered row after row
+	 *
+	 * @param i, j      the position of the cell on the grid
+	 */
+	int block_index(const int i, const int j) const
+	{
+		return (j / _block_size) * _current.width() + i / _block_size;
+	}
+
+	/**
+	 * @brief Tells if the block of a cell is processed by the current pass
+	 *
+	 * @param i, j      the position of the cell on the grid
+	 */
+	bool is_active(const int i, const int j) const
+	{
+		return _current.value(i / _block_size, j / _block_size);
+	}
+
+	/**
+	 * @brief Mark a modified cell, so that the next pass processes it and its neighbors
+	 *
+	 * @param i, j      the position of the cell on the grid
+	 */
+	void activate(const int i, const int j)
+	{
+		const int bi0 = std::max(i - 1, 0) / _block_size;
+		const int bi1 = std::min(i + 1, _width - 1) / _block_size;
+		const int bj0 = std::max(j - 1, 0) / _block_size;
+		const int bj1 = std::min(j + 1, _height - 1) / _block_size;
+
+		for(int bj = bj0; bj <= bj1; ++bj)
+		{
+			for(int bi = bi0; bi <= bi1; ++bi)
+			{
+				_next.at(bi, bj) = true;
+			}
+		}
+	}
+
+	/**
+	 * @brief Make the next pass process the whole grid
+	 *
+	 */
+	void activate_all()
+	{
+		_next.set_all(true);
+	}
+
+	/**
+	 * @brief Start the next pass: the blocks activated become the blocks to process
+	 *
+	 */
+	void advance()
+	{
+		std::swap(_current, _next);
+		_next.set_all(false);
+	}
+
+	/**
+	 * @brief Call a function on each block of the current pass, row after row
+	 *
+	 * @param function      the function, called with the first cell i, j and past the last cell i, j of the block
+	 */
+	template<typename Function>
+	void for_each_block(Function function) const
+	{
+		_current.for_each_set([&](const int bi, const int bj)
+		{
+			function(bi * _block_size, bj * _block_size,
+			         std::min((bi + 1) * _block_size, _width), std::min((bj + 1) * _block_size, _height));
+		});
+	}
+
+private:
+	/**
+	 * @brief Get the number of blocks covering cells along a side of the grid
+	 *
+	 * @throw           invalid_argument if the blocks have no cell
+	 */
+	static int blocks(const int cells, const int block_size)
+	{
+		if(block_size <= 0)
+		{
+			throw std::invalid_argument("the blocks of an active set need at least 1 cell");
+		}
+
+		return (cells + block_size - 1) / block_size;
+	}
+
+	int _width;             /**< the size of the grid*/
+	int _height;
+	int _block_size;        /**< the number of cells along the side of a block*/
+	BooleanField _current;  /**< the blocks of the current pass*/
+	BooleanField _next;     /**< the blocks of the next pass*/
+};
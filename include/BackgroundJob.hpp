@@ -0,0 +1,168 @@
+#pragma once
+
+#include <MultiLayerMap.hpp>
+#include <Progress.hpp>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+
+/**
+ * @brief Runs one long operation on a worker thread, so that the thread starting it, usually the interface, stays responsive.
+ * An operation on a terrain works on a copy of it, the result replacing the terrain only when the starting thread calls finish,
+ * so the terrain is never seen half modified. The operation reports its progress and is cancelled through report_progress
+ *
+ */
+class BackgroundJob
+{
+public:
+	/**
+	 * @brief The state of the job
+	 *
+	 */
+	enum class Status
+	{
+		idle,       /**< no job was started*/
+		running,    /**< the operation is running*/
+		finished,   /**< the operation ended normally*/
+		cancelled,  /**< the operation was cancelled*/
+		failed      /**< the operation threw an exception*/
+	};
+
+	/**
+	 * @brief Construct a job that does nothing yet
+	 *
+	 */
+	BackgroundJob()
+		: _status(Status::idle), _apply(false)
+	{
+	}
+	BackgroundJob(const BackgroundJob&) = delete;
+	BackgroundJob& operator=(const BackgroundJob&) = delete;
+
+	/**
+	 * @brief Cancel the operation and wait for it
+	 *
+	 */
+	~BackgroundJob();
+
+	/**
+	 * @brief Start an operation on the worker thread
+	 *
+	 * @param name          the name of the operation, to display
+	 * @param work          the operation
+	 * @return true         if the operation is started
+	 * @return false        if an operation is already running
+	 */
+	bool start(const std::string& name, std::function<void()> work);
+
+	/**
+	 * @brief Start an operation on a copy of a terrain
+	 *
+	 * @param name          the name of the operation, to display
+	 * @param source        the terrain to copy, left untouched
+	 * @param operation     the operation to apply on the copy
+	 * @param apply         if true the copy replaces the terrain given to finish, otherwise the operation only reads it
+	 * @return true         if the operation is started
+	 * @return false        if an operation is already running
+	 */
+	bool start(const std::string& name, const MultiLayerMap& source, std::function<void(MultiLayerMap&)> operation, const bool apply = true);
+
+	/**
+	 * @brief Ask the operation to stop at its next report of progress
+	 *
+	 */
+	void cancel();
+
+	/**
+	 * @brief Get the state of the job
+	 *
+	 * @return Status       the state
+	 */
+	Status status() const
+	{
+		return _status;
+	}
+
+	/**
+	 * @brief Tells if the operation is running
+	 *
+	 * @return true         if the operation is running
+	 * @return false        otherwise
+	 */
+	bool is_running() const
+	{
+		return _status == Status::running;
+	}
+
+	/**
+	 * @brief Tells if the operation ended and finish was not called yet
+	 *
+	 * @return true         if the next call to finish returns true
+	 * @return false        otherwise
+	 */
+	bool is_pending() const
+	{
+		return !is_running() && _thread.joinable();
+	}
+
+	/**
+	 * @brief Get the name of the last operation started
+	 *
+	 * @return const std::string&   the name
+	 */
+	const std::string& name() const
+	{
+		return _name;
+	}
+
+	/**
+	 * @brief Get the progress of the operation
+	 *
+	 * @return double       the fraction done, between 0 and 1
+	 */
+	double progress() const
+	{
+		return _progress.fraction();
+	}
+
+	/**
+	 * @brief Get the message of the exception thrown by the operation, when it failed
+	 *
+	 * @return std::string  the message, empty if the operation did not fail
+	 */
+	std::string error() const
+	{
+		return (_status == Status::failed) ? _error : std::string();
+	}
+
+	/**
+	 * @brief Wait for the worker thread once the operation ended.
+	 * Must be called regularly by the thread that started the operation
+	 *
+	 * @return true         if the operation ended since the last call
+	 * @return false        otherwise
+	 */
+	bool finish();
+
+	/**
+	 * @brief Wait for the worker thread once the operation ended, then replace a terrain by the result of a finished operation
+	 * Must be called regularly by the thread that started the operation
+	 *
+	 * @param target        the terrain to replace, not used while the operation is running
+	 * @return true         if the operation ended since the last call
+	 * @return false        otherwise
+	 */
+	bool finish(MultiLayerMap& target);
+
+private:
+	std::thread _thread;                    /**< the worker thread*/
+	std::atomic<Status> _status;            /**< the state of the job*/
+	Progress _progress;                     /**< the progress of the operation*/
+	std::string _name;                      /**< the name of the operation*/
+	std::string _error;                     /**< the message of the exception of the operation*/
+	std::unique_ptr<MultiLayerMap> _result; /**< the copy of the terrain the operation works on*/
+	bool _apply;                            /**< tells if the copy replaces the terrain*/
+};
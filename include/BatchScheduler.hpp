@@ -0,0 +1,122 @@
+#pragma once
+
+#include <Pipeline.hpp>
+
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Defines a terrain generation job of a batch
+ *
+ */
+struct BatchJob
+{
+	int index;                                                      /**< the index of the job in the batch*/
+	std::vector<std::pair<std::string, std::string>> parameters;    /**< the swept parameters of the job and their values*/
+	Pipeline pipeline;                                              /**< the pipeline run by the job*/
+	long memory;                                                    /**< the estimated memory used by the job, in bytes*/
+};
+
+/**
+ * @brief Runs a pipeline for every combination of the parameters of its [sweep] section, several jobs at the same time.
+ * Each parameter of the sweep is written section.parameter = values, the values being a list separated by spaces
+ * or a range first:last or first:last:step.
+ * The [batch] section sets the maximal number of jobs run at the same time (jobs), the summary file (summary, a csv file
+ * in the output directory by default) and two limits on the memory estimated by estimate_memory, which do not bound
+ * the memory actually allocated: the estimate of all the running jobs (estimated_memory, in MB) and the estimate
+ * allowed for a single job (estimated_job_memory, in MB).
+ * The cores not used by concurrent jobs are given to the jobs through the threads parameter of their pipeline
+ *
+ */
+class BatchScheduler
+{
+public:
+	BatchScheduler() = delete;
+	/**
+	 * @brief Construct the jobs of a batch
+	 *
+	 * @param pipeline      the pipeline with its [sweep] and [batch] sections
+	 * @param cores         the number of cores of the machine, detected if 0
+	 * @throw               invalid_argument if the sweep is not valid
+	 */
+	BatchScheduler(const Pipeline& pipeline, const int cores = 0);
+
+	/**
+	 * @brief Get the values of a swept parameter
+	 *
+	 * @param values        a list of values separated by spaces, or a range first:last[:step]
+	 * @return std::vector<std::string>     the values
+	 * @throw               invalid_argument if the range is not valid
+	 */
+	static std::vector<std::string> sweep_values(const std::string& values);
+
+	/**
+	 * @brief Estimate the memory used by a pipeline from the size of its terrain.
+	 * This is a rough upper bound of the maps kept by the stages
+	 *
+	 * @param pipeline      the pipeline
+	 * @return long         the memory, in bytes
+	 */
+	static long estimate_memory(const Pipeline& pipeline);
+
+	/**
+	 * @brief Get the number of jobs
+	 *
+	 * @return int          the number of jobs
+	 */
+	int job_number() const
+	{
+		return _jobs.size();
+	}
+
+	/**
+	 * @brief Get a job
+	 *
+	 * @param index         the index of the job
+	 * @return const BatchJob&  the job
+	 */
+	const BatchJob& job(const int index) const
+	{
+		return _jobs.at(index);
+	}
+
+	/**
+	 * @brief Get the maximal number of jobs run at the same time
+	 *
+	 * @return int          the number of jobs
+	 */
+	int concurrent_jobs() const
+	{
+		return _concurrent_jobs;
+	}
+
+	/**
+	 * @brief Get the number of threads given to each job
+	 *
+	 * @return int          the number of threads
+	 */
+	int threads_per_job() const
+	{
+		return _threads_per_job;
+	}
+
+	/**
+	 * @brief Run all the jobs.
+	 * A line is added to the summary file as soon as a job ends
+	 *
+	 * @param log           the output of the progress messages
+	 * @return int          the number of jobs that failed or were refused
+	 */
+	int run(std::ostream& log) const;
+
+private:
+	std::vector<BatchJob> _jobs;            /**< the jobs*/
+	std::vector<std::string> _parameters;   /**< the names of the swept parameters*/
+	int _concurrent_jobs;                   /**< the maximal number of jobs run at the same time*/
+	int _threads_per_job;                   /**< the number of threads given to each job*/
+	long _estimated_memory;                 /**< the estimated memory of all the running jobs, in bytes, 0 if unlimited*/
+	long _estimated_job_memory;             /**< the estimated memory allowed for a job, in bytes, 0 if unlimited*/
+	std::string _summary;                   /**< the name of the summary file*/
+};
@@ -1,58 +1,123 @@
 #pragma once
 
+#include <Eigen/Core>
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
 #include <vector>
 
 /**
- * @brief Defines a field of values spread across a grid on the plane
+ * @brief Defines a field of booleans spread across a grid, packed in words of 64 bits.
+ * The cell i, j is the bit j * width + i, the bits past the last cell being always false
  *
  */
 class BooleanField
 {
 public:
+	/**
+	 * @brief A reference to the bit of a cell
+	 *
+	 */
+	class Reference
+	{
+	public:
+		Reference(std::uint64_t& word, const std::uint64_t mask)
+			: _word(word), _mask(mask)
+		{
+		}
+
+		operator bool() const
+		{
+			return (_word & _mask) != 0;
+		}
+
+		Reference& operator=(const bool value)
+		{
+			_word = value ? (_word | _mask) : (_word & ~_mask);
+			return *this;
+		}
+
+		Reference& operator=(const Reference& r)
+		{
+			return *this = static_cast<bool>(r);
+		}
+
+	private:
+		std::uint64_t& _word;   /**< the word of the cell*/
+		std::uint64_t _mask;    /**< the bit of the cell in the word*/
+	};
+
 	BooleanField() = delete;
 	/**
-	 * @brief Construct a new Scalar Field object from an other Scalar Field
+	 * @brief Construct a new Boolean Field object from an other Boolean Field
 	 *
-	 * @param bf        the Scalar field to copy
+	 * @param bf        the Boolean field to copy
 	 */
 	BooleanField(const BooleanField& bf)
-		: _width(bf._width), _height(bf._height), _values(bf._values) {}
+		: _width(bf._width), _height(bf._height), _words(bf._words) {}
 	/**
-	 * @brief Construct a new Scalar Field object from an other Scalar Field
+	 * @brief Construct a new Boolean Field object from an other Boolean Field
 	 *
-	 * @param hf        the Scalar Field to copy
+	 * @param bf        the Boolean Field to move
 	 */
 	BooleanField(BooleanField&& bf)
-		: _width(bf._width), _height(bf._height), _values(std::move(bf._values)) {}
+		: _width(bf._width), _height(bf._height), _words(std::move(bf._words)) {}
 	/**
-	 * @brief Construct a new Scalar Field object
+	 * @brief Construct a new Boolean Field object
 	 *
-	 * @param width     the number of cells along the width of the grid
-	 * @param height    the number of cells along the height of the grid
-	 * @param a         the first point of the grid
-	 * @param b         the second point of the grid
+	 * @param width         the number of cells along the width of the grid
+	 * @param height        the number of cells along the height of the grid
+	 * @param default_value the value of all the cells
 	 */
 	BooleanField(const int width, const int height, const bool default_value = false)
 		: _width(width), _height(height)
 	{
-		_values.resize(width * height, default_value);
+		_words.resize((width * height + 63) / 64);
+		set_all(default_value);
+	}
+
+	/**
+	 * @brief Affectation operator
+	 *
+	 */
+	BooleanField& operator=(const BooleanField& bf) = default;
+	BooleanField& operator=(BooleanField&& bf) = default;
+
+	/**
+	 * @brief Get the number of cells along the width of the grid
+	 *
+	 */
+	int width() const
+	{
+		return _width;
+	}
+
+	/**
+	 * @brief Get the number of cells along the height of the grid
+	 *
+	 */
+	int height() const
+	{
+		return _height;
 	}
 
 	/**
-	 * @brief Get the value (copy) of the field at a given cell
+	 * @brief Get the value of the field at a given cell
 	 *
 	 * @param i, j      the position of the cell on the grid
-	 * @return double   the exact value of the field in that cell
+	 * @return bool     the value of that cell
 	 */
 	bool value(const int i, const int j) const
 	{
-		return static_cast<bool>(_values.at(index(i, j)));
+		const int k = index(i, j);
+		return (_words[k >> 6] >> (k & 63)) & 1;
 	}
 	/**
-	 * @brief Get the value (copy) of the field at a given cell
+	 * @brief Get the value of the field at a given cell
 	 *
 	 * @param p         the position of the cell on the grid
-	 * @return double   the exact value of the field in that cell
+	 * @return bool     the value of that cell
 	 */
 	bool value(const Eigen::Vector2i p) const
 	{
@@ -62,10 +127,10 @@ public:
 	/**
 	 * @brief Gets acess to a cell of the field
 	 *
-	 * @param p      the position of the cell on the grid
-	 * @return double&  a reference to the value of that cell
+	 * @param p         the position of the cell on the grid
+	 * @return Reference  a reference to the value of that cell
 	 */
-	char& at(const Eigen::Vector2i p)
+	Reference at(const Eigen::Vector2i p)
 	{
 		return at(p(0), p(1));
 	}
@@ -74,11 +139,53 @@ public:
 	 * @brief Gets acess to a cell of the field
 	 *
 	 * @param i, j      the position of the cell on the grid
-	 * @return double&  a reference to the value of that cell
+	 * @return Reference  a reference to the value of that cell
+	 */
+	Reference at(const int i, const int j)
+	{
+		const int k = index(i, j);
+		return Reference(_words[k >> 6], std::uint64_t(1) << (k & 63));
+	}
+
+	/**
+	 * @brief Set the value of a cell
+	 *
+	 * @param i, j      the position of the cell on the grid
+	 * @param value     the value of the cell
+	 */
+	void set_value(const int i, const int j, const bool value)
+	{
+		at(i, j) = value;
+	}
+
+	/**
+	 * @brief Set a cell to true and give its previous value
+	 *
+	 * @param p         the position of the cell on the grid
+	 * @return bool     the value of the cell before
+	 */
+	bool test_and_set(const Eigen::Vector2i p)
+	{
+		const int k = index(p(0), p(1));
+		const std::uint64_t mask = std::uint64_t(1) << (k & 63);
+		const bool previous = (_words[k >> 6] & mask) != 0;
+		_words[k >> 6] |= mask;
+		return previous;
+	}
+
+	/**
+	 * @brief Set a cell to false and give its previous value
+	 *
+	 * @param p         the position of the cell on the grid
+	 * @return bool     the value of the cell before
 	 */
-	char& at(const int i, const int j)
+	bool test_and_clear(const Eigen::Vector2i p)
 	{
-		return _values.at(index(i, j));
+		const int k = index(p(0), p(1));
+		const std::uint64_t mask = std::uint64_t(1) << (k & 63);
+		const bool previous = (_words[k >> 6] & mask) != 0;
+		_words[k >> 6] &= ~mask;
+		return previous;
 	}
 
 	/**
@@ -87,7 +194,117 @@ public:
 	 */
 	void set_all(bool value = false)
 	{
-		std::fill(_values.begin(), _values.end(), value);
+		std::fill(_words.begin(), _words.end(), value ? ~std::uint64_t(0) : 0);
+		clear_padding();
+	}
+
+	/**
+	 * @brief Get the number of true cells
+	 *
+	 * @return int      the number of cells set to true
+	 */
+	int count() const
+	{
+		int n = 0;
+
+		for(const std::uint64_t w : _words)
+		{
+			n += popcount(w);
+		}
+
+		return n;
+	}
+
+	/**
+	 * @brief Get the words of the field
+	 *
+	 * @return const std::vector<std::uint64_t>&    the words, the cell k being the bit k % 64 of the word k / 64
+	 */
+	const std::vector<std::uint64_t>& words() const
+	{
+		return _words;
+	}
+
+	/**
+	 * @brief Set to true the cells true in an other field
+	 *
+	 * @param bf                the other field, of the same size
+	 * @return BooleanField&    a reference to this field
+	 */
+	BooleanField& operator|=(const BooleanField& bf)
+	{
+		for(int w = 0; w < _words.size(); ++w)
+		{
+			_words[w] |= bf._words.at(w);
+		}
+
+		return *this;
+	}
+
+	/**
+	 * @brief Set to false the cells false in an other field
+	 *
+	 * @param bf                the other field, of the same size
+	 * @return BooleanField&    a reference to this field
+	 */
+	BooleanField& operator&=(const BooleanField& bf)
+	{
+		for(int w = 0; w < _words.size(); ++w)
+		{
+			_words[w] &= bf._words.at(w);
+		}
+
+		return *this;
+	}
+
+	/**
+	 * @brief Call a function on each true cell, row after row, skipping 64 false cells at once
+	 *
+	 * @param function      the function, called with the position i, j of the cell
+	 */
+	template<typename Function>
+	void for_each_set(Function function) const
+	{
+		for_each(function, 0);
+	}
+
+	/**
+	 * @brief Call a function on each false cell, row after row, skipping 64 true cells at once
+	 *
+	 * @param function      the function, called with the position i, j of the cell
+	 */
+	template<typename Function>
+	void for_each_unset(Function function) const
+	{
+		for_each(function, ~std::uint64_t(0));
+	}
+
+	/**
+	 * @brief Get the number of bits set in a word
+	 *
+	 */
+	static int popcount(const std::uint64_t w)
+	{
+#if defined(__GNUC__)
+		return __builtin_popcountll(w);
+#else
+		std::uint64_t v = w - ((w >> 1) & 0x5555555555555555ULL);
+		v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+		return static_cast<int>((((v + (v >> 4)) & 0x0f0f0f0f0f0f0f0fULL) * 0x0101010101010101ULL) >> 56);
+#endif
+	}
+
+	/**
+	 * @brief Get the rank of the lowest bit set in a word, not null
+	 *
+	 */
+	static int lowest_bit(const std::uint64_t w)
+	{
+#if defined(__GNUC__)
+		return __builtin_ctzll(w);
+#else
+		return popcount((w & (~w + 1)) - 1);
+#endif
 	}
 
 protected:
@@ -102,7 +319,7 @@ protected:
 	{
 		int index = _width * j + i;
 
-		if(index >= _width * _height)
+		if(index < 0 || index >= _width * _height)
 		{
 			throw std::invalid_argument("wrong access to a value in the BooleanField");
 		}
@@ -110,7 +327,49 @@ protected:
 		return index;
 	}
 
-	int _width;
-	int _height;
-	std::vector<char> _values;    /**< array containing all the values of the field*/
+	/**
+	 * @brief Set to false the bits of the last word past the last cell
+	 *
+	 */
+	void clear_padding()
+	{
+		const int used = (_width * _height) & 63;
+
+		if(used != 0)
+		{
+			_words.back() &= (std::uint64_t(1) << used) - 1;
+		}
+	}
+
+	/**
+	 * @brief Call a function on the cells whose bit differs from the bits of a word
+	 *
+	 */
+	template<typename Function>
+	void for_each(Function& function, const std::uint64_t flip) const
+	{
+		const int n = _width * _height;
+
+		for(int w = 0; w < _words.size(); ++w)
+		{
+			std::uint64_t bits = _words[w] ^ flip;
+
+			while(bits)
+			{
+				const int k = (w << 6) + lowest_bit(bits);
+
+				if(k >= n)
+				{
+					return;
+				}
+
+				function(k % _width, k / _width);
+				bits &= bits - 1;
+			}
+		}
+	}
+
+	int _width;                         /**< the number of cells along the width of the grid*/
+	int _height;                        /**< the number of cells along the height of the grid*/
+	std::vector<std::uint64_t> _words;  /**< the bits of the cells*/
 };
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <stdexcept>
+#include <vector>
+
+/**
+ * @brief Defines a priority queue of the cells of a grid, the priorities being quantized in a small number of buckets.
+ * A cell is queued at most once: pushing it again with a higher priority moves it, the old entry being skipped when popped.
+ * The cells of a bucket are popped last in first out, which keeps the cells modified together close in memory
+ *
+ */
+class BucketQueue
+{
+public:
+	BucketQueue() = delete;
+
+	/**
+	 * @brief Construct an empty queue
+	 *
+	 * @param cells         the number of cells of the grid, the cells being their linear index
+	 * @param buckets       the number of priorities, at most 127
+	 */
+	BucketQueue(const int cells, const int buckets)
+		: _buckets(bucket_number(buckets)), _bucket_of(cells, -1), _top(-1), _size(0)
+	{
+	}
+
+	/**
+	 * @brief Get the number of cells queued
+	 *
+	 */
+	int size() const
+	{
+		return _size;
+	}
+
+	/**
+	 * @brief Tells if there is no cell to pop
+	 *
+	 */
+	bool empty() const
+	{
+		return _size == 0;
+	}
+
+	/**
+	 * @brief Get the bucket of a cell
+	 *
+	 * @param cell      the index of the cell
+	 * @return int      the bucket, -1 if the cell is not queued
+	 */
+	int bucket(const int cell) const
+	{
+		return _bucket_of[cell];
+	}
+
+	/**
+	 * @brief Queue a cell, or raise its priority if it is queued with a lower one
+	 *
+	 * @param cell      the index of the cell
+	 * @param bucket    the priority, between 0 and the number of buckets, clamped
+	 * @return true     if the cell was pushed
+	 * @return false    if the cell is already queued with this priority or a higher one
+	 */
+	bool push(const int cell, int bucket)
+	{
+		bucket = (bucket < 0) ? 0 : ((bucket >= _buckets.size()) ? _buckets.size() - 1 : bucket);
+
+		if(_bucket_of[cell] >= bucket)
+		{
+			return false;
+		}
+
+		_size += (_bucket_of[cell] < 0) ? 1 : 0;
+		_bucket_of[cell] = bucket;
+		_buckets[bucket].push_back(cell);
+		_top = (bucket > _top) ? bucket : _top;
+		return true;
+	}
+
+	/**
+	 * @brief Remove a cell with the highest priority
+	 *
+	 * @return int      the index of the cell
+	 * @throw           logic_error if the queue is empty
+	 */
+	int pop()
+	{
+		while(_top >= 0)
+		{
+			std::vector<int>& top = _buckets[_top];
+
+			while(!top.empty())
+			{
+				const int cell = top.back();
+				top.pop_back();
+
+				// the cell was moved to a higher bucket and already popped from it
+				if(_bucket_of[cell] == _top)
+				{
+					_bucket_of[cell] = -1;
+					--_size;
+					return cell;
+				}
+			}
+
+			--_top;
+		}
+
+		throw std::logic_error("pop on an empty bucket queue");
+	}
+
+private:
+	/**
+	 * @brief Check the number of buckets
+	 *
+	 * @throw           invalid_argument if the priorities don't fit in the queue
+	 */
+	static int bucket_number(const int buckets)
+	{
+		if(buckets <= 0 || buckets > 127)
+		{
+			throw std::invalid_argument("a bucket queue needs between 1 and 127 buckets");
+		}
+
+		return buckets;
+	}
+
+	std::vector<std::vector<int>> _buckets;     /**< the cells of each priority, some of them moved to a higher one*/
+	std::vector<signed char> _bucket_of;        /**< the priority of each cell, -1 if it is not queued*/
+	int _top;                                   /**< the highest bucket that may not be empty*/
+	int _size;                                  /**< the number of cells queued*/
+};
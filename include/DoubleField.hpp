@@ -1,10 +1,13 @@
 #pragma once
 
 #include <Grid2d.hpp>
+#include <Statistics.hpp>
 #include <vector>
 #include <fstream>
 #include <algorithm>
 
+class MeshWriter;
+
 /**
  * @brief Defines a field of values spread across a grid on the plane
  *
@@ -80,6 +83,22 @@ public:
 	 */
 	virtual double value(const int i, const int j) const = 0;
 
+	/**
+	 * @brief Get the version of the values of the field.
+	 * The version changes every time the values may have been modified
+	 *
+	 * @return unsigned long    an identifier of the current state of the values, greater than all the previous ones
+	 */
+	virtual unsigned long version() const = 0;
+
+	/**
+	 * @brief Get the values of a row of the field
+	 *
+	 * @param j         the row
+	 * @param values    the values of the row (a pointer to an array of size at least grid_width)
+	 */
+	virtual void get_row(const int j, double* values) const;
+
 	/**
 	 * @brief Get the value of the field at a given cell
 	 *    DOES NOT WORK - WE DON'T KNOW WHY
@@ -118,6 +137,39 @@ public:
 	 */
 	double value_inter(const double x, const double y) const;
 
+	/**
+	 * @brief Get the min, max, sum, mean and variance of the values of the field in a single pass
+	 *
+	 * @return FieldStatistics  the statistics of the field
+	 */
+	virtual FieldStatistics statistics() const;
+
+	/**
+	 * @brief Get the histogram of the values of the field on a given range
+	 *
+	 * @param min, max          the range of the histogram
+	 * @param bins              the number of bins
+	 * @return Histogram        the histogram of the field
+	 */
+	virtual Histogram histogram(const double min, const double max, const int bins = 256) const;
+
+	/**
+	 * @brief Get the histogram of the values of the field between its min and max values
+	 *
+	 * @param bins              the number of bins
+	 * @return Histogram        the histogram of the field
+	 */
+	Histogram histogram(const int bins = 256) const;
+
+	/**
+	 * @brief Get the values between which lie a given proportion of the values of the field
+	 *
+	 * @param low, high         the proportions of the values under the returned bounds, between 0 and 1
+	 * @param bins              the number of bins of the histogram used to compute the percentiles
+	 * @return std::pair<double, double>    the values of the low and high percentiles
+	 */
+	std::pair<double, double> percentile_range(const double low, const double high, const int bins = 1024) const;
+
 	/**
 	 * @brief Get the min value of the field
 	 *
@@ -178,6 +230,36 @@ public:
 	 * @return Eigen::Vector3d  the normal at that cell
 	 */
 	Eigen::Vector3d normal(const int i, const int j) const;
+	/**
+	 * @brief Get the values and the normals of a block of rows, each value being read only once
+	 *
+	 * @param row_begin         the first row of the block
+	 * @param row_end           the row after the last row of the block
+	 * @param heights           the values of the block (a pointer to an array of size at least (row_end - row_begin) * grid_width)
+	 * @param normals           the normals of the block, as (x, y, z) triplets (a pointer to an array of size at least 3 * (row_end - row_begin) * grid_width)
+	 */
+	void get_rows_normals(const int row_begin, const int row_end, double* heights, double* normals) const;
+
+	/**
+	 * @brief Get the gradients of a block of rows, with the differences of gradient(), each value being read only once.
+	 * The borders of the grid are handled out of the loop over the inner cells of a row
+	 *
+	 * @param row_begin         the first row of the block
+	 * @param row_end           the row after the last row of the block
+	 * @param gx, gy            the coordinates of the gradients of the block (pointers to arrays of size at least (row_end - row_begin) * grid_width)
+	 * @param values            if not null, the values of the block (a pointer to an array of the same size)
+	 */
+	void get_rows_gradients(const int row_begin, const int row_end, double* gx, double* gy, double* values = nullptr) const;
+
+	/**
+	 * @brief Compute the normals of cells from their gradients, as normal() does
+	 *
+	 * @param n                 the number of cells
+	 * @param gx, gy            the gradients of the cells
+	 * @param nx, ny, nz        the coordinates of the normals
+	 * @param stride            the distance between the coordinates of two consecutive cells in the arrays of the normals
+	 */
+	static void normals_from_gradients(const int n, const double* gx, const double* gy, double* nx, double* ny, double* nz, const int stride = 1);
 
 	/**
 	 * @brief Get indices of values sorted by height
@@ -342,6 +424,29 @@ public:
 	 */
 	void export_as_obj(const std::string filename, std::string name = "") const;
 
+	/**
+	 * @brief Export the Field as a ply
+	 *
+	 * @param filename      the name of the file
+	 * @param binary        tells if the data should be binary (little endian) or ASCII
+	 */
+	void export_as_ply(const std::string filename, const bool binary = true) const;
+
+	/**
+	 * @brief Export the Field in the compact indexed binary mesh format of BinaryMeshWriter
+	 *
+	 * @param filename      the name of the file
+	 */
+	void export_as_binary_mesh(const std::string filename) const;
+
+	/**
+	 * @brief Write the Field as a triangle mesh, the values being on the y axis.
+	 * The vertices are generated by blocks of rows so that the mesh is never entirely in memory
+	 *
+	 * @param writer        the output of the mesh
+	 */
+	void export_mesh(MeshWriter& writer) const;
+
 	/**
 	 * @brief Export the Field as a pgm
 	 *
@@ -352,12 +457,29 @@ public:
 	 */
 	void export_as_pgm(const std::string filename, bool minMan = true, double rangeMin = 0, double rangeMax = 1) const;
 
+	/**
+	 * @brief Export the Field as a pgm, ranged on percentiles so that a few extreme values do not flatten the image
+	 *
+	 * @param filename      the name of the file
+	 * @param low           the proportion of the values clipped to black
+	 * @param high          the proportion of the values under white
+	 */
+	void export_as_pgm_clipped(const std::string filename, const double low = 0.01, const double high = 0.99) const;
+
 	/**
 	 * @brief export the Field as a list of pairs <value/position>
 	 *
 	 * @return std::vector<std::pair<double, Eigen::Vector2i>>  a list of pair <value/cell_position> representing the Field
 	 */
 	std::vector<std::pair<double, Eigen::Vector2i>> export_to_list() const;
+
+protected:
+	/**
+	 * @brief Get a new version identifier, shared by all the fields
+	 *
+	 * @return unsigned long    a version identifier greater than all the previously given ones
+	 */
+	static unsigned long new_version();
 };
 
 /**
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <MultiLayerMap.hpp>
+
+#include <algorithm>
+#include <vector>
+
+/**
+ * @brief Defines a pyramid of a field at decreasing resolutions, each level having half the resolution of the previous one.
+ * Map is SimpleLayerMap or MultiLayerMap
+ *
+ */
+template<typename Map>
+class FieldPyramid
+{
+public:
+	FieldPyramid() = delete;
+	/**
+	 * @brief Construct a new Field Pyramid
+	 *
+	 * @param field         the field at full resolution, the level 0
+	 * @param levels        the maximal number of levels after the level 0
+	 * @param min_size      the minimal number of cells along each axis of the coarsest level
+	 */
+	FieldPyramid(const Map& field, const int levels, const int min_size = 16)
+		: _levels(1, field)
+	{
+		const int min_grid = std::max(min_size, 2);
+
+		while(_levels.size() <= levels
+		        && (_levels.back().grid_width() + 1) / 2 >= min_grid
+		        && (_levels.back().grid_height() + 1) / 2 >= min_grid)
+		{
+			_levels.push_back(Map::generate_downsampled(_levels.back()));
+		}
+	}
+
+	/**
+	 * @brief Get the number of levels, including the full resolution
+	 *
+	 * @return int          the number of levels
+	 */
+	int level_number() const
+	{
+		return _levels.size();
+	}
+
+	/**
+	 * @brief Get a level of the pyramid
+	 *
+	 * @param level         the index of the level, 0 being the full resolution
+	 * @return const Map&   a reference to the level
+	 */
+	const Map& level(const int level) const
+	{
+		return _levels.at(level);
+	}
+	/**
+	 * @brief Get a level of the pyramid
+	 *
+	 * @param level         the index of the level, 0 being the full resolution
+	 * @return Map&         a modifiable reference to the level
+	 */
+	Map& level(const int level)
+	{
+		return _levels.at(level);
+	}
+
+private:
+	std::vector<Map> _levels;   /**< the levels, from the full resolution to the coarsest*/
+};
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <MultiLayerMap.hpp>
+
+#include <vector>
+
+/**
+ * @brief Measures the mass of each layer of a terrain, as the sum of its heights times the area of a cell,
+ * split in bands along the borders of the grid where the operations lose what leaves the terrain, the last band being the interior.
+ * The cells of band b are at a distance between b * band_width and (b + 1) * band_width of the nearest border.
+ * The sums are compensated so that comparing two measures finds leaks much smaller than the rounding errors of a plain sum
+ *
+ */
+class MassAudit
+{
+public:
+	MassAudit() = delete;
+
+	/**
+	 * @brief Measure a terrain, in parallel over its tiles
+	 *
+	 * @param mlm           the terrain
+	 * @param band_width    the width of the bands along the borders, in cells
+	 * @param bands         the number of bands along the borders, 0 to measure the whole grid as interior
+	 * @throw               invalid_argument if the band width is not positive or the number of bands is negative
+	 */
+	MassAudit(const MultiLayerMap& mlm, const int band_width = 8, const int bands = 1);
+
+	/**
+	 * @brief Get the number of layers measured
+	 *
+	 */
+	int layer_number() const
+	{
+		return _layers;
+	}
+
+	/**
+	 * @brief Get the number of bands, the interior included
+	 *
+	 */
+	int band_number() const
+	{
+		return _bands + 1;
+	}
+
+	/**
+	 * @brief Get the width of the bands along the borders
+	 *
+	 */
+	int band_width() const
+	{
+		return _band_width;
+	}
+
+	/**
+	 * @brief Get the mass of a layer in a band
+	 *
+	 * @param layer     the layer
+	 * @param band      the band, band_number - 1 for the interior
+	 */
+	double mass(const int layer, const int band) const
+	{
+		return _masses[layer * band_number() + band];
+	}
+
+	/**
+	 * @brief Get the mass of a layer
+	 *
+	 * @param layer     the layer
+	 */
+	double layer_mass(const int layer) const;
+
+	/**
+	 * @brief Get the mass of all the layers
+	 *
+	 */
+	double total() const;
+
+	/**
+	 * @brief Tells if two measures can be compared
+	 *
+	 * @return true     if they have the same grid and bands, a layer missing from one of them being empty
+	 */
+	bool comparable(const MassAudit& other) const;
+
+private:
+	int _width;                     /**< the size of the grid*/
+	int _height;
+	int _layers;                    /**< the number of layers*/
+	int _band_width;                /**< the width of a band, in cells*/
+	int _bands;                     /**< the number of bands along the borders*/
+	std::vector<double> _masses;    /**< the mass of each band of each layer*/
+};
+
+/**
+ * @brief Defines the mass gained or lost by a terrain between two measures
+ *
+ */
+struct MassLeak
+{
+	bool comparable = false;    /**< false if the measures have different grids or bands, the leaks then being empty*/
+	int bands = 0;              /**< the number of bands, the interior included*/
+	std::vector<double> leaks;  /**< the mass gained by each band of each layer, negative when lost*/
+	double total = 0;           /**< the mass gained by the terrain*/
+	double relative = 0;        /**< the mass gained relatively to the mass before*/
+
+	/**
+	 * @brief Get the mass gained by a layer in a band
+	 *
+	 * @param layer     the layer
+	 * @param band      the band
+	 */
+	double leak(const int layer, const int band) const
+	{
+		return leaks[layer * bands + band];
+	}
+
+	/**
+	 * @brief Get the mass gained by a layer
+	 *
+	 * @param layer     the layer
+	 */
+	double layer_leak(const int layer) const;
+
+	/**
+	 * @brief Get the mass gained by a band, all the layers included
+	 *
+	 * @param band      the band
+	 */
+	double band_leak(const int band) const;
+};
+
+/**
+ * @brief Compare the mass of a terrain before and after an operation
+ *
+ * @param before        the measure before the operation
+ * @param after         the measure after the operation
+ * @return MassLeak     the mass gained by each layer and band
+ */
+MassLeak compare_mass(const MassAudit& before, const MassAudit& after);
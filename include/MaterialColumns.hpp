@@ -0,0 +1,201 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+
+/**
+ * @brief Stores the materials of the columns of a grid as runs of a material and a thickness, stacked from the bottom.
+ * A cell can have several stacks, one for each layer of a terrain. The runs of all the stacks are kept in a single arena,
+ * each stack owning a slice of it that moves to the end of the arena when it is full, so the memory used grows with the number
+ * of runs and not with the heights of the columns
+ *
+ */
+class MaterialColumns
+{
+public:
+	/**
+	 * @brief A run of a material
+	 *
+	 */
+	struct Run
+	{
+		int material;       /**< the material of the run*/
+		double thickness;   /**< the height of the run*/
+	};
+
+	MaterialColumns() = delete;
+
+	/**
+	 * @brief Construct empty stacks
+	 *
+	 * @param width, height     the number of cells along the width and the height of the grid
+	 * @param stacks            the number of stacks of each cell
+	 * @throw                   invalid_argument if there is no stack
+	 */
+	MaterialColumns(const int width, const int height, const int stacks = 1);
+
+	/**
+	 * @brief Get the number of cells along the width of the grid
+	 *
+	 */
+	int width() const
+	{
+		return _width;
+	}
+
+	/**
+	 * @brief Get the number of cells along the height of the grid
+	 *
+	 */
+	int height() const
+	{
+		return _height;
+	}
+
+	/**
+	 * @brief Get the number of stacks of each cell
+	 *
+	 */
+	int stack_number() const
+	{
+		return _stacks;
+	}
+
+	/**
+	 * @brief Get the number of runs of a stack
+	 *
+	 * @param i, j      the position of the cell on the grid
+	 * @param stack     the stack of the cell
+	 */
+	int run_number(const int i, const int j, const int stack = 0) const
+	{
+		return _slices[slice(i, j, stack)].size;
+	}
+
+	/**
+	 * @brief Get the runs of a stack
+	 *
+	 * @param i, j          the position of the cell on the grid
+	 * @param stack         the stack of the cell
+	 * @return const Run*   the run_number runs, from the bottom to the top, valid until a run is added
+	 */
+	const Run* runs(const int i, const int j, const int stack = 0) const
+	{
+		return _arena.data() + _slices[slice(i, j, stack)].offset;
+	}
+
+	/**
+	 * @brief Get the material at the top of a stack
+	 *
+	 * @param i, j      the position of the cell on the grid
+	 * @param stack     the stack of the cell
+	 * @return int      the material, -1 if the stack is empty
+	 */
+	int top_material(const int i, const int j, const int stack = 0) const
+	{
+		const Slice& s = _slices[slice(i, j, stack)];
+		return (s.size > 0) ? _arena[s.offset + s.size - 1].material : -1;
+	}
+
+	/**
+	 * @brief Get the height of a stack
+	 *
+	 * @param i, j      the position of the cell on the grid
+	 * @param stack     the stack of the cell
+	 * @return double   the sum of the thicknesses of the runs
+	 */
+	double thickness(const int i, const int j, const int stack = 0) const;
+
+	/**
+	 * @brief Get the height of a material in a stack
+	 *
+	 * @param i, j      the position of the cell on the grid
+	 * @param stack     the stack of the cell
+	 * @param material  the material
+	 * @return double   the sum of the thicknesses of the runs of that material
+	 */
+	double thickness(const int i, const int j, const int stack, const int material) const;
+
+	/**
+	 * @brief Put a material at the top of a stack, extending the top run if it is of the same material
+	 *
+	 * @param i, j          the position of the cell on the grid
+	 * @param stack         the stack of the cell
+	 * @param material      the material
+	 * @param thickness     the height to add, ignored if not positive
+	 */
+	void deposit(const int i, const int j, const int stack, const int material, const double thickness);
+
+	/**
+	 * @brief Remove the top of a stack
+	 *
+	 * @param i, j          the position of the cell on the grid
+	 * @param stack         the stack of the cell
+	 * @param thickness     the height to remove
+	 * @param removed       if not null, receives the runs removed from the top to the bottom, the last one possibly partially
+	 * @return double       the height removed, less than thickness if the stack was not high enough
+	 */
+	double remove(const int i, const int j, const int stack, const double thickness, std::vector<Run>* removed = nullptr);
+
+	/**
+	 * @brief Get the number of runs of all the stacks
+	 *
+	 */
+	long total_runs() const;
+
+	/**
+	 * @brief Get the number of bytes used by the runs and the slices of the arena
+	 *
+	 */
+	long memory() const;
+
+	/**
+	 * @brief Move the stacks next to each other, freeing the space of the slices that moved
+	 *
+	 */
+	void compact();
+
+private:
+	/**
+	 * @brief The part of the arena owned by a stack
+	 *
+	 */
+	struct Slice
+	{
+		int offset;     /**< the index of the first run in the arena*/
+		int size;       /**< the number of runs*/
+		int capacity;   /**< the number of runs that fit before the next slice*/
+	};
+
+	/**
+	 * @brief Get the index of the slice of a stack
+	 *
+	 * @throw           out_of_range if the stack is not on the grid
+	 */
+	int slice(const int i, const int j, const int stack) const;
+
+	int _width;                 /**< the size of the grid*/
+	int _height;
+	int _stacks;                /**< the number of stacks of each cell*/
+	std::vector<Slice> _slices; /**< the slices of the stacks of each cell, row after row*/
+	std::vector<Run> _arena;    /**< the runs of all the stacks*/
+	long _unused;               /**< the number of runs of the arena owned by no slice*/
+};
+
+/**
+ * @brief Read material columns written by operator<<
+ *
+ * @param is                the input stream to get the data from
+ * @param columns           the columns replaced by the ones read, left unchanged if the stream fails
+ * @return std::istream&    the original input stream
+ */
+std::istream& operator>>(std::istream& is, MaterialColumns& columns);
+
+/**
+ * @brief Write material columns as the size of their grid and their number of stacks, then the runs of each stack
+ *
+ * @param os                the output stream to save the data to
+ * @param columns           the columns to save
+ * @return std::ostream&    the original output stream
+ */
+std::ostream& operator<<(std::ostream& os, const MaterialColumns& columns);
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Writes text and binary data to a file through a large buffer.
+ * Numbers are formatted without going through the streams
+ *
+ */
+class BufferedWriter
+{
+public:
+	BufferedWriter() = delete;
+	BufferedWriter(const BufferedWriter&) = delete;
+	BufferedWriter& operator=(const BufferedWriter&) = delete;
+	/**
+	 * @brief Open a file for writing
+	 *
+	 * @param filename      the name of the file
+	 * @param buffer_size   the number of bytes kept in memory before writing to the file
+	 */
+	BufferedWriter(const std::string& filename, const int buffer_size = 1 << 20);
+	/**
+	 * @brief Flush the remaining data and close the file
+	 *
+	 */
+	~BufferedWriter();
+
+	/**
+	 * @brief Tells if the file could be opened
+	 *
+	 * @return true     if data can be written
+	 * @return false    if the file could not be opened
+	 */
+	bool is_open() const
+	{
+		return _output.is_open();
+	}
+
+	/**
+	 * @brief Write raw bytes
+	 *
+	 * @param data      the bytes to write (a pointer to an array of size at least n)
+	 * @param n         the number of bytes
+	 */
+	void write(const char* data, const int n);
+
+	/**
+	 * @brief Write a string
+	 *
+	 * @param s         the string to write
+	 */
+	void write(const std::string& s)
+	{
+		write(s.data(), s.size());
+	}
+
+	/**
+	 * @brief Write a single character
+	 *
+	 * @param c         the character to write
+	 */
+	void write_char(const char c)
+	{
+		if(_used == _buffer.size())
+		{
+			flush();
+		}
+
+		_buffer[_used++] = c;
+	}
+
+	/**
+	 * @brief Write an integer as text
+	 *
+	 * @param v         the integer to write
+	 */
+	void write_int(const long v);
+
+	/**
+	 * @brief Write a floating point number as text with a fixed number of decimals, trailing zeros are removed
+	 *
+	 * @param v         the number to write
+	 * @param decimals  the maximal number of decimals, between 0 and 9
+	 */
+	void write_double(const double v, const int decimals = 6);
+
+	/**
+	 * @brief Write an unsigned integer in little endian, whatever the byte order of the machine
+	 *
+	 * @param v         the number to write
+	 * @param bytes     the number of low order bytes of v written, between 1 and 4
+	 */
+	void write_uint(const std::uint32_t v, const int bytes = 4);
+
+	/**
+	 * @brief Write a single precision float in little endian, whatever the byte order of the machine
+	 *
+	 * @param v         the number to write
+	 */
+	void write_float(const float v);
+
+	/**
+	 * @brief Write the content of the buffer to the file
+	 *
+	 */
+	void flush();
+
+private:
+	std::ofstream _output;      /**< the output file*/
+	std::vector<char> _buffer;  /**< the data not yet written to the file*/
+	int _used;                  /**< the number of bytes used in the buffer*/
+};
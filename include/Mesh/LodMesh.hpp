@@ -0,0 +1,33 @@
+#pragma once
+
+#include <DoubleField.hpp>
+#include <Mesh/Mesh.hpp>
+
+/** \addtogroup Mesh
+ * @{
+ */
+
+/**
+ * @brief Generate a simplified mesh of a field with a quadtree.
+ * A node is split while the triangles fanning from its center to its corners are farther than the tolerance from a value of the field.
+ * Each leaf is triangulated from its center through all the corners of the neighbouring leaves lying on its border, so the mesh has no cracks.
+ * Leaves without such corners use two triangles when they are precise enough.
+ * The values are on the y axis, as in DoubleField::export_as_obj
+ *
+ * @param field             the field to mesh
+ * @param tolerance         the maximal vertical distance between the mesh and the values of the field, in world units
+ * @return Mesh             the simplified mesh
+ */
+Mesh generate_lod_mesh(const DoubleField& field, const double tolerance);
+
+/**
+ * @brief Convert an error in pixels into a world space tolerance for generate_lod_mesh
+ *
+ * @param pixel_error       the tolerated error on screen, in pixels
+ * @param distance          the distance between the camera and the terrain
+ * @param fov               the vertical field of view of the camera, in radians
+ * @param viewport_height   the height of the viewport, in pixels
+ * @return double           the size of pixel_error pixels at that distance, in world units
+ */
+double screen_space_tolerance(const double pixel_error, const double distance, const double fov, const int viewport_height);
+/** @}*/
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <Mesh/MeshWriter.hpp>
+
+#include <vector>
+
+/**
+ * @brief Defines an indexed triangle mesh, vertices having a position, a normal and texture coordinates
+ *
+ */
+struct Mesh
+{
+	/**
+	 * @brief Add a vertex to the mesh
+	 *
+	 * @param position          the position of the vertex (x, y, z)
+	 * @param normal            the normal of the vertex (x, y, z)
+	 * @param uv                the texture coordinates of the vertex (u, v)
+	 * @return unsigned int     the index of the new vertex
+	 */
+	unsigned int add_vertex(const double* position, const double* normal, const double* uv);
+
+	/**
+	 * @brief Add a triangle to the mesh
+	 *
+	 * @param a                 the index of the first vertex
+	 * @param b                 the index of the second vertex
+	 * @param c                 the index of the third vertex
+	 */
+	void add_triangle(const unsigned int a, const unsigned int b, const unsigned int c)
+	{
+		indices.push_back(a);
+		indices.push_back(b);
+		indices.push_back(c);
+	}
+
+	/**
+	 * @brief Get the number of vertices
+	 *
+	 * @return int              the number of vertices
+	 */
+	int vertex_number() const
+	{
+		return positions.size() / 3;
+	}
+
+	/**
+	 * @brief Get the number of triangles
+	 *
+	 * @return int              the number of triangles
+	 */
+	int triangle_number() const
+	{
+		return indices.size() / 3;
+	}
+
+	/**
+	 * @brief Write the mesh
+	 *
+	 * @param writer            the output of the mesh
+	 */
+	void write(MeshWriter& writer) const;
+
+	std::vector<double> positions;      /**< the positions of the vertices, as (x, y, z) triplets*/
+	std::vector<double> normals;        /**< the normals of the vertices, as (x, y, z) triplets*/
+	std::vector<double> uvs;            /**< the texture coordinates of the vertices, as (u, v) pairs*/
+	std::vector<unsigned int> indices;  /**< the indices of the vertices of the triangles, 3 per triangle*/
+};
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <Mesh/BufferedWriter.hpp>
+
+#include <string>
+
+/**
+ * @brief Defines an output for a triangle mesh, written in a streaming fashion:
+ * begin, all the vertices, all the triangles and then end
+ *
+ */
+class MeshWriter
+{
+public:
+	virtual ~MeshWriter()
+	{
+	}
+
+	/**
+	 * @brief Start the mesh
+	 *
+	 * @param vertex_number     the number of vertices that will be written
+	 * @param triangle_number   the number of triangles that will be written
+	 */
+	virtual void begin(const int vertex_number, const int triangle_number) = 0;
+
+	/**
+	 * @brief Write a vertex
+	 *
+	 * @param position          the position of the vertex (x, y, z)
+	 * @param normal            the normal of the vertex, normalized (x, y, z)
+	 * @param uv                the texture coordinates of the vertex (u, v)
+	 */
+	virtual void vertex(const double* position, const double* normal, const double* uv) = 0;
+
+	/**
+	 * @brief Write a triangle
+	 *
+	 * @param a                 the index of the first vertex, starting at 0
+	 * @param b                 the index of the second vertex
+	 * @param c                 the index of the third vertex
+	 */
+	virtual void triangle(const unsigned int a, const unsigned int b, const unsigned int c) = 0;
+
+	/**
+	 * @brief End the mesh and write the remaining data
+	 *
+	 */
+	virtual void end() = 0;
+};
+
+/**
+ * @brief Writes a mesh in the Wavefront OBJ text format
+ *
+ */
+class ObjWriter : public MeshWriter
+{
+public:
+	/**
+	 * @brief Construct a new ObjWriter
+	 *
+	 * @param filename          the name of the file
+	 * @param name              the name of the object, no name if empty
+	 */
+	ObjWriter(const std::string& filename, const std::string& name = "");
+
+	void begin(const int vertex_number, const int triangle_number);
+	void vertex(const double* position, const double* normal, const double* uv);
+	void triangle(const unsigned int a, const unsigned int b, const unsigned int c);
+	void end();
+
+private:
+	BufferedWriter _output;     /**< the output file*/
+	std::string _name;          /**< the name of the object*/
+};
+
+/**
+ * @brief Writes a mesh in the PLY format, in ASCII or in binary little endian.
+ * Vertices have a position, a normal and texture coordinates stored as floats
+ *
+ */
+class PlyWriter : public MeshWriter
+{
+public:
+	/**
+	 * @brief Construct a new PlyWriter
+	 *
+	 * @param filename          the name of the file
+	 * @param binary            true to write binary data, false for ASCII
+	 */
+	PlyWriter(const std::string& filename, const bool binary = true);
+
+	void begin(const int vertex_number, const int triangle_number);
+	void vertex(const double* position, const double* normal, const double* uv);
+	void triangle(const unsigned int a, const unsigned int b, const unsigned int c);
+	void end();
+
+private:
+	BufferedWriter _output;     /**< the output file*/
+	bool _binary;               /**< write binary data if true*/
+};
+
+/**
+ * @brief Writes a mesh in a compact indexed binary format, ready to be uploaded to a GPU.
+ * The file starts with the header:
+ * char[4] "TGMB", uint32 version, uint32 vertex number, uint32 index number, uint32 index size (2 or 4 bytes).
+ * Then each vertex is stored with 3 float for the position and 3 int16 for the normal (scaled by 32767),
+ * followed by all the indices as uint16 if there are at most 65536 vertices, uint32 otherwise.
+ * All the values are little endian
+ *
+ */
+class BinaryMeshWriter : public MeshWriter
+{
+public:
+	/**
+	 * @brief Construct a new BinaryMeshWriter
+	 *
+	 * @param filename          the name of the file
+	 */
+	BinaryMeshWriter(const std::string& filename);
+
+	void begin(const int vertex_number, const int triangle_number);
+	void vertex(const double* position, const double* normal, const double* uv);
+	void triangle(const unsigned int a, const unsigned int b, const unsigned int c);
+	void end();
+
+private:
+	BufferedWriter _output;     /**< the output file*/
+	bool _short_indices;        /**< true if the indices are written on 2 bytes*/
+};
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <SimpleLayerMap.hpp>
+#include <MaterialColumns.hpp>
+
+#include <memory>
 
 /**
  * @brief Defines a layered field
@@ -17,15 +20,15 @@ public:
 	 *
 	 * @param map       the Multi Layer Map to copy
 	 */
-	MultiLayerMap(const MultiLayerMap& map) : DoubleField(map), _layers(map._layers) {}
+	MultiLayerMap(const MultiLayerMap& map) : DoubleField(map), _layers(map._layers), _materials(map._materials), _version(map._version) {}
 	/**
 	 * @brief Construct a new Multi Layer Map object from an other one
 	 *
 	 * @param map       the Multi Layer Map to copy
 	 */
-	MultiLayerMap(MultiLayerMap&& map) : DoubleField(std::move(map)), _layers(std::move(map._layers)) {}
+	MultiLayerMap(MultiLayerMap&& map) : DoubleField(std::move(map)), _layers(std::move(map._layers)), _materials(std::move(map._materials)), _version(map._version) {}
 	
-	MultiLayerMap(const Grid2d& d) : DoubleField(d) 
+	MultiLayerMap(const Grid2d& d) : DoubleField(d), _version(new_version())
 	{
 	}
 	/**
@@ -37,7 +40,7 @@ public:
 	 * @param b         the second point of the grid
 	 */
 	MultiLayerMap(const int width, const int height, const Eigen::Vector2d a = {0, 0}, const Eigen::Vector2d b = {1, 1})
-		: DoubleField(width, height, a, b) {}
+		: DoubleField(width, height, a, b), _version(new_version()) {}
 
 	/**
 	 * @brief Get the value of the field at a given cell
@@ -47,6 +50,29 @@ public:
 	 */
 	virtual double value(const int i, const int j) const;
 
+	/**
+	 * @brief Get the values of a row of the map
+	 *
+	 * @param j         the row
+	 * @param values    the sums of the values in every layer (a pointer to an array of size at least grid_width)
+	 */
+	virtual void get_row(const int j, double* values) const;
+
+	/**
+	 * @brief Get the version of the Multi Layer Map.
+	 * The version changes when any of the layers is modified or when layers are added
+	 *
+	 * @return unsigned long    an identifier of the current state of the map
+	 */
+	virtual unsigned long version() const;
+
+	/**
+	 * @brief Release the tiles of zeros of every layer, as the sediments left empty by the erosion, the version being unchanged
+	 *
+	 * @return int      the number of tiles released
+	 */
+	int compact();
+
 	/**
 	 * @brief Get the number of layers
 	 *
@@ -86,6 +112,26 @@ public:
 	 */
 	SimpleLayerMap generate_field() const;
 
+	/**
+	 * @brief Generate a Multi Layer Map with half the resolution, each layer being downsampled
+	 *
+	 * @param map               the source map, at least 3 cells along each axis
+	 * @return MultiLayerMap    the downsampled map
+	 * @see SimpleLayerMap::generate_downsampled
+	 */
+	static MultiLayerMap generate_downsampled(const MultiLayerMap& map);
+
+	/**
+	 * @brief Generate a Multi Layer Map by interpolating each layer of a map on an other grid
+	 *
+	 * @param map               the source map
+	 * @param grid              the grid of the resulting map
+	 * @param bicubic           use a bicubic interpolation if true, a bilinear one otherwise
+	 * @return MultiLayerMap    the resampled map
+	 * @see SimpleLayerMap::generate_resampled
+	 */
+	static MultiLayerMap generate_resampled(const MultiLayerMap& map, const Grid2d& grid, const bool bicubic = false);
+
 	/**
 	 * @brief Get the sum of all values at one point.
 	 * This is done by summing all the Scalar Fields together
@@ -115,6 +161,7 @@ public:
 	void set_field(int field_index, const SimpleLayerMap& field)
 	{
 		_layers.at(field_index).copy_values(field);
+		_version = new_version();
 	}
 	/**
 	 * @brief Set the values of a whole field
@@ -125,6 +172,7 @@ public:
 	void set_field(int field_index, SimpleLayerMap&& field)
 	{
 		_layers.at(field_index).copy_values(std::move(field));
+		_version = new_version();
 	}
 
 	/**
@@ -135,6 +183,7 @@ public:
 	void add_field(const SimpleLayerMap& field)
 	{
 		_layers.push_back(field);
+		_version = new_version();
 	}
 	/**
 	 * @brief Add a field to the Multi Layer Map
@@ -144,6 +193,7 @@ public:
 	void add_field(SimpleLayerMap&& field)
 	{
 		_layers.push_back(std::move(field));
+		_version = new_version();
 	}
 
 	/**
@@ -153,6 +203,68 @@ public:
 	 */
 	SimpleLayerMap& new_layer();
 
+	/**
+	 * @brief Tells if the materials of the layers are known
+	 *
+	 */
+	bool has_materials() const
+	{
+		return _materials != nullptr;
+	}
+
+	/**
+	 * @brief Get the materials of the layers, the stack k of a cell being the materials of the layer k.
+	 * They are shared between the copies of the map, and are only updated by the erosions working on materials and by the transports
+	 *
+	 * @return const MaterialColumns&   the materials
+	 * @throw                           logic_error if the materials are not known
+	 */
+	const MaterialColumns& materials() const;
+
+	/**
+	 * @brief Get the materials of the layers to modify them, copying them if they are shared with a copy of the map
+	 *
+	 * @return MaterialColumns&     the materials
+	 * @throw                       logic_error if the materials are not known
+	 */
+	MaterialColumns& mutable_materials();
+
+	/**
+	 * @brief Set the materials of the layers
+	 *
+	 * @param materials     the materials, with a stack for each layer at least
+	 * @throw               invalid_argument if the materials are not on the same grid or have fewer stacks than layers
+	 */
+	void set_materials(MaterialColumns materials);
+
+	/**
+	 * @brief Forget the materials of the layers
+	 *
+	 */
+	void clear_materials()
+	{
+		_materials.reset();
+	}
+
+	/**
+	 * @brief Use the materials of an other map, without copying them
+	 *
+	 * @param map           the map on the same grid to get the materials from
+	 */
+	void share_materials(const MultiLayerMap& map)
+	{
+		_materials = map._materials;
+	}
+
+	/**
+	 * @brief Tells if the materials are the same as the materials of an other map, which means they were not modified since one was copied from the other
+	 *
+	 */
+	bool shares_materials(const MultiLayerMap& map) const
+	{
+		return _materials == map._materials;
+	}
+
 	/**
 	 * @brief Reshape the MultiLayerMap to a new size and position
 	 *
@@ -190,20 +302,23 @@ public:
 
 protected:
 	std::vector<SimpleLayerMap> _layers; /**< Array of simple layer map*/
+	std::shared_ptr<MaterialColumns> _materials; /**< the materials of the layers, null if they are not known*/
+	unsigned long _version;              /**< version of the structure of the map, the layers have their own*/
 };
 
 /**
- * @brief input flux operator
+ * @brief input flux operator, the materials being read if the data has them and forgotten otherwise
  * 
  * @param is 					the input stream to get the data from
  * @param m 					the target multilayermap
  * @return std::istream& 		the original input stream
+ * @throw 					invalid_argument if the materials read are not on the grid of the map
  */
 std::istream& operator>>(std::istream& is, MultiLayerMap& m);
 
 
 /**
- * @brief output flux operator
+ * @brief output flux operator, the materials being written after the layers if they are known
  * 
  * @param os 					the output stream to save the data ta
  * @param m 					the multilayermap to save
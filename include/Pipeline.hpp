@@ -0,0 +1,309 @@
+#pragma once
+
+#include <MassAudit.hpp>
+#include <MultiLayerMap.hpp>
+#include <Weather/Erosion.hpp>
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Defines a stage of a pipeline: its type and its parameters as written in the pipeline file
+ *
+ */
+class PipelineStage
+{
+public:
+	PipelineStage() = delete;
+	/**
+	 * @brief Construct a new stage without parameters
+	 *
+	 * @param type          the type of the stage
+	 * @param line          the line of the stage in the pipeline file, used for the error messages
+	 */
+	PipelineStage(const std::string& type, const int line)
+		: _type(type), _line(line)
+	{
+	}
+
+	/**
+	 * @brief Get the type of the stage
+	 *
+	 * @return const std::string&   the type of the stage
+	 */
+	const std::string& type() const
+	{
+		return _type;
+	}
+
+	/**
+	 * @brief Get the line of the stage in the pipeline file
+	 *
+	 * @return int          the line of the header of the stage
+	 */
+	int line() const
+	{
+		return _line;
+	}
+
+	/**
+	 * @brief Set a parameter of the stage
+	 *
+	 * @param key           the name of the parameter
+	 * @param value         the value of the parameter, as written in the file
+	 */
+	void set(const std::string& key, const std::string& value)
+	{
+		_parameters[key] = value;
+	}
+
+	/**
+	 * @brief Tells if a parameter is set
+	 *
+	 * @param key           the name of the parameter
+	 * @return true         if the parameter is set
+	 * @return false        otherwise
+	 */
+	bool has(const std::string& key) const
+	{
+		return _parameters.count(key) != 0;
+	}
+
+	/**
+	 * @brief Get the names of all the parameters that are set
+	 *
+	 * @return std::vector<std::string>     the names of the parameters
+	 */
+	std::vector<std::string> keys() const;
+
+	/**
+	 * @brief Get a parameter as a string
+	 *
+	 * @param key           the name of the parameter
+	 * @param default_value the value if the parameter is not set
+	 * @return std::string  the value of the parameter
+	 */
+	std::string get_string(const std::string& key, const std::string& default_value = "") const;
+
+	/**
+	 * @brief Get a parameter as a number
+	 *
+	 * @param key           the name of the parameter
+	 * @param default_value the value if the parameter is not set
+	 * @return double       the value of the parameter
+	 * @throw               invalid_argument if the parameter is not a number
+	 */
+	double get_double(const std::string& key, const double default_value = 0) const;
+
+	/**
+	 * @brief Get a parameter as an integer
+	 *
+	 * @param key           the name of the parameter
+	 * @param default_value the value if the parameter is not set
+	 * @return int          the value of the parameter
+	 * @throw               invalid_argument if the parameter is not an integer
+	 */
+	int get_int(const std::string& key, const int default_value = 0) const;
+
+	/**
+	 * @brief Get a parameter as a boolean, written true/false, yes/no, on/off or 1/0
+	 *
+	 * @param key           the name of the parameter
+	 * @param default_value the value if the parameter is not set
+	 * @return bool         the value of the parameter
+	 * @throw               invalid_argument if the parameter is not a boolean
+	 */
+	bool get_bool(const std::string& key, const bool default_value = false) const;
+
+	/**
+	 * @brief Get a parameter as a list of numbers separated by spaces
+	 *
+	 * @param key           the name of the parameter
+	 * @return std::vector<double>  the values of the parameter, empty if it is not set
+	 * @throw               invalid_argument if a value is not a number
+	 */
+	std::vector<double> get_doubles(const std::string& key) const;
+
+private:
+	/**
+	 * @brief Throw an error about a parameter of the stage
+	 *
+	 */
+	void error(const std::string& key, const std::string& message) const;
+
+	std::string _type;                                  /**< the type of the stage*/
+	int _line;                                          /**< the line of the stage in the pipeline file*/
+	std::map<std::string, std::string> _parameters;     /**< the parameters of the stage*/
+};
+
+/**
+ * @brief Defines what happened to a stage during a run
+ *
+ */
+struct StageReport
+{
+	std::string type;       /**< the type of the stage*/
+	bool skipped;           /**< true if the stage is disabled in the pipeline file*/
+	bool resumed;           /**< true if the stage was not run because a later checkpoint was loaded*/
+	double seconds;         /**< the duration of the stage*/
+	ErosionStatistics erosion; /**< the iterations of the stage, none if it does not iterate an erosion*/
+	MassLeak mass;          /**< the mass gained by the terrain during the stage, not comparable if the pipeline is not audited*/
+};
+
+/**
+ * @brief Create the directories of a path up to its last /, the missing parents included
+ *
+ * @param path      an output prefix or a file name, whose directories are created
+ */
+void make_parent_directories(const std::string& path);
+
+/**
+ * @brief Defines a terrain generation pipeline read from a file.
+ * The file is made of sections, each one starting with a [type] line followed by key = value lines, # starting a comment.
+ * The optional [pipeline] section sets the name, the output prefix, the seed, the checkpoints, the resume
+ * and the maximal number of threads of the shared ThreadPool used by the run.
+ * With audit = true, the mass of each layer is measured before and after each stage and the leaks are logged,
+ * split in audit_bands bands of audit_band_width cells along the borders and the interior, see MassAudit.
+ * The optional [sweep] and [batch] sections turn the pipeline into a batch of jobs, see BatchScheduler.
+ * Every other section is a stage, run in the order of the file:
+ * terrain, erosion, layered_erosion, transport, droplets, vegetation and export.
+ * The erosion, layered_erosion and transport stages do at most iterations iterations, stopping early when an iteration
+ * moves less than the convergence fraction of the mass moved by the first one.
+ * Any stage can be disabled with skip = true
+ *
+ */
+class Pipeline
+{
+public:
+	Pipeline() = delete;
+
+	/**
+	 * @brief Read a pipeline
+	 *
+	 * @param input         the stream to read the pipeline from
+	 * @param name          the name used in the error messages and as the default name of the pipeline
+	 * @return Pipeline     the pipeline
+	 * @throw               invalid_argument if the pipeline is not well formed
+	 */
+	static Pipeline parse(std::istream& input, const std::string& name = "pipeline");
+
+	/**
+	 * @brief Read a pipeline file
+	 *
+	 * @param filename      the name of the file
+	 * @return Pipeline     the pipeline
+	 * @throw               invalid_argument if the file can't be read or is not well formed
+	 */
+	static Pipeline load(const std::string& filename);
+
+	/**
+	 * @brief Get the name of the pipeline
+	 *
+	 * @return std::string  the name of the pipeline
+	 */
+	std::string name() const
+	{
+		return _settings.get_string("name", _name);
+	}
+
+	/**
+	 * @brief Get the settings of the pipeline
+	 *
+	 * @return const PipelineStage&     the [pipeline] section
+	 */
+	const PipelineStage& settings() const
+	{
+		return _settings;
+	}
+
+	/**
+	 * @brief Get the parameters swept by a batch
+	 *
+	 * @return const PipelineStage&     the [sweep] section, its parameters being named section.parameter
+	 */
+	const PipelineStage& sweep() const
+	{
+		return _sweep;
+	}
+
+	/**
+	 * @brief Get the settings of a batch
+	 *
+	 * @return const PipelineStage&     the [batch] section
+	 */
+	const PipelineStage& batch() const
+	{
+		return _batch;
+	}
+
+	/**
+	 * @brief Get a copy of the pipeline with a parameter changed
+	 *
+	 * @param name          the name of the parameter as section.parameter, set in every stage of that section
+	 * @param value         the new value of the parameter
+	 * @return Pipeline     the modified pipeline
+	 * @throw               invalid_argument if the parameter does not exist or there is no such stage
+	 */
+	Pipeline with_parameter(const std::string& name, const std::string& value) const;
+
+	/**
+	 * @brief Get the number of stages
+	 *
+	 * @return int          the number of stages
+	 */
+	int stage_number() const
+	{
+		return _stages.size();
+	}
+
+	/**
+	 * @brief Get a stage
+	 *
+	 * @param index         the index of the stage
+	 * @return const PipelineStage&     the stage
+	 */
+	const PipelineStage& stage(const int index) const
+	{
+		return _stages.at(index);
+	}
+
+	/**
+	 * @brief Run the stages of the pipeline.
+	 * When checkpoints are enabled, the terrain is saved after each stage modifying it,
+	 * and a resumed run starts after the last checkpoint found
+	 *
+	 * @param log           the output of the progress and timing messages
+	 * @return std::vector<StageReport>     a report for each stage
+	 * @throw               invalid_argument if a parameter is invalid
+	 */
+	std::vector<StageReport> run(std::ostream& log) const;
+
+	/**
+	 * @brief Run the stages of the pipeline on a given terrain
+	 *
+	 * @param mlm           the terrain, replaced by the terrain stage if there is one
+	 * @param log           the output of the progress and timing messages
+	 * @return std::vector<StageReport>     a report for each stage
+	 * @see run
+	 */
+	std::vector<StageReport> run(MultiLayerMap& mlm, std::ostream& log) const;
+
+private:
+	/**
+	 * @brief Construct a new empty Pipeline
+	 *
+	 * @param name          the default name of the pipeline
+	 */
+	Pipeline(const std::string& name)
+		: _name(name), _settings("pipeline", 0), _sweep("sweep", 0), _batch("batch", 0)
+	{
+	}
+
+	std::string _name;                      /**< the default name of the pipeline*/
+	PipelineStage _settings;                /**< the settings of the pipeline*/
+	PipelineStage _sweep;                   /**< the parameters swept by a batch*/
+	PipelineStage _batch;                   /**< the settings of a batch*/
+	std::vector<PipelineStage> _stages;     /**< the stages, in the order of execution*/
+};
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <atomic>
+#include <iostream>
+#include <string>
+
+/**
+ * @brief Collects the duration of scopes and the value of counters of the library, for all the threads.
+ * Nothing is recorded until the profiler is enabled, a disabled scope or counter costing a single test.
+ * The records are written as a Chrome trace, readable by chrome://tracing or Perfetto, and as a summary table
+ *
+ */
+class Profiler
+{
+public:
+	Profiler() = delete;
+
+	/**
+	 * @brief Enable or disable the recording
+	 *
+	 * @param enabled       true to record the scopes and counters
+	 */
+	static void enable(const bool enabled = true);
+
+	/**
+	 * @brief Tells if the recording is enabled
+	 *
+	 * @return true         if the scopes and counters are recorded
+	 * @return false        otherwise
+	 */
+	static bool is_enabled()
+	{
+		return _enabled.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * @brief Remove all the records. Must not be called while profiled code is running
+	 *
+	 */
+	static void reset();
+
+	/**
+	 * @brief Get the identifier of a counter, created the first time its name is given
+	 *
+	 * @param name          the name of the counter
+	 * @return int          the identifier of the counter
+	 * @throw               length_error if there are too many counters
+	 */
+	static int counter_id(const std::string& name);
+
+	/**
+	 * @brief Add a value to a counter for the current thread
+	 *
+	 * @param counter       the identifier of the counter
+	 * @param n             the value to add
+	 */
+	static void add(const int counter, const long n);
+
+	/**
+	 * @brief Get the total of a counter over all the threads
+	 *
+	 * @param name          the name of the counter
+	 * @return long         the total, 0 if the counter does not exist
+	 */
+	static long counter(const std::string& name);
+
+	/**
+	 * @brief Get a name that stays valid until the end of the program
+	 *
+	 * @param name          the name
+	 * @return const char*  the stored name
+	 */
+	static const char* intern(const std::string& name);
+
+	/**
+	 * @brief Get the current time
+	 *
+	 * @return long long    the number of microseconds since the first use of the profiler
+	 */
+	static long long now();
+
+	/**
+	 * @brief Record a scope of the current thread
+	 *
+	 * @param name          the name of the scope, valid until the end of the program
+	 * @param start         the start of the scope, given by now()
+	 * @param duration      the duration of the scope, in microseconds
+	 */
+	static void record(const char* name, const long long start, const long long duration);
+
+	/**
+	 * @brief Write the records as a Chrome trace. Must not be called while profiled code is running
+	 *
+	 * @param filename      the name of the json file
+	 * @throw               invalid_argument if the file can't be written
+	 */
+	static void write_trace(const std::string& filename);
+
+	/**
+	 * @brief Write the total time of each scope and the total of each counter. Must not be called while profiled code is running
+	 *
+	 * @param output        the stream to write the table to
+	 */
+	static void write_summary(std::ostream& output);
+
+private:
+	static std::atomic<bool> _enabled;  /**< tells if the recording is enabled*/
+};
+
+/**
+ * @brief Records the duration of the scope it is declared in, if the profiler is enabled when it is constructed
+ *
+ */
+class ProfileScope
+{
+public:
+	ProfileScope() = delete;
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+	/**
+	 * @brief Start recording a scope
+	 *
+	 * @param name          the name of the scope, a string literal
+	 */
+	explicit ProfileScope(const char* name)
+		: _name(Profiler::is_enabled() ? name : nullptr), _start(_name ? Profiler::now() : 0)
+	{
+	}
+
+	/**
+	 * @brief Start recording a scope with a computed name
+	 *
+	 * @param name          the name of the scope
+	 */
+	explicit ProfileScope(const std::string& name)
+		: _name(Profiler::is_enabled() ? Profiler::intern(name) : nullptr), _start(_name ? Profiler::now() : 0)
+	{
+	}
+
+	/**
+	 * @brief Record the scope
+	 *
+	 */
+	~ProfileScope()
+	{
+		if(_name)
+		{
+			Profiler::record(_name, _start, Profiler::now() - _start);
+		}
+	}
+
+private:
+	const char* _name;      /**< the name of the scope, null if it is not recorded*/
+	long long _start;       /**< the start of the scope*/
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+/**
+ * @brief Record the duration of the current scope under a name
+ *
+ */
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+
+/**
+ * @brief Add a value to a counter named by a string literal
+ *
+ */
+#define PROFILE_COUNT(name, n) \
+	do \
+	{ \
+		if(Profiler::is_enabled()) \
+		{ \
+			static const int profile_counter = Profiler::counter_id(name); \
+			Profiler::add(profile_counter, n); \
+		} \
+	} \
+	while(0)
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <atomic>
+#include <stdexcept>
+
+/**
+ * @brief Thrown by report_progress when the operation is cancelled
+ *
+ */
+class JobCancelled : public std::runtime_error
+{
+public:
+	JobCancelled()
+		: std::runtime_error("cancelled")
+	{
+	}
+};
+
+/**
+ * @brief Defines the progress of a long operation, read and cancelled from an other thread
+ *
+ */
+class Progress
+{
+public:
+	/**
+	 * @brief Construct a new progress at 0
+	 *
+	 */
+	Progress()
+		: _fraction(0), _cancelled(false)
+	{
+	}
+	Progress(const Progress&) = delete;
+	Progress& operator=(const Progress&) = delete;
+
+	/**
+	 * @brief Get the fraction of the operation done
+	 *
+	 * @return double       the fraction, between 0 and 1
+	 */
+	double fraction() const
+	{
+		return _fraction;
+	}
+
+	/**
+	 * @brief Set the fraction of the operation done
+	 *
+	 * @param fraction      the fraction, between 0 and 1
+	 */
+	void set_fraction(const double fraction)
+	{
+		_fraction = fraction;
+	}
+
+	/**
+	 * @brief Ask the operation to stop at its next report
+	 *
+	 */
+	void cancel()
+	{
+		_cancelled = true;
+	}
+
+	/**
+	 * @brief Tells if the operation is cancelled
+	 *
+	 * @return true         if cancel was called
+	 * @return false        otherwise
+	 */
+	bool is_cancelled() const
+	{
+		return _cancelled;
+	}
+
+	/**
+	 * @brief Restart the progress at 0, not cancelled
+	 *
+	 */
+	void reset()
+	{
+		_fraction = 0;
+		_cancelled = false;
+	}
+
+private:
+	std::atomic<double> _fraction;  /**< the fraction of the operation done*/
+	std::atomic<bool> _cancelled;   /**< tells if the operation is cancelled*/
+};
+
+/**
+ * @brief Sets the progress the current thread reports to, while it exists.
+ * Scopes can be nested to split an operation in steps, each step reporting from 0 to 1 on its part of the parent range.
+ * The progress and the range are part of the task context, so the tasks of the parallel loops started in the scope
+ * report to the same progress and stop when it is cancelled
+ *
+ */
+class ProgressScope
+{
+public:
+	ProgressScope() = delete;
+	ProgressScope(const ProgressScope&) = delete;
+	ProgressScope& operator=(const ProgressScope&) = delete;
+
+	/**
+	 * @brief Report to a progress, on its whole range
+	 *
+	 * @param progress      the progress
+	 */
+	explicit ProgressScope(Progress& progress);
+
+	/**
+	 * @brief Report a step of the current operation, does nothing if the thread has no progress
+	 *
+	 * @param begin, end    the part of the current range used by the step, between 0 and 1
+	 */
+	ProgressScope(const double begin, const double end);
+
+	/**
+	 * @brief Restore the previous progress and range
+	 *
+	 */
+	~ProgressScope();
+
+private:
+	Progress* _previous;        /**< the previous progress of the task context*/
+	double _previous_begin;     /**< the previous beginning of the range*/
+	double _previous_end;       /**< the previous end of the range*/
+};
+
+/**
+ * @brief Report the progress of the current thread, if it has one.
+ * A cancelled operation stops in the middle of its work, so it should work on a copy of its data
+ *
+ * @param fraction      the fraction of the current step done
+ * @throw               JobCancelled if the operation is cancelled
+ */
+void report_progress(const double fraction);
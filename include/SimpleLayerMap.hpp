@@ -1,18 +1,24 @@
 #pragma once
 
 #include <DoubleField.hpp>
+#include <TileStorage.hpp>
 
+#include <atomic>
 #include <vector>
 #include <fstream>
 
+struct SurfaceMaps;
+
 /**
- * @brief Defines a field of values spread across a grid on the plane on one layer
+ * @brief Defines a field of values spread across a grid on the plane on one layer.
+ * The values are stored in tiles shared by the copies of the layer, a copy only duplicating the tiles it modifies
  *
  */
 class SimpleLayerMap : public DoubleField
 {
 public:
 	using DoubleField::value;
+	using DoubleField::histogram;
 	/**
 	 * @brief Generate a layer map of the slope from a field
 	 *
@@ -20,6 +26,72 @@ public:
 	 * @return SimpleLayerMap   the resulting layer
 	 */
 	static SimpleLayerMap generate_slope_map(const DoubleField& field);
+
+	/**
+	 * @brief Generate the layer maps of the normals from a field
+	 *
+	 * @param field                         the source field to use
+	 * @return std::vector<SimpleLayerMap>  the x, y and z coordinates of the normals, one layer each
+	 */
+	static std::vector<SimpleLayerMap> generate_normal_maps(const DoubleField& field);
+
+	/**
+	 * @brief Generate the layer map of the aspect from a field
+	 *
+	 * @param field             the source field to use
+	 * @return SimpleLayerMap   the direction of the steepest descent on the plane, in radians between -pi and pi, 0 on flat cells
+	 */
+	static SimpleLayerMap generate_aspect_map(const DoubleField& field);
+
+	/**
+	 * @brief Generate the gradients, slopes, aspects and normals of a field in a single parallel pass over its rows
+	 *
+	 * @param field             the source field to use
+	 * @return SurfaceMaps      the layers of each quantity
+	 */
+	static SurfaceMaps generate_surface_maps(const DoubleField& field);
+
+	/**
+	 * @brief Generate a layer with half the resolution of a field.
+	 * Each value is the mean of a block of 2x2 values, centered on that block, so that the sum of each value
+	 * multiplied by the number of values of its block is the sum of the values of the field.
+	 * Blocks are incomplete on the last row and column when the grid has an odd size
+	 *
+	 * @param field             the source field to use, at least 3 cells along each axis
+	 * @return SimpleLayerMap   the downsampled layer
+	 */
+	static SimpleLayerMap generate_downsampled(const SimpleLayerMap& field);
+
+	/**
+	 * @brief Get the grid of the downsampled layers of a field
+	 *
+	 * @param field             the field to downsample
+	 * @return Grid2d           the grid with half the resolution, its points at the center of the blocks of 2x2 cells
+	 */
+	static Grid2d downsampled_grid(const Grid2d& field);
+
+	/**
+	 * @brief Get the number of values of a field averaged in a cell of its downsampled layer
+	 *
+	 * @param field             the field that was downsampled
+	 * @param i, j              the position of the cell in the downsampled layer
+	 * @return int              the number of values of the block, between 1 and 4
+	 */
+	static int downsampled_block_size(const Grid2d& field, const int i, const int j)
+	{
+		return std::min(2, field.grid_width() - 2 * i) * std::min(2, field.grid_height() - 2 * j);
+	}
+
+	/**
+	 * @brief Generate a layer by interpolating a field on an other grid.
+	 * Positions outside of the field use the values of its border
+	 *
+	 * @param field             the source field to use
+	 * @param grid              the grid of the resulting layer
+	 * @param bicubic           use a Catmull-Rom bicubic interpolation if true, a bilinear one otherwise
+	 * @return SimpleLayerMap   the resampled layer
+	 */
+	static SimpleLayerMap generate_resampled(const SimpleLayerMap& field, const Grid2d& grid, const bool bicubic = false);
 public:
 	SimpleLayerMap() = delete;
 	/**
@@ -28,24 +100,31 @@ public:
 	 * @param hf        the Scalar field to copy
 	 */
 	SimpleLayerMap(const SimpleLayerMap& hf)
-		: DoubleField(hf), _values(hf._values) {}
+		: DoubleField(hf), _values(hf._values), _version(hf.version()), _modified(false) {}
 	/**
 	 * @brief Construct a new simple layer field object from an other layer
 	 *
 	 * @param hf        the Scalar Field to copy
 	 */
 	SimpleLayerMap(SimpleLayerMap&& hf)
-		: DoubleField(std::move(hf)), _values(std::move(hf._values)) {}
+		: DoubleField(std::move(hf)), _values(std::move(hf._values)), _version(hf.version()), _modified(false) {}
 	/**
 	 * @brief Construct a new empty layer object from a grid
 	 *
 	 * @param g         the initial grid of the Scalar Field
 	 */
 	SimpleLayerMap(const Grid2d &g)
-		: DoubleField(g)
+		: DoubleField(g), _values(g.grid_width(), g.grid_height()), _version(new_version()), _modified(false)
 	{
-		_values.resize(g.cell_number());
 	}
+	/**
+	 * @brief Construct a new layer object from a grid and the values of its cells, computed elsewhere
+	 *
+	 * @param g         the grid of the Scalar Field
+	 * @param values    the values of the cells, row after row
+	 * @throw           invalid_argument if there is not a value for each cell
+	 */
+	SimpleLayerMap(const Grid2d &g, std::vector<double>&& values);
 	/**
 	 * @brief Construct a new simple layer field object from a box
 	 *
@@ -54,9 +133,8 @@ public:
 	 * @param height    the number of cells along the height of the grid
 	 */
 	SimpleLayerMap(const Box2d &b, const int width, const int height)
-		: DoubleField(b, width, height)
+		: DoubleField(b, width, height), _values(width, height), _version(new_version()), _modified(false)
 	{
-		_values.resize(width * height);
 	}
 	/**
 	 * @brief Construct a new simple layer field object
@@ -67,9 +145,8 @@ public:
 	 * @param b         the second point of the grid
 	 */
 	SimpleLayerMap(const int width, const int height, const Eigen::Vector2d a = {0, 0}, const Eigen::Vector2d b = {1, 1})
-		: DoubleField(width, height, a, b)
+		: DoubleField(width, height, a, b), _values(width, height), _version(new_version()), _modified(false)
 	{
-		_values.resize(width * height);
 	}
 
 	/**
@@ -80,9 +157,79 @@ public:
 	 */
 	virtual double value(const int i, const int j) const
 	{
-		return _values.at(index(i, j));
+		if(i < 0 || i >= _grid_width || j < 0 || j >= _grid_height)
+		{
+			const Eigen::Vector2i p = cell_of_index(i, j);
+			return _values.get(p(0), p(1));
+		}
+
+		return _values.get(i, j);
+	}
+
+	/**
+	 * @brief Get the storage of the values, to process them tile by tile
+	 *
+	 * @return const TileStorage&   the tiles of the field
+	 */
+	const TileStorage& storage() const
+	{
+		return _values;
+	}
+
+	/**
+	 * @brief Get access to the storage of the values, to modify them tile by tile
+	 *
+	 * @return TileStorage&         the tiles of the field
+	 */
+	TileStorage& mutable_storage()
+	{
+		mark_modified();
+		return _values;
+	}
+
+	/**
+	 * @brief Release the tiles of zeros, the values and the version being unchanged
+	 *
+	 * @return int      the number of tiles released, see TileStorage::compact
+	 */
+	int compact()
+	{
+		return _values.compact();
 	}
 
+	/**
+	 * @brief Get the version of the values of the field.
+	 * Any non const access to the values is considered as a modification.
+	 * It can be called from several threads reading the field at the same time.
+	 *
+	 * @return unsigned long    an identifier of the current state of the values
+	 */
+	virtual unsigned long version() const;
+
+	/**
+	 * @brief Get the values of a row of the field, copied from the tiles
+	 *
+	 * @param j         the row
+	 * @param values    the values of the row (a pointer to an array of size at least grid_width)
+	 */
+	virtual void get_row(const int j, double* values) const;
+
+	/**
+	 * @brief Get the min, max, sum, mean and variance of the values of the field in a single pass
+	 *
+	 * @return FieldStatistics  the statistics of the field
+	 */
+	virtual FieldStatistics statistics() const;
+
+	/**
+	 * @brief Get the histogram of the values of the field on a given range
+	 *
+	 * @param min, max          the range of the histogram
+	 * @param bins              the number of bins
+	 * @return Histogram        the histogram of the field
+	 */
+	virtual Histogram histogram(const double min, const double max, const int bins = 256) const;
+
 	/**
 	 * @brief Set the value of a cell of the field
 	 *
@@ -109,7 +256,15 @@ public:
 	 */
 	double& at(const int i, const int j)
 	{
-		return _values.at(index(i, j));
+		mark_modified();
+
+		if(i < 0 || i >= _grid_width || j < 0 || j >= _grid_height)
+		{
+			const Eigen::Vector2i p = cell_of_index(i, j);
+			return _values.at(p(0), p(1));
+		}
+
+		return _values.at(i, j);
 	}
 
 	/**
@@ -236,6 +391,8 @@ public:
 	/**
 	 * @brief Multiplication assignment operator
 	 *
+	 * The empty tiles stay empty unless the other factor is NaN or infinite, since 0 * NaN and 0 * inf are NaN.
+	 *
 	 * @param sf            the Scalar field to multiply
 	 * @return SimpleLayerMap& a reference to this Scalar Field
 	 */
@@ -251,6 +408,8 @@ public:
 	/**
 	 * @brief Multiplication assignment operator
 	 *
+	 * The empty tiles stay empty unless the other factor is NaN or infinite, since 0 * NaN and 0 * inf are NaN.
+	 *
 	 * @param d             the double to multiply
 	 * @return SimpleLayerMap& a reference to this Scalar Field
 	 */
@@ -265,5 +424,50 @@ public:
 	friend SimpleLayerMap operator*(SimpleLayerMap lsf, const double& rd);
 
 protected:
-	std::vector<double> _values;    /**< array containing all the values of the field*/
+	/**
+	 * @brief Get the cell of the index of a position outside of the grid, as when the values were in a single array
+	 *
+	 * @param i, j              the position
+	 * @return Eigen::Vector2i  the cell at the index of the position
+	 * @throw                   invalid_argument or out_of_range if the index is outside of the grid
+	 */
+	Eigen::Vector2i cell_of_index(const int i, const int j) const
+	{
+		const int k = index(i, j);
+
+		if(k < 0)
+		{
+			throw std::out_of_range("wrong access to a value in the Field");
+		}
+
+		return posi_from_index(k);
+	}
+
+	/**
+	 * @brief Tell that the values may have changed, the version being renewed by the next call to version
+	 *
+	 */
+	void mark_modified()
+	{
+		_modified.store(true, std::memory_order_relaxed);
+	}
+
+	TileStorage _values;                            /**< tiles containing all the values of the field*/
+	mutable std::atomic<unsigned long> _version;    /**< version of the values, renewed lazily after a modification*/
+	mutable std::atomic<bool> _modified;            /**< tells if the values may have changed since the version was given*/
+};
+
+/**
+ * @brief The layers describing the surface of a field, as computed by SimpleLayerMap::generate_surface_maps
+ *
+ */
+struct SurfaceMaps
+{
+	SimpleLayerMap gradient_x;  /**< the gradient of the field, as computed by DoubleField::gradient*/
+	SimpleLayerMap gradient_y;
+	SimpleLayerMap slope;       /**< the norm of the gradient*/
+	SimpleLayerMap aspect;      /**< the direction of the steepest descent, see SimpleLayerMap::generate_aspect_map*/
+	SimpleLayerMap normal_x;    /**< the normal, as computed by DoubleField::normal*/
+	SimpleLayerMap normal_y;
+	SimpleLayerMap normal_z;
 };
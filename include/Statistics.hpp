@@ -0,0 +1,218 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+
+/**
+ * @brief Defines the statistics of a set of values, computed in a single pass.
+ * Statistics of separate blocks of values can be merged together
+ *
+ */
+struct FieldStatistics
+{
+	/**
+	 * @brief Construct the statistics of an empty set of values
+	 *
+	 */
+	FieldStatistics();
+
+	/**
+	 * @brief Add a block of values to the statistics
+	 *
+	 * @param values        the values to add (a pointer to an array of size at least n)
+	 * @param n             the number of values
+	 */
+	void add_values(const double* values, const int n);
+
+	/**
+	 * @brief Merge the statistics of an other set of values
+	 *
+	 * @param s             the statistics to merge
+	 */
+	void merge(const FieldStatistics& s);
+
+	/**
+	 * @brief Get the range of the values
+	 *
+	 * @return double       the difference between the max and the min values
+	 */
+	double range() const
+	{
+		return max - min;
+	}
+
+	int count;          /**< the number of values*/
+	double min;         /**< the min value*/
+	double max;         /**< the max value*/
+	double sum;         /**< the sum of all the values*/
+	double mean;        /**< the mean of the values*/
+	double variance;    /**< the variance of the values*/
+};
+
+/**
+ * @brief Defines a sum of values whose rounding errors are compensated (Neumaier's variant of Kahan's summation),
+ * so that its error does not grow with the number of values. Sums of separate blocks of values can be merged together
+ *
+ */
+class CompensatedSum
+{
+public:
+	/**
+	 * @brief Construct an empty sum
+	 *
+	 */
+	CompensatedSum()
+		: _sum(0), _compensation(0)
+	{
+	}
+
+	/**
+	 * @brief Add a value to the sum
+	 *
+	 * @param value         the value to add
+	 */
+	void add(const double value)
+	{
+		const double t = _sum + value;
+
+		// the low order bits lost by the addition
+		if(std::abs(_sum) >= std::abs(value))
+		{
+			_compensation += (_sum - t) + value;
+		}
+		else
+		{
+			_compensation += (value - t) + _sum;
+		}
+
+		_sum = t;
+	}
+
+	/**
+	 * @brief Add a block of values to the sum
+	 *
+	 * @param values        the values to add (a pointer to an array of size at least n)
+	 * @param n             the number of values
+	 */
+	void add_values(const double* values, const int n);
+
+	/**
+	 * @brief Merge the sum of an other set of values
+	 *
+	 * @param s             the sum to merge
+	 */
+	void merge(const CompensatedSum& s)
+	{
+		add(s._sum);
+		_compensation += s._compensation;
+	}
+
+	/**
+	 * @brief Get the sum
+	 *
+	 * @return double       the sum of the values added
+	 */
+	double value() const
+	{
+		return _sum + _compensation;
+	}
+
+private:
+	double _sum;            /**< the rounded sum*/
+	double _compensation;   /**< the sum of the rounding errors*/
+};
+
+/**
+ * @brief Defines an histogram of values on a fixed range, filled in a streaming fashion
+ *
+ */
+class Histogram
+{
+public:
+	Histogram() = delete;
+	/**
+	 * @brief Construct a new empty Histogram
+	 *
+	 * @param min           the lower bound of the first bin
+	 * @param max           the upper bound of the last bin
+	 * @param bins          the number of bins
+	 */
+	Histogram(const double min, const double max, const int bins = 256);
+
+	/**
+	 * @brief Add a value to the histogram, values outside of the range go to the first or last bin.
+	 * NaN and infinite values are not added
+	 *
+	 * @param value         the value to add
+	 */
+	void add(const double value);
+
+	/**
+	 * @brief Add a block of values to the histogram, as with add(const double)
+	 *
+	 * @param values        the values to add (a pointer to an array of size at least n)
+	 * @param n             the number of values
+	 */
+	void add(const double* values, const int n);
+
+	/**
+	 * @brief Merge an other histogram with the same range and number of bins
+	 *
+	 * @param h             the histogram to merge
+	 * @throw               invalid_argument if the histograms are not compatible
+	 */
+	void merge(const Histogram& h);
+
+	/**
+	 * @brief Get the number of values in the histogram
+	 *
+	 * @return long         the number of values
+	 */
+	long count() const
+	{
+		return _count;
+	}
+
+	/**
+	 * @brief Get the number of bins
+	 *
+	 * @return int          the number of bins
+	 */
+	int bin_number() const
+	{
+		return _bins.size();
+	}
+
+	/**
+	 * @brief Get the number of values in a bin
+	 *
+	 * @param bin           the index of the bin
+	 * @return long         the number of values in that bin
+	 */
+	long bin(const int bin) const
+	{
+		return _bins.at(bin);
+	}
+
+	/**
+	 * @brief Get the value under which a proportion of the values are.
+	 * The values are considered evenly spread inside each bin
+	 *
+	 * @param p             the proportion, between 0 and 1
+	 * @return double       the value of the percentile
+	 */
+	double percentile(const double p) const;
+
+private:
+	/**
+	 * @brief Get the bin of a finite value, clamped to the first and last bins
+	 *
+	 */
+	int bin_of(const double value) const;
+
+	double _min;                /**< lower bound of the first bin*/
+	double _max;                /**< upper bound of the last bin*/
+	double _bin_scale;          /**< number of bins per unit of value*/
+	long _count;                /**< number of values in the histogram*/
+	std::vector<long> _bins;    /**< number of values in each bin*/
+};
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <MultiLayerMap.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Keeps the operations applied on a terrain to undo and redo them.
+ * An operation only keeps the tiles it modified, as the compressed difference between their values before and after it,
+ * so undoing or redoing it costs a time proportional to the modified area.
+ * When the operations use more memory than the budget, the ones the furthest from the current state are written to the spill directory.
+ * When there is none, the oldest operation or the newest undone one are forgotten instead, never one in the middle of the history.
+ * The tiles modified by an operation are hashed, so that a terrain modified outside of the history is refused instead of corrupted.
+ * The materials of the terrain, when it has some, are kept as they were before and after the operation
+ *
+ */
+class TerrainHistory
+{
+public:
+	/**
+	 * @brief Construct an empty history
+	 *
+	 * @param memory_budget     the number of bytes the operations can use in memory
+	 * @param spill_directory   the directory the operations are written to above the budget, created if needed. Empty to forget them instead
+	 */
+	TerrainHistory(const long memory_budget = 256L << 20, const std::string& spill_directory = "");
+	TerrainHistory(const TerrainHistory&) = delete;
+	TerrainHistory& operator=(const TerrainHistory&) = delete;
+
+	/**
+	 * @brief Remove the files of the operations written to the spill directory
+	 *
+	 */
+	~TerrainHistory();
+
+	/**
+	 * @brief Record an operation, forgetting the operations that were undone.
+	 * The operation is found by comparing the terrain before and after it, the tiles shared by both being skipped without reading them
+	 *
+	 * @param name          the name of the operation
+	 * @param before        the terrain before the operation, usually a copy made just before it
+	 * @param after         the terrain after the operation
+	 * @return true         if the operation modified the terrain and was recorded
+	 * @return false        if the terrain is unchanged
+	 */
+	bool record(const std::string& name, const MultiLayerMap& before, const MultiLayerMap& after);
+
+	/**
+	 * @brief Undo the last operation
+	 *
+	 * @param mlm           the terrain, as after the operation
+	 * @throw               logic_error if there is no operation to undo or if the terrain does not match the operation,
+	 *                      its tiles modified by the operation being compared with their hashes
+	 */
+	void undo(MultiLayerMap& mlm);
+
+	/**
+	 * @brief Redo the last operation undone
+	 *
+	 * @param mlm           the terrain, as before the operation
+	 * @throw               logic_error if there is no operation to redo or if the terrain does not match the operation,
+	 *                      its tiles modified by the operation being compared with their hashes
+	 */
+	void redo(MultiLayerMap& mlm);
+
+	/**
+	 * @brief Forget all the operations
+	 *
+	 */
+	void clear();
+
+	/**
+	 * @brief Tells if an operation can be undone
+	 *
+	 */
+	bool can_undo() const
+	{
+		return _current > 0;
+	}
+
+	/**
+	 * @brief Tells if an operation can be redone
+	 *
+	 */
+	bool can_redo() const
+	{
+		return _current < _entries.size();
+	}
+
+	/**
+	 * @brief Get the name of the operation undone by undo
+	 *
+	 * @return std::string      the name, empty if there is none
+	 */
+	std::string undo_name() const
+	{
+		return can_undo() ? _entries[_current - 1]->name : std::string();
+	}
+
+	/**
+	 * @brief Get the name of the operation redone by redo
+	 *
+	 * @return std::string      the name, empty if there is none
+	 */
+	std::string redo_name() const
+	{
+		return can_redo() ? _entries[_current]->name : std::string();
+	}
+
+	/**
+	 * @brief Get the number of operations that can be undone
+	 *
+	 */
+	int undo_number() const
+	{
+		return _current;
+	}
+
+	/**
+	 * @brief Get the number of operations that can be redone
+	 *
+	 */
+	int redo_number() const
+	{
+		return _entries.size() - _current;
+	}
+
+	/**
+	 * @brief Get the number of bytes used in memory by the operations
+	 *
+	 */
+	long memory() const
+	{
+		return _memory;
+	}
+
+	/**
+	 * @brief Get the number of operations written to the spill directory
+	 *
+	 */
+	int spilled() const;
+
+	/**
+	 * @brief The compressed difference of a tile between the terrains before and after an operation
+	 *
+	 */
+	struct TileDelta
+	{
+		int layer;                          /**< the layer of the tile*/
+		int tile;                           /**< the index of the tile in its layer*/
+		char side;                          /**< 0 for the difference of both terrains, 1 or 2 for the values of the terrain before or after*/
+		std::vector<unsigned char> data;    /**< the compressed bits*/
+		std::uint64_t before_hash;          /**< the hash of the tile before the operation, 0 if side is 2*/
+		std::uint64_t after_hash;           /**< the hash of the tile after the operation, 0 if side is 1*/
+	};
+
+	/**
+	 * @brief Compress the difference between the values of two tiles
+	 *
+	 * @param a, b                          the tile_cells values of both tiles, b null for zeros
+	 * @return std::vector<unsigned char>   the compressed exclusive or of their bits, empty if they are equal
+	 */
+	static std::vector<unsigned char> encode(const double* a, const double* b);
+
+	/**
+	 * @brief Apply a compressed difference to a tile, the tile before becoming the tile after and conversely
+	 *
+	 * @param data          the compressed difference
+	 * @param tile          the tile_cells values of the tile
+	 * @throw               runtime_error if the data is corrupted
+	 */
+	static void decode(const std::vector<unsigned char>& data, double* tile);
+
+private:
+	/**
+	 * @brief A recorded operation
+	 *
+	 */
+	struct Entry
+	{
+		Entry(const std::string& n, const Grid2d& b, const Grid2d& a, const int bl, const int al)
+			: name(n), before(b), after(a), before_layers(bl), after_layers(al), bytes(0), before_materials(b), after_materials(a)
+		{
+		}
+
+		std::string name;               /**< the name of the operation*/
+		Grid2d before;                  /**< the grid of the terrain before the operation*/
+		Grid2d after;                   /**< the grid of the terrain after the operation*/
+		int before_layers;              /**< the number of layers before the operation*/
+		int after_layers;               /**< the number of layers after the operation*/
+		std::vector<TileDelta> deltas;  /**< the modified tiles, empty while the operation is spilled*/
+		long bytes;                     /**< the size of the deltas*/
+		std::string file;               /**< the file the deltas are written to, empty if they are in memory*/
+		MultiLayerMap before_materials; /**< a map without layers sharing the materials of the terrain before the operation*/
+		MultiLayerMap after_materials;  /**< a map without layers sharing the materials of the terrain after the operation*/
+	};
+
+	/**
+	 * @brief Move an operation from one state of the terrain to the other
+	 *
+	 * @param entry         the operation
+	 * @param mlm           the terrain
+	 * @param forward       true to go from the state before to the state after
+	 */
+	void apply(Entry& entry, MultiLayerMap& mlm, const bool forward);
+
+	/**
+	 * @brief Write or forget operations until the budget is respected
+	 *
+	 */
+	void enforce_budget();
+
+	/**
+	 * @brief Write the deltas of an operation to the spill directory
+	 *
+	 */
+	void spill(Entry& entry);
+
+	/**
+	 * @brief Read the deltas of a spilled operation back
+	 *
+	 */
+	void load(Entry& entry);
+
+	long _budget;                                   /**< the number of bytes the operations can use*/
+	std::string _directory;                         /**< the spill directory, empty if operations are forgotten*/
+	std::vector<std::unique_ptr<Entry>> _entries;   /**< the operations, oldest first*/
+	int _current;                                   /**< the number of operations applied, the others were undone*/
+	long _memory;                                   /**< the size of the deltas in memory*/
+	long _files;                                    /**< the number of files written, to name them*/
+};
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <Weather/Biome.hpp>
+
+#include <memory>
+#include <vector>
+
+/**
+ * @brief Renders a terrain in an RGBA image on the CPU, to be shown by the interface.
+ * A full render takes the maps cached by the BiomeInfo of the terrain. After that, an update only computes again
+ * the rows around the tiles of the terrain that changed, as far as the shown value depends on the height.
+ * The image is split in square tiles and an update only renders again the tiles whose values changed,
+ * so that the interface only uploads these tiles to its texture
+ *
+ */
+class TerrainPreview
+{
+public:
+	/**
+	 * @brief The value of the terrain shown by the preview
+	 *
+	 */
+	enum class Mode
+	{
+		height,     /**< the height of all the layers*/
+		slope,      /**< the slope of the height*/
+		exposure    /**< the light exposure of the height*/
+	};
+
+	/**
+	 * @brief A part of the image, in pixels
+	 *
+	 */
+	struct Tile
+	{
+		int x, y;           /**< the first pixel of the tile*/
+		int width, height;  /**< the size of the tile, smaller on the last row and column*/
+	};
+
+	/**
+	 * @brief Construct an empty preview
+	 *
+	 * @param tile_size     the size of the tiles, in pixels
+	 * @throw               invalid_argument if the size is not positive
+	 */
+	TerrainPreview(const int tile_size = 64);
+
+	/**
+	 * @brief Render the tiles of the terrain that changed since the last update.
+	 * The colors are mapped on a range that only grows, so that a local change does not render the whole image again
+	 *
+	 * @param biome         the biome information of the terrain
+	 * @param mode          the value to show
+	 * @return int          the number of tiles rendered, all of them if the size or the mode changed, none if the terrain is empty
+	 */
+	int update(const BiomeInfo& biome, const Mode mode);
+
+	/**
+	 * @brief Forget the last render, the next update renders the whole image with a new range
+	 *
+	 */
+	void reset();
+
+	/**
+	 * @brief Get the width of the image
+	 *
+	 * @return int      the number of pixels along the width
+	 */
+	int width() const
+	{
+		return _width;
+	}
+
+	/**
+	 * @brief Get the height of the image
+	 *
+	 * @return int      the number of pixels along the height
+	 */
+	int height() const
+	{
+		return _height;
+	}
+
+	/**
+	 * @brief Get the size of the tiles
+	 *
+	 * @return int      the size of the tiles, in pixels
+	 */
+	int tile_size() const
+	{
+		return _tile_size;
+	}
+
+	/**
+	 * @brief Get the pixels of the image, row after row, 4 bytes per pixel
+	 *
+	 * @return const unsigned char* the RGBA values
+	 */
+	const unsigned char* pixels() const
+	{
+		return _pixels.data();
+	}
+
+	/**
+	 * @brief Get the tiles rendered by the last update
+	 *
+	 * @return const std::vector<Tile>&     the tiles, in row order
+	 */
+	const std::vector<Tile>& dirty_tiles() const
+	{
+		return _dirty;
+	}
+
+	/**
+	 * @brief Get the value shown by a pixel in the last render
+	 *
+	 * @param i, j      the pixel, a cell of the grid
+	 */
+	double value(const int i, const int j) const
+	{
+		return _values[j * _width + i];
+	}
+
+	/**
+	 * @brief Get the range of the values mapped on the colors
+	 *
+	 * @return double   the value of the first or last color
+	 */
+	double min() const
+	{
+		return _min;
+	}
+	double max() const
+	{
+		return _max;
+	}
+
+private:
+	/**
+	 * @brief Get the values shown in a mode from the maps of the biome
+	 *
+	 */
+	static std::vector<double> field_values(const BiomeInfo& biome, const Mode mode);
+
+	/**
+	 * @brief Compute again the values of the rows around the tiles of the terrain that changed since the last render
+	 *
+	 * @param terrain   the terrain now
+	 * @param values    the values of the last render, updated
+	 */
+	void update_values(const SimpleLayerMap& terrain, std::vector<double>& values) const;
+
+	/**
+	 * @brief Write the color of a value
+	 *
+	 * @param t         the value mapped on [0, 1]
+	 * @param rgba      the pixel to write
+	 */
+	void color(const double t, unsigned char* rgba) const;
+
+	int _tile_size;                     /**< the size of the tiles*/
+	int _width;                         /**< the size of the image*/
+	int _height;
+	Mode _mode;                         /**< the mode of the last render*/
+	unsigned long _version;             /**< the version of the terrain of the last render*/
+	bool _valid;                        /**< tells if there was a render since the last reset*/
+	double _min;                        /**< the range of the colors*/
+	double _max;
+	std::unique_ptr<SimpleLayerMap> _terrain; /**< the terrain of the last render, sharing its tiles with the biome*/
+	std::vector<double> _values;        /**< the values of the last render*/
+	std::vector<unsigned char> _pixels; /**< the RGBA image*/
+	std::vector<Tile> _dirty;           /**< the tiles rendered by the last update*/
+};
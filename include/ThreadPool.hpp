@@ -0,0 +1,353 @@
+#pragma once
+
+#include <Grid2d.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ConcurrencyLimit;
+class Progress;
+
+/**
+ * @brief Defines the state a task inherits from the thread submitting it.
+ * TaskGroup::run captures the context of the calling thread, which is the context of the thread running the task while it runs,
+ * so that the parallel loops nested in a task see the same state as the thread that started the work
+ *
+ */
+struct TaskContext
+{
+	/**
+	 * @brief Construct an empty context
+	 *
+	 */
+	TaskContext()
+		: limit(nullptr), progress(nullptr), progress_begin(0), progress_end(1)
+	{
+	}
+
+	/**
+	 * @brief Get the context of the calling thread, the one of its task if it runs one
+	 *
+	 * @return TaskContext&     the context
+	 */
+	static TaskContext& current();
+
+	ConcurrencyLimit* limit;    /**< the innermost limit on the number of threads, none if null*/
+	Progress* progress;         /**< the progress of the job the work belongs to, none if null, see ProgressScope*/
+	double progress_begin;      /**< the part of the progress used by the current step of the job*/
+	double progress_end;
+};
+
+/**
+ * @brief Defines the task scheduler shared by the whole library.
+ * Each worker thread has its own queue of tasks: it runs the last task it added first,
+ * and takes the oldest tasks of the other queues when its own is empty.
+ * The thread waiting for a group of tasks runs tasks too, so the number of threads is counting it
+ *
+ */
+class ThreadPool
+{
+public:
+	/**
+	 * @brief Get the pool used by the library
+	 *
+	 * @return ThreadPool&  the pool, using all the cores of the machine by default
+	 */
+	static ThreadPool& instance();
+
+	/**
+	 * @brief Construct a new pool
+	 *
+	 * @param threads       the number of threads running tasks, including the waiting thread, all the cores if 0
+	 */
+	explicit ThreadPool(const int threads = 0);
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	~ThreadPool();
+
+	/**
+	 * @brief Get the number of threads running tasks
+	 *
+	 * @return int          the number of worker threads plus the waiting thread
+	 */
+	int thread_number() const
+	{
+		return _threads.size() + 1;
+	}
+
+	/**
+	 * @brief Change the number of threads. Must not be called while tasks are running
+	 *
+	 * @param threads       the number of threads running tasks, including the waiting thread, all the cores if 0
+	 */
+	void set_thread_number(const int threads);
+
+	/**
+	 * @brief Get the number of threads a parallel loop started by the calling thread can use, if no other loop is running
+	 *
+	 * @return int          the number of threads of the pool, reduced by the ConcurrencyLimit of the task context
+	 */
+	int concurrency() const;
+
+	/**
+	 * @brief Add a task to the queues
+	 *
+	 * @param task          the task
+	 */
+	void submit(std::function<void()> task);
+
+	/**
+	 * @brief Run a task of the queues from the calling thread
+	 *
+	 * @return true         if a task was run
+	 * @return false        if all the queues are empty
+	 */
+	bool run_pending_task();
+
+private:
+	/**
+	 * @brief The tasks added by a worker thread
+	 *
+	 */
+	struct Queue
+	{
+		std::mutex mutex;                               /**< protects the tasks*/
+		std::deque<std::function<void()>> tasks;        /**< the tasks*/
+	};
+
+	void start(const int threads);
+	void stop();
+	void work(const int index);
+	/**
+	 * @brief Take a task, from the queue of the thread first, from the other queues otherwise
+	 *
+	 */
+	bool pop(const int index, std::function<void()>& task);
+
+	std::vector<std::unique_ptr<Queue>> _queues;    /**< the queues, one for each worker thread*/
+	std::vector<std::thread> _threads;              /**< the worker threads*/
+	std::mutex _mutex;                              /**< protects the sleep of the workers*/
+	std::condition_variable _wake;                  /**< wakes the workers up when a task is added*/
+	std::atomic<int> _pending;                      /**< the number of tasks in the queues*/
+	std::atomic<unsigned int> _next_queue;          /**< the queue of the next task added from outside the pool*/
+	bool _stopping;                                 /**< tells the workers to stop*/
+};
+
+/**
+ * @brief Limits the number of threads used together by the parallel loops started by the current thread, while it exists.
+ * The limit is part of the task context, so the loops nested in the tasks of these loops share it:
+ * a loop only gets the threads the other loops under the limit left, running alone on its thread otherwise
+ *
+ */
+class ConcurrencyLimit
+{
+public:
+	ConcurrencyLimit() = delete;
+	/**
+	 * @brief Set the limit, counting the calling thread.
+	 * Under an other limit, the new one can't be higher
+	 *
+	 * @param threads       the maximal number of threads, no limit if 0
+	 */
+	explicit ConcurrencyLimit(const int threads);
+	ConcurrencyLimit(const ConcurrencyLimit&) = delete;
+	ConcurrencyLimit& operator=(const ConcurrencyLimit&) = delete;
+	/**
+	 * @brief Restore the previous limit. The loops started under this one must have ended
+	 *
+	 */
+	~ConcurrencyLimit();
+
+	/**
+	 * @brief Get the maximal number of threads
+	 *
+	 * @return int          the number of threads, 0 if there is no limit
+	 */
+	int threads() const
+	{
+		return _threads;
+	}
+
+	/**
+	 * @brief Take some of the threads left by the loops running under the limit
+	 *
+	 * @param wanted        the number of threads wanted
+	 * @return int          the number of threads taken, at most wanted, to give back with release
+	 */
+	int acquire(const int wanted);
+
+	/**
+	 * @brief Give back threads taken with acquire
+	 *
+	 * @param threads       the number of threads
+	 */
+	void release(const int threads);
+
+private:
+	ConcurrencyLimit* _previous;    /**< the limit of the context before this one*/
+	int _threads;                   /**< the maximal number of threads, 0 if there is no limit*/
+	std::atomic<int> _used;         /**< the number of threads used by the loops under the limit*/
+};
+
+/**
+ * @brief Defines a group of tasks that can be waited for and cancelled together
+ *
+ */
+class TaskGroup
+{
+public:
+	/**
+	 * @brief Construct a new empty group
+	 *
+	 * @param pool          the pool running the tasks
+	 */
+	explicit TaskGroup(ThreadPool& pool = ThreadPool::instance());
+	TaskGroup(const TaskGroup&) = delete;
+	TaskGroup& operator=(const TaskGroup&) = delete;
+	/**
+	 * @brief Wait for the tasks, their errors being ignored
+	 *
+	 */
+	~TaskGroup();
+
+	/**
+	 * @brief Add a task to the group. The task is not run if the group is cancelled before it starts
+	 *
+	 * @param task          the task
+	 */
+	void run(std::function<void()> task);
+
+	/**
+	 * @brief Wait for all the tasks of the group, running tasks of the pool meanwhile
+	 *
+	 * @throw               the first exception thrown by a task
+	 */
+	void wait();
+
+	/**
+	 * @brief Cancel the tasks that did not start. The running tasks can stop early using is_cancelled
+	 *
+	 */
+	void cancel()
+	{
+		_cancelled = true;
+	}
+
+	/**
+	 * @brief Tells if the group is cancelled, by cancel or by an exception in a task
+	 *
+	 * @return true         if the group is cancelled
+	 * @return false        otherwise
+	 */
+	bool is_cancelled() const
+	{
+		return _cancelled;
+	}
+
+private:
+	/**
+	 * @brief Keep the first exception and cancel the group
+	 *
+	 */
+	void fail(std::exception_ptr error);
+
+	ThreadPool& _pool;                      /**< the pool running the tasks*/
+	std::atomic<int> _pending;              /**< the number of unfinished tasks*/
+	std::atomic<bool> _cancelled;           /**< tells if the group is cancelled*/
+	std::mutex _mutex;                      /**< protects the error and the end of the tasks*/
+	std::condition_variable _done;          /**< signaled when the last task ends*/
+	std::exception_ptr _error;              /**< the first exception thrown by a task*/
+};
+
+/**
+ * @brief Run a function on all the chunks of a range, in parallel.
+ * The chunks only depend on the grain, not on the number of threads
+ *
+ * @param begin, end    the range
+ * @param body          the function, called with the range of a chunk
+ * @param grain         the size of the chunks
+ * @throw               the first exception thrown by the function
+ */
+void parallel_for(const int begin, const int end, const std::function<void(int, int)>& body, const int grain = 1);
+
+/**
+ * @brief Get the number of rows of a grid processed by a task, about 16k cells
+ *
+ * @param grid          the grid
+ * @return int          the number of rows
+ */
+int rows_per_task(const Grid2d& grid);
+
+/**
+ * @brief Run a function on blocks of rows of a grid, in parallel
+ *
+ * @param grid          the grid
+ * @param body          the function, called with the first and past the last rows of a block
+ * @param rows          the number of rows of the blocks, rows_per_task if 0
+ */
+void parallel_for_rows(const Grid2d& grid, const std::function<void(int, int)>& body, const int rows = 0);
+
+/**
+ * @brief Run a function on square tiles of a grid, in parallel
+ *
+ * @param grid          the grid
+ * @param tile_size     the number of cells along the side of a tile
+ * @param body          the function, called with the first cell i, j and the past the last cell i, j of a tile
+ */
+void parallel_for_tiles(const Grid2d& grid, const int tile_size, const std::function<void(int, int, int, int)>& body);
+
+/**
+ * @brief Compute a value on all the chunks of a range in parallel, then combine them in the order of the chunks.
+ * The result does not depend on the number of threads
+ *
+ * @param begin, end    the range
+ * @param grain         the size of the chunks
+ * @param identity      the value of an empty range
+ * @param map           the function computing the value of a chunk, called with the range of the chunk
+ * @param reduce        the function combining two values
+ * @return T            the combined value
+ */
+template<typename T, typename Map, typename Reduce>
+T parallel_reduce(const int begin, const int end, const int grain, const T& identity, const Map& map, const Reduce& reduce)
+{
+	const int chunks = (end > begin) ? (end - begin + grain - 1) / grain : 0;
+	std::vector<T> partial(chunks, identity);
+	parallel_for(0, chunks, [&](int c_begin, int c_end)
+	{
+		for(int c = c_begin; c < c_end; ++c)
+		{
+			partial[c] = map(begin + c * grain, std::min(begin + (c + 1) * grain, end));
+		}
+	});
+	T result = identity;
+
+	for(const T& p : partial)
+	{
+		result = reduce(result, p);
+	}
+
+	return result;
+}
+
+/**
+ * @brief Compute a value on blocks of rows of a grid in parallel, then combine them in the order of the rows
+ *
+ * @param grid          the grid
+ * @param identity      the value of no rows
+ * @param map           the function computing the value of a block, called with the first and past the last rows
+ * @param reduce        the function combining two values
+ * @return T            the combined value
+ */
+template<typename T, typename Map, typename Reduce>
+T parallel_reduce_rows(const Grid2d& grid, const T& identity, const Map& map, const Reduce& reduce)
+{
+	return parallel_reduce(0, grid.grid_height(), rows_per_task(grid), identity, map, reduce);
+}
@@ -0,0 +1,283 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+/**
+ * @brief Stores the values of a grid in square tiles shared between copies.
+ * Copying the storage only copies the pointers to the tiles, a tile being copied the first time one of its values is modified,
+ * so a copy only pays for the regions it modifies.
+ * The tiles of zeros are all the same empty tile shared by every storage, so a layer that is zero over large regions,
+ * as the sediments, only allocates the tiles where it has values and the operations can skip the empty tiles.
+ * Different tiles can be modified by different threads, a storage must not be copied while an other thread modifies it
+ *
+ */
+class TileStorage
+{
+public:
+	static const int tile_shift = 6;                        /**< the tiles are 64 x 64 cells*/
+	static const int tile_size = 1 << tile_shift;           /**< the number of cells along the side of a tile*/
+	static const int tile_cells = tile_size * tile_size;    /**< the number of cells of a tile*/
+
+	/**
+	 * @brief The values of a tile, row after row. The cells outside of the grid on the last row and column of tiles are unused
+	 *
+	 */
+	struct Tile
+	{
+		double values[tile_cells];
+	};
+
+	TileStorage() = delete;
+
+	/**
+	 * @brief Construct a storage of zeros, all its tiles being empty
+	 *
+	 * @param width, height     the number of cells along the width and the height of the grid
+	 */
+	TileStorage(const int width, const int height);
+
+	/**
+	 * @brief Construct a storage from the values of the cells, the tiles of zeros being empty
+	 *
+	 * @param width, height     the number of cells along the width and the height of the grid
+	 * @param values            the values, row after row, width * height of them
+	 */
+	TileStorage(const int width, const int height, const std::vector<double>& values);
+
+	/**
+	 * @brief Get the number of cells along the width of the grid
+	 *
+	 */
+	int width() const
+	{
+		return _width;
+	}
+
+	/**
+	 * @brief Get the number of cells along the height of the grid
+	 *
+	 */
+	int height() const
+	{
+		return _height;
+	}
+
+	/**
+	 * @brief Get the number of tiles along the width of the grid
+	 *
+	 */
+	int tiles_x() const
+	{
+		return _tiles_x;
+	}
+
+	/**
+	 * @brief Get the number of tiles
+	 *
+	 */
+	int tile_number() const
+	{
+		return _tiles.size();
+	}
+
+	/**
+	 * @brief Get the tile of a cell
+	 *
+	 * @param i, j      the position of the cell, on the grid
+	 * @return int      the index of the tile
+	 */
+	int tile_index(const int i, const int j) const
+	{
+		return (j >> tile_shift) * _tiles_x + (i >> tile_shift);
+	}
+
+	/**
+	 * @brief Get the position of a cell in its tile
+	 *
+	 * @param i, j      the position of the cell, on the grid
+	 * @return int      the index of the value in the tile
+	 */
+	static int tile_offset(const int i, const int j)
+	{
+		return ((j & (tile_size - 1)) << tile_shift) + (i & (tile_size - 1));
+	}
+
+	/**
+	 * @brief Get the cells of the grid covered by a tile
+	 *
+	 * @param t                 the index of the tile
+	 * @param i0, j0, i1, j1    the first cell and past the last cell of the tile
+	 */
+	void tile_bounds(const int t, int& i0, int& j0, int& i1, int& j1) const;
+
+	/**
+	 * @brief Get the value of a cell
+	 *
+	 * @param i, j      the position of the cell, on the grid
+	 * @return double   the value
+	 */
+	double get(const int i, const int j) const
+	{
+		return _tiles[tile_index(i, j)]->values[tile_offset(i, j)];
+	}
+
+	/**
+	 * @brief Get access to the value of a cell, copying its tile if it is shared
+	 *
+	 * @param i, j      the position of the cell, on the grid
+	 * @return double&  a reference to the value, valid until the storage is copied or assigned
+	 */
+	double& at(const int i, const int j)
+	{
+		return mutable_tile(tile_index(i, j))[tile_offset(i, j)];
+	}
+
+	/**
+	 * @brief Get the values of a tile
+	 *
+	 * @param t                 the index of the tile
+	 * @return const double*    the tile_cells values of the tile, row after row
+	 */
+	const double* tile(const int t) const
+	{
+		return _tiles[t]->values;
+	}
+
+	/**
+	 * @brief Get the values of a tile to modify them, copying the tile if it is shared
+	 *
+	 * @param t             the index of the tile
+	 * @return double*      the tile_cells values of the tile, row after row
+	 */
+	double* mutable_tile(const int t)
+	{
+		if(_tiles[t].use_count() != 1)
+		{
+			unshare(t);
+		}
+
+		return _tiles[t]->values;
+	}
+
+	/**
+	 * @brief Copy the values of a row, one tile after the other
+	 *
+	 * @param j         the row
+	 * @param values    the values of the row (a pointer to an array of size at least width)
+	 */
+	void get_row(const int j, double* values) const;
+
+	/**
+	 * @brief Add the values of a row to an array, one tile after the other
+	 *
+	 * @param j         the row
+	 * @param values    the array the values of the row are added to (of size at least width)
+	 */
+	void add_row(const int j, double* values) const;
+
+	/**
+	 * @brief Tells if a tile is shared with an other storage, the empty tile being always shared
+	 *
+	 * @param t         the index of the tile
+	 * @return true     if the tile is shared
+	 * @return false    otherwise
+	 */
+	bool is_shared(const int t) const
+	{
+		return _tiles[t].use_count() != 1;
+	}
+
+	/**
+	 * @brief Tells if a tile is the empty tile, all its values being zero
+	 *
+	 * @param t         the index of the tile
+	 * @return true     if the tile is empty
+	 * @return false    if the tile is allocated, its values being zero or not
+	 */
+	bool is_empty(const int t) const
+	{
+		return _tiles[t] == empty_tile();
+	}
+
+	/**
+	 * @brief Set the values of a tile to zero, replacing it by the empty tile
+	 *
+	 * @param t         the index of the tile
+	 */
+	void clear_tile(const int t)
+	{
+		_tiles[t] = empty_tile();
+	}
+
+	/**
+	 * @brief Tells if a tile is the same as the tile of an other storage, which means it was not modified since one was copied from the other
+	 *
+	 * @param t         the index of the tile
+	 * @param other     the other storage, with the same size
+	 * @return true     if both storages share the tile
+	 * @return false    otherwise
+	 */
+	bool shares_tile(const int t, const TileStorage& other) const
+	{
+		return _tiles[t] == other._tiles[t];
+	}
+
+	/**
+	 * @brief Get the number of tiles shared with other storages, the empty tiles excepted
+	 *
+	 * @return int      the number of shared tiles
+	 */
+	int shared_tiles() const;
+
+	/**
+	 * @brief Get the number of empty tiles
+	 *
+	 */
+	int empty_tiles() const;
+
+	/**
+	 * @brief Replace the allocated tiles whose cells are all zero by the empty tile
+	 *
+	 * @return int      the number of tiles released
+	 */
+	int compact();
+
+	/**
+	 * @brief Set all the values
+	 *
+	 * @param value     the value of every cell
+	 */
+	void fill(const double value);
+
+	/**
+	 * @brief Get the values of the cells
+	 *
+	 * @return std::vector<double>  the values, row after row
+	 */
+	std::vector<double> to_vector() const;
+
+private:
+	/**
+	 * @brief Replace a shared tile by a copy only used by this storage
+	 *
+	 */
+	void unshare(const int t);
+
+	/**
+	 * @brief Get the tile of zeros shared by all the storages, which is never modified
+	 *
+	 */
+	static const std::shared_ptr<Tile>& empty_tile();
+
+	/**
+	 * @brief Tells if the cells of a tile on the grid are all zero
+	 *
+	 */
+	bool is_zero(const int t) const;
+
+	int _width;                                 /**< the size of the grid*/
+	int _height;
+	int _tiles_x;                               /**< the number of tiles along the width of the grid*/
+	std::vector<std::shared_ptr<Tile>> _tiles;  /**< the tiles, row after row*/
+};
@@ -16,6 +16,13 @@
  */
 void generate_distribution(const MultiLayerMap& m);
 
+/**
+ * @brief generate a basic distribution of species using the maps already computed
+ * 
+ * @param bi        the biome information of the input terrain
+ */
+void generate_distribution(const BiomeInfo& bi);
+
 /**
  * @brief simulate a basic ecosystem on a terrain
  * 
@@ -23,5 +30,22 @@ void generate_distribution(const MultiLayerMap& m);
  */
 void simulate(const MultiLayerMap& mlm);
 
+/**
+ * @brief simulate a basic ecosystem on a terrain using the maps already computed
+ * 
+ * @param bi        the biome information of the input terrain
+ */
+void simulate(const BiomeInfo& bi);
+
+/**
+ * @brief simulate a basic ecosystem on a terrain, writing all the outputs with a given prefix
+ * 
+ * @param bi            the biome information of the input terrain
+ * @param gen           the random numbers generator of the simulation
+ * @param prefix        the prefix of the output files (densities, images and plant positions)
+ * @param iterations    the number of iterations of the simulation
+ */
+void simulate(const BiomeInfo& bi, std::mt19937& gen, const std::string& prefix, const int iterations = 5000);
+
 
 /** @}*/
\ No newline at end of file
@@ -7,17 +7,176 @@
  * @{
  */
 
-struct BiomeInfo
+/**
+ * @brief Lazily computes the maps derived from a terrain.
+ * Each map is computed once on first use and shared by all the consumers of the BiomeInfo.
+ * The maps are computed again when the version of the map they depend on changes:
+ *     terrain <- source
+ *     raw slope, area, raw exposure, normals <- terrain
+ *     raw water index <- area, raw slope
+ *     slope, exposure, water index, height <- their raw map
+ *     sediments <- sediment layer of the source
+ * The source terrain must outlive the BiomeInfo.
+ */
+class BiomeInfo
 {
-    BiomeInfo(const MultiLayerMap& m);
+public:
+	BiomeInfo() = delete;
+	/**
+	 * @brief Construct a new Biome Info object, no map is computed until it is needed
+	 *
+	 * @param m         the source terrain
+	 */
+	BiomeInfo(const MultiLayerMap& m);
+
+	/**
+	 * @brief Get the source terrain
+	 *
+	 * @return const MultiLayerMap&     the source terrain
+	 */
+	const MultiLayerMap& source() const
+	{
+		return _source;
+	}
+
+	/**
+	 * @brief Get the agregation of the layers of the source
+	 *
+	 * @return const SimpleLayerMap&    the height of the terrain
+	 */
+	const SimpleLayerMap& terrain() const;
+
+	/**
+	 * @brief Get the slope of the terrain
+	 *
+	 * @return const SimpleLayerMap&    the slope of the terrain
+	 */
+	const SimpleLayerMap& raw_slope() const;
+
+	/**
+	 * @brief Get the hydraulic area of the terrain
+	 *
+	 * @return const SimpleLayerMap&    the distributed hydraulic area
+	 */
+	const SimpleLayerMap& area() const;
+
+	/**
+	 * @brief Get the water index of the terrain
+	 *
+	 * @return const SimpleLayerMap&    the water index
+	 */
+	const SimpleLayerMap& raw_water_index() const;
+
+	/**
+	 * @brief Get the light exposure of the terrain
+	 *
+	 * @return const SimpleLayerMap&    the light exposure
+	 */
+	const SimpleLayerMap& raw_exposure() const;
+
+	/**
+	 * @brief Get the normals of the terrain
+	 *
+	 * @return const std::vector<SimpleLayerMap>&   the x, y and z coordinates of the normals
+	 */
+	const std::vector<SimpleLayerMap>& normals() const;
+
+	/**
+	 * @brief Get the normalized slope of the terrain
+	 *
+	 * @return const SimpleLayerMap&    the slope between 0 and 1
+	 */
+	const SimpleLayerMap& slope() const;
 
-    SimpleLayerMap slope;
-    SimpleLayerMap exposure;
-    SimpleLayerMap water_index;
-    SimpleLayerMap height;
-    SimpleLayerMap sediments;
+	/**
+	 * @brief Get the normalized light exposure of the terrain
+	 *
+	 * @return const SimpleLayerMap&    the exposure between 0 and 1
+	 */
+	const SimpleLayerMap& exposure() const;
+
+	/**
+	 * @brief Get the normalized water index of the terrain
+	 *
+	 * @return const SimpleLayerMap&    the water index between 0 and 1
+	 */
+	const SimpleLayerMap& water_index() const;
+
+	/**
+	 * @brief Get the normalized height of the terrain
+	 *
+	 * @return const SimpleLayerMap&    the height between 0 and 1
+	 */
+	const SimpleLayerMap& height() const;
+
+	/**
+	 * @brief Get the normalized sediments of the terrain
+	 *
+	 * @return const SimpleLayerMap&    the sediments between 0 and 1
+	 */
+	const SimpleLayerMap& sediments() const;
+
+private:
+	/**
+	 * @brief A derived map and the version of the source it was computed from
+	 *
+	 */
+	struct CachedMaps
+	{
+		CachedMaps() : version(0) {}
+
+		std::vector<SimpleLayerMap> maps;
+		unsigned long version;
+	};
+
+	/**
+	 * @brief Get the slope and the normals of the terrain, computed in a single pass
+	 *
+	 * @return const std::vector<SimpleLayerMap>&   the slope then the x, y and z coordinates of the normals
+	 */
+	const std::vector<SimpleLayerMap>& surface() const;
+
+	/**
+	 * @brief Get the maps of an entry, computing them if the entry is not up to date
+	 *
+	 * @param entry         the entry of the cache
+	 * @param version       the current version of the map the entry depends on
+	 * @param compute       the function computing the maps
+	 * @return const std::vector<SimpleLayerMap>&   the up to date maps of the entry
+	 */
+	template<typename Compute>
+	const std::vector<SimpleLayerMap>& cached(CachedMaps& entry, const unsigned long version, Compute compute) const
+	{
+		if(entry.maps.empty() || entry.version != version)
+		{
+			entry.maps = compute();
+			entry.version = version;
+		}
+
+		return entry.maps;
+	}
+
+	const MultiLayerMap& _source;       /**< the terrain from which the maps are derived*/
+	mutable CachedMaps _terrain;
+	mutable CachedMaps _surface;
+	mutable CachedMaps _raw_slope;
+	mutable CachedMaps _area;
+	mutable CachedMaps _raw_water_index;
+	mutable CachedMaps _raw_exposure;
+	mutable CachedMaps _normals;
+	mutable CachedMaps _slope;
+	mutable CachedMaps _exposure;
+	mutable CachedMaps _water_index;
+	mutable CachedMaps _height;
+	mutable CachedMaps _sediments;
 };
 
+/**
+ * @brief The default radius of the light exposure, in cells: the exposure of a cell only depends on the cells closer than it
+ *
+ */
+const int light_exposure_steps = 20;
+
 /**
  * @brief Get the light exposure of a MultiLayerMap
  *
@@ -26,13 +185,41 @@ struct BiomeInfo
  * @param nb_sambles        The number of direction for calculating the exposure
  * @return SimpleLayerMap   A field contaning the exposure information
  */
-SimpleLayerMap get_light_exposure(const DoubleField& df, const int nb_steps = 20, const int nb_samples = 10);
+SimpleLayerMap get_light_exposure(const DoubleField& df, const int nb_steps = light_exposure_steps, const int nb_samples = 10);
+
+/**
+ * @brief Get the light exposure of some rows of a field, as get_light_exposure
+ *
+ * @param df                The source field
+ * @param row_begin, row_end    The first and past the last rows
+ * @param values            The exposure of the rows, row after row (a pointer to an array of size at least (row_end - row_begin) * grid_width)
+ * @param nb_steps          The radius used for calculating the exposure, measured in cells of the grid
+ * @param nb_sambles        The number of direction for calculating the exposure
+ */
+void get_light_exposure_rows(const DoubleField& df, const int row_begin, const int row_end, double* values,
+                             const int nb_steps = light_exposure_steps, const int nb_samples = 10);
 
 /**
  * @brief saves a texture of the multilayer map
- * 
+ *
  * @param mlm 					the source multilayermap
  */
 void save_colorized(const MultiLayerMap& mlm);
 
-/** @}*/
\ No newline at end of file
+/**
+ * @brief saves a texture of the multilayer map using the maps already computed
+ *
+ * @param bi 					the biome information of the source multilayermap
+ */
+void save_colorized(const BiomeInfo& bi);
+
+/**
+ * @brief saves a texture of the multilayer map in a given file
+ *
+ * @param bi 					the biome information of the source multilayermap
+ * @param filename 				the name of the ppm file
+ * @param gen 					the random numbers generator used for the color noise
+ */
+void save_colorized(const BiomeInfo& bi, const std::string& filename, std::mt19937& gen);
+
+/** @}*/
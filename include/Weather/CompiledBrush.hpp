@@ -0,0 +1,153 @@
+#pragma once
+
+#include <DoubleField.hpp>
+#include <TileStorage.hpp>
+
+#include <vector>
+
+/** \addtogroup Hydro
+ * @{
+ */
+
+/**
+ * @brief Defines a brush as the list of its taps, the cells with a weight that is not zero, relative to its center.
+ * Each tap also keeps its offset in a tile, so a brush entirely inside a tile is applied with one tile access
+ * and no bounds check, the other positions checking each tap against the borders of the grid
+ *
+ */
+class CompiledBrush
+{
+public:
+	/**
+	 * @brief Compile a brush given as a field, its center being the cell (grid_width / 2, grid_height / 2)
+	 *
+	 * @param brush         the weights of the brush
+	 */
+	explicit CompiledBrush(const DoubleField& brush);
+
+	/**
+	 * @brief Get a round brush of uniform weights
+	 *
+	 * @param radius            the radius of the brush, in cells
+	 * @return CompiledBrush    the brush, its weights summing to 1
+	 * @throw                   invalid_argument if the radius is not positive
+	 */
+	static CompiledBrush disk(const double radius);
+
+	/**
+	 * @brief Get a round brush whose weights decrease linearly from its center to its border
+	 *
+	 * @param radius            the radius of the brush, in cells
+	 * @return CompiledBrush    the brush, its weights summing to 1
+	 * @throw                   invalid_argument if the radius is not positive
+	 */
+	static CompiledBrush cone(const double radius);
+
+	/**
+	 * @brief Get a round brush of gaussian weights
+	 *
+	 * @param radius            the radius of the brush, in cells, where the weights are cut
+	 * @param sigma             the standard deviation of the gaussian, in cells
+	 * @return CompiledBrush    the brush, its weights summing to 1
+	 * @throw                   invalid_argument if the radius or sigma is not positive
+	 */
+	static CompiledBrush gaussian(const double radius, const double sigma);
+
+	/**
+	 * @brief Get the number of taps
+	 *
+	 */
+	int tap_number() const
+	{
+		return _weights.size();
+	}
+
+	/**
+	 * @brief Get the position of a tap relative to the center of the brush
+	 *
+	 * @param k         the tap
+	 */
+	int tap_i(const int k) const
+	{
+		return _di[k];
+	}
+
+	int tap_j(const int k) const
+	{
+		return _dj[k];
+	}
+
+	/**
+	 * @brief Get the weight of a tap
+	 *
+	 * @param k         the tap
+	 */
+	double weight(const int k) const
+	{
+		return _weights[k];
+	}
+
+	/**
+	 * @brief Get the largest distance between the center and a tap, along the width or the height
+	 *
+	 */
+	int extent() const
+	{
+		return _extent;
+	}
+
+	/**
+	 * @brief Tells if the brush centered on a cell covers cells outside of the grid
+	 *
+	 * @param x, y      the center of the brush, on the grid
+	 * @param width, height     the size of the grid
+	 */
+	bool crosses_border(const int x, const int y, const int width, const int height) const
+	{
+		return x < _extent || y < _extent || x + _extent >= width || y + _extent >= height;
+	}
+
+	/**
+	 * @brief Add a quantity spread by the brush to the cells around a position
+	 *
+	 * @param values        the values of the cells
+	 * @param x, y          the center of the brush, on the grid
+	 * @param amount        the quantity, each cell receiving amount times the weight of its tap
+	 * @param other         if not null, other values on the same grid receiving the same quantities
+	 * @return double       the quantity of the taps outside of the grid, not added
+	 */
+	double add(TileStorage& values, const int x, const int y, const double amount, TileStorage* other = nullptr) const;
+
+private:
+	/**
+	 * @brief Construct an empty brush
+	 *
+	 */
+	CompiledBrush()
+		: _extent(0)
+	{
+	}
+
+	/**
+	 * @brief Add a tap to the brush
+	 *
+	 */
+	void add_tap(const int di, const int dj, const double weight);
+
+	/**
+	 * @brief Get a round brush whose weights are given by the distance of their cell to its center
+	 *
+	 * @param radius            the radius of the brush, only the cells closer than it being taps
+	 * @param weight            the weight of a tap from its distance to the center, the weights being scaled to sum to 1
+	 */
+	template <typename Weight>
+	static CompiledBrush radial(const double radius, const Weight& weight);
+
+	std::vector<int> _di;           /**< the positions of the taps relative to the center*/
+	std::vector<int> _dj;
+	std::vector<int> _offsets;      /**< the offsets of the taps in a tile, from the center*/
+	std::vector<double> _weights;   /**< the weights of the taps*/
+	int _extent;                    /**< the largest distance between the center and a tap along an axis*/
+};
+
+/** @}*/
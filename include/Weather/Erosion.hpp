@@ -1,6 +1,10 @@
 #pragma once
 
+#include <ActiveSet.hpp>
 #include <MultiLayerMap.hpp>
+#include <Weather/Stratigraphy.hpp>
+#include <Weather/TerrainBuffer.hpp>
+#include <functional>
 
 /** \addtogroup Erosion
  * @{
@@ -56,6 +60,14 @@ void erode_using_mean_double_slope(MultiLayerMap& layers, const double k);
  */
 void erode_using_exposure(MultiLayerMap& layers, const double k);
 
+/**
+ * @brief Erodes the Multi Layer Map of a buffer using the exposure of each cell, the exposure being computed on the buffered terrain
+ *
+ * @param buffer    the terrain of the Multi Layer Map to erode
+ * @param k         the erosion value
+ */
+void erode_using_exposure(TerrainBuffer& buffer, const double k);
+
 /**
  * @brief Erodes a Multi Layer Map using the exposure in a multi-material context
  *
@@ -63,20 +75,98 @@ void erode_using_exposure(MultiLayerMap& layers, const double k);
  * @param layers_top_heights		list of the heights of the top of the layers, in increasing order
  * @param layers_erosion_values		list of the erosion values for the layers, in the same order as layers_top_heights
  *					with one more value for the topmost 'infinite' layer
+ * @param layers_angle			the tilt of the layers along the height, around the middle row
  */
 void erode_layered_materials_using_exposure(MultiLayerMap& layers,
 					const std::vector<double>& layers_top_heights,
 					const std::vector<double>& layers_erosion_values,
 					const double layers_angle = 0.);
 
+/**
+ * @brief Erodes a Multi Layer Map using the exposure in a multi-material context
+ *
+ * @param layers    			the Multi Layer Map to erode
+ * @param strata			the materials under the terrain and their erosion values
+ */
+void erode_layered_materials_using_exposure(MultiLayerMap& layers, const Stratigraphy& strata);
+
+/**
+ * @brief Erodes the Multi Layer Map of a buffer using the exposure in a multi-material context
+ *
+ * @param buffer    			the terrain of the Multi Layer Map to erode
+ * @param strata			the materials under the terrain and their erosion values
+ */
+void erode_layered_materials_using_exposure(TerrainBuffer& buffer, const Stratigraphy& strata);
+
+/**
+ * @brief Erodes the materials of a Multi Layer Map using the exposure of each cell
+ *	  The erosion value of each cell is the one of the material at the top of its bedrock, the eroded runs being
+ *	  removed from the bedrock stack of the materials and put on the sediment stack with their material
+ *
+ * @param layers    			the Multi Layer Map to erode, with materials
+ * @param erodibilities			the erosion values of the materials
+ * @throw				logic_error if the materials of the map are not known
+ */
+void erode_materials_using_exposure(MultiLayerMap& layers, const std::vector<double>& erodibilities);
+
+/**
+ * @brief Erodes the materials of the Multi Layer Map of a buffer using the exposure of each cell
+ *
+ * @param buffer    			the terrain of the Multi Layer Map to erode, with materials
+ * @param erodibilities			the erosion values of the materials
+ * @throw				logic_error if the materials of the map are not known
+ */
+void erode_materials_using_exposure(TerrainBuffer& buffer, const std::vector<double>& erodibilities);
+
+/**
+ * @brief The work done by a transport, to compare the scheduling of the cells
+ *
+ */
+struct TransportStatistics
+{
+	long cells = 0;     /**< the number of cells taken from the queue*/
+	long pushes = 0;    /**< the number of cells put in the queue*/
+};
+
+/**
+ * @brief Transports the sediments towards the neighbors in 8-connexity from a Multi Layer Map until stable
+ *	  All the cells are visited in random order, then the neighbors receiving sediments in first in first out order.
+ *	  When the map tracks the materials of its sediments, all the transports move them with the sediments
+ *
+ * @param layers        	the Multi Layer Map containing sediments to transport
+ * @param rest_angle    	the angle over which sediments are stable
+ * @param quantity_tolerance 	the quantity under which no transport occurs because the quantity is considered negligible
+ * @param statistics		if not null, receives the number of cells visited
+ */
+void transport(MultiLayerMap& layers, const double rest_angle = 45, const double quantity_tolerance = 0.000000000000001,
+					TransportStatistics* statistics = nullptr);
+
+/**
+ * @brief Transports the sediments of the Multi Layer Map of a buffer, the slopes being read on the buffered terrain
+ * @see transport
+ */
+void transport(TerrainBuffer& buffer, const double rest_angle = 45, const double quantity_tolerance = 0.000000000000001,
+					TransportStatistics* statistics = nullptr);
+
 /**
  * @brief Transports the sediments towards the neighbors in 8-connexity from a Multi Layer Map until stable
+ *	  Only the unstable cells are visited, the most unstable first: the cells are ordered by how much their steepest
+ *	  downward slope exceeds the rest angle, so the large moves happen before the small corrections around them
  *
  * @param layers        	the Multi Layer Map containing sediments to transport
  * @param rest_angle    	the angle over which sediments are stable
  * @param quantity_tolerance 	the quantity under which no transport occurs because the quantity is considered negligible
+ * @param statistics		if not null, receives the number of cells visited
+ */
+void transport_unstable_first(MultiLayerMap& layers, const double rest_angle = 45, const double quantity_tolerance = 0.000000000000001,
+					TransportStatistics* statistics = nullptr);
+
+/**
+ * @brief Transports the sediments of the Multi Layer Map of a buffer, the most unstable first
+ * @see transport_unstable_first
  */
-void transport(MultiLayerMap& layers, const double rest_angle = 45, const double quantity_tolerance = 0.000000000000001);
+void transport_unstable_first(TerrainBuffer& buffer, const double rest_angle = 45, const double quantity_tolerance = 0.000000000000001,
+					TransportStatistics* statistics = nullptr);
 
 /**
  * @brief Transports the sediments towards the neighbors in 4-connexity from a Multi Layer Map until stable
@@ -87,6 +177,12 @@ void transport(MultiLayerMap& layers, const double rest_angle = 45, const double
  */
 void transport_4connex(MultiLayerMap& layers, const double rest_angle = 45, const double quantity_tolerance = 0.000000000000001);
 
+/**
+ * @brief Transports the sediments of the Multi Layer Map of a buffer towards the neighbors in 4-connexity
+ * @see transport_4connex
+ */
+void transport_4connex(TerrainBuffer& buffer, const double rest_angle = 45, const double quantity_tolerance = 0.000000000000001);
+
 /**
  * @brief Transports the sediments towards the neighbors in 8-connexity from a Multi Layer Map until stable
  *	  This is NOT FUNCTIONAL 
@@ -99,4 +195,125 @@ void transport_varying_stability_angle(MultiLayerMap& layers,
 					const double min_rest_angle = 20, const double max_rest_angle = 30,
 					const double quantity_tolerance = 0.000000000000001);
 
+/**
+ * @brief Transports the sediments of the Multi Layer Map of a buffer with a rest angle varying with the drainage area
+ * @see transport_varying_stability_angle
+ */
+void transport_varying_stability_angle(TerrainBuffer& buffer,
+					const double min_rest_angle = 20, const double max_rest_angle = 30,
+					const double quantity_tolerance = 0.000000000000001);
+
+/**
+ * @brief Runs erosion iterations from coarse to fine resolutions, most of the large scale work being done on small grids.
+ * The changes made at each level are interpolated on the next finer level, keeping the mass moved in each layer
+ * and leaving the cells unchanged where the layer did not change.
+ * Layers above the bedrock are kept positive, the bedrock under a cell giving what a layer would lose below zero,
+ * so the total mass is kept
+ *
+ * @param layers        	the Multi Layer Map to erode, at full resolution
+ * @param step          	one iteration of erosion and transport, applied to the map at the current resolution
+ * @param iterations    	the number of iterations at each level, from the coarsest to the full resolution
+ * @param bicubic       	interpolate the changes with a bicubic interpolation if true, a bilinear one otherwise
+ */
+void erode_coarse_to_fine(MultiLayerMap& layers, const std::function<void(MultiLayerMap&)>& step,
+					const std::vector<int>& iterations, const bool bicubic = false);
+
+/**
+ * @brief What an iteration of erosion changed on a terrain
+ *
+ */
+struct ErosionIteration
+{
+	double mass_moved;          /**< half the sum of the absolute changes of all the layers, so that a quantity moved from a layer or a cell to an other counts once*/
+	double max_talus_violation; /**< the most the slope of a cell with sediments exceeds the rest angle by, 0 if it is not measured*/
+	long changed_cells;         /**< the number of cells where a layer changed*/
+};
+
+/**
+ * @brief When to stop iterating an erosion
+ *
+ */
+struct ConvergenceCriteria
+{
+	int max_iterations = 100;           /**< the number of iterations done if the erosion does not converge*/
+	double relative_mass = 0.;          /**< the erosion converged when an iteration moves less than this fraction of the mass moved by the first one, 0 to only stop when nothing changes*/
+	double rest_angle = 0.;             /**< the rest angle the talus violation is measured with, 0 to not measure it*/
+	double talus_tolerance = 0.000001;  /**< the talus violation under which the sediments are considered stable*/
+	double cell_tolerance = 0.000000000001; /**< the change under which a cell is not counted as changed*/
+};
+
+/**
+ * @brief What a loop of erosion iterations did
+ *
+ */
+struct ErosionStatistics
+{
+	int iterations = 0;                     /**< the number of iterations done*/
+	bool converged = false;                 /**< true if the last iteration met the criteria*/
+	double mass_moved = 0.;                 /**< the mass moved by all the iterations*/
+	std::vector<ErosionIteration> history;  /**< the changes of each iteration*/
+};
+
+/**
+ * @brief The talus violations of the blocks of a terrain, kept across the iterations of an erosion
+ *	  so that the talus is only measured again around the cells the iterations change
+ *
+ */
+struct TalusBlocks
+{
+	/**
+	 * @brief Construct the blocks of a grid, all of them to be measured by the first iteration
+	 *
+	 * @param width, height     the number of cells along the width and the height of the grid
+	 * @param block_size        the number of cells along the side of a block
+	 */
+	TalusBlocks(const int width, const int height, const int block_size = 16)
+		: active(width, height, block_size, false), violations(active.block_number(), 0.)
+	{
+		active.activate_all();
+	}
+
+	ActiveSet active;               /**< the blocks around the cells changed since their last measure*/
+	std::vector<double> violations; /**< the talus violation of each block at its last measure*/
+};
+
+/**
+ * @brief Measure what an iteration of erosion changed, the tiles of the layers shared by both terrains being skipped
+ *
+ * @param before            the terrain before the iteration, on the same grid
+ * @param after             the terrain after the iteration
+ * @param criteria          the rest angle and the tolerances of the measures
+ * @param terrain           if not null, the sum of the layers after the iteration, to measure the talus without summing them
+ * @param blocks            if not null, the talus is only measured in its blocks around the cells changed since their last measure,
+ *                          the other blocks keeping their violation
+ * @return ErosionIteration the changes
+ */
+ErosionIteration measure_erosion(const MultiLayerMap& before, const MultiLayerMap& after, const ConvergenceCriteria& criteria,
+					const SimpleLayerMap* terrain = nullptr, TalusBlocks* blocks = nullptr);
+
+/**
+ * @brief Runs erosion iterations until the terrain stops changing
+ *	  The loop stops when an iteration changes no cell, or moves less than the relative mass with no talus violation.
+ *	  The talus of an iteration is only measured in the blocks of the grid around the cells it changed
+ *
+ * @param layers        	the Multi Layer Map to erode
+ * @param step          	one iteration of erosion, usually followed by a transport
+ * @param criteria      	when to stop
+ * @return ErosionStatistics	the changes of each iteration
+ */
+ErosionStatistics erode_until_converged(MultiLayerMap& layers, const std::function<void(MultiLayerMap&)>& step,
+					const ConvergenceCriteria& criteria);
+
+/**
+ * @brief Runs erosion iterations on the Multi Layer Map of a buffer until the terrain stops changing
+ *	  The steps given the buffer keep the terrain in sync, so the layers are not summed again by each erosion, transport and measure
+ *
+ * @param buffer        	the terrain of the Multi Layer Map to erode
+ * @param step          	one iteration of erosion, usually followed by a transport
+ * @param criteria      	when to stop
+ * @return ErosionStatistics	the changes of each iteration
+ */
+ErosionStatistics erode_until_converged(TerrainBuffer& buffer, const std::function<void(TerrainBuffer&)>& step,
+					const ConvergenceCriteria& criteria);
+
 /** @}*/
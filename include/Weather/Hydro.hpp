@@ -2,6 +2,8 @@
 
 #include <random>
 #include <MultiLayerMap.hpp>
+#include <Weather/CompiledBrush.hpp>
+#include <Weather/TerrainBuffer.hpp>
 
 /** \addtogroup Hydro
  * @{
@@ -24,6 +26,15 @@ SimpleLayerMap get_area(const DoubleField& heightmap, bool distribute = true);
  */
 SimpleLayerMap get_water_indexes(const DoubleField& heightmap);
 
+/**
+ * @brief Get the water indexes from already computed hydraulic area and slope
+ *
+ * @param area              the hydraulic area of the heightmap
+ * @param slope             the slope of the heightmap
+ * @return SimpleLayerMap   the map of the computed water index
+ */
+SimpleLayerMap get_water_indexes(const SimpleLayerMap& area, const SimpleLayerMap& slope);
+
 /**
  * @brief Erode and transport from Hydraulic area
  *
@@ -47,4 +58,56 @@ void erode_from_area(MultiLayerMap& layers, const SimpleLayerMap& area, double k
  * @param kd              deposition weight, high value leads to more flat plains
  */
 void erode_from_droplets(MultiLayerMap& layers, std::mt19937& gen, const SimpleLayerMap& brush, int n, double water_loss, double k, double kd = 0.5);
+
+/**
+ * @brief Erode and transport using droplets, with a compiled brush
+ *
+ * @param layers          the source for heightmap computation
+ * @param gen             the random numbers generator
+ * @param brush           distribute droplet effect among neighbors according to the given pattern
+ * @param n               number of droplets
+ * @param water_loss      water quantity loss per iteration
+ * @param k               intensity of erosion per droplet
+ * @param kd              deposition weight, high value leads to more flat plains
+ */
+void erode_from_droplets(MultiLayerMap& layers, std::mt19937& gen, const CompiledBrush& brush, int n, double water_loss, double k, double kd = 0.5);
+
+/**
+ * @brief The parameters of the droplets moving continuously on a terrain
+ *
+ */
+struct DropletParameters
+{
+	int radius = 3;             /**< the radius of the brush the droplets erode with, in cells*/
+	double inertia = 0.05;      /**< how much a droplet keeps its direction instead of following the slope, between 0 and 1*/
+	double capacity = 4.;       /**< the sediments a droplet can carry per unit of height descended, speed and water*/
+	double min_slope = 0.01;    /**< the height descended used for the capacity on flat areas*/
+	double erosion = 0.3;       /**< the fraction of the free capacity eroded at each step*/
+	double deposition = 0.3;    /**< the fraction of the excess of sediments deposited at each step*/
+	double evaporation = 0.01;  /**< the fraction of the water lost at each step*/
+	double gravity = 4.;        /**< how much the height descended accelerates a droplet*/
+	int max_steps = 64;         /**< the number of steps of a droplet*/
+};
+
+/**
+ * @brief Erode and transport using droplets moving continuously on the terrain.
+ * A droplet keeps a position between the cells and a direction, following the gradient of the bilinear interpolation of the terrain
+ * weighted by its inertia. It erodes the cells around it with a brush and deposits on the four cells under it,
+ * so the sediments are taken from the highest layer of each cell with a thickness down to the bedrock, and put on the top layer.
+ * The sediments of a droplet are deposited where it stops, so the mass of the terrain is kept
+ *
+ * @param buffer            the terrain of the Multi Layer Map to erode, a sediment layer being added if there is none
+ * @param gen               the random numbers generator
+ * @param n                 number of droplets
+ * @param parameters        the parameters of the droplets
+ * @return long             the number of steps done by all the droplets
+ * @throw                   invalid_argument if the radius of the brush or the number of steps is not positive
+ */
+long erode_from_continuous_droplets(TerrainBuffer& buffer, std::mt19937& gen, const int n, const DropletParameters& parameters = DropletParameters());
+
+/**
+ * @brief Erode and transport using droplets moving continuously on the terrain
+ * @see erode_from_continuous_droplets
+ */
+long erode_from_continuous_droplets(MultiLayerMap& layers, std::mt19937& gen, const int n, const DropletParameters& parameters = DropletParameters());
 /** @}*/
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <DoubleField.hpp>
+#include <MaterialColumns.hpp>
+
+#include <Eigen/Core>
+#include <vector>
+
+/** \addtogroup Erosion
+ * @{
+ */
+
+/**
+ * @brief Defines strata of materials under a terrain, stacked along the height then tilted and folded.
+ * All the strata are displaced by the same height at a given position, so the material of a point is found by a binary search
+ * of its height minus that displacement among the tops of the strata
+ *
+ */
+class Stratigraphy
+{
+public:
+	Stratigraphy() = delete;
+
+	/**
+	 * @brief Construct horizontal strata
+	 *
+	 * @param top_heights       the heights of the tops of the strata, in increasing order
+	 * @param erodibilities     the erosion values of the materials, in the same order, with one more value for the topmost 'infinite' material
+	 * @throw                   invalid_argument if the heights are not increasing or if the number of erosion values does not match
+	 */
+	Stratigraphy(const std::vector<double>& top_heights, const std::vector<double>& erodibilities);
+
+	/**
+	 * @brief Tilt the strata
+	 *
+	 * @param slope_x, slope_y  the height gained by the strata per unit along the width and the height of the plane
+	 * @param origin            the position on the plane where the strata are not displaced
+	 */
+	void set_tilt(const double slope_x, const double slope_y, const Eigen::Vector2d& origin);
+
+	/**
+	 * @brief Fold the strata in parallel waves
+	 *
+	 * @param amplitude         the height of the waves, 0 for no fold
+	 * @param wavelength        the distance between two crests, on the plane
+	 * @param direction         the angle between the width and the direction the waves follow each other, in degrees
+	 */
+	void set_fold(const double amplitude, const double wavelength, const double direction = 0);
+
+	/**
+	 * @brief Get the number of materials
+	 *
+	 */
+	int material_number() const
+	{
+		return _erodibilities.size();
+	}
+
+	/**
+	 * @brief Get the erosion value of a material
+	 *
+	 * @param material          the material, between 0 and material_number
+	 */
+	double erodibility(const int material) const
+	{
+		return _erodibilities[material];
+	}
+
+	/**
+	 * @brief Get the height the strata are displaced by at a position
+	 *
+	 * @param x, y              the position on the plane
+	 */
+	double offset(const double x, const double y) const;
+
+	/**
+	 * @brief Get the material at a point
+	 *
+	 * @param x, y, z           the position of the point, z being its height
+	 * @return int              the material, the number of strata whose top is under z
+	 */
+	int material(const double x, const double y, const double z) const;
+
+	/**
+	 * @brief Get the materials of the surface of a row of a field
+	 *
+	 * @param heights           the heights of the surface
+	 * @param j                 the row
+	 * @param materials         the grid_width materials to fill
+	 */
+	void materials_row(const DoubleField& heights, const int j, int* materials) const;
+
+	/**
+	 * @brief Fill a stack of columns with the strata between a base height and the heights of a field
+	 *
+	 * @param columns           the columns, on the grid of the field, the stack being emptied first
+	 * @param stack             the stack to fill
+	 * @param heights           the heights of the tops of the columns
+	 * @param base              the height of the bottom of the columns
+	 */
+	void fill_stack(MaterialColumns& columns, const int stack, const DoubleField& heights, const double base) const;
+
+private:
+	/**
+	 * @brief Get the material at a displaced height, starting the search from a guess
+	 *
+	 * @param z                 the height once the displacement of the strata is removed
+	 * @param guess             a likely material, the material of the previous cell of the row
+	 */
+	int search(const double z, const int guess) const;
+
+	std::vector<double> _tops;          /**< the heights of the tops of the strata, increasing*/
+	std::vector<double> _erodibilities; /**< the erosion values of the materials*/
+	Eigen::Vector2d _slope;             /**< the height gained per unit along the plane*/
+	Eigen::Vector2d _origin;            /**< the position of no displacement*/
+	double _amplitude;                  /**< the height of the folds*/
+	Eigen::Vector2d _wave;              /**< the direction of the folds, scaled to give a phase of 2 pi per wavelength*/
+};
+
+/** @}*/
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <MultiLayerMap.hpp>
+
+#include <memory>
+
+/** \addtogroup Erosion
+ * @{
+ */
+
+/**
+ * @brief Keeps the terrain of a Multi Layer Map, the sum of its layers, across the erosion and transport calls of an iteration.
+ * The operations taking a buffer update the terrain along with the layers and mark it as synced, so the layers are only summed again
+ * when they were modified outside of the buffer, which is detected with the version of the map.
+ * The terrain is updated incrementally and only matches the sum of the layers up to the rounding errors
+ *
+ */
+class TerrainBuffer
+{
+public:
+	TerrainBuffer() = delete;
+	TerrainBuffer(const TerrainBuffer&) = delete;
+	TerrainBuffer& operator=(const TerrainBuffer&) = delete;
+
+	/**
+	 * @brief Construct a buffer on a map, the layers being summed on the first access to the terrain
+	 *
+	 * @param layers        the Multi Layer Map, which must outlive the buffer
+	 */
+	explicit TerrainBuffer(MultiLayerMap& layers)
+		: _layers(layers), _version(0), _sums(0)
+	{
+	}
+
+	/**
+	 * @brief Get the map of the buffer
+	 *
+	 */
+	MultiLayerMap& layers()
+	{
+		return _layers;
+	}
+
+	/**
+	 * @brief Get the terrain, summing the layers again if they were modified outside of the buffer
+	 *
+	 * @return SimpleLayerMap&  the terrain, to modify along with the layers before calling mark_synced
+	 */
+	SimpleLayerMap& terrain();
+
+	/**
+	 * @brief Tells that the terrain matches the layers as they are now, after modifying both
+	 *
+	 */
+	void mark_synced()
+	{
+		_version = _layers.version();
+	}
+
+	/**
+	 * @brief Get the number of times the layers were summed
+	 *
+	 */
+	long sum_number() const
+	{
+		return _sums;
+	}
+
+private:
+	MultiLayerMap& _layers;                     /**< the map*/
+	std::unique_ptr<SimpleLayerMap> _terrain;   /**< the sum of the layers, null before the first access*/
+	unsigned long _version;                     /**< the version of the map the terrain matches*/
+	long _sums;                                 /**< the number of times the layers were summed*/
+};
+
+/** @}*/
@@ -0,0 +1,105 @@
+#include <BackgroundJob.hpp>
+
+BackgroundJob::~BackgroundJob()
+{
+	_progress.cancel();
+
+	if(_thread.joinable())
+	{
+		_thread.join();
+	}
+}
+
+bool BackgroundJob::start(const std::string& name, std::function<void()> work)
+{
+	if(is_running())
+	{
+		return false;
+	}
+
+	// the previous operation ended but its result was never asked for
+	finish();
+
+	_name = name;
+	_error.clear();
+	_progress.reset();
+	_status = Status::running;
+
+	_thread = std::thread([this, work]()
+	{
+		ProgressScope scope(_progress);
+
+		try
+		{
+			work();
+			// an operation that never reports its progress can't stop early, its result is still dropped
+			_status = _progress.is_cancelled() ? Status::cancelled : Status::finished;
+		}
+		catch(const JobCancelled&)
+		{
+			_status = Status::cancelled;
+		}
+		catch(const std::exception& e)
+		{
+			_error = e.what();
+			_status = Status::failed;
+		}
+	});
+
+	return true;
+}
+
+bool BackgroundJob::start(const std::string& name, const MultiLayerMap& source, std::function<void(MultiLayerMap&)> operation, const bool apply)
+{
+	if(is_running())
+	{
+		return false;
+	}
+
+	finish();
+
+	// the copy is made here so that the source can be modified as soon as the function returns
+	_result.reset(new MultiLayerMap(source));
+	_apply = apply;
+	MultiLayerMap* result = _result.get();
+
+	return start(name, [result, operation]()
+	{
+		operation(*result);
+	});
+}
+
+void BackgroundJob::cancel()
+{
+	_progress.cancel();
+}
+
+bool BackgroundJob::finish()
+{
+	if(is_running() || !_thread.joinable())
+	{
+		return false;
+	}
+
+	_thread.join();
+	_result.reset();
+	return true;
+}
+
+bool BackgroundJob::finish(MultiLayerMap& target)
+{
+	if(is_running() || !_thread.joinable())
+	{
+		return false;
+	}
+
+	_thread.join();
+
+	if(_status == Status::finished && _apply && _result)
+	{
+		target = std::move(*_result);
+	}
+
+	_result.reset();
+	return true;
+}
@@ -0,0 +1,349 @@
+#include <BatchScheduler.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+/**
+ * @brief Rough number of bytes used by a cell of the terrain during a run:
+ * the layers, the maps cached by the biome information, the transport and vegetation buffers and a checkpoint copy
+ *
+ */
+const long bytes_per_cell = 256;
+
+const long megabyte = 1024 * 1024;
+
+std::string format_number(const double v)
+{
+	std::ostringstream output;
+	output << v;
+	return output.str();
+}
+
+/**
+ * @brief Quote a csv field if needed
+ *
+ */
+std::string csv_field(const std::string& s)
+{
+	if(s.find_first_of(",\"\n") == std::string::npos)
+	{
+		return s;
+	}
+
+	std::string result = "\"";
+
+	for(char c : s)
+	{
+		result += (c == '"') ? "\"\"" : std::string(1, c);
+	}
+
+	return result + "\"";
+}
+}
+
+BatchScheduler::BatchScheduler(const Pipeline& pipeline, const int cores)
+{
+	const std::vector<std::string> names = pipeline.sweep().keys();
+	std::vector<std::vector<std::string>> values;
+	int job_number = 1;
+
+	for(const std::string& name : names)
+	{
+		values.push_back(sweep_values(pipeline.sweep().get_string(name)));
+
+		if(values.back().empty())
+		{
+			throw std::invalid_argument("no value for the swept parameter " + name);
+		}
+
+		job_number *= values.back().size();
+	}
+
+	_parameters = names;
+	const std::string output = pipeline.settings().get_string("output");
+	const std::string name = pipeline.name();
+
+	// each combination of the values is a job, the last parameter varying first
+	for(int index = 0; index < job_number; ++index)
+	{
+		BatchJob job = {index, {}, pipeline, 0};
+		int rest = index;
+
+		for(int p = names.size() - 1; p >= 0; --p)
+		{
+			job.parameters.insert(job.parameters.begin(), std::make_pair(names[p], values[p][rest % values[p].size()]));
+			rest /= values[p].size();
+		}
+
+		for(const auto& parameter : job.parameters)
+		{
+			job.pipeline = job.pipeline.with_parameter(parameter.first, parameter.second);
+		}
+
+		job.pipeline = job.pipeline.with_parameter("pipeline.name", name + "_" + std::to_string(index));
+		job.pipeline = job.pipeline.with_parameter("pipeline.output", output + "job_" + std::to_string(index) + "/");
+		job.memory = estimate_memory(job.pipeline);
+		_jobs.push_back(job);
+	}
+
+	const PipelineStage& batch = pipeline.batch();
+	_estimated_memory = static_cast<long>(batch.get_double("estimated_memory", 0) * megabyte);
+	_estimated_job_memory = static_cast<long>(batch.get_double("estimated_job_memory", 0) * megabyte);
+	_summary = batch.get_string("summary", output + "summary.csv");
+
+	// the cores are shared between the concurrent jobs and the threads of each job
+	const int core_number = cores > 0 ? cores : std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+	_concurrent_jobs = std::max(std::min(batch.get_int("jobs", core_number), job_number), 1);
+
+	if(_estimated_memory > 0)
+	{
+		long largest = 0;
+
+		for(const BatchJob& job : _jobs)
+		{
+			largest = std::max(largest, job.memory);
+		}
+
+		if(largest > 0)
+		{
+			_concurrent_jobs = std::max(std::min(static_cast<long>(_concurrent_jobs), _estimated_memory / largest), 1L);
+		}
+	}
+
+	_threads_per_job = std::max(core_number / _concurrent_jobs, 1);
+
+	for(BatchJob& job : _jobs)
+	{
+		if(!pipeline.sweep().has("pipeline.threads") && !pipeline.settings().has("threads"))
+		{
+			job.pipeline = job.pipeline.with_parameter("pipeline.threads", std::to_string(_threads_per_job));
+		}
+	}
+}
+
+std::vector<std::string> BatchScheduler::sweep_values(const std::string& values)
+{
+	std::istringstream input(values);
+	std::vector<std::string> words;
+	std::string word;
+
+	while(input >> word)
+	{
+		words.push_back(word);
+	}
+
+	if(words.size() != 1 || words[0].find(':') == std::string::npos)
+	{
+		return words;
+	}
+
+	// a range first:last[:step], the last value being included
+	std::vector<double> bounds;
+	std::istringstream range(words[0]);
+
+	while(std::getline(range, word, ':'))
+	{
+		std::istringstream number(word);
+		double v;
+
+		if(!(number >> v) || !number.eof())
+		{
+			throw std::invalid_argument("invalid range " + values);
+		}
+
+		bounds.push_back(v);
+	}
+
+	const double step = bounds.size() == 3 ? bounds[2] : 1;
+
+	if(bounds.size() < 2 || bounds.size() > 3 || step <= 0 || bounds[1] < bounds[0])
+	{
+		throw std::invalid_argument("invalid range " + values);
+	}
+
+	std::vector<std::string> result;
+	const int n = std::floor((bounds[1] - bounds[0]) / step + 1e-9) + 1;
+
+	for(int k = 0; k < n; ++k)
+	{
+		result.push_back(format_number(bounds[0] + k * step));
+	}
+
+	return result;
+}
+
+long BatchScheduler::estimate_memory(const Pipeline& pipeline)
+{
+	long cells = 0;
+
+	for(int s = 0; s < pipeline.stage_number(); ++s)
+	{
+		const PipelineStage& stage = pipeline.stage(s);
+
+		if(stage.type() != "terrain" || stage.get_bool("skip", false))
+		{
+			continue;
+		}
+
+		if(stage.has("input"))
+		{
+			// the size of a saved terrain is read from the header of the file
+			std::ifstream input(stage.get_string("input"), std::ifstream::in);
+			double bounds[4];
+			long width = 0;
+			long height = 0;
+			input >> bounds[0] >> bounds[1] >> bounds[2] >> bounds[3] >> width >> height;
+			cells = std::max(cells, input ? width * height : 0L);
+		}
+		else
+		{
+			const long width = stage.get_int("width", 100);
+			cells = std::max(cells, width * stage.get_int("height", width));
+		}
+	}
+
+	return cells * bytes_per_cell;
+}
+
+int BatchScheduler::run(std::ostream& log) const
+{
+	// the summary and the outputs of the jobs are usually in a directory of the batch
+	make_parent_directories(_summary);
+
+	for(const BatchJob& job : _jobs)
+	{
+		make_parent_directories(job.pipeline.settings().get_string("output"));
+	}
+
+	std::ofstream summary(_summary, std::ofstream::out);
+
+	if(!summary)
+	{
+		throw std::invalid_argument("can't write the summary file " + _summary);
+	}
+
+	summary << "job,name,status,seconds,estimated_memory_mb";
+
+	for(const std::string& name : _parameters)
+	{
+		summary << "," << csv_field(name);
+	}
+
+	for(int s = 0; !_jobs.empty() && s < _jobs[0].pipeline.stage_number(); ++s)
+	{
+		summary << ",stage_" << s << "_" << _jobs[0].pipeline.stage(s).type();
+	}
+
+	summary << ",min,max,mean" << std::endl;
+
+	std::mutex mutex;
+	std::condition_variable released;
+	long running_memory = 0;
+	int next = 0;
+	int failures = 0;
+
+	auto worker = [&]()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+
+		while(next < _jobs.size())
+		{
+			const BatchJob& job = _jobs[next++];
+			std::string status = "ok";
+			std::vector<StageReport> reports;
+			FieldStatistics stats;
+			double seconds = 0;
+			std::ostringstream buffer;
+
+			if(_estimated_job_memory > 0 && job.memory > _estimated_job_memory)
+			{
+				status = "over_memory";
+				buffer << job.pipeline.name() << ": estimated to need " << job.memory / megabyte << " MB, more than the "
+				       << _estimated_job_memory / megabyte << " MB allowed" << std::endl;
+			}
+			else
+			{
+				// a job starts when the estimated memory of the running jobs leaves room for it, or when it is the only one
+				released.wait(lock, [&]()
+				{
+					return _estimated_memory <= 0 || running_memory == 0 || running_memory + job.memory <= _estimated_memory;
+				});
+				running_memory += job.memory;
+				lock.unlock();
+
+				auto start = std::chrono::steady_clock::now();
+
+				try
+				{
+					MultiLayerMap mlm(2, 2);
+					reports = job.pipeline.run(mlm, buffer);
+					stats = mlm.statistics();
+				}
+				catch(const std::exception& e)
+				{
+					status = "failed";
+					buffer << job.pipeline.name() << ": " << e.what() << std::endl;
+				}
+
+				seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				lock.lock();
+				running_memory -= job.memory;
+				released.notify_all();
+			}
+
+			failures += (status != "ok");
+			log << buffer.str() << job.pipeline.name() << ": " << status << " in " << seconds << " s" << std::endl;
+
+			summary << job.index << "," << csv_field(job.pipeline.name()) << "," << status << "," << seconds << "," << job.memory / megabyte;
+
+			for(const auto& parameter : job.parameters)
+			{
+				summary << "," << csv_field(parameter.second);
+			}
+
+			for(int s = 0; s < job.pipeline.stage_number(); ++s)
+			{
+				summary << ",";
+
+				if(s < reports.size())
+				{
+					summary << reports[s].seconds;
+				}
+			}
+
+			if(status == "ok" && stats.count > 0)
+			{
+				summary << "," << stats.min << "," << stats.max << "," << stats.mean << std::endl;
+			}
+			else
+			{
+				summary << ",,," << std::endl;
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+
+	for(int t = 1; t < _concurrent_jobs; ++t)
+	{
+		threads.push_back(std::thread(worker));
+	}
+
+	worker();
+
+	for(std::thread& t : threads)
+	{
+		t.join();
+	}
+
+	return failures;
+}
@@ -1,5 +1,10 @@
 #include <DoubleField.hpp>
+#include <Mesh/MeshWriter.hpp>
+#include <ThreadPool.hpp>
+#include <Profiler.hpp>
 #include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <iostream>
 
 
@@ -13,6 +18,12 @@ DoubleField::read_only_iterator DoubleField::end() const
 	return DoubleField::read_only_iterator(this, cell_number());
 }
 
+unsigned long DoubleField::new_version()
+{
+	static std::atomic<unsigned long> last_version(0);
+	return ++last_version;
+}
+
 double DoubleField::value_inter(const double x, const double y) const
 {
 	Eigen::Vector2i ij = grid_position(x, y);
@@ -24,36 +35,83 @@ double DoubleField::value_inter(const double x, const double y) const
 	return (1 - u) * (1 - v) * value(ij(0), ij(1)) + (1 - u) * v * value(ij(0), ij(1) + 1) + u * (1 - v) * value(ij(0) + 1, ij(1)) + u * v * value(ij(0) + 1, ij(1) + 1);
 }
 
+FieldStatistics DoubleField::statistics() const
+{
+	return parallel_reduce_rows(*this, FieldStatistics(), [this](int row_begin, int row_end)
+	{
+		FieldStatistics stats;
+		std::vector<double> row(_grid_width);
+
+		for(int j = row_begin; j < row_end; ++j)
+		{
+			for(int i = 0; i < _grid_width; ++i)
+			{
+				row[i] = value(i, j);
+			}
+
+			stats.add_values(row.data(), _grid_width);
+		}
+
+		return stats;
+	}, [](FieldStatistics a, const FieldStatistics& b)
+	{
+		a.merge(b);
+		return a;
+	});
+}
+
+Histogram DoubleField::histogram(const double min, const double max, const int bins) const
+{
+	return parallel_reduce_rows(*this, Histogram(min, max, bins), [&](int row_begin, int row_end)
+	{
+		Histogram hist(min, max, bins);
+
+		for(int j = row_begin; j < row_end; ++j)
+		{
+			for(int i = 0; i < _grid_width; ++i)
+			{
+				hist.add(value(i, j));
+			}
+		}
+
+		return hist;
+	}, [](Histogram a, const Histogram& b)
+	{
+		a.merge(b);
+		return a;
+	});
+}
+
+Histogram DoubleField::histogram(const int bins) const
+{
+	FieldStatistics stats = statistics();
+	return histogram(stats.min, stats.max, bins);
+}
+
+std::pair<double, double> DoubleField::percentile_range(const double low, const double high, const int bins) const
+{
+	Histogram hist = histogram(bins);
+	return std::make_pair(hist.percentile(low), hist.percentile(high));
+}
+
 double DoubleField::get_min() const
 {
-	return *std::min_element(begin(), end());
+	return statistics().min;
 }
 
 double DoubleField::get_max() const
 {
-	return *std::max_element(begin(), end());
+	return statistics().max;
 }
 
 double DoubleField::get_range() const
 {
-	double valMin = get_min();
-	double valMax = get_max();
-	return valMax - valMin;
+	return statistics().range();
 }
 
 double DoubleField::get_sum() const
 {
-	double sum = 0;
-
-	for(int j = 0; j < grid_height(); ++j)
-	{
-		for(int i = 0; i < grid_width(); i++)
-		{
-			sum += value(i, j);
-		}
-	}
-
-	return sum;
+	return statistics().sum;
 }
 
 double DoubleField::slope(const Eigen::Vector2i p) const
@@ -102,6 +160,14 @@ Eigen::Vector2d DoubleField::gradient(const int i, const int j) const
 	return scale * grad;
 }
 
+void DoubleField::get_row(const int j, double* values) const
+{
+	for(int i = 0; i < _grid_width; ++i)
+	{
+		values[i] = value(i, j);
+	}
+}
+
 Eigen::Vector3d DoubleField::normal(const int i, const int j) const
 {
 	Eigen::Vector3d result;
@@ -113,6 +179,79 @@ Eigen::Vector3d DoubleField::normal(const int i, const int j) const
 	return result;
 }
 
+void DoubleField::get_rows_normals(const int row_begin, const int row_end, double* heights, double* normals) const
+{
+	const int n = (row_end - row_begin) * _grid_width;
+	std::vector<double> gx(n);
+	std::vector<double> gy(n);
+	get_rows_gradients(row_begin, row_end, gx.data(), gy.data(), heights);
+	normals_from_gradients(n, gx.data(), gy.data(), normals, normals + 1, normals + 2, 3);
+}
+
+void DoubleField::get_rows_gradients(const int row_begin, const int row_end, double* gx, double* gy, double* values) const
+{
+	const int w = _grid_width;
+	const double delta_x = width() / _grid_width;
+	const double delta_y = height() / _grid_height;
+
+	// the rows around the block are needed for the gradient, each one read once
+	const int first = std::max(row_begin - 1, 0);
+	const int last = std::min(row_end, _grid_height - 1);
+	std::vector<double> rows((last - first + 1) * w);
+
+	for(int j = first; j <= last; ++j)
+	{
+		get_row(j, &rows[(j - first) * w]);
+	}
+
+	for(int j = row_begin; j < row_end; ++j)
+	{
+		const double* row = &rows[(j - first) * w];
+		const double* below = &rows[(std::max(j - 1, 0) - first) * w];
+		const double* above = &rows[(std::min(j + 1, _grid_height - 1) - first) * w];
+		const double dy = (j <= 0 || j >= _grid_height - 1) ? delta_y : 2.0 * delta_y;
+		double* rx = gx + (j - row_begin) * w;
+		double* ry = gy + (j - row_begin) * w;
+
+		if(values)
+		{
+			std::copy(row, row + w, values + (j - row_begin) * w);
+		}
+
+		for(int i = 0; i < w; ++i)
+		{
+			ry[i] = (above[i] - below[i]) / dy;
+		}
+
+		if(w < 2)
+		{
+			rx[0] = 0;
+			continue;
+		}
+
+		// centered differences inside the row, one sided ones on its ends
+		for(int i = 1; i < w - 1; ++i)
+		{
+			rx[i] = (row[i + 1] - row[i - 1]) / (2.0 * delta_x);
+		}
+
+		rx[0] = (row[1] - row[0]) / delta_x;
+		rx[w - 1] = (row[w - 1] - row[w - 2]) / delta_x;
+	}
+}
+
+void DoubleField::normals_from_gradients(const int n, const double* gx, const double* gy, double* nx, double* ny, double* nz, const int stride)
+{
+	// the build has no instruction-set flags, this loop has no branch so that the compiler can vectorize it
+	for(int k = 0; k < n; ++k)
+	{
+		const double norm = std::sqrt(gx[k] * gx[k] + gy[k] * gy[k] + 1.);
+		nx[k * stride] = - gx[k] / norm;
+		ny[k * stride] = - gy[k] / norm;
+		nz[k * stride] = 1. / norm;
+	}
+}
+
 std::vector<std::pair<double, Eigen::Vector2i>> DoubleField::sort_by_height() const
 {
 	std::vector<std::pair<double, Eigen::Vector2i>> sorted_indices = export_to_list();
@@ -310,63 +449,77 @@ DoubleField& DoubleField::operator=(DoubleField&& sf)
 
 void DoubleField::export_as_obj(const std::string filename, const std::string name) const
 {
-	// Open the output file
-	std::ofstream output(filename, std::ofstream::out);
+	ObjWriter writer(filename, name);
+	export_mesh(writer);
+}
 
-	// Give the name to the object if specified
-	if(name != "")
-	{
-		output << "o " << name << std::endl;
-	}
+void DoubleField::export_as_ply(const std::string filename, const bool binary) const
+{
+	PlyWriter writer(filename, binary);
+	export_mesh(writer);
+}
 
-	// Set the information for each points
-	for(int j = 0; j < _grid_height; ++j)
+void DoubleField::export_as_binary_mesh(const std::string filename) const
+{
+	BinaryMeshWriter writer(filename);
+	export_mesh(writer);
+}
+
+void DoubleField::export_mesh(MeshWriter& writer) const
+{
+	PROFILE_SCOPE("export.mesh");
+	writer.begin(_grid_width * _grid_height, 2 * (_grid_width - 1) * (_grid_height - 1));
+
+	// Set the information for each points, by blocks of rows
+	const int block = 64;
+	std::vector<double> heights(block * _grid_width);
+	std::vector<double> normals(3 * block * _grid_width);
+	const double u_scale = 1. / std::max(_grid_width - 1, 1);
+	const double v_scale = 1. / std::max(_grid_height - 1, 1);
+
+	for(int row_begin = 0; row_begin < _grid_height; row_begin += block)
 	{
-		// a => the lower left corner of the field in world coordinate
-		// Calculate the y coordinate
-		double vy = _a[1] + j * _cell_size[1];
+		int row_end = std::min(row_begin + block, _grid_height);
+		parallel_for(row_begin, row_end, [&](int b, int e)
+		{
+			get_rows_normals(b, e, &heights[(b - row_begin) * _grid_width], &normals[3 * (b - row_begin) * _grid_width]);
+		}, 8);
 
-		for(int i = 0; i < _grid_width; ++i)
+		for(int j = row_begin; j < row_end; ++j)
 		{
-			// Compute the normal of the point
-			Eigen::Vector3d norm = normal(i, j);
-			// Set the vertex information
-			output << "v " << _a[0] + i * _cell_size[0] << " " << value(i, j) << " " << vy << std::endl;
-			// Set the texture information
-			output << "vt " << (double)i / (_grid_width - 1) << " " << (double)j / (_grid_height - 1) << std::endl;
-			// Set the normal information
-			output << "vn " << norm[0] << " " << norm[2] << " " << norm[1] << std::endl;
-			output << std::endl;
+			// a => the lower left corner of the field in world coordinate
+			double vy = _a[1] + j * _cell_size[1];
+
+			for(int i = 0; i < _grid_width; ++i)
+			{
+				int k = (j - row_begin) * _grid_width + i;
+				const double* norm = &normals[3 * k];
+				// the values are on the y axis of the mesh
+				double position[3] = {_a[0] + i * _cell_size[0], heights[k], vy};
+				double normal[3] = {norm[0], norm[2], norm[1]};
+				double uv[2] = {i * u_scale, j * v_scale};
+				writer.vertex(position, normal, uv);
+			}
 		}
 	}
 
 	// Set the information for each face
 	for(int j = 0; j < _grid_height - 1; ++j)
 	{
-		for(int i = 1; i < _grid_width; ++i)
+		for(int i = 0; i < _grid_width - 1; ++i)
 		{
-			int id0 = j * _grid_width + i;
-			int id1 = j * _grid_width + i + 1;
-			int id2 = (j + 1) * _grid_width + i;
-			output << "f " << id0 << "/" << id0 << "/" << id0;
-			output << " " << id1 << "/" << id1 << "/" << id1;
-			output << " " << id2 << "/" << id2 << "/" << id2 << std::endl;
-			id0 = j * _grid_width + i + 1;
-			id1 = (j + 1) * _grid_width + i + 1;
-			id2 = (j + 1) * _grid_width + i;
-			output << "f " << id0 << "/" << id0 << "/" << id0;
-			output << " " << id1 << "/" << id1 << "/" << id1;
-			output << " " << id2 << "/" << id2 << "/" << id2 << std::endl;
+			unsigned int id = j * _grid_width + i;
+			writer.triangle(id, id + 1, id + _grid_width);
+			writer.triangle(id + 1, id + _grid_width + 1, id + _grid_width);
 		}
 	}
 
-	output << std::flush;
-	output.close();
+	writer.end();
 }
 
-
 void DoubleField::export_as_pgm(const std::string filename, bool minMax, double rangeMin, double rangeMax) const
 {
+	PROFILE_SCOPE("export.pgm");
 	int maxVal = 255;
 	std::ofstream output(filename, std::ofstream::out);
 	output << "P2" << std::endl;
@@ -375,8 +528,9 @@ void DoubleField::export_as_pgm(const std::string filename, bool minMax, double
 
 	if(minMax)
 	{
-		rangeMax = get_max();
-		rangeMin = get_min();
+		FieldStatistics stats = statistics();
+		rangeMax = stats.max;
+		rangeMin = stats.min;
 	}
 
 	float range = rangeMax - rangeMin;
@@ -392,6 +546,11 @@ void DoubleField::export_as_pgm(const std::string filename, bool minMax, double
 	}
 }
 
+void DoubleField::export_as_pgm_clipped(const std::string filename, const double low, const double high) const
+{
+	std::pair<double, double> range = percentile_range(low, high);
+	export_as_pgm(filename, false, range.first, range.second);
+}
 
 std::vector<std::pair<double, Eigen::Vector2i>> DoubleField::export_to_list() const
 {
@@ -0,0 +1,151 @@
+#include <MassAudit.hpp>
+#include <Profiler.hpp>
+#include <Statistics.hpp>
+#include <ThreadPool.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+MassAudit::MassAudit(const MultiLayerMap& mlm, const int band_width, const int bands)
+	: _width(mlm.grid_width()), _height(mlm.grid_height()), _layers(mlm.get_layer_number()), _band_width(band_width), _bands(bands)
+{
+	if(band_width <= 0 || bands < 0)
+	{
+		throw std::invalid_argument("a mass audit needs a positive band width and a positive number of bands");
+	}
+
+	PROFILE_SCOPE("mass_audit");
+	const int n = band_number();
+	const int border = _bands * _band_width;
+	const double area = mlm.cell_size()(0) * mlm.cell_size()(1);
+
+	for(int f = 0; f < _layers; ++f)
+	{
+		const TileStorage& values = mlm.get_field(f).storage();
+
+		// 4 tiles of 4096 cells per chunk, each chunk summing in its own bands
+		const std::vector<CompensatedSum> sums = parallel_reduce(0, values.tile_number(), 4, std::vector<CompensatedSum>(n), [&](int begin, int end)
+		{
+			std::vector<CompensatedSum> s(n);
+
+			for(int t = begin; t < end; ++t)
+			{
+				if(values.is_empty(t))
+				{
+					continue;
+				}
+
+				int i0, j0, i1, j1;
+				values.tile_bounds(t, i0, j0, i1, j1);
+				const double* tile = values.tile(t);
+
+				// the tiles away from the borders are summed row by row
+				if(i0 >= border && j0 >= border && i1 <= _width - border && j1 <= _height - border)
+				{
+					for(int j = j0; j < j1; ++j)
+					{
+						s[_bands].add_values(tile + TileStorage::tile_offset(i0, j), i1 - i0);
+					}
+
+					continue;
+				}
+
+				for(int j = j0; j < j1; ++j)
+				{
+					const int dj = std::min(j, _height - 1 - j);
+
+					for(int i = i0; i < i1; ++i)
+					{
+						const int d = std::min(dj, std::min(i, _width - 1 - i));
+						s[std::min(d / _band_width, _bands)].add(tile[TileStorage::tile_offset(i, j)]);
+					}
+				}
+			}
+
+			return s;
+		}, [](std::vector<CompensatedSum> a, const std::vector<CompensatedSum>& b)
+		{
+			for(int k = 0; k < a.size(); ++k)
+			{
+				a[k].merge(b[k]);
+			}
+
+			return a;
+		});
+
+		for(int b = 0; b < n; ++b)
+		{
+			_masses.push_back(sums[b].value() * area);
+		}
+	}
+}
+
+double MassAudit::layer_mass(const int layer) const
+{
+	CompensatedSum sum;
+	sum.add_values(_masses.data() + layer * band_number(), band_number());
+	return sum.value();
+}
+
+double MassAudit::total() const
+{
+	CompensatedSum sum;
+	sum.add_values(_masses.data(), _masses.size());
+	return sum.value();
+}
+
+bool MassAudit::comparable(const MassAudit& other) const
+{
+	return _width == other._width && _height == other._height && _band_width == other._band_width && _bands == other._bands;
+}
+
+double MassLeak::layer_leak(const int layer) const
+{
+	CompensatedSum sum;
+	sum.add_values(leaks.data() + layer * bands, bands);
+	return sum.value();
+}
+
+double MassLeak::band_leak(const int band) const
+{
+	CompensatedSum sum;
+
+	for(int i = band; i < leaks.size(); i += bands)
+	{
+		sum.add(leaks[i]);
+	}
+
+	return sum.value();
+}
+
+MassLeak compare_mass(const MassAudit& before, const MassAudit& after)
+{
+	MassLeak result;
+
+	if(!before.comparable(after))
+	{
+		return result;
+	}
+
+	result.comparable = true;
+	result.bands = before.band_number();
+
+	// a layer added or removed by the operation is empty on the other side
+	const int layers = std::max(before.layer_number(), after.layer_number());
+
+	for(int f = 0; f < layers; ++f)
+	{
+		for(int b = 0; b < result.bands; ++b)
+		{
+			const double m0 = (f < before.layer_number()) ? before.mass(f, b) : 0.;
+			const double m1 = (f < after.layer_number()) ? after.mass(f, b) : 0.;
+			result.leaks.push_back(m1 - m0);
+		}
+	}
+
+	const double total = before.total();
+	result.total = after.total() - total;
+	result.relative = (total != 0) ? result.total / std::abs(total) : 0.;
+	return result;
+}
@@ -0,0 +1,213 @@
+#include <MaterialColumns.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+
+MaterialColumns::MaterialColumns(const int width, const int height, const int stacks)
+	: _width(width), _height(height), _stacks(stacks), _unused(0)
+{
+	if(width <= 0 || height <= 0 || stacks <= 0)
+	{
+		throw std::invalid_argument("material columns need at least one cell and one stack");
+	}
+
+	_slices.resize(width * height * stacks, {0, 0, 0});
+}
+
+int MaterialColumns::slice(const int i, const int j, const int stack) const
+{
+	if(i < 0 || i >= _width || j < 0 || j >= _height || stack < 0 || stack >= _stacks)
+	{
+		throw std::out_of_range("wrong access to a stack of the MaterialColumns");
+	}
+
+	return (j * _width + i) * _stacks + stack;
+}
+
+double MaterialColumns::thickness(const int i, const int j, const int stack) const
+{
+	const Slice& s = _slices[slice(i, j, stack)];
+	double sum = 0;
+
+	for(int r = s.offset; r < s.offset + s.size; ++r)
+	{
+		sum += _arena[r].thickness;
+	}
+
+	return sum;
+}
+
+double MaterialColumns::thickness(const int i, const int j, const int stack, const int material) const
+{
+	const Slice& s = _slices[slice(i, j, stack)];
+	double sum = 0;
+
+	for(int r = s.offset; r < s.offset + s.size; ++r)
+	{
+		sum += (_arena[r].material == material) ? _arena[r].thickness : 0.;
+	}
+
+	return sum;
+}
+
+void MaterialColumns::deposit(const int i, const int j, const int stack, const int material, const double thickness)
+{
+	if(thickness <= 0)
+	{
+		return;
+	}
+
+	Slice* s = &_slices[slice(i, j, stack)];
+
+	if(s->size > 0 && _arena[s->offset + s->size - 1].material == material)
+	{
+		_arena[s->offset + s->size - 1].thickness += thickness;
+		return;
+	}
+
+	if(s->size == s->capacity)
+	{
+		// more than half of the arena belongs to no slice anymore
+		if(_unused > 1024 && _unused * 2 > _arena.size())
+		{
+			compact();
+			s = &_slices[slice(i, j, stack)];
+		}
+
+		// the slice moves to the end of the arena with twice its capacity
+		const int capacity = std::max(2, 2 * s->capacity);
+		const int offset = _arena.size();
+		_arena.resize(offset + capacity);
+		std::copy(_arena.begin() + s->offset, _arena.begin() + s->offset + s->size, _arena.begin() + offset);
+		_unused += s->capacity;
+		s->offset = offset;
+		s->capacity = capacity;
+	}
+
+	_arena[s->offset + s->size] = {material, thickness};
+	++s->size;
+}
+
+double MaterialColumns::remove(const int i, const int j, const int stack, const double thickness, std::vector<Run>* removed)
+{
+	Slice& s = _slices[slice(i, j, stack)];
+	double left = thickness;
+
+	while(left > 0 && s.size > 0)
+	{
+		Run& top = _arena[s.offset + s.size - 1];
+		const double taken = std::min(left, top.thickness);
+
+		if(removed)
+		{
+			removed->push_back({top.material, taken});
+		}
+
+		left -= taken;
+		top.thickness -= taken;
+
+		if(top.thickness <= 0)
+		{
+			--s.size;
+		}
+	}
+
+	return thickness - std::max(left, 0.);
+}
+
+long MaterialColumns::total_runs() const
+{
+	long n = 0;
+
+	for(const Slice& s : _slices)
+	{
+		n += s.size;
+	}
+
+	return n;
+}
+
+long MaterialColumns::memory() const
+{
+	return _arena.capacity() * sizeof(Run) + _slices.capacity() * sizeof(Slice);
+}
+
+void MaterialColumns::compact()
+{
+	std::vector<Run> arena;
+	arena.reserve(total_runs());
+
+	for(Slice& s : _slices)
+	{
+		const int offset = arena.size();
+		arena.insert(arena.end(), _arena.begin() + s.offset, _arena.begin() + s.offset + s.size);
+		s.offset = offset;
+		s.capacity = s.size;
+	}
+
+	_arena = std::move(arena);
+	_unused = 0;
+}
+
+std::istream& operator>>(std::istream& is, MaterialColumns& columns)
+{
+	int width, height, stacks;
+
+	if(!(is >> width >> height >> stacks))
+	{
+		return is;
+	}
+
+	MaterialColumns read(width, height, stacks);
+
+	for(int j = 0; j < height; ++j)
+	{
+		for(int i = 0; i < width; ++i)
+		{
+			for(int s = 0; s < stacks; ++s)
+			{
+				int runs = 0;
+				is >> runs;
+
+				for(int r = 0; r < runs && is; ++r)
+				{
+					MaterialColumns::Run run;
+					is >> run.material >> run.thickness;
+					read.deposit(i, j, s, run.material, run.thickness);
+				}
+			}
+		}
+	}
+
+	if(is)
+	{
+		columns = std::move(read);
+	}
+
+	return is;
+}
+
+std::ostream& operator<<(std::ostream& os, const MaterialColumns& columns)
+{
+	os << columns.width() << " " << columns.height() << " " << columns.stack_number() << " ";
+
+	for(int j = 0; j < columns.height(); ++j)
+	{
+		for(int i = 0; i < columns.width(); ++i)
+		{
+			for(int s = 0; s < columns.stack_number(); ++s)
+			{
+				const int runs = columns.run_number(i, j, s);
+				const MaterialColumns::Run* run = columns.runs(i, j, s);
+				os << runs << " ";
+
+				for(int r = 0; r < runs; ++r)
+				{
+					os << run[r].material << " " << run[r].thickness << " ";
+				}
+			}
+		}
+	}
+
+	return os;
+}
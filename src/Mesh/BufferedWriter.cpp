@@ -0,0 +1,139 @@
+#include <Mesh/BufferedWriter.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+BufferedWriter::BufferedWriter(const std::string& filename, const int buffer_size)
+	: _output(filename, std::ofstream::out | std::ofstream::binary), _buffer(std::max(buffer_size, 64)), _used(0)
+{
+}
+
+BufferedWriter::~BufferedWriter()
+{
+	flush();
+	_output.close();
+}
+
+void BufferedWriter::write(const char* data, const int n)
+{
+	if(_used + n > _buffer.size())
+	{
+		flush();
+
+		if(n > _buffer.size())
+		{
+			_output.write(data, n);
+			return;
+		}
+	}
+
+	std::memcpy(_buffer.data() + _used, data, n);
+	_used += n;
+}
+
+void BufferedWriter::write_int(const long v)
+{
+	char digits[24];
+	int n = 0;
+	unsigned long a = v < 0 ? -static_cast<unsigned long>(v) : v;
+
+	do
+	{
+		digits[n++] = '0' + a % 10;
+		a /= 10;
+	}
+	while(a != 0);
+
+	if(v < 0)
+	{
+		write_char('-');
+	}
+
+	while(n > 0)
+	{
+		write_char(digits[--n]);
+	}
+}
+
+void BufferedWriter::write_double(const double v, const int decimals)
+{
+	static const long powers[10] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000};
+	double a = std::abs(v);
+
+	// NaN, infinite and huge values are rare enough to go through printf
+	if(!(a < 1e9) || decimals < 0 || decimals > 9)
+	{
+		char tmp[32];
+		int n = std::snprintf(tmp, sizeof(tmp), "%g", v);
+		write(tmp, n);
+		return;
+	}
+
+	long scaled = std::lround(a * powers[decimals]);
+
+	if(scaled == 0)
+	{
+		write_char('0');
+		return;
+	}
+
+	if(v < 0)
+	{
+		write_char('-');
+	}
+
+	write_int(scaled / powers[decimals]);
+	long fraction = scaled % powers[decimals];
+
+	if(fraction != 0)
+	{
+		int digits = decimals;
+
+		while(fraction % 10 == 0)
+		{
+			fraction /= 10;
+			--digits;
+		}
+
+		char tmp[10];
+
+		for(int d = digits - 1; d >= 0; --d)
+		{
+			tmp[d] = '0' + fraction % 10;
+			fraction /= 10;
+		}
+
+		write_char('.');
+		write(tmp, digits);
+	}
+}
+
+void BufferedWriter::write_uint(const std::uint32_t v, const int bytes)
+{
+	char data[4];
+
+	for(int b = 0; b < bytes; ++b)
+	{
+		data[b] = static_cast<char>((v >> (8 * b)) & 0xff);
+	}
+
+	write(data, bytes);
+}
+
+void BufferedWriter::write_float(const float v)
+{
+	std::uint32_t bits;
+	std::memcpy(&bits, &v, sizeof(bits));
+	write_uint(bits);
+}
+
+void BufferedWriter::flush()
+{
+	if(_used > 0)
+	{
+		_output.write(_buffer.data(), _used);
+		_used = 0;
+	}
+}
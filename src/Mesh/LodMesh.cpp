@@ -0,0 +1,229 @@
+#include <Mesh/LodMesh.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+/**
+ * @brief A square node of the quadtree, in grid coordinates
+ *
+ */
+struct QuadNode
+{
+	int x;              /**< the column of the lower left corner*/
+	int y;              /**< the row of the lower left corner*/
+	int size;           /**< the number of cells on a side*/
+	bool split;         /**< true if two triangles are precise enough for this node*/
+};
+
+/**
+ * @brief Compute the errors of the approximations of a node:
+ * the four triangles fanning from its center and the two triangles split along a diagonal
+ *
+ */
+void node_errors(const std::vector<double>& heights, const int w, const QuadNode& n, double& fan, double& split)
+{
+	fan = 0;
+	split = 0;
+	const int s = n.size;
+
+	if(s < 2)
+	{
+		return;
+	}
+
+	const double* base = &heights[n.y * w + n.x];
+	const double h00 = base[0];
+	const double h10 = base[s];
+	const double h01 = base[s * w];
+	const double h11 = base[s * w + s];
+	const double hc = base[(s / 2) * w + s / 2];
+	const double inv = 1. / s;
+
+	for(int j = 0; j <= s; ++j)
+	{
+		const double* row = base + j * w;
+		const double dv = (j - s / 2) * inv;
+
+		for(int i = 0; i <= s; ++i)
+		{
+			// two triangles, the diagonal joining the (x + s, y) and (x, y + s) corners
+			double t = (i + j <= s) ? h00 + (h10 - h00) * i * inv + (h01 - h00) * j * inv
+			           : h11 + (h01 - h11) * (s - i) * inv + (h10 - h11) * (s - j) * inv;
+			split = std::max(split, std::abs(row[i] - t));
+
+			// four triangles from the center, the corners being at offsets of +/-0.5
+			const double du = (i - s / 2) * inv;
+			double f;
+
+			if(dv <= -std::abs(du))
+			{
+				f = hc + (-du - dv) * (h00 - hc) + (du - dv) * (h10 - hc);
+			}
+			else if(dv >= std::abs(du))
+			{
+				f = hc + (du + dv) * (h11 - hc) + (dv - du) * (h01 - hc);
+			}
+			else if(du > 0)
+			{
+				f = hc + (du - dv) * (h10 - hc) + (du + dv) * (h11 - hc);
+			}
+			else
+			{
+				f = hc + (dv - du) * (h01 - hc) + (-du - dv) * (h00 - hc);
+			}
+
+			fan = std::max(fan, std::abs(row[i] - f));
+		}
+	}
+}
+}
+
+Mesh generate_lod_mesh(const DoubleField& field, const double tolerance)
+{
+	Mesh mesh;
+	const int w = field.grid_width();
+	const int h = field.grid_height();
+
+	if(w < 2 || h < 2)
+	{
+		return mesh;
+	}
+
+	std::vector<double> heights(w * h);
+	std::vector<double> normals(3 * w * h);
+	field.get_rows_normals(0, h, heights.data(), normals.data());
+
+	// the root covers the whole grid, nodes crossing its border are always split
+	int root = 1;
+
+	while(root < std::max(w - 1, h - 1))
+	{
+		root *= 2;
+	}
+
+	std::vector<QuadNode> stack(1, QuadNode{0, 0, root, false});
+	std::vector<QuadNode> leaves;
+	std::vector<char> corner(w * h, 0);
+
+	while(!stack.empty())
+	{
+		QuadNode n = stack.back();
+		stack.pop_back();
+
+		if(n.x >= w - 1 || n.y >= h - 1)
+		{
+			continue;
+		}
+
+		if(n.x + n.size <= w - 1 && n.y + n.size <= h - 1)
+		{
+			double fan, split;
+			node_errors(heights, w, n, fan, split);
+
+			if(fan <= tolerance)
+			{
+				n.split = split <= tolerance;
+				leaves.push_back(n);
+				corner[n.y * w + n.x] = 1;
+				corner[n.y * w + n.x + n.size] = 1;
+				corner[(n.y + n.size) * w + n.x] = 1;
+				corner[(n.y + n.size) * w + n.x + n.size] = 1;
+				continue;
+			}
+		}
+
+		const int half = n.size / 2;
+		stack.push_back(QuadNode{n.x, n.y, half, false});
+		stack.push_back(QuadNode{n.x + half, n.y, half, false});
+		stack.push_back(QuadNode{n.x, n.y + half, half, false});
+		stack.push_back(QuadNode{n.x + half, n.y + half, half, false});
+	}
+
+	// only the points used by a triangle become vertices
+	const Eigen::Vector2d a = field.min();
+	const Eigen::Vector2d cell = field.cell_size();
+	const double u_scale = 1. / (w - 1);
+	const double v_scale = 1. / (h - 1);
+	std::vector<int> ids(w * h, -1);
+
+	auto vertex = [&](const int i, const int j) -> unsigned int
+	{
+		int k = j * w + i;
+
+		if(ids[k] < 0)
+		{
+			double position[3] = {a[0] + i * cell[0], heights[k], a[1] + j * cell[1]};
+			double normal[3] = {normals[3 * k], normals[3 * k + 2], normals[3 * k + 1]};
+			double uv[2] = {i * u_scale, j * v_scale};
+			ids[k] = mesh.add_vertex(position, normal, uv);
+		}
+
+		return ids[k];
+	};
+
+	std::vector<unsigned int> border;
+
+	for(const QuadNode& n : leaves)
+	{
+		const int s = n.size;
+
+		// walk the border counterclockwise, keeping the corners of the leaves
+		border.clear();
+
+		for(int i = 0; i < s; ++i)
+		{
+			if(corner[n.y * w + n.x + i])
+			{
+				border.push_back(vertex(n.x + i, n.y));
+			}
+		}
+
+		for(int j = 0; j < s; ++j)
+		{
+			if(corner[(n.y + j) * w + n.x + s])
+			{
+				border.push_back(vertex(n.x + s, n.y + j));
+			}
+		}
+
+		for(int i = s; i > 0; --i)
+		{
+			if(corner[(n.y + s) * w + n.x + i])
+			{
+				border.push_back(vertex(n.x + i, n.y + s));
+			}
+		}
+
+		for(int j = s; j > 0; --j)
+		{
+			if(corner[(n.y + j) * w + n.x])
+			{
+				border.push_back(vertex(n.x, n.y + j));
+			}
+		}
+
+		if(border.size() == 4 && (s == 1 || n.split))
+		{
+			mesh.add_triangle(border[0], border[1], border[3]);
+			mesh.add_triangle(border[1], border[2], border[3]);
+		}
+		else
+		{
+			unsigned int center = vertex(n.x + s / 2, n.y + s / 2);
+
+			for(int b = 0; b < border.size(); ++b)
+			{
+				mesh.add_triangle(center, border[b], border[(b + 1) % border.size()]);
+			}
+		}
+	}
+
+	return mesh;
+}
+
+double screen_space_tolerance(const double pixel_error, const double distance, const double fov, const int viewport_height)
+{
+	return pixel_error * 2 * distance * std::tan(fov / 2) / std::max(viewport_height, 1);
+}
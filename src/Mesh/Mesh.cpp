@@ -0,0 +1,26 @@
+#include <Mesh/Mesh.hpp>
+
+unsigned int Mesh::add_vertex(const double* position, const double* normal, const double* uv)
+{
+	positions.insert(positions.end(), position, position + 3);
+	normals.insert(normals.end(), normal, normal + 3);
+	uvs.insert(uvs.end(), uv, uv + 2);
+	return vertex_number() - 1;
+}
+
+void Mesh::write(MeshWriter& writer) const
+{
+	writer.begin(vertex_number(), triangle_number());
+
+	for(int v = 0; v < vertex_number(); ++v)
+	{
+		writer.vertex(&positions[3 * v], &normals[3 * v], &uvs[2 * v]);
+	}
+
+	for(int t = 0; t < triangle_number(); ++t)
+	{
+		writer.triangle(indices[3 * t], indices[3 * t + 1], indices[3 * t + 2]);
+	}
+
+	writer.end();
+}
@@ -0,0 +1,185 @@
+#include <Mesh/MeshWriter.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+ObjWriter::ObjWriter(const std::string& filename, const std::string& name)
+	: _output(filename), _name(name)
+{
+}
+
+void ObjWriter::begin(const int, const int)
+{
+	// Give the name to the object if specified
+	if(_name != "")
+	{
+		_output.write("o ");
+		_output.write(_name);
+		_output.write_char('\n');
+	}
+}
+
+void ObjWriter::vertex(const double* position, const double* normal, const double* uv)
+{
+	_output.write("v ");
+	_output.write_double(position[0]);
+	_output.write_char(' ');
+	_output.write_double(position[1]);
+	_output.write_char(' ');
+	_output.write_double(position[2]);
+	_output.write("\nvt ");
+	_output.write_double(uv[0]);
+	_output.write_char(' ');
+	_output.write_double(uv[1]);
+	_output.write("\nvn ");
+	_output.write_double(normal[0]);
+	_output.write_char(' ');
+	_output.write_double(normal[1]);
+	_output.write_char(' ');
+	_output.write_double(normal[2]);
+	_output.write("\n\n");
+}
+
+void ObjWriter::triangle(const unsigned int a, const unsigned int b, const unsigned int c)
+{
+	// OBJ indices start at 1 and are the same for the position, the texture and the normal
+	const unsigned int ids[3] = {a + 1, b + 1, c + 1};
+	_output.write_char('f');
+
+	for(int k = 0; k < 3; ++k)
+	{
+		_output.write_char(' ');
+		_output.write_int(ids[k]);
+		_output.write_char('/');
+		_output.write_int(ids[k]);
+		_output.write_char('/');
+		_output.write_int(ids[k]);
+	}
+
+	_output.write_char('\n');
+}
+
+void ObjWriter::end()
+{
+	_output.flush();
+}
+
+PlyWriter::PlyWriter(const std::string& filename, const bool binary)
+	: _output(filename), _binary(binary)
+{
+}
+
+void PlyWriter::begin(const int vertex_number, const int triangle_number)
+{
+	_output.write("ply\n");
+	_output.write(_binary ? "format binary_little_endian 1.0\n" : "format ascii 1.0\n");
+	_output.write("element vertex ");
+	_output.write_int(vertex_number);
+	_output.write("\nproperty float x\nproperty float y\nproperty float z\n");
+	_output.write("property float nx\nproperty float ny\nproperty float nz\n");
+	_output.write("property float s\nproperty float t\n");
+	_output.write("element face ");
+	_output.write_int(triangle_number);
+	_output.write("\nproperty list uchar uint vertex_indices\nend_header\n");
+}
+
+void PlyWriter::vertex(const double* position, const double* normal, const double* uv)
+{
+	if(_binary)
+	{
+		const double* data[3] = {position, normal, uv};
+		const int sizes[3] = {3, 3, 2};
+
+		for(int k = 0; k < 3; ++k)
+		{
+			for(int c = 0; c < sizes[k]; ++c)
+			{
+				_output.write_float(data[k][c]);
+			}
+		}
+	}
+	else
+	{
+		const double* data[3] = {position, normal, uv};
+		const int sizes[3] = {3, 3, 2};
+
+		for(int k = 0; k < 3; ++k)
+		{
+			for(int c = 0; c < sizes[k]; ++c)
+			{
+				_output.write_double(data[k][c]);
+				_output.write_char(k == 2 && c == 1 ? '\n' : ' ');
+			}
+		}
+	}
+}
+
+void PlyWriter::triangle(const unsigned int a, const unsigned int b, const unsigned int c)
+{
+	if(_binary)
+	{
+		_output.write_uint(3, 1);
+		_output.write_uint(a);
+		_output.write_uint(b);
+		_output.write_uint(c);
+	}
+	else
+	{
+		_output.write("3 ");
+		_output.write_int(a);
+		_output.write_char(' ');
+		_output.write_int(b);
+		_output.write_char(' ');
+		_output.write_int(c);
+		_output.write_char('\n');
+	}
+}
+
+void PlyWriter::end()
+{
+	_output.flush();
+}
+
+BinaryMeshWriter::BinaryMeshWriter(const std::string& filename)
+	: _output(filename), _short_indices(false)
+{
+}
+
+void BinaryMeshWriter::begin(const int vertex_number, const int triangle_number)
+{
+	_short_indices = vertex_number <= 65536;
+	_output.write("TGMB", 4);
+	_output.write_uint(1);
+	_output.write_uint(vertex_number);
+	_output.write_uint(3 * triangle_number);
+	_output.write_uint(_short_indices ? 2 : 4);
+}
+
+void BinaryMeshWriter::vertex(const double* position, const double* normal, const double*)
+{
+	for(int k = 0; k < 3; ++k)
+	{
+		_output.write_float(position[k]);
+	}
+
+	// the normals are stored as int16, written as their two's complement
+	for(int k = 0; k < 3; ++k)
+	{
+		const std::int16_t n = static_cast<std::int16_t>(std::lround(std::max(-1., std::min(1., normal[k])) * 32767));
+		_output.write_uint(static_cast<std::uint16_t>(n), 2);
+	}
+}
+
+void BinaryMeshWriter::triangle(const unsigned int a, const unsigned int b, const unsigned int c)
+{
+	const int bytes = _short_indices ? 2 : 4;
+	_output.write_uint(a, bytes);
+	_output.write_uint(b, bytes);
+	_output.write_uint(c, bytes);
+}
+
+void BinaryMeshWriter::end()
+{
+	_output.flush();
+}
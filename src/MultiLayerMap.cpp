@@ -1,4 +1,49 @@
 #include <MultiLayerMap.hpp>
+#include <ThreadPool.hpp>
+#include <Profiler.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace
+{
+/**
+ * @brief Add the values of tiles to a tile, each pass over it reading up to four tiles.
+ * The values are added in the order of the tiles, so the sums are the same as adding one tile after the other
+ *
+ * @param sum       the tile the values are added to
+ * @param tiles     the tiles to add
+ * @param n         the number of tiles
+ */
+void accumulate_tiles(double* sum, const double* const* tiles, const int n)
+{
+	int l = 0;
+
+	for(; l + 4 <= n; l += 4)
+	{
+		const double* a = tiles[l];
+		const double* b = tiles[l + 1];
+		const double* c = tiles[l + 2];
+		const double* d = tiles[l + 3];
+
+		for(int k = 0; k < TileStorage::tile_cells; ++k)
+		{
+			sum[k] = sum[k] + a[k] + b[k] + c[k] + d[k];
+		}
+	}
+
+	for(; l < n; ++l)
+	{
+		const double* a = tiles[l];
+
+		for(int k = 0; k < TileStorage::tile_cells; ++k)
+		{
+			sum[k] += a[k];
+		}
+	}
+}
+}
 
 double MultiLayerMap::value(const int i, const int j) const
 {
@@ -12,15 +57,93 @@ double MultiLayerMap::value(const int i, const int j) const
 	return result;
 }
 
+void MultiLayerMap::get_row(const int j, double* values) const
+{
+	// the layers are summed in the same order as value()
+	std::fill(values, values + _grid_width, 0.);
+
+	for(int l = 0; l < get_layer_number(); ++l)
+	{
+		_layers[l].storage().add_row(j, values);
+	}
+}
+
+unsigned long MultiLayerMap::version() const
+{
+	unsigned long result = _version;
+
+	for(int l = 0; l < get_layer_number(); ++l)
+	{
+		result = std::max(result, _layers[l].version());
+	}
+
+	return result;
+}
+
+int MultiLayerMap::compact()
+{
+	PROFILE_SCOPE("compact");
+	int released = 0;
+
+	for(SimpleLayerMap& layer : _layers)
+	{
+		released += layer.compact();
+	}
+
+	PROFILE_COUNT("compact.released_tiles", released);
+	return released;
+}
+
 SimpleLayerMap& MultiLayerMap::new_layer()
 {
 	add_field(SimpleLayerMap(_grid_width, _grid_height, _a, _b));
 	return _layers.back();
 }
 
+const MaterialColumns& MultiLayerMap::materials() const
+{
+	if(!_materials)
+	{
+		throw std::logic_error("the materials of the map are not known");
+	}
+
+	return *_materials;
+}
+
+MaterialColumns& MultiLayerMap::mutable_materials()
+{
+	if(!_materials)
+	{
+		throw std::logic_error("the materials of the map are not known");
+	}
+
+	if(_materials.use_count() != 1)
+	{
+		_materials = std::make_shared<MaterialColumns>(*_materials);
+	}
+
+	return *_materials;
+}
+
+void MultiLayerMap::set_materials(MaterialColumns materials)
+{
+	if(materials.width() != _grid_width || materials.height() != _grid_height)
+	{
+		throw std::invalid_argument("the materials are not on the grid of the map");
+	}
+
+	if(materials.stack_number() < _layers.size())
+	{
+		throw std::invalid_argument("the materials need a stack for each layer of the map");
+	}
+
+	_materials = std::make_shared<MaterialColumns>(std::move(materials));
+}
+
 void MultiLayerMap::reshape(const double ax, const double ay, const double bx, const double by)
 {
 	Grid2d::reshape(ax, ay, bx, by);
+	_version = new_version();
 
 	for(int i = 0; i < _layers.size(); ++i)
 	{
@@ -31,6 +154,7 @@ void MultiLayerMap::reshape(const double ax, const double ay, const double bx, c
 void MultiLayerMap::reshape(const Eigen::Vector2d a, const Eigen::Vector2d b)
 {
 	Grid2d::reshape(a, b);
+	_version = new_version();
 
 	for(int i = 0; i < _layers.size(); ++i)
 	{
@@ -42,6 +166,8 @@ MultiLayerMap& MultiLayerMap::operator=(const MultiLayerMap &mlm)
 {
 	Grid2d::operator=(mlm);
 	_layers = mlm._layers;
+	_materials = mlm._materials;
+	_version = new_version();
 	return *this;
 }
 
@@ -51,29 +177,67 @@ MultiLayerMap& MultiLayerMap::operator=(MultiLayerMap &&mlm)
 	{
 		Grid2d::operator=(std::move(mlm));
 		_layers = std::move(mlm._layers);
+		_materials = std::move(mlm._materials);
+		_version = new_version();
 	}
 
 	return *this;
 }
 
-SimpleLayerMap MultiLayerMap::generate_field() const
+MultiLayerMap MultiLayerMap::generate_downsampled(const MultiLayerMap& map)
 {
-	SimpleLayerMap result(*this);
+	MultiLayerMap result(SimpleLayerMap::downsampled_grid(map));
 
-	for(int i = 0; i < _grid_width; ++i)
+	for(int l = 0; l < map.get_layer_number(); ++l)
 	{
-		for(int j = 0; j < _grid_height; ++j)
+		result.add_field(SimpleLayerMap::generate_downsampled(map._layers[l]));
+	}
+
+	return result;
+}
+
+MultiLayerMap MultiLayerMap::generate_resampled(const MultiLayerMap& map, const Grid2d& grid, const bool bicubic)
+{
+	MultiLayerMap result(grid);
+
+	for(int l = 0; l < map.get_layer_number(); ++l)
+	{
+		result.add_field(SimpleLayerMap::generate_resampled(map._layers[l], grid, bicubic));
+	}
+
+	return result;
+}
+
+SimpleLayerMap MultiLayerMap::generate_field() const
+{
+	PROFILE_SCOPE("generate_field");
+	SimpleLayerMap result(static_cast<const Grid2d&>(*this));
+	TileStorage& sums = result.mutable_storage();
+	parallel_for(0, sums.tile_number(), [&](int t_begin, int t_end)
+	{
+		std::vector<const double*> tiles(_layers.size());
+
+		for(int t = t_begin; t < t_end; ++t)
 		{
-			result.set_value(i, j, 0);
+			int n = 0;
 
-			for(int f = 0; f < _layers.size(); ++f)
+			// adding zeros does not change the sums, so the empty tiles are skipped
+			for(int l = 0; l < _layers.size(); ++l)
 			{
-				result.at(i, j) += _layers[f].value(i, j);
+				if(!_layers[l].storage().is_empty(t))
+				{
+					tiles[n++] = _layers[l].storage().tile(t);
+				}
 			}
-		}
-	}
 
-	return std::move(result);
+			// the tiles of the sums start with zeros, as the sums of value(), and stay empty if every layer is
+			if(n > 0)
+			{
+				accumulate_tiles(sums.mutable_tile(t), tiles.data(), n);
+			}
+		}
+	}, 4);
+	return result;
 }
 
 double MultiLayerMap::get_sum(const int i, const int j) const
@@ -83,7 +247,7 @@ double MultiLayerMap::get_sum(const int i, const int j) const
 		return 0;
 	}
 
-	double res;
+	double res = 0;
 	for(int f = 0; f < _layers.size(); ++f)
 	{
 		res += _layers[f].value(i, j);
@@ -104,6 +268,7 @@ std::istream& operator>>(std::istream& is, MultiLayerMap& m)
 	int nb_layers;
 	is >> nb_layers;
 	m._layers.resize(nb_layers, SimpleLayerMap(static_cast<Grid2d>(m)));
+	m._version = m.new_version();
 
 	for(int i = 0; i < nb_layers; ++i)
 	{
@@ -112,6 +277,17 @@ std::istream& operator>>(std::istream& is, MultiLayerMap& m)
 		}
 	}
 
+	// the materials follow the layers in the files of the maps that have them
+	m._materials.reset();
+
+	if((is >> std::ws).peek() == 'm')
+	{
+		std::string tag;
+		MaterialColumns materials(1, 1);
+		is >> tag >> materials;
+		m.set_materials(std::move(materials));
+	}
+
 	return is;
 }
 
@@ -134,32 +310,53 @@ std::ostream& operator<<(std::ostream& os, const MultiLayerMap& m)
 		}
 	}
 
+	if(m._materials)
+	{
+		os << "materials " << *m._materials;
+	}
+
 	return os;
 }
 
 MultiLayerMap normalized(const MultiLayerMap& mlm){
+	PROFILE_SCOPE("normalized");
 	SimpleLayerMap terrain = mlm.generate_field();
 	double whole_max = terrain.get_max();
 	double whole_min = mlm.get_field(0).get_min(); // minimum of everything is the minimum of the bedrock layer
 	double whole_range = whole_max - whole_min;
+	// 0 / 0 and 0 / NaN are NaN, so the empty tiles of the upper layers are only kept for a valid range
+	const bool keep_empty = whole_range != 0 && !std::isnan(whole_range);
 
 	MultiLayerMap output(mlm);
+	std::vector<TileStorage*> layers;
 
-	// translating bedrock layer before normalization
-	for(int w = 0; w < output.grid_width(); ++w){
-		for(int h = 0; h < output.grid_height(); ++h){
-			output.get_field(0).at(w, h) -= whole_min;
-		}
+	for(int ilayer = 0; ilayer < output.get_layer_number(); ++ilayer){
+		layers.push_back(&output.get_field(ilayer).mutable_storage());
 	}
 
-	// scaling all layers with the global range
-	for(int ilayer = 0; ilayer < output.get_layer_number(); ++ilayer){
-		for(int w = 0; w < output.grid_width(); ++w){
-			for(int h = 0; h < output.grid_height(); ++h){
-				output.get_field(ilayer).at(w, h) /= whole_range;
+	// translating the bedrock layer and scaling all layers with the global range, one tile of every layer after the other
+	parallel_for(0, terrain.storage().tile_number(), [&](int t_begin, int t_end)
+	{
+		for(int t = t_begin; t < t_end; ++t){
+			double* bedrock = layers[0]->mutable_tile(t);
+
+			for(int k = 0; k < TileStorage::tile_cells; ++k){
+				bedrock[k] = (bedrock[k] - whole_min) / whole_range;
+			}
+
+			for(int ilayer = 1; ilayer < layers.size(); ++ilayer){
+				if(keep_empty && layers[ilayer]->is_empty(t)){
+					continue;
+				}
+
+				double* tile = layers[ilayer]->mutable_tile(t);
+
+				for(int k = 0; k < TileStorage::tile_cells; ++k){
+					tile[k] /= whole_range;
+				}
 			}
 		}
-	}
+	}, 4);
 
 	return output;
 }
@@ -0,0 +1,810 @@
+#include <Pipeline.hpp>
+
+#include <Noise/TerrainNoise.hpp>
+#include <Weather/Erosion.hpp>
+#include <Weather/Hydro.hpp>
+#include <Weather/Biome.hpp>
+#include <Vegetation/Vegetation.hpp>
+#include <Mesh/LodMesh.hpp>
+#include <ThreadPool.hpp>
+#include <Profiler.hpp>
+#include <Progress.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <sys/stat.h>
+
+namespace
+{
+/**
+ * @brief Get the parameters allowed for each type of section
+ *
+ */
+const std::map<std::string, std::vector<std::string>>& section_keys()
+{
+	static const std::map<std::string, std::vector<std::string>> keys =
+	{
+		{"pipeline", {"name", "output", "seed", "checkpoints", "resume", "threads", "audit", "audit_band_width", "audit_bands"}},
+		{"batch", {"jobs", "estimated_memory", "estimated_job_memory", "summary"}},
+		{"sweep", {}},
+		{"terrain", {"skip", "input", "width", "height", "min_x", "min_y", "max_x", "max_y", "amplitude", "frequency", "octaves", "seed1", "seed2", "noise"}},
+		{"erosion", {"skip", "method", "k", "iterations", "convergence", "rest_angle"}},
+		{"layered_erosion", {"skip", "top_heights", "resistances", "relative", "angle", "fold_amplitude", "fold_wavelength", "fold_direction", "typed", "iterations", "convergence", "rest_angle"}},
+		{"transport", {"skip", "method", "rest_angle", "min_rest_angle", "max_rest_angle", "iterations", "convergence"}},
+		{"droplets", {"skip", "method", "number", "brush", "brush_size", "brush_border", "brush_center", "brush_radius", "brush_sigma", "water_loss", "k", "kd", "seed",
+		              "radius", "inertia", "capacity", "min_slope", "erosion", "deposition", "evaporation", "gravity", "max_steps"}},
+		{"vegetation", {"skip", "iterations", "seed"}},
+		{"export", {"skip", "name", "obj", "ply", "lod", "pgm", "colorized", "mlm"}}
+	};
+	return keys;
+}
+
+/**
+ * @brief Tells if a parameter is allowed in a section, the parameters of a sweep being written section.parameter
+ *
+ */
+bool valid_key(const std::string& type, const std::string& key)
+{
+	if(type == "sweep")
+	{
+		size_t dot = key.find('.');
+		return dot != std::string::npos && key.substr(0, dot) != "sweep" && key.substr(0, dot) != "batch"
+		       && section_keys().count(key.substr(0, dot)) != 0 && valid_key(key.substr(0, dot), key.substr(dot + 1));
+	}
+
+	const std::vector<std::string>& allowed = section_keys().at(type);
+	return std::find(allowed.begin(), allowed.end(), key) != allowed.end();
+}
+
+std::string trim(const std::string& s)
+{
+	const char* spaces = " \t\r\n";
+	size_t begin = s.find_first_not_of(spaces);
+
+	if(begin == std::string::npos)
+	{
+		return "";
+	}
+
+	return s.substr(begin, s.find_last_not_of(spaces) - begin + 1);
+}
+
+std::string checkpoint_name(const std::string& prefix, const int stage)
+{
+	return prefix + "checkpoint_" + std::to_string(stage) + ".mlm";
+}
+
+
+/**
+ * @brief The state shared by the stages of a run
+ *
+ */
+struct RunContext
+{
+	MultiLayerMap& mlm;         /**< the terrain*/
+	const BiomeInfo& biome;     /**< the biome information of the terrain*/
+	std::string prefix;         /**< the prefix of the output files*/
+	int seed;                   /**< the seed of the pipeline*/
+	ErosionStatistics erosion;  /**< the iterations of the current stage, if it iterates an erosion*/
+};
+
+/**
+ * @brief Transport the sediments after an erosion iteration if a rest angle is given
+ *
+ */
+void transport_after(const PipelineStage& stage, TerrainBuffer& buffer)
+{
+	double rest_angle = stage.get_double("rest_angle", 0);
+
+	if(rest_angle > 0)
+	{
+		transport(buffer, rest_angle);
+	}
+}
+
+/**
+ * @brief Iterate an erosion, at most iterations times, stopping early when the mass moved by an iteration falls under
+ * the convergence fraction of the mass moved by the first one.
+ * The terrain is kept in a buffer across the steps of all the iterations
+ *
+ */
+void iterate(const PipelineStage& stage, RunContext& context, const std::function<void(TerrainBuffer&)>& step)
+{
+	ConvergenceCriteria criteria;
+	criteria.max_iterations = stage.get_int("iterations", 1);
+	criteria.relative_mass = stage.get_double("convergence", 0);
+	// the talus is only measured when the iterations can stop early
+	criteria.rest_angle = (criteria.relative_mass > 0) ? stage.get_double("rest_angle", 0) : 0;
+	TerrainBuffer buffer(context.mlm);
+	context.erosion = erode_until_converged(buffer, step, criteria);
+}
+
+bool run_terrain(const PipelineStage& stage, const int, RunContext& context)
+{
+	if(stage.has("input"))
+	{
+		std::ifstream input(stage.get_string("input"), std::ifstream::in);
+
+		if(!input)
+		{
+			throw std::invalid_argument("line " + std::to_string(stage.line()) + ": can't read " + stage.get_string("input"));
+		}
+
+		input >> context.mlm;
+		return true;
+	}
+
+	const int width = stage.get_int("width", 100);
+	const int height = stage.get_int("height", width);
+
+	if(width < 2 || height < 2)
+	{
+		throw std::invalid_argument("line " + std::to_string(stage.line()) + ": the terrain needs at least 2 cells along each axis");
+	}
+
+	Eigen::Vector2d a(stage.get_double("min_x", -5), stage.get_double("min_y", -5));
+	Eigen::Vector2d b(stage.get_double("max_x", 5), stage.get_double("max_y", 5));
+	TerrainNoise t_noise(stage.get_double("amplitude", 2.5), stage.get_double("frequency", 0.01), stage.get_int("octaves", 8),
+	                     stage.get_int("seed1", context.seed), stage.get_int("seed2", context.seed + 4));
+	const int noise = stage.get_int("noise", 1);
+
+	context.mlm = MultiLayerMap(width, height, a, b);
+	SimpleLayerMap& bedrock = context.mlm.new_layer();
+
+	for(int j = 0; j < height; ++j)
+	{
+		report_progress(j / double(height));
+
+		for(int i = 0; i < width; ++i)
+		{
+			bedrock.at(i, j) = noise == 3 ? t_noise.get_noise3(i, j) : (noise == 2 ? t_noise.get_noise2(i, j) : t_noise.get_noise(i, j));
+		}
+	}
+
+	return true;
+}
+
+bool run_erosion(const PipelineStage& stage, const int, RunContext& context)
+{
+	static const std::map<std::string, void (*)(MultiLayerMap&, const double)> methods =
+	{
+		{"constant", erode_constant},
+		{"median_slope", erode_using_median_slope},
+		{"median_double_slope", erode_using_median_double_slope},
+		{"mean_slope", erode_using_mean_slope},
+		{"mean_double_slope", erode_using_mean_double_slope},
+		{"exposure", erode_using_exposure}
+	};
+	const std::string method = stage.get_string("method", "exposure");
+
+	if(methods.count(method) == 0)
+	{
+		throw std::invalid_argument("line " + std::to_string(stage.line()) + ": unknown erosion method " + method);
+	}
+
+	const double k = stage.get_double("k", 0.1);
+
+	iterate(stage, context, [&](TerrainBuffer& buffer)
+	{
+		if(method == "exposure")
+		{
+			erode_using_exposure(buffer, k);
+		}
+		else
+		{
+			methods.at(method)(buffer.layers(), k);
+		}
+
+		transport_after(stage, buffer);
+	});
+
+	return true;
+}
+
+bool run_layered_erosion(const PipelineStage& stage, const int, RunContext& context)
+{
+	std::vector<double> top_heights = stage.get_doubles("top_heights");
+	const std::vector<double> resistances = stage.get_doubles("resistances");
+
+	if(top_heights.empty() || resistances.size() != top_heights.size() + 1)
+	{
+		throw std::invalid_argument("line " + std::to_string(stage.line()) + ": layered_erosion needs one more resistance than top heights");
+	}
+
+	if(!std::is_sorted(top_heights.begin(), top_heights.end()))
+	{
+		throw std::invalid_argument("line " + std::to_string(stage.line()) + ": the top heights of layered_erosion must be increasing");
+	}
+
+	// the heights are given between 0 and 1 and rescaled to the height range of the terrain
+	if(stage.get_bool("relative", true))
+	{
+		FieldStatistics stats = context.mlm.statistics();
+
+		for(double& h : top_heights)
+		{
+			h = stats.min + h * stats.range();
+		}
+	}
+
+	// the same strata as erode_layered_materials_using_exposure with an angle, folded
+	Stratigraphy strata(top_heights, resistances);
+	strata.set_tilt(0., tan(stage.get_double("angle", 0)), context.mlm.world_position(0, context.mlm.grid_height() / 2));
+	strata.set_fold(stage.get_double("fold_amplitude", 0), stage.get_double("fold_wavelength", 1), stage.get_double("fold_direction", 0));
+
+	// the materials are tracked in the columns of the terrain, down to one height range under its lowest point
+	const bool typed = stage.get_bool("typed", false);
+
+	if(typed && !context.mlm.has_materials())
+	{
+		FieldStatistics stats = context.mlm.get_field(0).statistics();
+		MaterialColumns columns(context.mlm.grid_width(), context.mlm.grid_height(), std::max(2, context.mlm.get_layer_number()));
+		strata.fill_stack(columns, 0, context.mlm.get_field(0), stats.min - std::max(stats.range(), 1.));
+		context.mlm.set_materials(std::move(columns));
+	}
+
+	iterate(stage, context, [&](TerrainBuffer& buffer)
+	{
+		if(typed)
+		{
+			erode_materials_using_exposure(buffer, resistances);
+		}
+		else
+		{
+			erode_layered_materials_using_exposure(buffer, strata);
+		}
+
+		transport_after(stage, buffer);
+	});
+
+	return true;
+}
+
+bool run_transport(const PipelineStage& stage, const int, RunContext& context)
+{
+	const std::string method = stage.get_string("method", "8connex");
+
+	if(method != "8connex" && method != "4connex" && method != "varying" && method != "unstable_first")
+	{
+		throw std::invalid_argument("line " + std::to_string(stage.line()) + ": unknown transport method " + method);
+	}
+
+	iterate(stage, context, [&](TerrainBuffer& buffer)
+	{
+		if(method == "8connex")
+		{
+			transport(buffer, stage.get_double("rest_angle", 45));
+		}
+		else if(method == "4connex")
+		{
+			transport_4connex(buffer, stage.get_double("rest_angle", 45));
+		}
+		else if(method == "unstable_first")
+		{
+			transport_unstable_first(buffer, stage.get_double("rest_angle", 45));
+		}
+		else
+		{
+			transport_varying_stability_angle(buffer, stage.get_double("min_rest_angle", 20), stage.get_double("max_rest_angle", 30));
+		}
+	});
+
+	return true;
+}
+
+bool run_droplets(const PipelineStage& stage, const int index, RunContext& context)
+{
+	const std::string method = stage.get_string("method", "cells");
+
+	if(method != "cells" && method != "continuous")
+	{
+		throw std::invalid_argument("line " + std::to_string(stage.line()) + ": unknown droplets method " + method);
+	}
+
+	if(method == "continuous")
+	{
+		DropletParameters parameters;
+		parameters.radius = stage.get_int("radius", parameters.radius);
+		parameters.inertia = stage.get_double("inertia", parameters.inertia);
+		parameters.capacity = stage.get_double("capacity", parameters.capacity);
+		parameters.min_slope = stage.get_double("min_slope", parameters.min_slope);
+		parameters.erosion = stage.get_double("erosion", parameters.erosion);
+		parameters.deposition = stage.get_double("deposition", parameters.deposition);
+		parameters.evaporation = stage.get_double("evaporation", parameters.evaporation);
+		parameters.gravity = stage.get_double("gravity", parameters.gravity);
+		parameters.max_steps = stage.get_int("max_steps", parameters.max_steps);
+
+		if(parameters.radius < 1 || parameters.max_steps < 1)
+		{
+			throw std::invalid_argument("line " + std::to_string(stage.line()) + ": the droplets need a radius and a number of steps of at least 1");
+		}
+
+		std::mt19937 gen(stage.get_int("seed", context.seed + index));
+		erode_from_continuous_droplets(context.mlm, gen, stage.get_int("number", 10000), parameters);
+		return true;
+	}
+
+	const std::string shape = stage.get_string("brush", "square");
+	const int brush_size = stage.get_int("brush_size", 3);
+	const double brush_radius = stage.get_double("brush_radius", 2);
+
+	if(shape != "square" && shape != "disk" && shape != "cone" && shape != "gaussian")
+	{
+		throw std::invalid_argument("line " + std::to_string(stage.line()) + ": unknown brush " + shape);
+	}
+
+	if(brush_size < 1 || brush_radius <= 0)
+	{
+		throw std::invalid_argument("line " + std::to_string(stage.line()) + ": the brush needs at least one cell");
+	}
+
+	// the square brush has a center weight and a border weight, the radial ones sum to 1
+	SimpleLayerMap square(brush_size, brush_size);
+	square.set_all(stage.get_double("brush_border", 0.05));
+	square.at(brush_size / 2, brush_size / 2) = stage.get_double("brush_center", 0.6);
+	const CompiledBrush brush = (shape == "square") ? CompiledBrush(square)
+	                            : (shape == "disk") ? CompiledBrush::disk(brush_radius)
+	                            : (shape == "cone") ? CompiledBrush::cone(brush_radius)
+	                            : CompiledBrush::gaussian(brush_radius, stage.get_double("brush_sigma", brush_radius / 2));
+
+	std::mt19937 gen(stage.get_int("seed", context.seed + index));
+	erode_from_droplets(context.mlm, gen, brush, stage.get_int("number", 100000), stage.get_double("water_loss", 0.01),
+	                    stage.get_double("k", 0.01), stage.get_double("kd", 0.2));
+	return true;
+}
+
+bool run_vegetation(const PipelineStage& stage, const int index, RunContext& context)
+{
+	std::mt19937 gen(stage.get_int("seed", context.seed + index));
+	simulate(context.biome, gen, context.prefix, stage.get_int("iterations", 5000));
+	return false;
+}
+
+bool run_export(const PipelineStage& stage, const int index, RunContext& context)
+{
+	const std::string name = context.prefix + stage.get_string("name", "terrain");
+	const SimpleLayerMap& terrain = context.biome.terrain();
+
+	if(stage.get_bool("obj", true))
+	{
+		terrain.export_as_obj(name + ".obj");
+	}
+
+	if(stage.get_bool("ply", false))
+	{
+		terrain.export_as_ply(name + ".ply");
+	}
+
+	if(stage.get_double("lod", 0) > 0)
+	{
+		PlyWriter writer(name + "_lod.ply");
+		generate_lod_mesh(terrain, stage.get_double("lod", 0)).write(writer);
+	}
+
+	if(stage.get_bool("pgm", true))
+	{
+		terrain.export_as_pgm(name + ".pgm");
+	}
+
+	if(stage.get_bool("colorized", false))
+	{
+		std::mt19937 gen(context.seed + index);
+		save_colorized(context.biome, name + "_texture.ppm", gen);
+	}
+
+	if(stage.get_bool("mlm", false))
+	{
+		std::ofstream output(name + ".mlm", std::ofstream::out);
+		output << context.mlm;
+	}
+
+	return false;
+}
+
+/**
+ * @brief Run a stage
+ *
+ * @return true     if the terrain was modified
+ */
+bool run_stage(const PipelineStage& stage, const int index, RunContext& context)
+{
+	static const std::map<std::string, bool (*)(const PipelineStage&, const int, RunContext&)> runners =
+	{
+		{"terrain", run_terrain},
+		{"erosion", run_erosion},
+		{"layered_erosion", run_layered_erosion},
+		{"transport", run_transport},
+		{"droplets", run_droplets},
+		{"vegetation", run_vegetation},
+		{"export", run_export}
+	};
+	return runners.at(stage.type())(stage, index, context);
+}
+}
+
+std::vector<std::string> PipelineStage::keys() const
+{
+	std::vector<std::string> result;
+
+	for(const auto& p : _parameters)
+	{
+		result.push_back(p.first);
+	}
+
+	return result;
+}
+
+void PipelineStage::error(const std::string& key, const std::string& message) const
+{
+	throw std::invalid_argument("line " + std::to_string(_line) + ": [" + _type + "] " + key + " " + message);
+}
+
+std::string PipelineStage::get_string(const std::string& key, const std::string& default_value) const
+{
+	auto p = _parameters.find(key);
+	return p == _parameters.end() ? default_value : p->second;
+}
+
+double PipelineStage::get_double(const std::string& key, const double default_value) const
+{
+	if(!has(key))
+	{
+		return default_value;
+	}
+
+	std::istringstream input(_parameters.at(key));
+	double v;
+	std::string rest;
+
+	if(!(input >> v) || (input >> rest))
+	{
+		error(key, "is not a number");
+	}
+
+	return v;
+}
+
+int PipelineStage::get_int(const std::string& key, const int default_value) const
+{
+	if(!has(key))
+	{
+		return default_value;
+	}
+
+	std::istringstream input(_parameters.at(key));
+	int v;
+	std::string rest;
+
+	if(!(input >> v) || (input >> rest))
+	{
+		error(key, "is not an integer");
+	}
+
+	return v;
+}
+
+bool PipelineStage::get_bool(const std::string& key, const bool default_value) const
+{
+	if(!has(key))
+	{
+		return default_value;
+	}
+
+	const std::string& v = _parameters.at(key);
+
+	if(v == "true" || v == "yes" || v == "on" || v == "1")
+	{
+		return true;
+	}
+
+	if(v != "false" && v != "no" && v != "off" && v != "0")
+	{
+		error(key, "is not a boolean");
+	}
+
+	return false;
+}
+
+std::vector<double> PipelineStage::get_doubles(const std::string& key) const
+{
+	std::vector<double> result;
+
+	if(!has(key))
+	{
+		return result;
+	}
+
+	std::istringstream input(_parameters.at(key));
+	std::string word;
+
+	while(input >> word)
+	{
+		std::istringstream number(word);
+		double v;
+
+		if(!(number >> v) || !number.eof())
+		{
+			error(key, "is not a list of numbers");
+		}
+
+		result.push_back(v);
+	}
+
+	return result;
+}
+
+Pipeline Pipeline::parse(std::istream& input, const std::string& name)
+{
+	Pipeline pipeline(name);
+	PipelineStage* current = nullptr;
+	std::string line;
+
+	for(int number = 1; std::getline(input, line); ++number)
+	{
+		line = trim(line.substr(0, line.find('#')));
+
+		if(line.empty())
+		{
+			continue;
+		}
+
+		const std::string position = name + ":" + std::to_string(number) + ": ";
+
+		if(line.front() == '[')
+		{
+			if(line.back() != ']')
+			{
+				throw std::invalid_argument(position + "missing ] in the section header");
+			}
+
+			std::string type = trim(line.substr(1, line.size() - 2));
+
+			if(section_keys().count(type) == 0)
+			{
+				throw std::invalid_argument(position + "unknown section [" + type + "]");
+			}
+
+			if(type == "pipeline")
+			{
+				pipeline._settings = PipelineStage(type, number);
+				current = &pipeline._settings;
+			}
+			else if(type == "batch")
+			{
+				pipeline._batch = PipelineStage(type, number);
+				current = &pipeline._batch;
+			}
+			else if(type == "sweep")
+			{
+				pipeline._sweep = PipelineStage(type, number);
+				current = &pipeline._sweep;
+			}
+			else
+			{
+				pipeline._stages.push_back(PipelineStage(type, number));
+				current = &pipeline._stages.back();
+			}
+
+			continue;
+		}
+
+		size_t equal = line.find('=');
+
+		if(equal == std::string::npos || current == nullptr)
+		{
+			throw std::invalid_argument(position + "expected a [section] or a key = value line");
+		}
+
+		std::string key = trim(line.substr(0, equal));
+
+		if(!valid_key(current->type(), key))
+		{
+			throw std::invalid_argument(position + "unknown parameter " + key + " in [" + current->type() + "]");
+		}
+
+		current->set(key, trim(line.substr(equal + 1)));
+	}
+
+	return pipeline;
+}
+
+Pipeline Pipeline::with_parameter(const std::string& name, const std::string& value) const
+{
+	size_t dot = name.find('.');
+	const std::string type = name.substr(0, dot);
+	const std::string key = dot == std::string::npos ? "" : name.substr(dot + 1);
+	Pipeline result(*this);
+	bool found = false;
+
+	if(dot == std::string::npos || type == "sweep" || type == "batch" || section_keys().count(type) == 0 || !valid_key(type, key))
+	{
+		throw std::invalid_argument("unknown parameter " + name);
+	}
+
+	if(type == "pipeline")
+	{
+		result._settings.set(key, value);
+		found = true;
+	}
+
+	for(PipelineStage& stage : result._stages)
+	{
+		if(stage.type() == type)
+		{
+			stage.set(key, value);
+			found = true;
+		}
+	}
+
+	if(!found)
+	{
+		throw std::invalid_argument("no [" + type + "] stage for the parameter " + name);
+	}
+
+	return result;
+}
+
+Pipeline Pipeline::load(const std::string& filename)
+{
+	std::ifstream input(filename, std::ifstream::in);
+
+	if(!input)
+	{
+		throw std::invalid_argument("can't read the pipeline file " + filename);
+	}
+
+	// the default name is the name of the file without its directory and extension
+	std::string name = filename.substr(filename.find_last_of('/') + 1);
+	return parse(input, name.substr(0, name.find_last_of('.')));
+}
+
+std::vector<StageReport> Pipeline::run(std::ostream& log) const
+{
+	MultiLayerMap mlm(2, 2);
+	return run(mlm, log);
+}
+
+void make_parent_directories(const std::string& path)
+{
+	// the existing directories are left as they are, a directory that can't be created making the writes fail later
+	for(size_t slash = path.find('/', 1); slash != std::string::npos; slash = path.find('/', slash + 1))
+	{
+		mkdir(path.substr(0, slash).c_str(), 0755);
+	}
+}
+
+std::vector<StageReport> Pipeline::run(MultiLayerMap& mlm, std::ostream& log) const
+{
+	const std::string prefix = _settings.get_string("output");
+	const bool checkpoints = _settings.get_bool("checkpoints", false);
+	// the parallel loops of the stages use at most the threads given to the pipeline
+	ConcurrencyLimit limit(_settings.get_int("threads", 0));
+	make_parent_directories(prefix);
+
+	// a resumed run starts after the last checkpoint
+	int first = 0;
+
+	if(_settings.get_bool("resume", false))
+	{
+		for(int s = _stages.size() - 1; s >= 0; --s)
+		{
+			std::ifstream input(checkpoint_name(prefix, s), std::ifstream::in);
+
+			if(input)
+			{
+				input >> mlm;
+				first = s + 1;
+				log << name() << ": resumed from " << checkpoint_name(prefix, s) << std::endl;
+				break;
+			}
+		}
+	}
+
+	BiomeInfo biome(mlm);
+	RunContext context = {mlm, biome, prefix, _settings.get_int("seed", 0), ErosionStatistics()};
+	std::vector<StageReport> reports;
+
+	// the terrain is measured once after each stage, that measure being the one before the next stage
+	const bool audit = _settings.get_bool("audit", false);
+	const int band_width = _settings.get_int("audit_band_width", 8);
+	const int bands = _settings.get_int("audit_bands", 1);
+	std::unique_ptr<MassAudit> measure;
+
+	for(int s = 0; s < _stages.size(); ++s)
+	{
+		const PipelineStage& stage = _stages[s];
+		StageReport report = {stage.type(), stage.get_bool("skip", false), s < first, 0, ErosionStatistics(), MassLeak()};
+
+		if(!report.skipped && !report.resumed)
+		{
+			auto start = std::chrono::steady_clock::now();
+			ProfileScope scope("stage." + stage.type());
+			// each stage reports on its share of the progress of the pipeline
+			ProgressScope progress(s / double(_stages.size()), (s + 1) / double(_stages.size()));
+			context.erosion = ErosionStatistics();
+
+			if(audit && !measure)
+			{
+				measure.reset(new MassAudit(mlm, band_width, bands));
+			}
+
+			bool modified = run_stage(stage, s, context);
+
+			if(modified)
+			{
+				// the erosion leaves the sediments empty over large regions, whose tiles are released
+				mlm.compact();
+			}
+
+			report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			report.erosion = context.erosion;
+			log << name() << ": stage " << s << " [" << stage.type() << "] " << report.seconds << " s";
+
+			if(report.erosion.iterations > 0)
+			{
+				log << ", " << report.erosion.iterations << " iteration(s)" << (report.erosion.converged ? " until convergence" : "")
+				    << ", mass moved " << report.erosion.mass_moved;
+			}
+
+			if(audit)
+			{
+				std::unique_ptr<MassAudit> after(new MassAudit(mlm, band_width, bands));
+				report.mass = compare_mass(*measure, *after);
+				measure = std::move(after);
+
+				if(!report.mass.comparable)
+				{
+					log << ", mass not comparable";
+				}
+				else
+				{
+					// only the terrain as a whole leaks, the layers exchanging their mass when the bedrock is eroded into sediments
+					log << ", mass leak " << report.mass.total << " (" << report.mass.relative << ")";
+
+					if(report.mass.bands > 1)
+					{
+						log << ", border leak [";
+
+						for(int b = 0; b + 1 < report.mass.bands; ++b)
+						{
+							log << (b > 0 ? " " : "") << report.mass.band_leak(b);
+						}
+
+						log << "]";
+					}
+
+					log << ", net transfer [";
+
+					for(int f = 0; f < report.mass.leaks.size() / report.mass.bands; ++f)
+					{
+						log << (f > 0 ? " " : "") << report.mass.layer_leak(f);
+					}
+
+					log << "]";
+				}
+			}
+
+			log << std::endl;
+
+			if(checkpoints && modified)
+			{
+				std::ofstream output(checkpoint_name(prefix, s), std::ofstream::out);
+				output << mlm;
+			}
+		}
+		else
+		{
+			log << name() << ": stage " << s << " [" << stage.type() << "] " << (report.skipped ? "skipped" : "resumed") << std::endl;
+		}
+
+		reports.push_back(report);
+	}
+
+	return reports;
+}
@@ -0,0 +1,304 @@
+#include <Profiler.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+std::atomic<bool> Profiler::_enabled(false);
+
+namespace
+{
+const int max_counters = 64;
+
+/**
+ * @brief A recorded scope
+ *
+ */
+struct Event
+{
+	const char* name;       /**< the name of the scope*/
+	long long start;        /**< the start of the scope, in microseconds*/
+	long long duration;     /**< the duration of the scope, in microseconds*/
+};
+
+/**
+ * @brief The records of a thread, only written by that thread
+ *
+ */
+struct ThreadRecords
+{
+	int thread;                                 /**< the number of the thread in the trace*/
+	std::mutex mutex;                           /**< protects the events against a concurrent reset or write*/
+	std::vector<Event> events;                  /**< the recorded scopes*/
+	std::atomic<long> counters[max_counters];   /**< the values of the counters*/
+};
+
+/**
+ * @brief The state shared by all the threads
+ *
+ */
+struct Registry
+{
+	Registry()
+		: epoch(std::chrono::steady_clock::now())
+	{
+	}
+
+	std::mutex mutex;                                       /**< protects the registry*/
+	std::vector<std::unique_ptr<ThreadRecords>> threads;    /**< the records of every thread that recorded something*/
+	std::vector<std::string> counters;                      /**< the names of the counters*/
+	std::set<std::string> names;                            /**< the interned names*/
+	std::chrono::steady_clock::time_point epoch;            /**< the origin of the times*/
+};
+
+Registry& registry()
+{
+	static Registry r;
+	return r;
+}
+
+/**
+ * @brief Get the records of the current thread, created on first use and kept after the thread ends
+ *
+ */
+ThreadRecords& thread_records()
+{
+	thread_local ThreadRecords* records = nullptr;
+
+	if(!records)
+	{
+		Registry& r = registry();
+		std::lock_guard<std::mutex> lock(r.mutex);
+		r.threads.push_back(std::unique_ptr<ThreadRecords>(new ThreadRecords));
+		records = r.threads.back().get();
+		records->thread = r.threads.size();
+
+		for(std::atomic<long>& c : records->counters)
+		{
+			c = 0;
+		}
+	}
+
+	return *records;
+}
+
+std::string json_string(const std::string& s)
+{
+	std::string result = "\"";
+
+	for(char c : s)
+	{
+		if(c == '"' || c == '\\')
+		{
+			result += '\\';
+		}
+
+		result += (c == '\n') ? ' ' : c;
+	}
+
+	return result + "\"";
+}
+}
+
+void Profiler::enable(const bool enabled)
+{
+	registry();
+	_enabled = enabled;
+}
+
+void Profiler::reset()
+{
+	Registry& r = registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+
+	for(std::unique_ptr<ThreadRecords>& t : r.threads)
+	{
+		std::lock_guard<std::mutex> thread_lock(t->mutex);
+		t->events.clear();
+
+		for(std::atomic<long>& c : t->counters)
+		{
+			c = 0;
+		}
+	}
+
+	r.epoch = std::chrono::steady_clock::now();
+}
+
+int Profiler::counter_id(const std::string& name)
+{
+	Registry& r = registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	auto p = std::find(r.counters.begin(), r.counters.end(), name);
+
+	if(p != r.counters.end())
+	{
+		return p - r.counters.begin();
+	}
+
+	if(r.counters.size() >= max_counters)
+	{
+		throw std::length_error("too many profiler counters");
+	}
+
+	r.counters.push_back(name);
+	return r.counters.size() - 1;
+}
+
+void Profiler::add(const int counter, const long n)
+{
+	thread_records().counters[counter].fetch_add(n, std::memory_order_relaxed);
+}
+
+long Profiler::counter(const std::string& name)
+{
+	Registry& r = registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	auto p = std::find(r.counters.begin(), r.counters.end(), name);
+	long total = 0;
+
+	for(std::unique_ptr<ThreadRecords>& t : r.threads)
+	{
+		total += (p == r.counters.end()) ? 0 : t->counters[p - r.counters.begin()].load();
+	}
+
+	return total;
+}
+
+const char* Profiler::intern(const std::string& name)
+{
+	Registry& r = registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	return r.names.insert(name).first->c_str();
+}
+
+long long Profiler::now()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - registry().epoch).count();
+}
+
+void Profiler::record(const char* name, const long long start, const long long duration)
+{
+	ThreadRecords& records = thread_records();
+	std::lock_guard<std::mutex> lock(records.mutex);
+	records.events.push_back({name, start, duration});
+}
+
+void Profiler::write_trace(const std::string& filename)
+{
+	std::ofstream output(filename, std::ofstream::out);
+
+	if(!output)
+	{
+		throw std::invalid_argument("can't write the trace file " + filename);
+	}
+
+	Registry& r = registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	long long end = 0;
+	bool first = true;
+	output << "{\"traceEvents\":[";
+
+	for(std::unique_ptr<ThreadRecords>& t : r.threads)
+	{
+		std::lock_guard<std::mutex> thread_lock(t->mutex);
+		output << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << t->thread
+		       << ",\"args\":{\"name\":\"thread " << t->thread << "\"}}";
+		first = false;
+
+		for(const Event& e : t->events)
+		{
+			output << ",\n{\"name\":" << json_string(e.name) << ",\"cat\":\"terrain\",\"ph\":\"X\",\"pid\":1,\"tid\":" << t->thread
+			       << ",\"ts\":" << e.start << ",\"dur\":" << e.duration << "}";
+			end = std::max(end, e.start + e.duration);
+		}
+	}
+
+	// the counters are shown as their totals at the end of the trace
+	for(int c = 0; c < r.counters.size(); ++c)
+	{
+		long total = 0;
+
+		for(std::unique_ptr<ThreadRecords>& t : r.threads)
+		{
+			total += t->counters[c].load();
+		}
+
+		output << (first ? "\n" : ",\n") << "{\"name\":" << json_string(r.counters[c]) << ",\"ph\":\"C\",\"pid\":1,\"ts\":" << end
+		       << ",\"args\":{\"total\":" << total << "}}";
+		first = false;
+	}
+
+	output << "\n],\"displayTimeUnit\":\"ms\"}" << std::endl;
+}
+
+void Profiler::write_summary(std::ostream& output)
+{
+	/**
+	 * @brief The total of the scopes of a name
+	 *
+	 */
+	struct ScopeTotal
+	{
+		long calls;
+		long long total;
+		long long max;
+	};
+
+	Registry& r = registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	std::map<std::string, ScopeTotal> scopes;
+
+	for(std::unique_ptr<ThreadRecords>& t : r.threads)
+	{
+		std::lock_guard<std::mutex> thread_lock(t->mutex);
+
+		for(const Event& e : t->events)
+		{
+			ScopeTotal& s = scopes.insert(std::make_pair(std::string(e.name), ScopeTotal{0, 0, 0})).first->second;
+			++s.calls;
+			s.total += e.duration;
+			s.max = std::max(s.max, e.duration);
+		}
+	}
+
+	// the most expensive scopes first
+	std::vector<std::pair<std::string, ScopeTotal>> sorted(scopes.begin(), scopes.end());
+	std::sort(sorted.begin(), sorted.end(), [](const std::pair<std::string, ScopeTotal>& a, const std::pair<std::string, ScopeTotal>& b)
+	{
+		return a.second.total > b.second.total;
+	});
+	char line[256];
+	std::snprintf(line, sizeof(line), "%-32s %10s %12s %12s %12s\n", "scope", "calls", "total ms", "mean ms", "max ms");
+	output << line;
+
+	for(const auto& s : sorted)
+	{
+		std::snprintf(line, sizeof(line), "%-32s %10ld %12.3f %12.3f %12.3f\n", s.first.c_str(), s.second.calls,
+		              s.second.total / 1000., s.second.total / 1000. / s.second.calls, s.second.max / 1000.);
+		output << line;
+	}
+
+	std::snprintf(line, sizeof(line), "%-32s %10s\n", "counter", "total");
+	output << line;
+
+	for(int c = 0; c < r.counters.size(); ++c)
+	{
+		long total = 0;
+
+		for(std::unique_ptr<ThreadRecords>& t : r.threads)
+		{
+			total += t->counters[c].load();
+		}
+
+		std::snprintf(line, sizeof(line), "%-32s %10ld\n", r.counters[c].c_str(), total);
+		output << line;
+	}
+}
@@ -0,0 +1,52 @@
+#include <Progress.hpp>
+#include <ThreadPool.hpp>
+
+#include <algorithm>
+
+ProgressScope::ProgressScope(Progress& progress)
+{
+	TaskContext& context = TaskContext::current();
+	_previous = context.progress;
+	_previous_begin = context.progress_begin;
+	_previous_end = context.progress_end;
+	context.progress = &progress;
+	context.progress_begin = 0;
+	context.progress_end = 1;
+}
+
+ProgressScope::ProgressScope(const double begin, const double end)
+{
+	TaskContext& context = TaskContext::current();
+	_previous = context.progress;
+	_previous_begin = context.progress_begin;
+	_previous_end = context.progress_end;
+	const double width = _previous_end - _previous_begin;
+	context.progress_begin = _previous_begin + std::min(std::max(begin, 0.), 1.) * width;
+	context.progress_end = _previous_begin + std::min(std::max(end, 0.), 1.) * width;
+}
+
+ProgressScope::~ProgressScope()
+{
+	TaskContext& context = TaskContext::current();
+	context.progress = _previous;
+	context.progress_begin = _previous_begin;
+	context.progress_end = _previous_end;
+}
+
+void report_progress(const double fraction)
+{
+	const TaskContext& context = TaskContext::current();
+
+	if(!context.progress)
+	{
+		return;
+	}
+
+	if(context.progress->is_cancelled())
+	{
+		throw JobCancelled();
+	}
+
+	const double width = context.progress_end - context.progress_begin;
+	context.progress->set_fraction(context.progress_begin + std::min(std::max(fraction, 0.), 1.) * width);
+}
@@ -1,19 +1,309 @@
 #include <SimpleLayerMap.hpp>
+#include <ThreadPool.hpp>
 #include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+SimpleLayerMap::SimpleLayerMap(const Grid2d &g, std::vector<double>&& values)
+	: DoubleField(g), _values(g.grid_width(), g.grid_height(), values), _version(new_version()), _modified(false)
+{
+}
+
+namespace
+{
+/**
+ * @brief Compute layers derived from the gradient of a field, in parallel over blocks of rows
+ *
+ * @param field     the source field
+ * @param layers    the number of layers
+ * @param derive    called on each block with its size and its gradients, storing the values of each layer in the given arrays
+ * @return std::vector<SimpleLayerMap>  the layers
+ */
+template <typename Derive>
+std::vector<SimpleLayerMap> derive_from_gradients(const DoubleField& field, const int layers, const Derive& derive)
+{
+	const int w = field.grid_width();
+	std::vector<std::vector<double>> values(layers, std::vector<double>(field.cell_number()));
+	parallel_for_rows(field, [&](int row_begin, int row_end)
+	{
+		const int n = (row_end - row_begin) * w;
+		std::vector<double> gx(n);
+		std::vector<double> gy(n);
+		field.get_rows_gradients(row_begin, row_end, gx.data(), gy.data());
+
+		std::vector<double*> out(layers);
+
+		for(int l = 0; l < layers; ++l)
+		{
+			out[l] = values[l].data() + row_begin * w;
+		}
+
+		derive(n, gx.data(), gy.data(), out.data());
+	});
+	std::vector<SimpleLayerMap> maps;
+
+	for(std::vector<double>& v : values)
+	{
+		maps.push_back(SimpleLayerMap(field, std::move(v)));
+	}
+
+	return maps;
+}
+
+void derive_slopes(const int n, const double* gx, const double* gy, double* slope)
+{
+	for(int k = 0; k < n; ++k)
+	{
+		slope[k] = std::sqrt(gx[k] * gx[k] + gy[k] * gy[k]);
+	}
+}
+
+void derive_aspects(const int n, const double* gx, const double* gy, double* aspect)
+{
+	for(int k = 0; k < n; ++k)
+	{
+		// atan2(0, 0) is 0, but -0 would give -pi
+		aspect[k] = std::atan2(0. - gy[k], 0. - gx[k]);
+	}
+}
+}
 
 SimpleLayerMap SimpleLayerMap::generate_slope_map(const DoubleField& field)
 {
-	SimpleLayerMap sf(static_cast<Grid2d>(field));
+	std::vector<SimpleLayerMap> maps = derive_from_gradients(field, 1, [](int n, const double* gx, const double* gy, double** out)
+	{
+		derive_slopes(n, gx, gy, out[0]);
+	});
+	return std::move(maps[0]);
+}
+
+std::vector<SimpleLayerMap> SimpleLayerMap::generate_normal_maps(const DoubleField& field)
+{
+	return derive_from_gradients(field, 3, [](int n, const double* gx, const double* gy, double** out)
+	{
+		DoubleField::normals_from_gradients(n, gx, gy, out[0], out[1], out[2]);
+	});
+}
+
+SimpleLayerMap SimpleLayerMap::generate_aspect_map(const DoubleField& field)
+{
+	std::vector<SimpleLayerMap> maps = derive_from_gradients(field, 1, [](int n, const double* gx, const double* gy, double** out)
+	{
+		derive_aspects(n, gx, gy, out[0]);
+	});
+	return std::move(maps[0]);
+}
 
-	for(int j = 0; j < field.grid_height(); ++j)
+SurfaceMaps SimpleLayerMap::generate_surface_maps(const DoubleField& field)
+{
+	std::vector<SimpleLayerMap> maps = derive_from_gradients(field, 7, [](int n, const double* gx, const double* gy, double** out)
 	{
-		for(int i = 0; i < field.grid_width(); ++i)
+		std::copy(gx, gx + n, out[0]);
+		std::copy(gy, gy + n, out[1]);
+		derive_slopes(n, gx, gy, out[2]);
+		derive_aspects(n, gx, gy, out[3]);
+		DoubleField::normals_from_gradients(n, gx, gy, out[4], out[5], out[6]);
+	});
+	return SurfaceMaps{std::move(maps[0]), std::move(maps[1]), std::move(maps[2]), std::move(maps[3]), std::move(maps[4]), std::move(maps[5]), std::move(maps[6])};
+}
+
+void SimpleLayerMap::get_row(const int j, double* values) const
+{
+	_values.get_row(j, values);
+}
+
+Grid2d SimpleLayerMap::downsampled_grid(const Grid2d& field)
+{
+	const int cw = (field.grid_width() + 1) / 2;
+	const int ch = (field.grid_height() + 1) / 2;
+	const Eigen::Vector2d cell = field.cell_size();
+	// the points are at the center of the blocks
+	const Eigen::Vector2d a = field.min() + cell / 2;
+	const Eigen::Vector2d b = a + Eigen::Vector2d(2 * (cw - 1) * cell[0], 2 * (ch - 1) * cell[1]);
+	return Grid2d(cw, ch, a, b);
+}
+
+SimpleLayerMap SimpleLayerMap::generate_downsampled(const SimpleLayerMap& field)
+{
+	const int w = field.grid_width();
+	const int h = field.grid_height();
+	SimpleLayerMap result(downsampled_grid(field));
+	const int cw = result.grid_width();
+
+	parallel_for_rows(result, [&](int row_begin, int row_end)
+	{
+		for(int j = row_begin; j < row_end; ++j)
 		{
-			sf.at(i, j) = field.slope(i, j);
+			const int j1 = std::min(2 * j + 1, h - 1);
+
+			for(int i = 0; i < cw; ++i)
+			{
+				const int i1 = std::min(2 * i + 1, w - 1);
+				double sum = 0;
+
+				for(int fj = 2 * j; fj <= j1; ++fj)
+				{
+					for(int fi = 2 * i; fi <= i1; ++fi)
+					{
+						sum += field._values.get(fi, fj);
+					}
+				}
+
+				result._values.at(i, j) = sum / downsampled_block_size(field, i, j);
+			}
 		}
+	});
+
+	return result;
+}
+
+namespace
+{
+/**
+ * @brief Catmull-Rom interpolation between v1 and v2
+ *
+ */
+double catmull_rom(const double v0, const double v1, const double v2, const double v3, const double t)
+{
+	return v1 + 0.5 * t * (v2 - v0 + t * (2 * v0 - 5 * v1 + 4 * v2 - v3 + t * (3 * (v1 - v2) + v3 - v0)));
+}
+}
+
+SimpleLayerMap SimpleLayerMap::generate_resampled(const SimpleLayerMap& field, const Grid2d& grid, const bool bicubic)
+{
+	SimpleLayerMap result(grid);
+	const int w = field.grid_width();
+	const int h = field.grid_height();
+	const Eigen::Vector2d cell = field.cell_size();
+
+	// position of a column or a row of the grid in the cells of the field, clamped inside the field
+	auto coordinate = [](const double p, const double a, const double size, const int n, int& c, double& t)
+	{
+		double u = std::min(std::max((p - a) / size, 0.), n - 1.);
+		c = std::min(static_cast<int>(u), std::max(n - 2, 0));
+		t = u - c;
+	};
+
+	parallel_for_rows(result, [&](int row_begin, int row_end)
+	{
+		for(int j = row_begin; j < row_end; ++j)
+		{
+			int cj;
+			double tj;
+			coordinate(grid.position(0, j)[1], field.min()[1], cell[1], h, cj, tj);
+			int rows[4];
+
+			for(int k = 0; k < 4; ++k)
+			{
+				rows[k] = std::min(std::max(cj - 1 + k, 0), h - 1);
+			}
+
+			for(int i = 0; i < grid.grid_width(); ++i)
+			{
+				int ci;
+				double ti;
+				coordinate(grid.position(i, 0)[0], field.min()[0], cell[0], w, ci, ti);
+				double v;
+
+				if(bicubic)
+				{
+					double column[4];
+
+					for(int k = 0; k < 4; ++k)
+					{
+						const int r = rows[k];
+						column[k] = catmull_rom(field._values.get(std::max(ci - 1, 0), r), field._values.get(ci, r),
+						                        field._values.get(std::min(ci + 1, w - 1), r), field._values.get(std::min(ci + 2, w - 1), r), ti);
+					}
+
+					v = catmull_rom(column[0], column[1], column[2], column[3], tj);
+				}
+				else
+				{
+					const int ci1 = std::min(ci + 1, w - 1);
+					const double a0 = field._values.get(ci, rows[1]);
+					const double a1 = field._values.get(ci, rows[2]);
+					double v0 = a0 + ti * (field._values.get(ci1, rows[1]) - a0);
+					double v1 = a1 + ti * (field._values.get(ci1, rows[2]) - a1);
+					v = v0 + tj * (v1 - v0);
+				}
+
+				result._values.at(i, j) = v;
+			}
+		}
+	});
+
+	return result;
+}
+
+unsigned long SimpleLayerMap::version() const
+{
+	// the readers may renew the version together, but not while the field is modified:
+	// the greatest new version is kept, and it is set before the modification is cleared
+	if(_modified.load())
+	{
+		const unsigned long version = new_version();
+		unsigned long current = _version.load();
+
+		while(current < version && !_version.compare_exchange_weak(current, version))
+		{
+		}
+
+		_modified.store(false);
 	}
 
-	return sf;
+	return _version.load();
+}
+
+FieldStatistics SimpleLayerMap::statistics() const
+{
+	// 4 tiles of 4096 cells per chunk
+	return parallel_reduce(0, _values.tile_number(), 4, FieldStatistics(), [this](int begin, int end)
+	{
+		FieldStatistics stats;
+
+		for(int t = begin; t < end; ++t)
+		{
+			int i0, j0, i1, j1;
+			_values.tile_bounds(t, i0, j0, i1, j1);
+
+			for(int j = j0; j < j1; ++j)
+			{
+				stats.add_values(_values.tile(t) + TileStorage::tile_offset(i0, j), i1 - i0);
+			}
+		}
+
+		return stats;
+	}, [](FieldStatistics a, const FieldStatistics& b)
+	{
+		a.merge(b);
+		return a;
+	});
+}
+
+Histogram SimpleLayerMap::histogram(const double min, const double max, const int bins) const
+{
+	return parallel_reduce(0, _values.tile_number(), 4, Histogram(min, max, bins), [&](int begin, int end)
+	{
+		Histogram hist(min, max, bins);
+
+		for(int t = begin; t < end; ++t)
+		{
+			int i0, j0, i1, j1;
+			_values.tile_bounds(t, i0, j0, i1, j1);
+
+			for(int j = j0; j < j1; ++j)
+			{
+				hist.add(_values.tile(t) + TileStorage::tile_offset(i0, j), i1 - i0);
+			}
+		}
+
+		return hist;
+	}, [](Histogram a, const Histogram& b)
+	{
+		a.merge(b);
+		return a;
+	});
 }
 
 void SimpleLayerMap::set_value(const int i, const int j, double value)
@@ -23,7 +313,8 @@ void SimpleLayerMap::set_value(const int i, const int j, double value)
 
 void SimpleLayerMap::set_all(const double value)
 {
-	std::fill(_values.begin(), _values.end(), value);
+	_values.fill(value);
+	mark_modified();
 }
 
 void SimpleLayerMap::import_list(std::vector<std::pair<double, Eigen::Vector2i>> &list)
@@ -37,14 +328,22 @@ void SimpleLayerMap::import_list(std::vector<std::pair<double, Eigen::Vector2i>>
 
 SimpleLayerMap& SimpleLayerMap::normalize()
 {
-	double range = get_range();
-	double min = get_min();
+	FieldStatistics stats = statistics();
+	double range = stats.range();
+	double min = stats.min;
 
-	for(int i = 0; i < _values.size(); i++)
+	for(int t = 0; t < _values.tile_number(); ++t)
 	{
-		_values[i] = (_values[i] - min) / range;
+		double* tile = _values.mutable_tile(t);
+
+		for(int k = 0; k < TileStorage::tile_cells; ++k)
+		{
+			tile[k] = (tile[k] - min) / range;
+		}
 	}
 
+	mark_modified();
+
 	return *this;
 }
 
@@ -53,6 +352,7 @@ void SimpleLayerMap::copy_values(const SimpleLayerMap& sf)
 	if(_grid_height == sf._grid_height && _grid_width == sf._grid_width)
 	{
 		_values = sf._values;
+		mark_modified();
 	}
 	else
 	{
@@ -65,6 +365,7 @@ void SimpleLayerMap::copy_values(SimpleLayerMap&& sf)
 	if(_grid_height == sf._grid_height && _grid_width == sf._grid_width)
 	{
 		_values = std::move(sf._values);
+		mark_modified();
 	}
 	else
 	{
@@ -78,6 +379,7 @@ SimpleLayerMap& SimpleLayerMap::operator=(const SimpleLayerMap& sf)
 	{
 		Grid2d::operator=(sf);
 		this->_values = sf._values;
+		mark_modified();
 	}
 
 	return *this;
@@ -89,6 +391,7 @@ SimpleLayerMap& SimpleLayerMap::operator=(SimpleLayerMap&& sf)
 	{
 		Grid2d::operator=(sf);
 		this->_values = std::move(sf._values);
+		mark_modified();
 	}
 
 	return *this;
@@ -96,14 +399,26 @@ SimpleLayerMap& SimpleLayerMap::operator=(SimpleLayerMap&& sf)
 
 SimpleLayerMap& SimpleLayerMap::operator+=(const SimpleLayerMap& sf)
 {
-	if(this->_values.size() == sf._values.size())
+	if(_grid_width == sf._grid_width && _grid_height == sf._grid_height)
 	{
-		for(int i = 0; i < this->_values.size(); ++i)
+		for(int t = 0; t < _values.tile_number(); ++t)
 		{
-			this->_values[i] += sf._values[i];
+			if(sf._values.is_empty(t))
+			{
+				continue;
+			}
+
+			double* tile = _values.mutable_tile(t);
+			const double* other = sf._values.tile(t);
+
+			for(int k = 0; k < TileStorage::tile_cells; ++k)
+			{
+				tile[k] += other[k];
+			}
 		}
 	}
 
+	mark_modified();
 	return *this;
 }
 
@@ -115,11 +430,17 @@ SimpleLayerMap operator+(SimpleLayerMap lsf, const SimpleLayerMap& rsf)
 
 SimpleLayerMap& SimpleLayerMap::operator+=(const double& d)
 {
-	for(int i = 0; i < this->_values.size(); ++i)
+	for(int t = 0; t < _values.tile_number(); ++t)
 	{
-		this->_values[i] += d;
+		double* tile = _values.mutable_tile(t);
+
+		for(int k = 0; k < TileStorage::tile_cells; ++k)
+		{
+			tile[k] += d;
+		}
 	}
 
+	mark_modified();
 	return *this;
 }
 
@@ -131,14 +452,26 @@ SimpleLayerMap operator+(SimpleLayerMap lsf, const double& rd)
 
 SimpleLayerMap& SimpleLayerMap::operator-=(const SimpleLayerMap& sf)
 {
-	if(this->_values.size() == sf._values.size())
+	if(_grid_width == sf._grid_width && _grid_height == sf._grid_height)
 	{
-		for(int i = 0; i < this->_values.size(); ++i)
+		for(int t = 0; t < _values.tile_number(); ++t)
 		{
-			this->_values[i] -= sf._values[i];
+			if(sf._values.is_empty(t))
+			{
+				continue;
+			}
+
+			double* tile = _values.mutable_tile(t);
+			const double* other = sf._values.tile(t);
+
+			for(int k = 0; k < TileStorage::tile_cells; ++k)
+			{
+				tile[k] -= other[k];
+			}
 		}
 	}
 
+	mark_modified();
 	return *this;
 }
 
@@ -150,11 +483,17 @@ SimpleLayerMap operator-(SimpleLayerMap lsf, const SimpleLayerMap& rsf)
 
 SimpleLayerMap& SimpleLayerMap::operator-=(const double& d)
 {
-	for(int i = 0; i < this->_values.size(); ++i)
+	for(int t = 0; t < _values.tile_number(); ++t)
 	{
-		this->_values[i] -= d;
+		double* tile = _values.mutable_tile(t);
+
+		for(int k = 0; k < TileStorage::tile_cells; ++k)
+		{
+			tile[k] -= d;
+		}
 	}
 
+	mark_modified();
 	return *this;
 }
 
@@ -170,16 +509,64 @@ SimpleLayerMap operator-(const double& ld, SimpleLayerMap rsf)
 	return rsf;
 }
 
+namespace
+{
+/**
+ * @brief Tell if all the values of a tile are finite, the cells past the border of the grid being ignored
+ *
+ */
+bool is_finite_tile(const TileStorage& storage, const int t)
+{
+	const double* tile = storage.tile(t);
+	int i0, j0, i1, j1;
+	storage.tile_bounds(t, i0, j0, i1, j1);
+
+	for(int j = 0; j < j1 - j0; ++j)
+	{
+		const double* row = tile + (j << TileStorage::tile_shift);
+
+		for(int i = 0; i < i1 - i0; ++i)
+		{
+			if(!std::isfinite(row[i]))
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+}
+
 SimpleLayerMap& SimpleLayerMap::operator*=(const SimpleLayerMap& sf)
 {
-	if(this->_values.size() == sf._values.size())
+	if(_grid_width == sf._grid_width && _grid_height == sf._grid_height)
 	{
-		for(int i = 0; i < this->_values.size(); ++i)
+		for(int t = 0; t < _values.tile_number(); ++t)
 		{
-			this->_values[i] *= sf._values[i];
+			// a product with an empty tile stays empty, unless the other tile has NaN or infinite values
+			if(_values.is_empty(t) && is_finite_tile(sf._values, t))
+			{
+				continue;
+			}
+
+			if(sf._values.is_empty(t) && is_finite_tile(_values, t))
+			{
+				_values.clear_tile(t);
+				continue;
+			}
+
+			double* tile = _values.mutable_tile(t);
+			const double* other = sf._values.tile(t);
+
+			for(int k = 0; k < TileStorage::tile_cells; ++k)
+			{
+				tile[k] *= other[k];
+			}
 		}
 	}
 
+	mark_modified();
 	return *this;
 }
 
@@ -191,11 +578,25 @@ SimpleLayerMap operator*(SimpleLayerMap lsf, const SimpleLayerMap& rsf)
 
 SimpleLayerMap& SimpleLayerMap::operator*=(const double& d)
 {
-	for(int i = 0; i < this->_values.size(); ++i)
+	// 0 * NaN and 0 * inf are NaN, so the empty tiles are only kept for a finite factor
+	const bool keep_empty = std::isfinite(d);
+
+	for(int t = 0; t < _values.tile_number(); ++t)
 	{
-		this->_values[i] *= d;
+		if(keep_empty && _values.is_empty(t))
+		{
+			continue;
+		}
+
+		double* tile = _values.mutable_tile(t);
+
+		for(int k = 0; k < TileStorage::tile_cells; ++k)
+		{
+			tile[k] *= d;
+		}
 	}
 
+	mark_modified();
 	return *this;
 }
 
@@ -0,0 +1,203 @@
+#include <Statistics.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+FieldStatistics::FieldStatistics()
+	: count(0)
+	, min(std::numeric_limits<double>::infinity())
+	, max(-std::numeric_limits<double>::infinity())
+	, sum(0)
+	, mean(0)
+	, variance(0)
+{
+}
+
+void FieldStatistics::add_values(const double* values, const int n)
+{
+	if(n <= 0)
+	{
+		return;
+	}
+
+	// independent lanes so that the loop can be vectorized,
+	// values are shifted by the first one to keep the sum of squares accurate
+	const int lanes = 4;
+	const double shift = values[0];
+	double lane_min[lanes];
+	double lane_max[lanes];
+	double lane_sum[lanes];
+	double lane_square[lanes];
+
+	for(int l = 0; l < lanes; ++l)
+	{
+		lane_min[l] = shift;
+		lane_max[l] = shift;
+		lane_sum[l] = 0;
+		lane_square[l] = 0;
+	}
+
+	int i = 0;
+
+	for(; i + lanes <= n; i += lanes)
+	{
+		for(int l = 0; l < lanes; ++l)
+		{
+			double v = values[i + l];
+			double d = v - shift;
+			lane_min[l] = v < lane_min[l] ? v : lane_min[l];
+			lane_max[l] = v > lane_max[l] ? v : lane_max[l];
+			lane_sum[l] += d;
+			lane_square[l] += d * d;
+		}
+	}
+
+	for(; i < n; ++i)
+	{
+		double d = values[i] - shift;
+		lane_min[0] = std::min(lane_min[0], values[i]);
+		lane_max[0] = std::max(lane_max[0], values[i]);
+		lane_sum[0] += d;
+		lane_square[0] += d * d;
+	}
+
+	FieldStatistics block;
+	double shifted_sum = 0;
+	double shifted_square = 0;
+
+	for(int l = 0; l < lanes; ++l)
+	{
+		block.min = std::min(block.min, lane_min[l]);
+		block.max = std::max(block.max, lane_max[l]);
+		shifted_sum += lane_sum[l];
+		shifted_square += lane_square[l];
+	}
+
+	block.count = n;
+	block.sum = shift * n + shifted_sum;
+	block.mean = block.sum / n;
+	block.variance = std::max(0., shifted_square / n - (shifted_sum / n) * (shifted_sum / n));
+
+	merge(block);
+}
+
+void FieldStatistics::merge(const FieldStatistics& s)
+{
+	if(s.count == 0)
+	{
+		return;
+	}
+
+	if(count == 0)
+	{
+		*this = s;
+		return;
+	}
+
+	// pairwise combination of the means and sums of squared deviations
+	double total = static_cast<double>(count) + s.count;
+	double delta = s.mean - mean;
+	double m2 = variance * count + s.variance * s.count + delta * delta * count * s.count / total;
+
+	min = std::min(min, s.min);
+	max = std::max(max, s.max);
+	sum += s.sum;
+	count += s.count;
+	mean += delta * s.count / total;
+	variance = m2 / total;
+}
+
+void CompensatedSum::add_values(const double* values, const int n)
+{
+	// pairs of values are summed exactly with their rounding error, halving the compensated additions
+	int i = 0;
+
+	for(; i + 1 < n; i += 2)
+	{
+		const double t = values[i] + values[i + 1];
+		const double v = t - values[i];
+		_compensation += (values[i] - (t - v)) + (values[i + 1] - v);
+		add(t);
+	}
+
+	if(i < n)
+	{
+		add(values[i]);
+	}
+}
+
+Histogram::Histogram(const double min, const double max, const int bins)
+	: _min(min), _max(max), _count(0), _bins(std::max(bins, 1), 0)
+{
+	_bin_scale = (_max > _min) ? _bins.size() / (_max - _min) : 0;
+}
+
+int Histogram::bin_of(const double value) const
+{
+	// clamped before the conversion, which is undefined outside of the range of int
+	const double b = (value - _min) * _bin_scale;
+	const double last = _bins.size() - 1;
+	return b > 0 ? static_cast<int>(std::min(b, last)) : 0;
+}
+
+void Histogram::add(const double value)
+{
+	if(std::isfinite(value))
+	{
+		++_bins[bin_of(value)];
+		++_count;
+	}
+}
+
+void Histogram::add(const double* values, const int n)
+{
+	for(int i = 0; i < n; ++i)
+	{
+		if(std::isfinite(values[i]))
+		{
+			++_bins[bin_of(values[i])];
+			++_count;
+		}
+	}
+}
+
+void Histogram::merge(const Histogram& h)
+{
+	if(h._bins.size() != _bins.size() || h._min != _min || h._max != _max)
+	{
+		throw std::invalid_argument("Histograms with different bins can't be merged");
+	}
+
+	for(int b = 0; b < _bins.size(); ++b)
+	{
+		_bins[b] += h._bins[b];
+	}
+
+	_count += h._count;
+}
+
+double Histogram::percentile(const double p) const
+{
+	if(_count == 0 || _bin_scale == 0)
+	{
+		return _min;
+	}
+
+	double target = std::min(std::max(p, 0.), 1.) * _count;
+	long cumulated = 0;
+
+	for(int b = 0; b < _bins.size(); ++b)
+	{
+		if(_bins[b] > 0 && cumulated + _bins[b] >= target)
+		{
+			double inside = (target - cumulated) / _bins[b];
+			return _min + (b + inside) / _bin_scale;
+		}
+
+		cumulated += _bins[b];
+	}
+
+	return _max;
+}
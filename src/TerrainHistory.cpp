@@ -0,0 +1,574 @@
+#include <TerrainHistory.hpp>
+#include <Profiler.hpp>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <sys/stat.h>
+
+namespace
+{
+const int plane_bytes = 8 * TileStorage::tile_cells;   /**< the number of bytes of the values of a tile*/
+const int zero_run = 4;                                 /**< the number of zeros ending a run of literal bytes*/
+
+void write_varint(std::vector<unsigned char>& output, unsigned int n)
+{
+	while(n >= 0x80)
+	{
+		output.push_back((n & 0x7f) | 0x80);
+		n >>= 7;
+	}
+
+	output.push_back(n);
+}
+
+unsigned int read_varint(const std::vector<unsigned char>& input, size_t& position)
+{
+	// the bytes are added on 64 bits, the shifts of a corrupted number going past 32 bits
+	std::uint64_t n = 0;
+
+	for(int shift = 0; shift < 35; shift += 7)
+	{
+		if(position >= input.size())
+		{
+			throw std::runtime_error("corrupted history delta");
+		}
+
+		const unsigned char byte = input[position++];
+		n |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+
+		if(!(byte & 0x80))
+		{
+			if(n > 0xffffffffu)
+			{
+				break;
+			}
+
+			return static_cast<unsigned int>(n);
+		}
+	}
+
+	throw std::runtime_error("corrupted history delta");
+}
+
+/**
+ * @brief Get a hash of the values of a tile on the cells of the grid it covers, its padding being skipped
+ *
+ * @param storage       the tiles of the grid
+ * @param t             the index of the tile
+ * @param tile          the values of the tile, null for zeros
+ * @return std::uint64_t    the FNV-1a hash of the bits of the values
+ */
+std::uint64_t tile_hash(const TileStorage& storage, const int t, const double* tile)
+{
+	int i0, j0, i1, j1;
+	storage.tile_bounds(t, i0, j0, i1, j1);
+	std::uint64_t hash = 14695981039346656037ULL;
+
+	for(int j = 0; j < j1 - j0; ++j)
+	{
+		for(int i = 0; i < i1 - i0; ++i)
+		{
+			std::uint64_t x = 0;
+
+			if(tile)
+			{
+				std::memcpy(&x, tile + (j << TileStorage::tile_shift) + i, sizeof(x));
+			}
+
+			hash = (hash ^ x) * 1099511628211ULL;
+		}
+	}
+
+	return hash;
+}
+
+/**
+ * @brief Tells if both terrains are on the same grid, so that their tiles match
+ *
+ */
+bool same_grid(const Grid2d& a, const Grid2d& b)
+{
+	return a.grid_width() == b.grid_width() && a.grid_height() == b.grid_height() && a.min() == b.min() && a.width() == b.width() && a.height() == b.height();
+}
+
+template<typename T>
+void write_value(std::ofstream& output, const T& value)
+{
+	output.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+void read_value(std::ifstream& input, T& value)
+{
+	input.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+}
+
+TerrainHistory::TerrainHistory(const long memory_budget, const std::string& spill_directory)
+	: _budget(memory_budget), _directory(spill_directory), _current(0), _memory(0), _files(0)
+{
+	if(!_directory.empty())
+	{
+		if(_directory.back() != '/')
+		{
+			_directory += '/';
+		}
+
+		mkdir(_directory.c_str(), 0755);
+	}
+}
+
+TerrainHistory::~TerrainHistory()
+{
+	clear();
+}
+
+std::vector<unsigned char> TerrainHistory::encode(const double* a, const double* b)
+{
+	// the bytes of the same rank of all the values are put together: the exponents and the high bits of the mantissas
+	// of close values are equal, so their difference gives long runs of zeros
+	std::vector<unsigned char> planes(plane_bytes);
+
+	for(int k = 0; k < TileStorage::tile_cells; ++k)
+	{
+		std::uint64_t x = 0;
+		std::uint64_t y = 0;
+		std::memcpy(&x, a + k, sizeof(x));
+
+		if(b)
+		{
+			std::memcpy(&y, b + k, sizeof(y));
+		}
+
+		x ^= y;
+
+		for(int p = 0; p < 8; ++p)
+		{
+			planes[p * TileStorage::tile_cells + k] = (x >> (8 * p)) & 0xff;
+		}
+	}
+
+	// runs of zeros followed by runs of literal bytes
+	std::vector<unsigned char> output;
+	bool modified = false;
+	int k = 0;
+
+	while(k < plane_bytes)
+	{
+		int literal = k;
+
+		while(literal < plane_bytes && planes[literal] == 0)
+		{
+			++literal;
+		}
+
+		int end = literal;
+
+		while(end < plane_bytes)
+		{
+			if(planes[end] != 0)
+			{
+				++end;
+				continue;
+			}
+
+			int zeros = end;
+
+			while(zeros < plane_bytes && planes[zeros] == 0 && zeros - end < zero_run)
+			{
+				++zeros;
+			}
+
+			if(zeros - end >= zero_run || zeros == plane_bytes)
+			{
+				break;
+			}
+
+			end = zeros;
+		}
+
+		write_varint(output, literal - k);
+		write_varint(output, end - literal);
+		output.insert(output.end(), planes.begin() + literal, planes.begin() + end);
+		modified = modified || end > literal;
+		k = end;
+	}
+
+	return modified ? output : std::vector<unsigned char>();
+}
+
+void TerrainHistory::decode(const std::vector<unsigned char>& data, double* tile)
+{
+	std::vector<unsigned char> planes(plane_bytes, 0);
+	size_t position = 0;
+	size_t k = 0;
+
+	while(position < data.size())
+	{
+		k += read_varint(data, position);
+		const size_t literals = read_varint(data, position);
+
+		if(k + literals > plane_bytes || position + literals > data.size())
+		{
+			throw std::runtime_error("corrupted history delta");
+		}
+
+		std::memcpy(&planes[k], &data[position], literals);
+		k += literals;
+		position += literals;
+	}
+
+	for(int c = 0; c < TileStorage::tile_cells; ++c)
+	{
+		std::uint64_t x = 0;
+		std::uint64_t y = 0;
+		std::memcpy(&x, tile + c, sizeof(x));
+
+		for(int p = 0; p < 8; ++p)
+		{
+			y |= static_cast<std::uint64_t>(planes[p * TileStorage::tile_cells + c]) << (8 * p);
+		}
+
+		x ^= y;
+		std::memcpy(tile + c, &x, sizeof(x));
+	}
+}
+
+bool TerrainHistory::record(const std::string& name, const MultiLayerMap& before, const MultiLayerMap& after)
+{
+	PROFILE_SCOPE("history.record");
+	const int before_layers = before.get_layer_number();
+	const int after_layers = after.get_layer_number();
+	std::unique_ptr<Entry> entry(new Entry(name, before, after, before_layers, after_layers));
+
+	// the tiles before and after are hashed, to check that the terrain is still in that state when the delta is applied
+	auto add = [&entry](const int layer, const int tile, const char side, std::vector<unsigned char>&& data,
+	                    const TileStorage& storage, const double* b, const double* a)
+	{
+		if(!data.empty())
+		{
+			entry->bytes += data.size();
+			const std::uint64_t before_hash = (side != 2) ? tile_hash(storage, tile, b) : 0;
+			const std::uint64_t after_hash = (side != 1) ? tile_hash(storage, tile, a) : 0;
+			entry->deltas.push_back({layer, tile, side, std::move(data), before_hash, after_hash});
+		}
+	};
+
+	if(same_grid(before, after))
+	{
+		// a layer missing on one side is seen as zeros
+		for(int l = 0; l < std::max(before_layers, after_layers); ++l)
+		{
+			const TileStorage* b = (l < before_layers) ? &before.get_field(l).storage() : nullptr;
+			const TileStorage* a = (l < after_layers) ? &after.get_field(l).storage() : nullptr;
+			const int tiles = (a ? a : b)->tile_number();
+
+			for(int t = 0; t < tiles; ++t)
+			{
+				if(a && b && a->shares_tile(t, *b))
+				{
+					continue;
+				}
+
+				const double* b_tile = b ? b->tile(t) : nullptr;
+				const double* a_tile = a ? a->tile(t) : nullptr;
+				add(l, t, 0, a ? encode(a_tile, b_tile) : encode(b_tile, nullptr), a ? *a : *b, b_tile, a_tile);
+			}
+		}
+
+		if(entry->deltas.empty() && before_layers == after_layers && before.shares_materials(after))
+		{
+			return false;
+		}
+	}
+	else
+	{
+		// the tiles don't match, both terrains are kept
+		for(int l = 0; l < before_layers; ++l)
+		{
+			const TileStorage& b = before.get_field(l).storage();
+
+			for(int t = 0; t < b.tile_number(); ++t)
+			{
+				add(l, t, 1, encode(b.tile(t), nullptr), b, b.tile(t), nullptr);
+			}
+		}
+
+		for(int l = 0; l < after_layers; ++l)
+		{
+			const TileStorage& a = after.get_field(l).storage();
+
+			for(int t = 0; t < a.tile_number(); ++t)
+			{
+				add(l, t, 2, encode(a.tile(t), nullptr), a, nullptr, a.tile(t));
+			}
+		}
+	}
+
+	entry->before_materials.share_materials(before);
+	entry->after_materials.share_materials(after);
+
+	// the operations undone can't be redone anymore
+	while(can_redo())
+	{
+		Entry& last = *_entries.back();
+
+		if(last.file.empty())
+		{
+			_memory -= last.bytes;
+		}
+		else
+		{
+			std::remove(last.file.c_str());
+		}
+
+		_entries.pop_back();
+	}
+
+	_memory += entry->bytes;
+	_entries.push_back(std::move(entry));
+	++_current;
+	PROFILE_COUNT("history.bytes", _entries.back()->bytes);
+	enforce_budget();
+	return true;
+}
+
+void TerrainHistory::undo(MultiLayerMap& mlm)
+{
+	if(!can_undo())
+	{
+		throw std::logic_error("no operation to undo");
+	}
+
+	apply(*_entries[_current - 1], mlm, false);
+	--_current;
+	enforce_budget();
+}
+
+void TerrainHistory::redo(MultiLayerMap& mlm)
+{
+	if(!can_redo())
+	{
+		throw std::logic_error("no operation to redo");
+	}
+
+	apply(*_entries[_current], mlm, true);
+	++_current;
+	enforce_budget();
+}
+
+void TerrainHistory::apply(Entry& entry, MultiLayerMap& mlm, const bool forward)
+{
+	PROFILE_SCOPE("history.apply");
+	const Grid2d& from = forward ? entry.before : entry.after;
+	const Grid2d& to = forward ? entry.after : entry.before;
+	const int from_layers = forward ? entry.before_layers : entry.after_layers;
+	const int to_layers = forward ? entry.after_layers : entry.before_layers;
+
+	if(!same_grid(mlm, from) || mlm.get_layer_number() != from_layers)
+	{
+		throw std::logic_error("the terrain does not match the operation " + entry.name);
+	}
+
+	if(!entry.file.empty())
+	{
+		load(entry);
+	}
+
+	// the layers are shared with the current terrain, only the modified tiles are copied
+	const bool same = same_grid(entry.before, entry.after);
+	MultiLayerMap result(to);
+
+	for(int l = 0; l < to_layers; ++l)
+	{
+		if(same && l < from_layers)
+		{
+			result.add_field(mlm.get_field(l));
+		}
+		else
+		{
+			result.add_field(SimpleLayerMap(to));
+		}
+	}
+
+	const char side = forward ? 2 : 1;
+	const char from_side = forward ? 1 : 2;
+
+	// the tiles of the terrain must be the ones the operation started from, or ended with when undone
+	for(const TileDelta& d : entry.deltas)
+	{
+		if((d.side == 0 || d.side == from_side) && d.layer < from_layers)
+		{
+			const TileStorage& storage = mlm.get_field(d.layer).storage();
+
+			if(tile_hash(storage, d.tile, storage.tile(d.tile)) != (forward ? d.before_hash : d.after_hash))
+			{
+				throw std::logic_error("the terrain was modified outside of the history since the operation " + entry.name);
+			}
+		}
+	}
+
+	for(const TileDelta& d : entry.deltas)
+	{
+		if((d.side == 0 || d.side == side) && d.layer < to_layers)
+		{
+			decode(d.data, result.get_field(d.layer).mutable_storage().mutable_tile(d.tile));
+		}
+	}
+
+	result.share_materials(forward ? entry.after_materials : entry.before_materials);
+	mlm = std::move(result);
+}
+
+void TerrainHistory::clear()
+{
+	for(std::unique_ptr<Entry>& e : _entries)
+	{
+		if(!e->file.empty())
+		{
+			std::remove(e->file.c_str());
+		}
+	}
+
+	_entries.clear();
+	_current = 0;
+	_memory = 0;
+}
+
+int TerrainHistory::spilled() const
+{
+	int n = 0;
+
+	for(const std::unique_ptr<Entry>& e : _entries)
+	{
+		n += !e->file.empty();
+	}
+
+	return n;
+}
+
+void TerrainHistory::enforce_budget()
+{
+	if(_directory.empty())
+	{
+		// an operation only applies to the state left by its neighbors, so only the ends of the history can be dropped,
+		// the one the furthest from the current state first
+		while(_memory > _budget)
+		{
+			const int redo = _entries.size() - _current;
+
+			if(redo > 0 && (redo >= _current || _current <= 1))
+			{
+				_memory -= _entries.back()->bytes;
+				_entries.pop_back();
+			}
+			else if(_current > 1)
+			{
+				_memory -= _entries.front()->bytes;
+				_entries.erase(_entries.begin());
+				--_current;
+			}
+			else
+			{
+				// the last operation is kept even above the budget
+				return;
+			}
+		}
+
+		return;
+	}
+
+	while(_memory > _budget)
+	{
+		// the operations in memory the furthest from the current state are the last to be needed
+		int victim = -1;
+		int distance = 0;
+
+		for(int k = 0; k < _entries.size(); ++k)
+		{
+			const int d = (k < _current) ? _current - k : k - _current + 1;
+
+			if(_entries[k]->file.empty() && _entries[k]->bytes > 0 && d > distance)
+			{
+				victim = k;
+				distance = d;
+			}
+		}
+
+		if(victim < 0)
+		{
+			return;
+		}
+
+		spill(*_entries[victim]);
+	}
+}
+
+void TerrainHistory::spill(Entry& entry)
+{
+	PROFILE_SCOPE("history.spill");
+	const std::string filename = _directory + "history_" + std::to_string(_files++) + ".bin";
+	std::ofstream output(filename, std::ofstream::out | std::ofstream::binary);
+
+	if(!output)
+	{
+		throw std::runtime_error("can't write the history file " + filename);
+	}
+
+	write_value(output, static_cast<std::uint64_t>(entry.deltas.size()));
+
+	for(const TileDelta& d : entry.deltas)
+	{
+		write_value(output, d.layer);
+		write_value(output, d.tile);
+		write_value(output, d.side);
+		write_value(output, d.before_hash);
+		write_value(output, d.after_hash);
+		write_value(output, static_cast<std::uint64_t>(d.data.size()));
+		output.write(reinterpret_cast<const char*>(d.data.data()), d.data.size());
+	}
+
+	if(!output)
+	{
+		throw std::runtime_error("can't write the history file " + filename);
+	}
+
+	entry.file = filename;
+	std::vector<TileDelta>().swap(entry.deltas);
+	_memory -= entry.bytes;
+}
+
+void TerrainHistory::load(Entry& entry)
+{
+	PROFILE_SCOPE("history.load");
+	std::ifstream input(entry.file, std::ifstream::in | std::ifstream::binary);
+	std::uint64_t n = 0;
+	read_value(input, n);
+	std::vector<TileDelta> deltas(n);
+
+	for(TileDelta& d : deltas)
+	{
+		std::uint64_t size = 0;
+		read_value(input, d.layer);
+		read_value(input, d.tile);
+		read_value(input, d.side);
+		read_value(input, d.before_hash);
+		read_value(input, d.after_hash);
+		read_value(input, size);
+		d.data.resize(input ? size : 0);
+		input.read(reinterpret_cast<char*>(d.data.data()), d.data.size());
+	}
+
+	if(!input)
+	{
+		throw std::runtime_error("can't read the history file " + entry.file);
+	}
+
+	std::remove(entry.file.c_str());
+	entry.file.clear();
+	entry.deltas = std::move(deltas);
+	_memory += entry.bytes;
+}
@@ -0,0 +1,257 @@
+#include <TerrainPreview.hpp>
+
+#include <ThreadPool.hpp>
+#include <Profiler.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <stdexcept>
+
+TerrainPreview::TerrainPreview(const int tile_size)
+	: _tile_size(tile_size), _width(0), _height(0), _mode(Mode::height), _version(0), _valid(false), _min(0), _max(1)
+{
+	if(tile_size <= 0)
+	{
+		throw std::invalid_argument("the tiles of the preview need at least 1 pixel");
+	}
+}
+
+std::vector<double> TerrainPreview::field_values(const BiomeInfo& biome, const Mode mode)
+{
+	const SimpleLayerMap& field = (mode == Mode::slope) ? biome.raw_slope() : (mode == Mode::exposure) ? biome.raw_exposure() : biome.terrain();
+	return field.storage().to_vector();
+}
+
+void TerrainPreview::update_values(const SimpleLayerMap& terrain, std::vector<double>& values) const
+{
+	// the rows whose values depend on a changed cell, the slope depending on the neighbors and the exposure on the cells in its radius
+	const int halo = (_mode == Mode::slope) ? 1 : (_mode == Mode::exposure) ? light_exposure_steps : 0;
+	const TileStorage& now = terrain.storage();
+	const TileStorage& before = _terrain->storage();
+	std::vector<char> rows(_height, 0);
+
+	for(int t = 0; t < now.tile_number(); ++t)
+	{
+		if(now.shares_tile(t, before))
+		{
+			continue;
+		}
+
+		int i0, j0, i1, j1;
+		now.tile_bounds(t, i0, j0, i1, j1);
+		bool changed = false;
+
+		for(int j = j0; j < j1 && !changed; ++j)
+		{
+			const int offset = TileStorage::tile_offset(i0, j);
+			changed = !std::equal(now.tile(t) + offset, now.tile(t) + offset + (i1 - i0), before.tile(t) + offset);
+		}
+
+		if(changed)
+		{
+			std::fill(rows.begin() + std::max(j0 - halo, 0), rows.begin() + std::min(j1 + halo, _height), 1);
+		}
+	}
+
+	const int w = _width;
+
+	for(int row_begin = 0; row_begin < _height; ++row_begin)
+	{
+		if(!rows[row_begin])
+		{
+			continue;
+		}
+
+		int row_end = row_begin;
+
+		while(row_end < _height && rows[row_end])
+		{
+			++row_end;
+		}
+
+		PROFILE_COUNT("preview.rows", row_end - row_begin);
+
+		if(_mode == Mode::height)
+		{
+			for(int j = row_begin; j < row_end; ++j)
+			{
+				terrain.get_row(j, &values[j * w]);
+			}
+		}
+		else if(_mode == Mode::slope)
+		{
+			parallel_for(row_begin, row_end, [&](int b, int e)
+			{
+				std::vector<double> gx((e - b) * w);
+				std::vector<double> gy((e - b) * w);
+				terrain.get_rows_gradients(b, e, gx.data(), gy.data());
+
+				for(int k = 0; k < gx.size(); ++k)
+				{
+					values[b * w + k] = std::sqrt(gx[k] * gx[k] + gy[k] * gy[k]);
+				}
+			}, rows_per_task(terrain));
+		}
+		else
+		{
+			parallel_for(row_begin, row_end, [&](int b, int e)
+			{
+				get_light_exposure_rows(terrain, b, e, &values[b * w]);
+			}, std::max(rows_per_task(terrain) / 16, 1));
+		}
+
+		row_begin = row_end;
+	}
+}
+
+void TerrainPreview::color(const double t, unsigned char* rgba) const
+{
+	/**
+	 * @brief A color of a ramp
+	 *
+	 */
+	struct Stop
+	{
+		double t;
+		double r, g, b;
+	};
+	// low valleys in green to high summits in white, steep slopes in white, exposed cells in yellow
+	static const std::vector<Stop> height_ramp = {{0, 40, 90, 40}, {0.35, 110, 150, 70}, {0.65, 140, 110, 70}, {0.85, 170, 160, 150}, {1, 250, 250, 250}};
+	static const std::vector<Stop> slope_ramp = {{0, 0, 0, 0}, {1, 255, 255, 255}};
+	static const std::vector<Stop> exposure_ramp = {{0, 10, 10, 40}, {0.5, 200, 80, 30}, {1, 255, 240, 120}};
+	const std::vector<Stop>& ramp = (_mode == Mode::slope) ? slope_ramp : ((_mode == Mode::exposure) ? exposure_ramp : height_ramp);
+
+	int s = 1;
+
+	while(s < ramp.size() - 1 && ramp[s].t < t)
+	{
+		++s;
+	}
+
+	const Stop& a = ramp[s - 1];
+	const Stop& b = ramp[s];
+	const double u = std::min(std::max((t - a.t) / (b.t - a.t), 0.), 1.);
+	rgba[0] = std::lround(a.r + u * (b.r - a.r));
+	rgba[1] = std::lround(a.g + u * (b.g - a.g));
+	rgba[2] = std::lround(a.b + u * (b.b - a.b));
+	rgba[3] = 255;
+}
+
+int TerrainPreview::update(const BiomeInfo& biome, const Mode mode)
+{
+	const MultiLayerMap& mlm = biome.source();
+	PROFILE_SCOPE("preview");
+	const bool same_image = _valid && mode == _mode && mlm.grid_width() == _width && mlm.grid_height() == _height;
+	_dirty.clear();
+
+	if(mlm.cell_number() <= 0)
+	{
+		// an empty terrain has no image
+		_width = 0;
+		_height = 0;
+		_pixels.clear();
+		_values.clear();
+		reset();
+		return 0;
+	}
+
+	if(same_image && mlm.version() == _version)
+	{
+		return 0;
+	}
+
+	// the terrain is summed once for the whole interface by the biome, the tiles of the last one tell what changed
+	const SimpleLayerMap& terrain = biome.terrain();
+	std::vector<double> values;
+
+	if(same_image)
+	{
+		values = _values;
+		update_values(terrain, values);
+	}
+	else
+	{
+		values = field_values(biome, mode);
+	}
+
+	const auto range = std::minmax_element(values.begin(), values.end());
+	bool full = !same_image;
+
+	if(full)
+	{
+		_mode = mode;
+		_width = mlm.grid_width();
+		_height = mlm.grid_height();
+		_min = *range.first;
+		_max = *range.second;
+		_pixels.assign(_width * _height * 4, 0);
+	}
+	else if(*range.first < _min || *range.second > _max)
+	{
+		// a wider range changes the color of every pixel
+		_min = std::min(_min, *range.first);
+		_max = std::max(_max, *range.second);
+		full = true;
+	}
+
+	const double scale = (_max > _min) ? 1 / (_max - _min) : 0;
+	const int tiles_x = (_width + _tile_size - 1) / _tile_size;
+	const int tiles_y = (_height + _tile_size - 1) / _tile_size;
+	std::vector<char> rendered(tiles_x * tiles_y, 0);
+	parallel_for(0, tiles_x * tiles_y, [&](int t_begin, int t_end)
+	{
+		for(int t = t_begin; t < t_end; ++t)
+		{
+			const int i0 = (t % tiles_x) * _tile_size;
+			const int j0 = (t / tiles_x) * _tile_size;
+			const int i1 = std::min(i0 + _tile_size, _width);
+			const int j1 = std::min(j0 + _tile_size, _height);
+			bool changed = full;
+
+			for(int j = j0; j < j1 && !changed; ++j)
+			{
+				changed = !std::equal(values.begin() + j * _width + i0, values.begin() + j * _width + i1, _values.begin() + j * _width + i0);
+			}
+
+			if(!changed)
+			{
+				continue;
+			}
+
+			for(int j = j0; j < j1; ++j)
+			{
+				for(int i = i0; i < i1; ++i)
+				{
+					color((values[j * _width + i] - _min) * scale, &_pixels[(j * _width + i) * 4]);
+				}
+			}
+
+			rendered[t] = 1;
+		}
+	});
+
+	for(int t = 0; t < rendered.size(); ++t)
+	{
+		if(rendered[t])
+		{
+			const int x = (t % tiles_x) * _tile_size;
+			const int y = (t / tiles_x) * _tile_size;
+			_dirty.push_back({x, y, std::min(_tile_size, _width - x), std::min(_tile_size, _height - y)});
+		}
+	}
+
+	_values = std::move(values);
+	_terrain.reset(new SimpleLayerMap(terrain));
+	_version = mlm.version();
+	_valid = true;
+	PROFILE_COUNT("preview.tiles", _dirty.size());
+	return _dirty.size();
+}
+
+void TerrainPreview::reset()
+{
+	_valid = false;
+	_terrain.reset();
+	_dirty.clear();
+}
@@ -0,0 +1,413 @@
+#include <ThreadPool.hpp>
+
+#include <chrono>
+
+namespace
+{
+thread_local ThreadPool* current_pool = nullptr;    /**< the pool of the current worker thread*/
+thread_local int current_queue = -1;                /**< the queue of the current worker thread*/
+thread_local TaskContext current_context;          /**< the context of the current thread or of its task*/
+
+/**
+ * @brief Gives back the threads taken from a limit when destroyed, after the tasks using them
+ *
+ */
+class LimitRelease
+{
+public:
+	LimitRelease(ConcurrencyLimit* limit, const int threads)
+		: _limit(limit), _threads(threads)
+	{
+	}
+
+	~LimitRelease()
+	{
+		if(_limit)
+		{
+			_limit->release(_threads);
+		}
+	}
+
+private:
+	ConcurrencyLimit* _limit;
+	int _threads;
+};
+}
+
+TaskContext& TaskContext::current()
+{
+	return current_context;
+}
+
+ThreadPool& ThreadPool::instance()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+ThreadPool::ThreadPool(const int threads)
+	: _pending(0), _next_queue(0), _stopping(false)
+{
+	start(threads);
+}
+
+ThreadPool::~ThreadPool()
+{
+	stop();
+}
+
+void ThreadPool::set_thread_number(const int threads)
+{
+	stop();
+	start(threads);
+}
+
+int ThreadPool::concurrency() const
+{
+	const ConcurrencyLimit* limit = current_context.limit;
+	return (limit && limit->threads() > 0) ? std::min(limit->threads(), thread_number()) : thread_number();
+}
+
+void ThreadPool::start(const int threads)
+{
+	const int n = threads > 0 ? threads : std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+	_stopping = false;
+	_queues.clear();
+
+	// there is always a queue, so that the tasks can be run by the waiting thread without workers
+	for(int q = 0; q < std::max(n - 1, 1); ++q)
+	{
+		_queues.push_back(std::unique_ptr<Queue>(new Queue));
+	}
+
+	for(int t = 0; t < n - 1; ++t)
+	{
+		_threads.push_back(std::thread(&ThreadPool::work, this, t));
+	}
+}
+
+void ThreadPool::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopping = true;
+	}
+
+	_wake.notify_all();
+
+	for(std::thread& t : _threads)
+	{
+		t.join();
+	}
+
+	_threads.clear();
+
+	// the tasks left are run by the calling thread
+	while(run_pending_task())
+	{
+	}
+}
+
+void ThreadPool::work(const int index)
+{
+	current_pool = this;
+	current_queue = index;
+	std::function<void()> task;
+
+	while(true)
+	{
+		if(pop(index, task))
+		{
+			task();
+			task = nullptr;
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(_mutex);
+		_wake.wait(lock, [this]()
+		{
+			return _stopping || _pending > 0;
+		});
+
+		if(_stopping && _pending <= 0)
+		{
+			return;
+		}
+	}
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+	// a worker adds its tasks to its own queue, the other threads share the tasks between the queues
+	const int q = (current_pool == this && current_queue >= 0) ? current_queue : _next_queue++ % _queues.size();
+
+	{
+		std::lock_guard<std::mutex> lock(_queues[q]->mutex);
+		_queues[q]->tasks.push_back(std::move(task));
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		++_pending;
+	}
+
+	_wake.notify_one();
+}
+
+bool ThreadPool::pop(const int index, std::function<void()>& task)
+{
+	if(index >= 0)
+	{
+		Queue& own = *_queues[index];
+		std::lock_guard<std::mutex> lock(own.mutex);
+
+		if(!own.tasks.empty())
+		{
+			task = std::move(own.tasks.back());
+			own.tasks.pop_back();
+			--_pending;
+			return true;
+		}
+	}
+
+	for(int k = 1; k <= _queues.size(); ++k)
+	{
+		Queue& other = *_queues[(std::max(index, 0) + k) % _queues.size()];
+		std::lock_guard<std::mutex> lock(other.mutex);
+
+		if(!other.tasks.empty())
+		{
+			task = std::move(other.tasks.front());
+			other.tasks.pop_front();
+			--_pending;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool ThreadPool::run_pending_task()
+{
+	std::function<void()> task;
+
+	if(!pop(current_pool == this ? current_queue : -1, task))
+	{
+		return false;
+	}
+
+	task();
+	return true;
+}
+
+ConcurrencyLimit::ConcurrencyLimit(const int threads)
+	: _previous(current_context.limit), _threads(std::max(threads, 0)), _used(1)
+{
+	if(_previous && _previous->threads() > 0)
+	{
+		_threads = (_threads > 0) ? std::min(_threads, _previous->threads()) : _previous->threads();
+	}
+
+	current_context.limit = this;
+}
+
+ConcurrencyLimit::~ConcurrencyLimit()
+{
+	current_context.limit = _previous;
+}
+
+int ConcurrencyLimit::acquire(const int wanted)
+{
+	if(_threads <= 0)
+	{
+		return wanted;
+	}
+
+	int used = _used;
+	int taken = 0;
+
+	do
+	{
+		taken = std::max(std::min(wanted, _threads - used), 0);
+	}
+	while(taken > 0 && !_used.compare_exchange_weak(used, used + taken));
+
+	return taken;
+}
+
+void ConcurrencyLimit::release(const int threads)
+{
+	if(_threads > 0)
+	{
+		_used -= threads;
+	}
+}
+
+TaskGroup::TaskGroup(ThreadPool& pool)
+	: _pool(pool), _pending(0), _cancelled(false)
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+	try
+	{
+		wait();
+	}
+	catch(...)
+	{
+	}
+}
+
+void TaskGroup::run(std::function<void()> task)
+{
+	++_pending;
+	const TaskContext context = current_context;
+	_pool.submit([this, task, context]()
+	{
+		if(!_cancelled)
+		{
+			// the task runs in the context of the thread that added it
+			const TaskContext previous = current_context;
+			current_context = context;
+
+			try
+			{
+				task();
+			}
+			catch(...)
+			{
+				fail(std::current_exception());
+			}
+
+			current_context = previous;
+		}
+
+		// the lock keeps the group alive until the notification is sent
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		if(--_pending == 0)
+		{
+			_done.notify_all();
+		}
+	});
+}
+
+void TaskGroup::wait()
+{
+	while(_pending > 0)
+	{
+		if(!_pool.run_pending_task())
+		{
+			// the tasks of the group are running elsewhere, new tasks may be added by them meanwhile
+			std::unique_lock<std::mutex> lock(_mutex);
+			_done.wait_for(lock, std::chrono::milliseconds(1), [this]()
+			{
+				return _pending == 0;
+			});
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	if(_error)
+	{
+		std::exception_ptr error = _error;
+		_error = nullptr;
+		std::rethrow_exception(error);
+	}
+}
+
+void TaskGroup::fail(std::exception_ptr error)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	if(!_error)
+	{
+		_error = error;
+	}
+
+	_cancelled = true;
+}
+
+void parallel_for(const int begin, const int end, const std::function<void(int, int)>& body, const int grain)
+{
+	if(end <= begin)
+	{
+		return;
+	}
+
+	const int size = std::max(grain, 1);
+	const int chunks = (end - begin + size - 1) / size;
+	ThreadPool& pool = ThreadPool::instance();
+	// the other threads are taken from the limit of the context, shared with the loops running under it
+	ConcurrencyLimit* limit = current_context.limit;
+	const int wanted = std::min(pool.thread_number(), chunks) - 1;
+	const int others = (limit && wanted > 0) ? limit->acquire(wanted) : wanted;
+	const int runners = others + 1;
+	LimitRelease release(limit, others);
+
+	if(runners <= 1)
+	{
+		for(int c = 0; c < chunks; ++c)
+		{
+			body(begin + c * size, std::min(begin + (c + 1) * size, end));
+		}
+
+		return;
+	}
+
+	// each runner takes the next chunk until there is none left, the group waits for them before next is destroyed
+	std::atomic<int> next(0);
+	TaskGroup group(pool);
+	auto runner = [&]()
+	{
+		for(int c = next++; c < chunks && !group.is_cancelled(); c = next++)
+		{
+			body(begin + c * size, std::min(begin + (c + 1) * size, end));
+		}
+	};
+
+	for(int r = 1; r < runners; ++r)
+	{
+		group.run(runner);
+	}
+
+	try
+	{
+		runner();
+	}
+	catch(...)
+	{
+		group.cancel();
+		throw;
+	}
+
+	group.wait();
+}
+
+int rows_per_task(const Grid2d& grid)
+{
+	return std::max(16384 / std::max(grid.grid_width(), 1), 1);
+}
+
+void parallel_for_rows(const Grid2d& grid, const std::function<void(int, int)>& body, const int rows)
+{
+	parallel_for(0, grid.grid_height(), body, rows > 0 ? rows : rows_per_task(grid));
+}
+
+void parallel_for_tiles(const Grid2d& grid, const int tile_size, const std::function<void(int, int, int, int)>& body)
+{
+	const int size = std::max(tile_size, 1);
+	const int tiles_x = (grid.grid_width() + size - 1) / size;
+	const int tiles_y = (grid.grid_height() + size - 1) / size;
+	parallel_for(0, tiles_x * tiles_y, [&](int t_begin, int t_end)
+	{
+		for(int t = t_begin; t < t_end; ++t)
+		{
+			const int i = (t % tiles_x) * size;
+			const int j = (t / tiles_x) * size;
+			body(i, j, std::min(i + size, grid.grid_width()), std::min(j + size, grid.grid_height()));
+		}
+	});
+}
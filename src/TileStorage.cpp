@@ -0,0 +1,197 @@
+#include <TileStorage.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+
+const int TileStorage::tile_shift;
+const int TileStorage::tile_size;
+const int TileStorage::tile_cells;
+
+TileStorage::TileStorage(const int width, const int height)
+	: _width(width), _height(height), _tiles_x((width + tile_size - 1) >> tile_shift)
+{
+	const int tiles_y = (height + tile_size - 1) >> tile_shift;
+	_tiles.resize(_tiles_x * tiles_y);
+
+	for(std::shared_ptr<Tile>& t : _tiles)
+	{
+		t = empty_tile();
+	}
+}
+
+TileStorage::TileStorage(const int width, const int height, const std::vector<double>& values)
+	: TileStorage(width, height)
+{
+	if(values.size() != static_cast<size_t>(width) * height)
+	{
+		throw std::invalid_argument("Wrong number of values for the TileStorage");
+	}
+
+	for(int t = 0; t < _tiles.size(); ++t)
+	{
+		int i0, j0, i1, j1;
+		tile_bounds(t, i0, j0, i1, j1);
+		bool zero = true;
+
+		for(int j = j0; j < j1 && zero; ++j)
+		{
+			zero = std::all_of(values.begin() + j * width + i0, values.begin() + j * width + i1, [](double v)
+			{
+				return v == 0;
+			});
+		}
+
+		if(zero)
+		{
+			continue;
+		}
+
+		// value initialized, so the unused cells are zeros
+		_tiles[t] = std::make_shared<Tile>();
+		double* tile = _tiles[t]->values;
+
+		for(int j = j0; j < j1; ++j)
+		{
+			std::copy(values.begin() + j * width + i0, values.begin() + j * width + i1, tile + tile_offset(i0, j));
+		}
+	}
+}
+
+void TileStorage::tile_bounds(const int t, int& i0, int& j0, int& i1, int& j1) const
+{
+	i0 = (t % _tiles_x) << tile_shift;
+	j0 = (t / _tiles_x) << tile_shift;
+	i1 = std::min(i0 + tile_size, _width);
+	j1 = std::min(j0 + tile_size, _height);
+}
+
+void TileStorage::get_row(const int j, double* values) const
+{
+	for(int i0 = 0; i0 < _width; i0 += tile_size)
+	{
+		const double* row = tile(tile_index(i0, j)) + tile_offset(i0, j);
+		std::copy(row, row + std::min(tile_size, _width - i0), values + i0);
+	}
+}
+
+void TileStorage::add_row(const int j, double* values) const
+{
+	for(int i0 = 0; i0 < _width; i0 += tile_size)
+	{
+		const int t = tile_index(i0, j);
+
+		if(is_empty(t))
+		{
+			continue;
+		}
+
+		const double* row = tile(t) + tile_offset(i0, j);
+		const int n = std::min(tile_size, _width - i0);
+		double* dest = values + i0;
+
+		for(int i = 0; i < n; ++i)
+		{
+			dest[i] += row[i];
+		}
+	}
+}
+
+int TileStorage::shared_tiles() const
+{
+	const std::shared_ptr<Tile>& empty = empty_tile();
+
+	return std::count_if(_tiles.begin(), _tiles.end(), [&](const std::shared_ptr<Tile>& t)
+	{
+		return t.use_count() != 1 && t != empty;
+	});
+}
+
+int TileStorage::empty_tiles() const
+{
+	return std::count(_tiles.begin(), _tiles.end(), empty_tile());
+}
+
+int TileStorage::compact()
+{
+	int released = 0;
+
+	for(int t = 0; t < _tiles.size(); ++t)
+	{
+		if(!is_empty(t) && is_zero(t))
+		{
+			_tiles[t] = empty_tile();
+			++released;
+		}
+	}
+
+	return released;
+}
+
+bool TileStorage::is_zero(const int t) const
+{
+	int i0, j0, i1, j1;
+	tile_bounds(t, i0, j0, i1, j1);
+
+	for(int j = j0; j < j1; ++j)
+	{
+		const double* row = _tiles[t]->values + tile_offset(i0, j);
+
+		if(!std::all_of(row, row + (i1 - i0), [](double v) { return v == 0; }))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void TileStorage::fill(const double value)
+{
+	if(value == 0)
+	{
+		std::fill(_tiles.begin(), _tiles.end(), empty_tile());
+		return;
+	}
+
+	for(int t = 0; t < _tiles.size(); ++t)
+	{
+		if(_tiles[t].use_count() != 1)
+		{
+			// no need to copy values that are overwritten
+			_tiles[t] = std::make_shared<Tile>();
+		}
+
+		std::fill(_tiles[t]->values, _tiles[t]->values + tile_cells, value);
+	}
+}
+
+std::vector<double> TileStorage::to_vector() const
+{
+	std::vector<double> values(static_cast<size_t>(_width) * _height);
+
+	for(int t = 0; t < _tiles.size(); ++t)
+	{
+		int i0, j0, i1, j1;
+		tile_bounds(t, i0, j0, i1, j1);
+		const double* tile = _tiles[t]->values;
+
+		for(int j = j0; j < j1; ++j)
+		{
+			std::copy(tile + tile_offset(i0, j), tile + tile_offset(i0, j) + (i1 - i0), values.begin() + j * _width + i0);
+		}
+	}
+
+	return values;
+}
+
+void TileStorage::unshare(const int t)
+{
+	_tiles[t] = std::make_shared<Tile>(*_tiles[t]);
+}
+
+const std::shared_ptr<TileStorage::Tile>& TileStorage::empty_tile()
+{
+	// value initialized, so filled with zeros, and never freed so that it outlives every storage
+	static const std::shared_ptr<Tile>* empty = new std::shared_ptr<Tile>(std::make_shared<Tile>());
+	return *empty;
+}
@@ -1,16 +1,20 @@
 #include <Vegetation/Plant/Bush.hpp>
+#include <Profiler.hpp>
 
 SimpleLayerMap bush_density(const BiomeInfo& bi)
 {
-	SimpleLayerMap density(static_cast<Grid2d>(bi.height));
+	const SimpleLayerMap& heights = bi.height();
+	const SimpleLayerMap& slope = bi.slope();
+	const SimpleLayerMap& exposure = bi.exposure();
+	SimpleLayerMap density(static_cast<Grid2d>(heights));
 
 	for(int j = 0; j < density.grid_height(); ++j)
 	{
 		for(int i = 0; i < density.grid_width(); i++)
 		{
-            double height = bi.height.value(i, j);
+            double height = heights.value(i, j);
             double hu = 1.5 * (-5*height*height*height + 5*height*height);
-			double value = std::min(bi.slope.value(i, j) * hu * bi.exposure.value(i, j), 1.0);
+			double value = std::min(slope.value(i, j) * hu * exposure.value(i, j), 1.0);
 			density.set_value(i, j, value);
 		}
 	}
@@ -47,6 +51,7 @@ void Bush::update(std::mt19937& gen, std::uniform_real_distribution<>& rdis, Veg
                 if(target.size() < 5 && chance < _density->value(new_pos))
                 {
                     target.push_back(new Bush(_ID, _max_age, _reproduction_age, _density->value(new_pos), _density));
+                    PROFILE_COUNT("vegetation.births", 1);
                 }
             }
 		}
@@ -1,14 +1,17 @@
 #include <Vegetation/Plant/Grass.hpp>
+#include <Profiler.hpp>
 
 SimpleLayerMap low_grass_density(const BiomeInfo& bi)
 {
-	SimpleLayerMap density(static_cast<Grid2d>(bi.height));
+	const SimpleLayerMap& water_index = bi.water_index();
+	const SimpleLayerMap& height = bi.height();
+	SimpleLayerMap density(static_cast<Grid2d>(height));
 
 	for(int j = 0; j < density.grid_height(); ++j)
 	{
 		for(int i = 0; i < density.grid_width(); i++)
 		{
-			double value = std::min(1.5*sqrt(bi.water_index.value(i, j)) * (1 - bi.height.value(i, j)), 1.0);
+			double value = std::min(1.5*sqrt(water_index.value(i, j)) * (1 - height.value(i, j)), 1.0);
 			density.set_value(i, j, value);
 		}
 	}
@@ -18,13 +21,15 @@ SimpleLayerMap low_grass_density(const BiomeInfo& bi)
 
 SimpleLayerMap strong_grass_density(const BiomeInfo& bi)
 {
-	SimpleLayerMap density(static_cast<Grid2d>(bi.height));
+	const SimpleLayerMap& water_index = bi.water_index();
+	const SimpleLayerMap& sediments = bi.sediments();
+	SimpleLayerMap density(static_cast<Grid2d>(water_index));
 
 	for(int j = 0; j < density.grid_height(); ++j)
 	{
 		for(int i = 0; i < density.grid_width(); i++)
 		{
-			double value = std::min(1.3*std::max(sqrt(bi.water_index.value(i, j)), bi.sediments.value(i, j)*bi.sediments.value(i, j)), 1.0);
+			double value = std::min(1.3*std::max(sqrt(water_index.value(i, j)), sediments.value(i, j)*sediments.value(i, j)), 1.0);
 			density.set_value(i, j, value);
 		}
 	}
@@ -57,6 +62,7 @@ void Grass::update(std::mt19937& gen, std::uniform_real_distribution<>& rdis, Ve
 			if(target.size() < 10 && chance < _density->value(pos[select_nei]))
 			{
 				target.push_back(new Grass(_ID, _max_age, _reproduction_age, _density->value(pos[select_nei]), _density));
+				PROFILE_COUNT("vegetation.births", 1);
 			}
 		}
 	}
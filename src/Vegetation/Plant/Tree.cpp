@@ -1,14 +1,17 @@
 #include <Vegetation/Plant/Tree.hpp>
+#include <Profiler.hpp>
 
 SimpleLayerMap tree_density(const BiomeInfo& bi)
 {
-	SimpleLayerMap density(static_cast<Grid2d>(bi.height));
+	const SimpleLayerMap& exposure = bi.exposure();
+	const SimpleLayerMap& slope = bi.slope();
+	SimpleLayerMap density(static_cast<Grid2d>(exposure));
 
 	for(int j = 0; j < density.grid_height(); ++j)
 	{
 		for(int i = 0; i < density.grid_width(); i++)
 		{
-			double value = std::max(0.0, bi.exposure.value(i, j)*bi.exposure.value(i, j) * (1-bi.slope.value(i, j)) -0.2);
+			double value = std::max(0.0, exposure.value(i, j)*exposure.value(i, j) * (1-slope.value(i, j)) -0.2);
 			density.set_value(i, j, value);
 		}
 	}
@@ -45,6 +48,7 @@ void Tree::update(std::mt19937& gen, std::uniform_real_distribution<>& rdis, Veg
                 if(target.size() < 5 && chance < _density->value(new_pos))
                 {
                     target.push_back(new Tree(_ID, _max_age, _reproduction_age, _density->value(new_pos), _density));
+                    PROFILE_COUNT("vegetation.births", 1);
                     // target.push_back(new Grass(Grass::BASE_ID, 40, 10, 1.0, _density));
                     // target.push_back(new Grass(Grass::BASE_ID, 40, 10, 1.0, _density));
                     // target.push_back(new Grass(Grass::BASE_ID, 40, 10, 1.0, _density));
@@ -1,11 +1,17 @@
 #include <Vegetation/Vegetation.hpp>
+#include <Profiler.hpp>
+#include <Progress.hpp>
 
 #include <iostream>
 
 void generate_distribution(const MultiLayerMap& m)
 {
+	generate_distribution(BiomeInfo(m));
+}
 
-	BiomeInfo bi(m);
+void generate_distribution(const BiomeInfo& bi)
+{
+	const MultiLayerMap& m = bi.source();
 	int maxVal = 255;
 	SimpleLayerMap distrib(static_cast<Grid2d>(m));
 	distrib.set_all(0.0);
@@ -110,21 +116,24 @@ void generate_distribution(const MultiLayerMap& m)
 	output.close();
 }
 
-void save_simulation(VegetationLayerMap& distribution, const MultiLayerMap& mlm, int iter, std::mt19937& gen)
+void save_simulation(VegetationLayerMap& distribution, const BiomeInfo& bi, int iter, std::mt19937& gen,
+                     const std::string& image_prefix, const std::string& data_prefix)
 {
-	std::string filename = "Simu/simulation_" + std::to_string(iter / 10) + ".ppm";
+	const MultiLayerMap& mlm = bi.source();
+	const SimpleLayerMap& terrain = bi.terrain();
+	std::string filename = image_prefix + "simulation_" + std::to_string(iter / 10) + ".ppm";
 	std::uniform_real_distribution<> rdis(0, 0.05);
 	std::uniform_int_distribution<> noise(0,15);
 	std::ofstream output(filename, std::ofstream::out);
-	filename = "Data_Simu_7/simulation_grass_" + std::to_string(iter / 10) + ".data";
+	filename = data_prefix + "simulation_grass_" + std::to_string(iter / 10) + ".data";
 	std::ofstream output_grass(filename, std::ofstream::out);
-	filename = "Data_Simu_7/simulation_lgrass1_" + std::to_string(iter / 10) + ".data";
+	filename = data_prefix + "simulation_lgrass1_" + std::to_string(iter / 10) + ".data";
 	std::ofstream output_lgrass1(filename, std::ofstream::out);
-	filename = "Data_Simu_7/simulation_lgrass2_" + std::to_string(iter / 10) + ".data";
+	filename = data_prefix + "simulation_lgrass2_" + std::to_string(iter / 10) + ".data";
 	std::ofstream output_lgrass2(filename, std::ofstream::out);
-	filename = "Data_Simu_7/simulation_bush_" + std::to_string(iter / 10) + ".data";
+	filename = data_prefix + "simulation_bush_" + std::to_string(iter / 10) + ".data";
 	std::ofstream output_bush(filename, std::ofstream::out);
-	filename = "Data_Simu_7/simulation_tree_" + std::to_string(iter / 10) + ".data";
+	filename = data_prefix + "simulation_tree_" + std::to_string(iter / 10) + ".data";
 	std::ofstream output_tree(filename, std::ofstream::out);
 	output << "P3" << std::endl;
 	output << distribution.grid_width() << " " << distribution.grid_height() << std::endl;
@@ -160,27 +169,27 @@ void save_simulation(VegetationLayerMap& distribution, const MultiLayerMap& mlm,
 				if(nb_h_grass != 0)
 				{
 					Eigen::Vector2d pos = distribution.world_position(i, j);
-					output_grass << pos.x()+rdis(gen) << " " << mlm.value(i, j) << " " << pos.y()+rdis(gen) << std::endl;
+					output_grass << pos.x()+rdis(gen) << " " << terrain.value(i, j) << " " << pos.y()+rdis(gen) << std::endl;
 				}
 				if(nb_bush != 0)
 				{
 					Eigen::Vector2d pos = distribution.world_position(i, j);
-					output_bush << pos.x()+rdis(gen) << " " << mlm.value(i, j) << " " << pos.y()+rdis(gen) << std::endl;
+					output_bush << pos.x()+rdis(gen) << " " << terrain.value(i, j) << " " << pos.y()+rdis(gen) << std::endl;
 				}
 				if(nb_tree != 0)
 				{
 					Eigen::Vector2d pos = distribution.world_position(i, j);
-					output_tree << pos.x()+rdis(gen) << " " << mlm.value(i, j) << " " << pos.y()+rdis(gen) << std::endl;
+					output_tree << pos.x()+rdis(gen) << " " << terrain.value(i, j) << " " << pos.y()+rdis(gen) << std::endl;
 				}
 				if(nb_grass1 != 0)
 				{
 					Eigen::Vector2d pos = distribution.world_position(i, j);
-					output_lgrass1 << pos.x()+rdis(gen) << " " << mlm.value(i, j) << " " << pos.y()+rdis(gen) << std::endl;
+					output_lgrass1 << pos.x()+rdis(gen) << " " << terrain.value(i, j) << " " << pos.y()+rdis(gen) << std::endl;
 				}
 				if(nb_grass2 != 0)
 				{
 					Eigen::Vector2d pos = distribution.world_position(i, j);
-					output_lgrass2 << pos.x()+rdis(gen) << " " << mlm.value(i, j) << " " << pos.y()+rdis(gen) << std::endl;
+					output_lgrass2 << pos.x()+rdis(gen) << " " << terrain.value(i, j) << " " << pos.y()+rdis(gen) << std::endl;
 				}
 			}
 			else
@@ -220,18 +229,33 @@ void save_simulation(VegetationLayerMap& distribution, const MultiLayerMap& mlm,
 
 void simulate(const MultiLayerMap& mlm)
 {
-	BiomeInfo bi(mlm);
+	simulate(BiomeInfo(mlm));
+}
+
+namespace
+{
+void simulate(const BiomeInfo& bi, std::mt19937& gen, const std::string& density_prefix,
+              const std::string& image_prefix, const std::string& data_prefix, const int iterations)
+{
+	PROFILE_SCOPE("vegetation");
+	long deaths = 0;
+	const MultiLayerMap& mlm = bi.source();
 	VegetationLayerMap distribution(static_cast<Grid2d>(mlm));
 	SimpleLayerMap g_density = strong_grass_density(bi);
 	SimpleLayerMap g_density2 = low_grass_density(bi);
 	SimpleLayerMap b_density = bush_density(bi);
 	SimpleLayerMap t_density = tree_density(bi);
-	g_density.export_as_pgm("DensityGrass.pgm");
-	g_density2.export_as_pgm("DensityGrass2.pgm");
-	b_density.export_as_pgm("DensityBush.pgm");
-	t_density.export_as_pgm("DensityTree.pgm", false, 0, 1);
-	std::random_device rd;
-	std::mt19937 gen(rd());
+
+	// the densities are zero where a plant cannot grow
+	for(SimpleLayerMap* density : {&g_density, &g_density2, &b_density, &t_density})
+	{
+		density->compact();
+	}
+
+	g_density.export_as_pgm(density_prefix + "DensityGrass.pgm");
+	g_density2.export_as_pgm(density_prefix + "DensityGrass2.pgm");
+	b_density.export_as_pgm(density_prefix + "DensityBush.pgm");
+	t_density.export_as_pgm(density_prefix + "DensityTree.pgm", false, 0, 1);
 	std::uniform_int_distribution<> dis_width(0, mlm.grid_width() - 1);
 	std::uniform_int_distribution<> dis_height(0, mlm.grid_width() - 1);
 	std::uniform_real_distribution<> rdis(0, 1);
@@ -333,10 +357,12 @@ void simulate(const MultiLayerMap& mlm)
 		while(nope);
 	}
 
-	save_simulation(distribution, mlm, 0, gen);
+	save_simulation(distribution, bi, 0, gen, image_prefix, data_prefix);
 
-	for(int it = 1; it <= 5000; ++it)
+	for(int it = 1; it <= iterations; ++it)
 	{
+		report_progress((it - 1) / double(iterations));
+
 		for(int j = 0; j < distribution.grid_height(); ++j)
 		{
 			for(int i = 0; i < distribution.grid_width(); i++)
@@ -352,6 +378,7 @@ void simulate(const MultiLayerMap& mlm)
 					{
 						delete *p;
 						p = cell.erase(p);
+						++deaths;
 					}
 					else
 					{
@@ -363,7 +390,22 @@ void simulate(const MultiLayerMap& mlm)
 
 		if(it % 10 == 0)
 		{
-			save_simulation(distribution, mlm, it, gen);
+			save_simulation(distribution, bi, it, gen, image_prefix, data_prefix);
 		}
 	}
+
+	PROFILE_COUNT("vegetation.deaths", deaths);
+}
+}
+
+void simulate(const BiomeInfo& bi)
+{
+	std::random_device rd;
+	std::mt19937 gen(rd());
+	simulate(bi, gen, "", "Simu/", "Data_Simu_7/", 5000);
+}
+
+void simulate(const BiomeInfo& bi, std::mt19937& gen, const std::string& prefix, const int iterations)
+{
+	simulate(bi, gen, prefix, prefix, prefix, iterations);
 }
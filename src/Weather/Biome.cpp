@@ -1,23 +1,141 @@
 #include <Weather/Biome.hpp>
+#include <ThreadPool.hpp>
+#include <Profiler.hpp>
 
-BiomeInfo::BiomeInfo(const MultiLayerMap& m)
-	: slope(SimpleLayerMap::generate_slope_map(m).normalize())
-	, exposure(get_light_exposure(m).normalize())
-	, water_index(get_water_indexes(m).normalize())
-	, height(m.generate_field().normalize())
-	, sediments(m.get_field(1)) 
+namespace
+{
+	std::vector<SimpleLayerMap> single(SimpleLayerMap&& map)
 	{
-		sediments.normalize();
+		std::vector<SimpleLayerMap> maps;
+		maps.push_back(std::move(map));
+		return maps;
 	}
 
-SimpleLayerMap get_light_exposure(const DoubleField& df, const int nb_steps, const int nb_samples)
+	std::vector<SimpleLayerMap> normalized_copy(const SimpleLayerMap& map)
+	{
+		SimpleLayerMap copy(map);
+		copy.normalize();
+		return single(std::move(copy));
+	}
+}
+
+BiomeInfo::BiomeInfo(const MultiLayerMap& m)
+	: _source(m)
+{
+}
+
+const SimpleLayerMap& BiomeInfo::terrain() const
+{
+	return cached(_terrain, _source.version(), [this]()
+	{
+		return single(_source.generate_field());
+	}).front();
+}
+
+const std::vector<SimpleLayerMap>& BiomeInfo::surface() const
+{
+	return cached(_surface, _source.version(), [this]()
+	{
+		SurfaceMaps surface = SimpleLayerMap::generate_surface_maps(terrain());
+		std::vector<SimpleLayerMap> maps;
+		maps.push_back(std::move(surface.slope));
+		maps.push_back(std::move(surface.normal_x));
+		maps.push_back(std::move(surface.normal_y));
+		maps.push_back(std::move(surface.normal_z));
+		return maps;
+	});
+}
+
+const SimpleLayerMap& BiomeInfo::raw_slope() const
 {
-	SimpleLayerMap res(static_cast<Grid2d>(df));
+	// the copies share the tiles of the surface maps
+	return cached(_raw_slope, _source.version(), [this]()
+	{
+		return single(SimpleLayerMap(surface()[0]));
+	}).front();
+}
+
+const SimpleLayerMap& BiomeInfo::area() const
+{
+	return cached(_area, _source.version(), [this]()
+	{
+		return single(get_area(terrain()));
+	}).front();
+}
+
+const SimpleLayerMap& BiomeInfo::raw_water_index() const
+{
+	return cached(_raw_water_index, _source.version(), [this]()
+	{
+		return single(get_water_indexes(area(), raw_slope()));
+	}).front();
+}
+
+const SimpleLayerMap& BiomeInfo::raw_exposure() const
+{
+	return cached(_raw_exposure, _source.version(), [this]()
+	{
+		return single(get_light_exposure(terrain()));
+	}).front();
+}
+
+const std::vector<SimpleLayerMap>& BiomeInfo::normals() const
+{
+	return cached(_normals, _source.version(), [this]()
+	{
+		return std::vector<SimpleLayerMap>(surface().begin() + 1, surface().end());
+	});
+}
+
+const SimpleLayerMap& BiomeInfo::slope() const
+{
+	return cached(_slope, _source.version(), [this]()
+	{
+		return normalized_copy(raw_slope());
+	}).front();
+}
+
+const SimpleLayerMap& BiomeInfo::exposure() const
+{
+	return cached(_exposure, _source.version(), [this]()
+	{
+		return normalized_copy(raw_exposure());
+	}).front();
+}
+
+const SimpleLayerMap& BiomeInfo::water_index() const
+{
+	return cached(_water_index, _source.version(), [this]()
+	{
+		return normalized_copy(raw_water_index());
+	}).front();
+}
+
+const SimpleLayerMap& BiomeInfo::height() const
+{
+	return cached(_height, _source.version(), [this]()
+	{
+		return normalized_copy(terrain());
+	}).front();
+}
+
+const SimpleLayerMap& BiomeInfo::sediments() const
+{
+	return cached(_sediments, _source.get_field(1).version(), [this]()
+	{
+		return normalized_copy(_source.get_field(1));
+	}).front();
+}
+
+void get_light_exposure_rows(const DoubleField& df, const int row_begin, const int row_end, double* values,
+                             const int nb_steps, const int nb_samples)
+{
+	const int w = df.grid_width();
 	double total = nb_samples * 3.1415 / 2.0;
 
-	for(int j = 0; j < res.grid_height(); ++j)
+	for(int j = row_begin; j < row_end; ++j)
 	{
-		for(int i = 0; i < res.grid_width(); ++i)
+		for(int i = 0; i < w; ++i)
 		{
 			double val = df.value_safe(i, j);
 			double sum_exp = 0;
@@ -47,28 +165,53 @@ SimpleLayerMap get_light_exposure(const DoubleField& df, const int nb_steps, con
 				sum_exp += (3.1415 / 2.0) - covA;
 			}
 
-			res.at(i, j) = sum_exp / total;
+			values[(j - row_begin) * w + i] = sum_exp / total;
 		}
 	}
+}
 
-	return res;
+SimpleLayerMap get_light_exposure(const DoubleField& df, const int nb_steps, const int nb_samples)
+{
+	PROFILE_SCOPE("light_exposure");
+	const int w = df.grid_width();
+	std::vector<double> values(df.cell_number());
+
+	// each cell reads nb_steps * nb_samples values, smaller blocks of rows keep the threads balanced
+	parallel_for_rows(df, [&](int row_begin, int row_end)
+	{
+		get_light_exposure_rows(df, row_begin, row_end, &values[row_begin * w], nb_steps, nb_samples);
+	}, std::max(rows_per_task(df) / 16, 1));
+	PROFILE_COUNT("exposure.cells", df.cell_number());
+
+	return SimpleLayerMap(df, std::move(values));
 }
 
 void save_colorized(const MultiLayerMap& mlm)
 {
+	save_colorized(BiomeInfo(mlm));
+}
+
+void save_colorized(const BiomeInfo& bi)
+{
+	std::random_device rd;
+	std::mt19937 gen(rd());
+	save_colorized(bi, "Terrain_texture.ppm", gen);
+}
+
+void save_colorized(const BiomeInfo& bi, const std::string& filename, std::mt19937& gen)
+{
+	PROFILE_SCOPE("export.colorized");
 	double snow_height = 15;
 	double sediment_height = 0.01;
 
-	SimpleLayerMap water_index = get_water_indexes(mlm).normalize();
-	SimpleLayerMap snow_proba = mlm.generate_field().normalize();
-	SimpleLayerMap slope = SimpleLayerMap::generate_slope_map(mlm).normalize();
+	const MultiLayerMap& mlm = bi.source();
+	const SimpleLayerMap& water_index = bi.water_index();
+	const SimpleLayerMap& snow_proba = bi.height();
+	const SimpleLayerMap& slope = bi.slope();
 
-	std::random_device rd;
-	std::mt19937 gen(rd());
 	std::uniform_int_distribution<> noise(0,15);
 	std::uniform_real_distribution<> snow(0,1);
 
-	std::string filename = "Terrain_texture.ppm";
 	std::ofstream output(filename, std::ofstream::out);
 	output << "P3" << std::endl;
 	output << mlm.grid_width() << " " << mlm.grid_height() << std::endl;
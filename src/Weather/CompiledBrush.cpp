@@ -0,0 +1,156 @@
+#include <Weather/CompiledBrush.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+CompiledBrush::CompiledBrush(const DoubleField& brush)
+	: _extent(0)
+{
+	const int ci = brush.grid_width() >> 1;
+	const int cj = brush.grid_height() >> 1;
+
+	for(int j = 0; j < brush.grid_height(); ++j)
+	{
+		for(int i = 0; i < brush.grid_width(); ++i)
+		{
+			const double w = brush.value(i, j);
+
+			if(w != 0)
+			{
+				add_tap(i - ci, j - cj, w);
+			}
+		}
+	}
+}
+
+void CompiledBrush::add_tap(const int di, const int dj, const double weight)
+{
+	_di.push_back(di);
+	_dj.push_back(dj);
+	_offsets.push_back(dj * TileStorage::tile_size + di);
+	_weights.push_back(weight);
+	_extent = std::max(_extent, std::max(std::abs(di), std::abs(dj)));
+}
+
+template <typename Weight>
+CompiledBrush CompiledBrush::radial(const double radius, const Weight& weight)
+{
+	if(radius <= 0)
+	{
+		throw std::invalid_argument("a radial brush needs a positive radius");
+	}
+
+	CompiledBrush brush;
+	const int r = std::ceil(radius);
+	double sum = 0;
+
+	for(int dj = -r; dj <= r; ++dj)
+	{
+		for(int di = -r; di <= r; ++di)
+		{
+			const double d = std::sqrt(double(di * di + dj * dj));
+			const double w = (d < radius) ? weight(d) : 0.;
+
+			if(w > 0)
+			{
+				brush.add_tap(di, dj, w);
+				sum += w;
+			}
+		}
+	}
+
+	for(double& w : brush._weights)
+	{
+		w /= sum;
+	}
+
+	return brush;
+}
+
+CompiledBrush CompiledBrush::disk(const double radius)
+{
+	return radial(radius, [](const double)
+	{
+		return 1.;
+	});
+}
+
+CompiledBrush CompiledBrush::cone(const double radius)
+{
+	return radial(radius, [radius](const double d)
+	{
+		return radius - d;
+	});
+}
+
+CompiledBrush CompiledBrush::gaussian(const double radius, const double sigma)
+{
+	if(sigma <= 0)
+	{
+		throw std::invalid_argument("a gaussian brush needs a positive sigma");
+	}
+
+	return radial(radius, [sigma](const double d)
+	{
+		return std::exp(- d * d / (2 * sigma * sigma));
+	});
+}
+
+double CompiledBrush::add(TileStorage& values, const int x, const int y, const double amount, TileStorage* other) const
+{
+	const int n = _weights.size();
+	const int* offsets = _offsets.data();
+	const double* weights = _weights.data();
+	const int shift = TileStorage::tile_shift;
+
+	// the whole brush is in the tile of its center, the taps are applied with their offsets in the tile
+	if(!crosses_border(x, y, values.width(), values.height())
+	   && ((x - _extent) >> shift) == ((x + _extent) >> shift) && ((y - _extent) >> shift) == ((y + _extent) >> shift))
+	{
+		const int t = values.tile_index(x, y);
+		const int center = TileStorage::tile_offset(x, y);
+		double* tile = values.mutable_tile(t);
+
+		for(int k = 0; k < n; ++k)
+		{
+			tile[center + offsets[k]] += amount * weights[k];
+		}
+
+		if(other)
+		{
+			tile = other->mutable_tile(t);
+
+			for(int k = 0; k < n; ++k)
+			{
+				tile[center + offsets[k]] += amount * weights[k];
+			}
+		}
+
+		return 0.;
+	}
+
+	double outside = 0.;
+
+	for(int k = 0; k < n; ++k)
+	{
+		const int i = x + _di[k];
+		const int j = y + _dj[k];
+
+		if(i < 0 || j < 0 || i >= values.width() || j >= values.height())
+		{
+			outside += amount * weights[k];
+		}
+		else
+		{
+			values.at(i, j) += amount * weights[k];
+
+			if(other)
+			{
+				other->at(i, j) += amount * weights[k];
+			}
+		}
+	}
+
+	return outside;
+}
@@ -3,13 +3,17 @@
 #include <cmath>
 #include <cassert>
 
+#include <memory>
 #include <queue>
-#include <iostream>
 
 #include <Weather/Erosion.hpp>
 #include <Weather/Biome.hpp>
+#include <FieldPyramid.hpp>
 #include <BooleanField.hpp>
+#include <BucketQueue.hpp>
 #include <Utils.hpp>
+#include <Profiler.hpp>
+#include <Progress.hpp>
 
 void erode_constant(MultiLayerMap& layers, const double k){
 	assert(layers.get_layer_number() > 0);
@@ -189,6 +193,12 @@ void erode_using_mean_double_slope(MultiLayerMap& layers, const double k){
 }
 
 void erode_using_exposure(MultiLayerMap& layers, const double k){
+	TerrainBuffer buffer(layers);
+	erode_using_exposure(buffer, k);
+}
+
+void erode_using_exposure(TerrainBuffer& buffer, const double k){
+	MultiLayerMap& layers = buffer.layers();
 	assert(layers.get_layer_number() > 0);
 
 	// creating the sediment layer if necessary
@@ -196,7 +206,7 @@ void erode_using_exposure(MultiLayerMap& layers, const double k){
 		layers.new_layer();
 	}
 
-	SimpleLayerMap terrain_exposure = get_light_exposure(layers);
+	SimpleLayerMap terrain_exposure = get_light_exposure(buffer.terrain());
 	terrain_exposure.normalize();
 
 	// apply erosion on layers
@@ -206,6 +216,9 @@ void erode_using_exposure(MultiLayerMap& layers, const double k){
 			layers.get_field(1).at(w, h) += k * terrain_exposure.at(w, h);
 		}
 	}
+
+	// the bedrock eroded becomes sediments, the terrain is unchanged
+	buffer.mark_synced();
 }
 
 void erode_layered_materials_using_exposure(MultiLayerMap& layers,
@@ -213,50 +226,149 @@ void erode_layered_materials_using_exposure(MultiLayerMap& layers,
 					const std::vector<double>& layers_erosion_values,
 					const double layers_angle){
 
-	assert(layers.get_layer_number() > 0);
 	assert(layers_top_heights.size() > 0 && (layers_top_heights.size() + 1) == layers_erosion_values.size());
 
+	// the layers are tilted along the height around the middle row, the angle being given to tan as is
+	// so that the existing pipelines keep their results
+	Stratigraphy strata(layers_top_heights, layers_erosion_values);
+	strata.set_tilt(0., tan(layers_angle), layers.world_position(0, layers.grid_height() / 2));
+
+	erode_layered_materials_using_exposure(layers, strata);
+}
+
+void erode_layered_materials_using_exposure(MultiLayerMap& layers, const Stratigraphy& strata){
+	TerrainBuffer buffer(layers);
+	erode_layered_materials_using_exposure(buffer, strata);
+}
+
+void erode_layered_materials_using_exposure(TerrainBuffer& buffer, const Stratigraphy& strata){
+	MultiLayerMap& layers = buffer.layers();
+	assert(layers.get_layer_number() > 0);
+
 	// creating the sediment layer if necessary
 	if(layers.get_layer_number() == 1){
 		layers.new_layer();
 	}
 
-	SimpleLayerMap terrain_exposure = get_light_exposure(layers);
+	const SimpleLayerMap& terrain = buffer.terrain();
+	SimpleLayerMap terrain_exposure = get_light_exposure(terrain);
 	terrain_exposure.normalize();
 
-	SimpleLayerMap terrain = layers.generate_field();
-
-	const double layers_randian = M_PI * layers_angle / 180.;
+	std::vector<int> materials(layers.grid_width());
 
 	// apply erosion on layers
 	for(int h = 0; h < layers.grid_height(); ++h){
+		strata.materials_row(terrain, h, materials.data());
+
+		for(int w = 0; w < layers.grid_width(); ++w){
+			double material_erosion_value = strata.erodibility(materials[w]);
 
-		// computing angular displacement for the current h value
-		std::vector<double> layers_angled_heights(layers_top_heights.size());
-		for(int ilayer = 0; ilayer != layers_top_heights.size(); ++ilayer){
-			layers_angled_heights[ilayer] = layers_top_heights[ilayer] + tan(layers_angle) * (h - layers.grid_height() / 2) * layers.cell_size().y();
+			layers.get_field(0).at(w, h) -= material_erosion_value * terrain_exposure.at(w, h);
+			layers.get_field(1).at(w, h) += material_erosion_value * terrain_exposure.at(w, h);
 		}
+	}
 
+	buffer.mark_synced();
+}
+
+void erode_materials_using_exposure(MultiLayerMap& layers, const std::vector<double>& erodibilities){
+	TerrainBuffer buffer(layers);
+	erode_materials_using_exposure(buffer, erodibilities);
+}
+
+void erode_materials_using_exposure(TerrainBuffer& buffer, const std::vector<double>& erodibilities){
+	MultiLayerMap& layers = buffer.layers();
+	assert(layers.get_layer_number() > 0);
+
+	// creating the sediment layer if necessary
+	if(layers.get_layer_number() == 1){
+		layers.new_layer();
+	}
+
+	SimpleLayerMap terrain_exposure = get_light_exposure(buffer.terrain());
+	terrain_exposure.normalize();
+
+	MaterialColumns& materials = layers.mutable_materials();
+	const bool typed_sediments = materials.stack_number() > 1;
+	std::vector<MaterialColumns::Run> removed;
+
+	// apply erosion on layers
+	for(int h = 0; h < layers.grid_height(); ++h){
 		for(int w = 0; w < layers.grid_width(); ++w){
+			int material = materials.top_material(w, h, 0);
 
-			// find the erosion value based on the height of the current layer
-			int ilayer = 0;
-			while(ilayer < layers_top_heights.size()
-			&& terrain.at(w, h) > layers_angled_heights[ilayer]){
-				++ilayer;
+			// nothing left to erode under the column
+			if(material < 0){
+				continue;
 			}
 
-			double material_erosion_value = layers_erosion_values[ilayer];
+			removed.clear();
+			double eroded = materials.remove(w, h, 0, erodibilities.at(material) * terrain_exposure.at(w, h), &removed);
 
-			layers.get_field(0).at(w, h) -= material_erosion_value * terrain_exposure.at(w, h);
-			layers.get_field(1).at(w, h) += material_erosion_value * terrain_exposure.at(w, h);
+			layers.get_field(0).at(w, h) -= eroded;
+			layers.get_field(1).at(w, h) += eroded;
+
+			for(int r = 0; typed_sediments && r != removed.size(); ++r){
+				materials.deposit(w, h, 1, removed[r].material, removed[r].thickness);
+			}
 		}
 	}
+
+	buffer.mark_synced();
 }
 
-void transport(MultiLayerMap& layers, const double rest_angle, const double quantity_tolerance)
+namespace
 {
-	assert(layers.get_layer_number() > 0);
+/**
+ * @brief Get the materials of the sediment layer moved by the transports, null if they are not tracked
+ *
+ */
+MaterialColumns* sediment_materials(MultiLayerMap& layers)
+{
+	return (layers.has_materials() && layers.materials().stack_number() > 1) ? &layers.mutable_materials() : nullptr;
+}
+
+/**
+ * @brief Move sediments from a cell to one of its neighbors, with their materials if they are tracked
+ *
+ * @param layers        the layers, the sediments being the second one
+ * @param terrain       the sum of the layers
+ * @param from, to      the cell and its neighbor
+ * @param amount        the height of sediments to move
+ * @param materials     the materials of the layers, null if they are not tracked
+ * @param removed       the runs taken from the cell, reused by the calls
+ */
+void move_sediments(MultiLayerMap& layers, SimpleLayerMap& terrain, const Eigen::Vector2i& from, const Eigen::Vector2i& to,
+			const double amount, MaterialColumns* materials, std::vector<MaterialColumns::Run>& removed)
+{
+	layers.get_field(1).at(from) -= amount;
+	layers.get_field(1).at(to) += amount;
+	terrain.at(from) -= amount;
+	terrain.at(to) += amount;
+
+	if(materials){
+		// the top of the sediments slides first, as the eroded materials do
+		removed.clear();
+		materials->remove(from(0), from(1), 1, amount, &removed);
+
+		for(int r = 0; r != removed.size(); ++r){
+			materials->deposit(to(0), to(1), 1, removed[r].material, removed[r].thickness);
+		}
+	}
+}
+}
+
+void transport(MultiLayerMap& layers, const double rest_angle, const double quantity_tolerance, TransportStatistics* statistics)
+{
+	TerrainBuffer buffer(layers);
+	transport(buffer, rest_angle, quantity_tolerance, statistics);
+}
+
+void transport(TerrainBuffer& buffer, const double rest_angle, const double quantity_tolerance, TransportStatistics* statistics)
+{
+	MultiLayerMap& layers = buffer.layers();
+	assert(layers.get_layer_number() > 1);
+	PROFILE_SCOPE("transport");
 
 	// the difference in height between two adjacent cells under which the pile is considered stable
 	double slope_stability_threshold = layers.cell_size().x() * tan(rest_angle / 180. * 3.14);
@@ -267,12 +379,16 @@ void transport(MultiLayerMap& layers, const double rest_angle, const double quan
 	double slopes[8];
 
 	// generating the base terrain layer on which slopes will be computed
-	SimpleLayerMap terrain = layers.generate_field();
+	SimpleLayerMap& terrain = buffer.terrain();
+
+	// the materials of the sediments move with them
+	MaterialColumns* materials = sediment_materials(layers);
+	std::vector<MaterialColumns::Run> removed;
 
 	// temporary vector to shuffle grid cells
 	std::vector<Eigen::Vector2i> coord_vector;
-	for(int i = 0; i < terrain.grid_height(); ++i){
-		for(int j = 0; j < terrain.grid_width(); ++j){
+	for(int j = 0; j < terrain.grid_height(); ++j){
+		for(int i = 0; i < terrain.grid_width(); ++i){
 			coord_vector.push_back({i, j});
 		}
 	}
@@ -285,12 +401,13 @@ void transport(MultiLayerMap& layers, const double rest_angle, const double quan
 	}
 
 	coord_vector.clear();
+	long pushes = unstable_coord.size();
+	long cells = 0;
 
 	// updating stability map with all cells unstable
 	BooleanField stability_map(layers.grid_width(), layers.grid_height(), false);
 
 	while(!unstable_coord.empty()){
-		//std::cout << "queue size: " << unstable_coord.size() << std::endl;
 		// pick the next unstable cell
 		const Eigen::Vector2i& unstable_cell = unstable_coord.front();
 
@@ -339,18 +456,13 @@ void transport(MultiLayerMap& layers, const double rest_angle, const double quan
 
 				// transporting some sediments to stabilize with regard to one neighbor
 				for(int neigh = 0; neigh != neighbors; ++neigh){
-					// updating the sediment layer
-					layers.get_field(1).at(unstable_cell) -= amount_to_transport;
-					layers.get_field(1).at(positions[neigh]) += amount_to_transport;
-
-					// updating terrain
-					terrain.at(unstable_cell) -= amount_to_transport;
-					terrain.at(positions[neigh]) += amount_to_transport;
+					// updating the sediment layer and the terrain
+					move_sediments(layers, terrain, unstable_cell, positions[neigh], amount_to_transport, materials, removed);
 
 					// adding neighbor to queue as if it may have become unstable
-					if(stability_map.at(positions[neigh])){
-						stability_map.at(positions[neigh]) = false;
+					if(stability_map.test_and_clear(positions[neigh])){
 						unstable_coord.push(positions[neigh]);
+						++pushes;
 					}
 				}
 			}
@@ -358,14 +470,194 @@ void transport(MultiLayerMap& layers, const double rest_angle, const double quan
 
 		// unstable_cell is now stable either because the slope difference is not big enough anymore
 		// or because there is no more sediments to transport from unstable_cell
-		stability_map.at(unstable_cell) = true;
+		stability_map.test_and_set(unstable_cell);
 		unstable_coord.pop();
+		++cells;
+
+		// the queue empties as the slopes settle
+		if((cells & 4095) == 0)
+		{
+			report_progress(cells / double(cells + unstable_coord.size()));
+		}
 	}
+
+	PROFILE_COUNT("transport.pushes", pushes);
+	PROFILE_COUNT("transport.cells", cells);
+
+	if(statistics){
+		statistics->cells = cells;
+		statistics->pushes = pushes;
+	}
+
+	buffer.mark_synced();
+}
+
+namespace
+{
+const int transport_buckets = 64;	/**< the number of priorities of the unstable cells*/
+
+/**
+ * @brief Get the priority of a cell for transport_unstable_first
+ *
+ * @return int		the bucket of the cell, on a logarithmic scale of how much its steepest slope exceeds the threshold
+ *			with the threshold itself in the middle. -1 if the cell is stable
+ */
+int instability_bucket(const MultiLayerMap& layers, const SimpleLayerMap& terrain, const Eigen::Vector2i& cell,
+			const double slope_stability_threshold, const double quantity_tolerance)
+{
+	if(layers.get_field(1).value(cell(0), cell(1)) < quantity_tolerance){
+		return -1;
+	}
+
+	double values[8];
+	Eigen::Vector2i positions[8];
+	double slopes[8];
+	int neighbors = terrain.neighbors_info_filter(cell, values, positions, slopes, - slope_stability_threshold, false);
+
+	if(neighbors == 0){
+		return -1;
+	}
+
+	double excess = - min_array(neighbors, slopes) - slope_stability_threshold;
+
+	if(excess <= 0.){
+		return -1;
+	}
+
+	double scale = (slope_stability_threshold > 0.) ? slope_stability_threshold : 1.;
+	return std::max(0, std::min(transport_buckets - 1, transport_buckets / 2 + std::ilogb(excess / scale)));
+}
+}
+
+void transport_unstable_first(MultiLayerMap& layers, const double rest_angle, const double quantity_tolerance, TransportStatistics* statistics)
+{
+	TerrainBuffer buffer(layers);
+	transport_unstable_first(buffer, rest_angle, quantity_tolerance, statistics);
+}
+
+void transport_unstable_first(TerrainBuffer& buffer, const double rest_angle, const double quantity_tolerance, TransportStatistics* statistics)
+{
+	MultiLayerMap& layers = buffer.layers();
+	assert(layers.get_layer_number() > 1);
+	PROFILE_SCOPE("transport");
+
+	// the difference in height between two adjacent cells under which the pile is considered stable
+	double slope_stability_threshold = layers.cell_size().x() * tan(rest_angle / 180. * 3.14);
+
+	// temp storage of neighborhood
+	double values[8];
+	Eigen::Vector2i positions[8];
+	double slopes[8];
+
+	// generating the base terrain layer on which slopes will be computed
+	SimpleLayerMap& terrain = buffer.terrain();
+	const int width = terrain.grid_width();
+
+	// the materials of the sediments move with them
+	MaterialColumns* materials = sediment_materials(layers);
+	std::vector<MaterialColumns::Run> removed;
+
+	// queue the unstable cells only, the cells are their index j * width + i
+	BucketQueue unstable_cells(width * terrain.grid_height(), transport_buckets);
+	long pushes = 0;
+	long cells = 0;
+
+	for(int j = 0; j < terrain.grid_height(); ++j){
+		for(int i = 0; i < width; ++i){
+			int bucket = instability_bucket(layers, terrain, {i, j}, slope_stability_threshold, quantity_tolerance);
+
+			if(bucket >= 0){
+				unstable_cells.push(j * width + i, bucket);
+				++pushes;
+			}
+		}
+	}
+
+	while(!unstable_cells.empty()){
+		const int index = unstable_cells.pop();
+		const Eigen::Vector2i unstable_cell(index % width, index / width);
+
+		int neighbors;
+		bool moved = false;
+		bool available_sediments = true;
+
+		// same stabilization as transport
+		do{
+			if(layers.get_field(1).at(unstable_cell) < quantity_tolerance){
+				break;
+			}
+
+			neighbors = terrain.neighbors_info_filter(unstable_cell, values, positions, slopes,
+								  - slope_stability_threshold, false);
+
+			if(neighbors > 0){
+				opp_array(neighbors, slopes);
+
+				double min_neighborhood_slope = min_array(neighbors, slopes);
+				double sediments_at_unstable_cell = layers.get_field(1).at(unstable_cell);
+				double min_stability_difference = min_neighborhood_slope - slope_stability_threshold;
+
+				double amount_to_transport_all_neighbors = min_stability_difference * neighbors;
+				if(amount_to_transport_all_neighbors > sediments_at_unstable_cell){
+					amount_to_transport_all_neighbors = sediments_at_unstable_cell;
+					available_sediments = false;
+				}
+
+				double amount_to_transport = amount_to_transport_all_neighbors / neighbors;
+				if(amount_to_transport < quantity_tolerance){
+					break;
+				}
+
+				for(int neigh = 0; neigh != neighbors; ++neigh){
+					move_sediments(layers, terrain, unstable_cell, positions[neigh], amount_to_transport, materials, removed);
+				}
+
+				moved = true;
+			}
+		}while(neighbors > 0 && available_sediments);
+
+		++cells;
+
+		// the neighbors receiving sediments became higher and the others became higher than the cell,
+		// they are the only cells that may have become unstable, or more unstable
+		neighbors = moved ? terrain.neighbors(unstable_cell(0), unstable_cell(1), positions) : 0;
+
+		for(int neigh = 0; neigh != neighbors; ++neigh){
+			int bucket = instability_bucket(layers, terrain, positions[neigh], slope_stability_threshold, quantity_tolerance);
+
+			if(bucket >= 0 && unstable_cells.push(positions[neigh](1) * width + positions[neigh](0), bucket)){
+				++pushes;
+			}
+		}
+
+		if((cells & 4095) == 0)
+		{
+			report_progress(cells / double(cells + unstable_cells.size()));
+		}
+	}
+
+	PROFILE_COUNT("transport.pushes", pushes);
+	PROFILE_COUNT("transport.cells", cells);
+
+	if(statistics){
+		statistics->cells = cells;
+		statistics->pushes = pushes;
+	}
+
+	buffer.mark_synced();
 }
 
 void transport_4connex(MultiLayerMap& layers, const double rest_angle, const double quantity_tolerance)
 {
-	assert(layers.get_layer_number() > 0);
+	TerrainBuffer buffer(layers);
+	transport_4connex(buffer, rest_angle, quantity_tolerance);
+}
+
+void transport_4connex(TerrainBuffer& buffer, const double rest_angle, const double quantity_tolerance)
+{
+	MultiLayerMap& layers = buffer.layers();
+	assert(layers.get_layer_number() > 1);
+	PROFILE_SCOPE("transport");
 
 	// the difference in height between two adjacent cells under which the pile is considered stable
 	double slope_stability_threshold = layers.cell_size().x() * tan(rest_angle / 180. * 3.14);
@@ -376,12 +668,16 @@ void transport_4connex(MultiLayerMap& layers, const double rest_angle, const dou
 	double slopes[4];
 
 	// generating the base terrain layer on which slopes will be computed
-	SimpleLayerMap terrain = layers.generate_field();
+	SimpleLayerMap& terrain = buffer.terrain();
+
+	// the materials of the sediments move with them
+	MaterialColumns* materials = sediment_materials(layers);
+	std::vector<MaterialColumns::Run> removed;
 
 	// temporary vector to shuffle grid cells
 	std::vector<Eigen::Vector2i> coord_vector;
-	for(int i = 0; i < terrain.grid_height(); ++i){
-		for(int j = 0; j < terrain.grid_width(); ++j){
+	for(int j = 0; j < terrain.grid_height(); ++j){
+		for(int i = 0; i < terrain.grid_width(); ++i){
 			coord_vector.push_back({i, j});
 		}
 	}
@@ -394,12 +690,13 @@ void transport_4connex(MultiLayerMap& layers, const double rest_angle, const dou
 	}
 
 	coord_vector.clear();
+	long pushes = unstable_coord.size();
+	long cells = 0;
 
 	// updating stability map with all cells unstable
 	BooleanField stability_map(layers.grid_width(), layers.grid_height(), false);
 
 	while(!unstable_coord.empty()){
-		//std::cout << "queue size: " << unstable_coord.size() << std::endl;
 
 		// pick the next unstable cell
 		const Eigen::Vector2i& unstable_cell = unstable_coord.front();
@@ -449,18 +746,13 @@ void transport_4connex(MultiLayerMap& layers, const double rest_angle, const dou
 
 				// transporting some sediments to stabilize with regard to one neighbor
 				for(int neigh = 0; neigh != neighbors; ++neigh){
-					// updating the sediment layer
-					layers.get_field(1).at(unstable_cell) -= amount_to_transport;
-					layers.get_field(1).at(positions[neigh]) += amount_to_transport;
-
-					// updating terrain
-					terrain.at(unstable_cell) -= amount_to_transport;
-					terrain.at(positions[neigh]) += amount_to_transport;
+					// updating the sediment layer and the terrain
+					move_sediments(layers, terrain, unstable_cell, positions[neigh], amount_to_transport, materials, removed);
 
 					// adding neighbor to queue as if it may have become unstable
-					if(stability_map.at(positions[neigh])){
-						stability_map.at(positions[neigh]) = false;
+					if(stability_map.test_and_clear(positions[neigh])){
 						unstable_coord.push(positions[neigh]);
+						++pushes;
 					}
 				}
 			}
@@ -468,19 +760,45 @@ void transport_4connex(MultiLayerMap& layers, const double rest_angle, const dou
 
 		// unstable_cell is now stable either because the slope difference is not big enough anymore
 		// or because there is no more sediments to transport from unstable_cell
-		stability_map.at(unstable_cell) = true;
+		stability_map.test_and_set(unstable_cell);
 		unstable_coord.pop();
+		++cells;
+
+		// the queue empties as the slopes settle
+		if((cells & 4095) == 0)
+		{
+			report_progress(cells / double(cells + unstable_coord.size()));
+		}
 	}
+
+	PROFILE_COUNT("transport.pushes", pushes);
+	PROFILE_COUNT("transport.cells", cells);
+
+	buffer.mark_synced();
 }
 
 void transport_varying_stability_angle(MultiLayerMap& layers,
 					const double min_rest_angle, const double max_rest_angle,
 					const double quantity_tolerance)
 {
-	assert(layers.get_layer_number() > 0);
+	TerrainBuffer buffer(layers);
+	transport_varying_stability_angle(buffer, min_rest_angle, max_rest_angle, quantity_tolerance);
+}
+
+void transport_varying_stability_angle(TerrainBuffer& buffer,
+					const double min_rest_angle, const double max_rest_angle,
+					const double quantity_tolerance)
+{
+	MultiLayerMap& layers = buffer.layers();
+	assert(layers.get_layer_number() > 1);
+	PROFILE_SCOPE("transport");
 
 	// generating the base terrain layer on which slopes & drainage area will be computed
-	SimpleLayerMap terrain = layers.generate_field();
+	SimpleLayerMap& terrain = buffer.terrain();
+
+	// the materials of the sediments move with them
+	MaterialColumns* materials = sediment_materials(layers);
+	std::vector<MaterialColumns::Run> removed;
 
 	// computing the stability of each pixel using the drainage area
 	// linear interpolation between min_rest_angle and max_rest_angle
@@ -501,8 +819,8 @@ void transport_varying_stability_angle(MultiLayerMap& layers,
 
 	// temporary vector to shuffle grid cells
 	std::vector<Eigen::Vector2i> coord_vector;
-	for(int i = 0; i < terrain.grid_height(); ++i){
-		for(int j = 0; j < terrain.grid_width(); ++j){
+	for(int j = 0; j < terrain.grid_height(); ++j){
+		for(int i = 0; i < terrain.grid_width(); ++i){
 			coord_vector.push_back({i, j});
 		}
 	}
@@ -515,13 +833,13 @@ void transport_varying_stability_angle(MultiLayerMap& layers,
 	}
 
 	coord_vector.clear();
+	long pushes = unstable_coord.size();
+	long cells = 0;
 
 	// updating stability map with all cells unstable
 	BooleanField stability_map(layers.grid_width(), layers.grid_height(), false);
 
 	while(!unstable_coord.empty()){
-		std::cout << "queue size: " << unstable_coord.size() << std::endl;
-
 		// pick the next unstable cell
 		const Eigen::Vector2i& unstable_cell = unstable_coord.front();
 
@@ -570,18 +888,13 @@ void transport_varying_stability_angle(MultiLayerMap& layers,
 
 				// transporting some sediments to stabilize with regard to one neighbor
 				for(int neigh = 0; neigh != neighbors; ++neigh){
-					// updating the sediment layer
-					layers.get_field(1).at(unstable_cell) -= amount_to_transport;
-					layers.get_field(1).at(positions[neigh]) += amount_to_transport;
-
-					// updating terrain
-					terrain.at(unstable_cell) -= amount_to_transport;
-					terrain.at(positions[neigh]) += amount_to_transport;
+					// updating the sediment layer and the terrain
+					move_sediments(layers, terrain, unstable_cell, positions[neigh], amount_to_transport, materials, removed);
 
 					// adding neighbor to queue as if it may have become unstable
-					if(stability_map.at(positions[neigh])){
-						stability_map.at(positions[neigh]) = false;
+					if(stability_map.test_and_clear(positions[neigh])){
 						unstable_coord.push(positions[neigh]);
+						++pushes;
 					}
 				}
 			}
@@ -589,8 +902,15 @@ void transport_varying_stability_angle(MultiLayerMap& layers,
 
 		// unstable_cell is now stable either because the slope difference is not big enough anymore
 		// or because there is no more sediments to transport from unstable_cell
-		stability_map.at(unstable_cell) = true;
+		stability_map.test_and_set(unstable_cell);
 		unstable_coord.pop();
+		++cells;
+
+		// the queue empties as the slopes settle
+		if((cells & 4095) == 0)
+		{
+			report_progress(cells / double(cells + unstable_coord.size()));
+		}
 
 		// updating rest angle map using the new drainage area
 		/*
@@ -605,4 +925,302 @@ void transport_varying_stability_angle(MultiLayerMap& layers,
 		}
 		*/
 	}
+
+	PROFILE_COUNT("transport.pushes", pushes);
+	PROFILE_COUNT("transport.cells", cells);
+
+	buffer.mark_synced();
+}
+
+void erode_coarse_to_fine(MultiLayerMap& layers, const std::function<void(MultiLayerMap&)>& step,
+					const std::vector<int>& iterations, const bool bicubic)
+{
+	if(iterations.empty())
+	{
+		return;
+	}
+
+	FieldPyramid<MultiLayerMap> pyramid(layers, iterations.size() - 1);
+	const int coarsest = pyramid.level_number() - 1;
+	MultiLayerMap current(pyramid.level(coarsest));
+
+	// the iterations of the levels too small to be built are done on the coarsest one
+	int iteration_number = 0;
+
+	for(int k = 0; k < iterations.size() - coarsest; ++k)
+	{
+		iteration_number += iterations[k];
+	}
+
+	for(int level = coarsest; level > 0; --level)
+	{
+		for(int k = 0; k < iteration_number; ++k)
+		{
+			step(current);
+		}
+
+		const MultiLayerMap& start = pyramid.level(level);
+		const MultiLayerMap& finer = pyramid.level(level - 1);
+		MultiLayerMap next(finer);
+
+		for(int l = 0; l < current.get_layer_number(); ++l)
+		{
+			// the step may have created layers
+			SimpleLayerMap delta(current.get_field(l));
+
+			if(l < start.get_layer_number())
+			{
+				delta -= start.get_field(l);
+			}
+
+			if(l >= next.get_layer_number())
+			{
+				next.new_layer();
+			}
+
+			// each coarse value stands for its block of finer values
+			double moved = 0;
+
+			for(int j = 0; j < delta.grid_height(); ++j)
+			{
+				for(int i = 0; i < delta.grid_width(); ++i)
+				{
+					moved += delta.value(i, j) * SimpleLayerMap::downsampled_block_size(finer, i, j);
+				}
+			}
+
+			SimpleLayerMap finer_delta = SimpleLayerMap::generate_resampled(delta, finer, bicubic);
+			const double residual = moved - finer_delta.get_sum();
+			double weight = 0;
+
+			for(int j = 0; j < finer_delta.grid_height(); ++j)
+			{
+				for(int i = 0; i < finer_delta.grid_width(); ++i)
+				{
+					weight += std::abs(finer_delta.value(i, j));
+				}
+			}
+
+			// the interpolation error is corrected where the layer changed, in proportion to the change,
+			// so the regions left unchanged stay unchanged
+			if(weight > 0)
+			{
+				for(int j = 0; j < finer_delta.grid_height(); ++j)
+				{
+					for(int i = 0; i < finer_delta.grid_width(); ++i)
+					{
+						const double d = finer_delta.value(i, j);
+
+						if(d != 0)
+						{
+							finer_delta.at(i, j) = d + residual * std::abs(d) / weight;
+						}
+					}
+				}
+			}
+			else
+			{
+				finer_delta += residual / finer.cell_number();
+			}
+
+			finer_delta.compact();
+			SimpleLayerMap& layer = next.get_field(l);
+			layer += finer_delta;
+
+			if(l > 0)
+			{
+				// what the change removes below zero is taken from the bedrock under the cell, keeping the total mass
+				SimpleLayerMap& bedrock = next.get_field(0);
+
+				for(int j = 0; j < layer.grid_height(); ++j)
+				{
+					for(int i = 0; i < layer.grid_width(); ++i)
+					{
+						const double v = layer.value(i, j);
+
+						if(v < 0)
+						{
+							layer.at(i, j) = 0;
+							bedrock.at(i, j) += v;
+						}
+					}
+				}
+			}
+		}
+
+		current = std::move(next);
+		iteration_number = iterations[iterations.size() - level];
+	}
+
+	for(int k = 0; k < iteration_number; ++k)
+	{
+		step(current);
+	}
+
+	for(int l = 0; l < current.get_layer_number(); ++l)
+	{
+		if(l >= layers.get_layer_number())
+		{
+			layers.new_layer();
+		}
+
+		layers.get_field(l).copy_values(std::move(current.get_field(l)));
+	}
+}
+
+ErosionIteration measure_erosion(const MultiLayerMap& before, const MultiLayerMap& after, const ConvergenceCriteria& criteria,
+					const SimpleLayerMap* terrain, TalusBlocks* blocks)
+{
+	PROFILE_SCOPE("erosion.measure");
+	ErosionIteration result = {0., 0., 0};
+	BooleanField changed(after.grid_width(), after.grid_height(), false);
+	double moved = 0.;
+
+	// a layer missing on one side is seen as zeros
+	for(int l = 0; l < std::max(before.get_layer_number(), after.get_layer_number()); ++l)
+	{
+		const TileStorage* b = (l < before.get_layer_number()) ? &before.get_field(l).storage() : nullptr;
+		const TileStorage* a = (l < after.get_layer_number()) ? &after.get_field(l).storage() : nullptr;
+		const TileStorage& any = a ? *a : *b;
+
+		for(int t = 0; t < any.tile_number(); ++t)
+		{
+			// a tile shared by both sides or empty on one side and missing on the other has not changed
+			if((a && b && a->shares_tile(t, *b)) || (!b && a->is_empty(t)) || (!a && b->is_empty(t)))
+			{
+				continue;
+			}
+
+			int i0, j0, i1, j1;
+			any.tile_bounds(t, i0, j0, i1, j1);
+
+			for(int j = j0; j < j1; ++j)
+			{
+				for(int i = i0; i < i1; ++i)
+				{
+					const double difference = std::abs((a ? a->get(i, j) : 0.) - (b ? b->get(i, j) : 0.));
+					moved += difference;
+
+					if(difference > criteria.cell_tolerance)
+					{
+						changed.at(i, j) = true;
+					}
+
+					// the talus of the cell and of its neighbors may change, even under the tolerance
+					if(blocks && difference > 0)
+					{
+						blocks->active.activate(i, j);
+					}
+				}
+			}
+		}
+	}
+
+	result.mass_moved = moved * 0.5;
+	result.changed_cells = changed.count();
+
+	if(criteria.rest_angle > 0 && after.get_layer_number() > 1)
+	{
+		const double slope_stability_threshold = after.cell_size().x() * tan(criteria.rest_angle / 180. * 3.14);
+		std::unique_ptr<SimpleLayerMap> summed(terrain ? nullptr : new SimpleLayerMap(after.generate_field()));
+		const SimpleLayerMap& heights = terrain ? *terrain : *summed;
+		long measured = 0;
+
+		// the most the slope of a cell with sediments exceeds the rest angle by in a block of cells
+		auto talus = [&](const int i0, const int j0, const int i1, const int j1)
+		{
+			double values[8];
+			Eigen::Vector2i positions[8];
+			double slopes[8];
+			double violation = 0.;
+			measured += (i1 - i0) * (j1 - j0);
+
+			for(int j = j0; j < j1; ++j)
+			{
+				for(int i = i0; i < i1; ++i)
+				{
+					if(after.get_field(1).value(i, j) < criteria.cell_tolerance)
+					{
+						continue;
+					}
+
+					int neighbors = heights.neighbors_info_filter(i, j, values, positions, slopes, - slope_stability_threshold, false);
+
+					if(neighbors > 0)
+					{
+						violation = std::max(violation, - min_array(neighbors, slopes) - slope_stability_threshold);
+					}
+				}
+			}
+
+			return violation;
+		};
+
+		if(blocks)
+		{
+			// the blocks away from the changes keep the violation of their last measure
+			blocks->active.advance();
+			blocks->active.for_each_block([&](const int i0, const int j0, const int i1, const int j1)
+			{
+				blocks->violations[blocks->active.block_index(i0, j0)] = talus(i0, j0, i1, j1);
+			});
+			result.max_talus_violation = *std::max_element(blocks->violations.begin(), blocks->violations.end());
+		}
+		else
+		{
+			result.max_talus_violation = talus(0, 0, after.grid_width(), after.grid_height());
+		}
+
+		PROFILE_COUNT("erosion.talus_cells", measured);
+	}
+
+	return result;
+}
+
+ErosionStatistics erode_until_converged(MultiLayerMap& layers, const std::function<void(MultiLayerMap&)>& step,
+					const ConvergenceCriteria& criteria)
+{
+	// the terrain is only summed when the talus is measured, as the step modifies the layers outside of the buffer
+	TerrainBuffer buffer(layers);
+	return erode_until_converged(buffer, [&](TerrainBuffer& b)
+	{
+		step(b.layers());
+	}, criteria);
+}
+
+ErosionStatistics erode_until_converged(TerrainBuffer& buffer, const std::function<void(TerrainBuffer&)>& step,
+					const ConvergenceCriteria& criteria)
+{
+	PROFILE_SCOPE("erosion.converge");
+	MultiLayerMap& layers = buffer.layers();
+	ErosionStatistics statistics;
+	double first_mass = 0.;
+	TalusBlocks blocks(layers.grid_width(), layers.grid_height());
+
+	while(statistics.iterations < criteria.max_iterations && !statistics.converged)
+	{
+		// the copy shares its tiles with the terrain, only the tiles the step modifies are copied
+		const MultiLayerMap before(layers);
+
+		{
+			ProgressScope progress(statistics.iterations / double(criteria.max_iterations),
+			                       (statistics.iterations + 1) / double(criteria.max_iterations));
+			step(buffer);
+		}
+
+		const bool talus = criteria.rest_angle > 0 && layers.get_layer_number() > 1;
+		const ErosionIteration iteration = measure_erosion(before, layers, criteria, talus ? &buffer.terrain() : nullptr,
+		                                                   (criteria.rest_angle > 0) ? &blocks : nullptr);
+		first_mass = (statistics.iterations == 0) ? iteration.mass_moved : first_mass;
+		statistics.history.push_back(iteration);
+		statistics.mass_moved += iteration.mass_moved;
+		++statistics.iterations;
+
+		const bool stable = criteria.rest_angle <= 0 || iteration.max_talus_violation <= criteria.talus_tolerance;
+		statistics.converged = iteration.changed_cells == 0
+		                       || (stable && iteration.mass_moved <= criteria.relative_mass * first_mass && statistics.iterations > 1);
+	}
+
+	PROFILE_COUNT("erosion.iterations", statistics.iterations);
+	return statistics;
 }
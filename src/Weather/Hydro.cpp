@@ -1,6 +1,12 @@
 #include <Weather/Hydro.hpp>
 #include <Utils.hpp>
+#include <Profiler.hpp>
+#include <Progress.hpp>
+
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <stdexcept>
 
 SimpleLayerMap get_area(const DoubleField& heightmap, bool distribute)
 {
@@ -55,9 +61,12 @@ SimpleLayerMap get_area(const DoubleField& heightmap, bool distribute)
 
 SimpleLayerMap get_water_indexes(const DoubleField& heightmap)
 {
-	SimpleLayerMap area = get_area(heightmap, true);
-	SimpleLayerMap slope = SimpleLayerMap::generate_slope_map(heightmap).normalize();
-	SimpleLayerMap water_index = SimpleLayerMap(static_cast<Grid2d>(heightmap));
+	return get_water_indexes(get_area(heightmap, true), SimpleLayerMap::generate_slope_map(heightmap));
+}
+
+SimpleLayerMap get_water_indexes(const SimpleLayerMap& area, const SimpleLayerMap& slope)
+{
+	SimpleLayerMap water_index = SimpleLayerMap(static_cast<Grid2d>(area));
 
 	double k = 4.0;
 
@@ -65,7 +74,7 @@ SimpleLayerMap get_water_indexes(const DoubleField& heightmap)
 	{
 		for(int i = 0; i < area.grid_width(); i++)
 		{
-			water_index.set_value(i, j, sqrt(area.value(i, j))/(1+k*heightmap.slope(i, j)));
+			water_index.set_value(i, j, sqrt(area.value(i, j))/(1+k*slope.value(i, j)));
 		}
 	}
 
@@ -118,16 +127,31 @@ void erode_from_area(MultiLayerMap& layers, const SimpleLayerMap& area, double k
 
 void erode_from_droplets(MultiLayerMap& layers, std::mt19937& gen, const SimpleLayerMap& brush, int n, double water_loss, double k, double kd)
 {
+	erode_from_droplets(layers, gen, CompiledBrush(brush), n, water_loss, k, kd);
+}
+
+void erode_from_droplets(MultiLayerMap& layers, std::mt19937& gen, const CompiledBrush& brush, int n, double water_loss, double k, double kd)
+{
+	PROFILE_SCOPE("droplets");
+	long steps = 0;
 	std::uniform_int_distribution<> dis_width(0, layers.grid_width() - 1);
-	std::uniform_int_distribution<> dis_height(0, layers.grid_width() - 1);
+	std::uniform_int_distribution<> dis_height(0, layers.grid_height() - 1);
 	std::uniform_real_distribution<> dis_proportion(0, 1);
 
 	SimpleLayerMap& firstField = layers.get_field(0);
 	SimpleLayerMap& topField = layers.get_field(layers.get_layer_number() - 1);
 	SimpleLayerMap heightmap = layers.generate_field();
+	TileStorage& first_values = firstField.mutable_storage();
+	TileStorage& top_values = topField.mutable_storage();
+	TileStorage& heights = heightmap.mutable_storage();
 
 	for(int i = 0; i < n; i++)
 	{
+		if((i & 1023) == 0)
+		{
+			report_progress(i / double(n));
+		}
+
 		int x = dis_width(gen);
 		int y = dis_height(gen);
 		int next_x = 0;
@@ -139,6 +163,7 @@ void erode_from_droplets(MultiLayerMap& layers, std::mt19937& gen, const SimpleL
 
 		while(qty_water > 0.0)
 		{
+			++steps;
 			// compute new x, y
 			double values[8];
 			Eigen::Vector2i positions[8];
@@ -199,32 +224,12 @@ void erode_from_droplets(MultiLayerMap& layers, std::mt19937& gen, const SimpleL
 				if(-delta_sed > qty_sed)			delta_sed = -qty_sed;				// qty_sed >= 0
 				if(delta_sed + qty_sed > 1.0) delta_sed = 1.0 - qty_sed;	// qty_sed <= 1
 
-				double unused = 0.0;
-				// update qty_sed and layers
-				for(int row = 0; row < brush.grid_height(); ++row)
-				{
-					for(int col = 0; col < brush.grid_width(); ++col)
-					{
-						int brush_origin = brush.grid_width() >> 1;
-						int field_col = x + col - brush_origin;
-						int field_row = y + row - brush_origin;
+				// update qty_sed and layers, the part of the brush outside of the grid going to the center
+				double unused = brush.add((delta_sed > 0) ? first_values : top_values, x, y, -delta_sed, &heights);
 
-						if(field_col < 0 || field_row < 0 || field_col >= firstField.grid_height() || field_row >= firstField.grid_width())
-						{
-							unused += brush.value(col, row) * delta_sed;
-						}
-						else
-						{
-							if(delta_sed > 0) firstField.at(field_col, field_row) -= brush.value(col, row) * delta_sed;
-							else 							topField.at(field_col, field_row) -= brush.value(col, row) * delta_sed;
-							heightmap.at(field_col, field_row) -= brush.value(col, row) * delta_sed;
-						}
-					}
-				}
-				
-				if(delta_sed > 0) firstField.at(x, y) -= unused;
-				else 							topField.at(x, y) -= unused;
-				heightmap.at(x, y) -= unused;
+				if(delta_sed > 0) firstField.at(x, y) += unused;
+				else 							topField.at(x, y) += unused;
+				heightmap.at(x, y) += unused;
 				qty_sed += delta_sed;	// qty_sed between 0 and 1
 
 				// update position
@@ -238,4 +243,212 @@ void erode_from_droplets(MultiLayerMap& layers, std::mt19937& gen, const SimpleL
 
 		firstField.at(x, y) += qty_sed;
 	}
-}
\ No newline at end of file
+
+	PROFILE_COUNT("droplets.steps", steps);
+}
+
+namespace
+{
+/**
+ * @brief Sample the bilinear interpolation of a terrain and its gradient, from the four cells around a position
+ *
+ * @param heights           the heights of the terrain
+ * @param i, j              the cell at the bottom left of the position
+ * @param u, v              the position inside the cell, between 0 and 1
+ * @param gx, gy            receive the gradient
+ * @return double           the height
+ */
+double sample(const TileStorage& heights, const int i, const int j, const float u, const float v, float& gx, float& gy)
+{
+	const double h00 = heights.get(i, j);
+	const double h10 = heights.get(i + 1, j);
+	const double h01 = heights.get(i, j + 1);
+	const double h11 = heights.get(i + 1, j + 1);
+	gx = (h10 - h00) * (1 - v) + (h11 - h01) * v;
+	gy = (h01 - h00) * (1 - u) + (h11 - h10) * u;
+	return (h00 * (1 - u) + h10 * u) * (1 - v) + (h01 * (1 - u) + h11 * u) * v;
+}
+}
+
+long erode_from_continuous_droplets(TerrainBuffer& buffer, std::mt19937& gen, const int n, const DropletParameters& parameters)
+{
+	MultiLayerMap& layers = buffer.layers();
+	const int width = layers.grid_width();
+	const int height = layers.grid_height();
+
+	if(parameters.radius < 1 || parameters.max_steps < 1 || width < 2 || height < 2)
+	{
+		throw std::invalid_argument("the droplets need a brush, at least one step and a grid of at least 2 cells along each axis");
+	}
+
+	PROFILE_SCOPE("droplets.continuous");
+
+	// creating the sediment layer if necessary
+	if(layers.get_layer_number() == 1)
+	{
+		layers.new_layer();
+	}
+
+	TileStorage& heights = buffer.terrain().mutable_storage();
+	std::vector<TileStorage*> storages;
+
+	for(int l = 0; l < layers.get_layer_number(); ++l)
+	{
+		storages.push_back(&layers.get_field(l).mutable_storage());
+	}
+
+	TileStorage& bedrock = *storages.front();
+	TileStorage& top = *storages.back();
+	const CompiledBrush brush = CompiledBrush::cone(parameters.radius);
+	std::uniform_real_distribution<float> dis_x(0, width - 1);
+	std::uniform_real_distribution<float> dis_y(0, height - 1);
+	long steps = 0;
+
+	// the sediments are put on the four cells around a position, with the weights of the bilinear interpolation
+	// computed in double so that they sum to 1
+	auto deposit = [&](const int i, const int j, const double u, const double v, const double amount)
+	{
+		const double shares[4] = {(1 - u) * (1 - v), u * (1 - v), (1 - u) * v, u * v};
+
+		for(int k = 0; k < 4; ++k)
+		{
+			top.at(i + (k & 1), j + (k >> 1)) += amount * shares[k];
+			heights.at(i + (k & 1), j + (k >> 1)) += amount * shares[k];
+		}
+	};
+
+	for(int d = 0; d < n; ++d)
+	{
+		if((d & 1023) == 0)
+		{
+			report_progress(d / double(n));
+		}
+
+		// the state of the droplet is kept in floats, the sediments in a double to keep the mass of the terrain
+		float x = dis_x(gen);
+		float y = dis_y(gen);
+		float dx = 0.f;
+		float dy = 0.f;
+		float speed = 1.f;
+		float water = 1.f;
+		double sediments = 0.;
+
+		for(int s = 0; s < parameters.max_steps; ++s)
+		{
+			++steps;
+			const int i = std::min(int(x), width - 2);
+			const int j = std::min(int(y), height - 2);
+			float gx, gy;
+			const double h = sample(heights, i, j, x - i, y - j, gx, gy);
+
+			// the direction follows the slope, weighted by the inertia
+			dx = dx * parameters.inertia - gx * (1 - parameters.inertia);
+			dy = dy * parameters.inertia - gy * (1 - parameters.inertia);
+			const float norm = std::sqrt(dx * dx + dy * dy);
+
+			if(norm == 0.f)
+			{
+				break;
+			}
+
+			dx /= norm;
+			dy /= norm;
+			const float nx = x + dx;
+			const float ny = y + dy;
+
+			// the droplet leaves the grid
+			if(nx < 0 || ny < 0 || nx >= width - 1 || ny >= height - 1)
+			{
+				break;
+			}
+
+			const int ni = std::min(int(nx), width - 2);
+			const int nj = std::min(int(ny), height - 2);
+			const double dh = sample(heights, ni, nj, nx - ni, ny - nj, gx, gy) - h;
+			const double capacity = std::max(-dh, parameters.min_slope) * speed * water * parameters.capacity;
+
+			if(sediments > capacity || dh > 0)
+			{
+				// going up, the droplet fills the pit it leaves at most
+				const double amount = (dh > 0) ? std::min(dh, sediments) : (sediments - capacity) * parameters.deposition;
+				sediments -= amount;
+				deposit(i, j, x - i, y - j, amount);
+			}
+			else
+			{
+				// never erode more than the height descended, which would dig a pit behind the droplet
+				const double amount = std::min((capacity - sediments) * parameters.erosion, -dh);
+				const bool border = brush.crosses_border(i, j, width, height);
+				double scale = 1.;
+
+				// near the borders the weights of the taps on the grid are scaled to sum to 1
+				if(border)
+				{
+					double sum = 0;
+
+					for(int k = 0; k < brush.tap_number(); ++k)
+					{
+						const int ti = i + brush.tap_i(k);
+						const int tj = j + brush.tap_j(k);
+						sum += (ti >= 0 && tj >= 0 && ti < width && tj < height) ? brush.weight(k) : 0.;
+					}
+
+					scale = 1. / sum;
+				}
+
+				// the layers of each cell are eroded from the highest one with a thickness down, then the bedrock
+				for(int k = 0; k < brush.tap_number(); ++k)
+				{
+					const int ti = i + brush.tap_i(k);
+					const int tj = j + brush.tap_j(k);
+
+					if(border && (ti < 0 || tj < 0 || ti >= width || tj >= height))
+					{
+						continue;
+					}
+
+					const double eroded = amount * brush.weight(k) * scale;
+					double left = eroded;
+
+					for(int l = storages.size() - 1; l > 0 && left > 0; --l)
+					{
+						// reading first, so that the empty tiles of the layers stay shared
+						const double thickness = storages[l]->get(ti, tj);
+
+						if(thickness > 0)
+						{
+							const double taken = std::min(thickness, left);
+							storages[l]->at(ti, tj) -= taken;
+							left -= taken;
+						}
+					}
+
+					bedrock.at(ti, tj) -= left;
+					heights.at(ti, tj) -= eroded;
+				}
+
+				sediments += amount;
+			}
+
+			speed = std::sqrt(std::max(0., speed * speed - dh * parameters.gravity));
+			water *= 1 - parameters.evaporation;
+			x = nx;
+			y = ny;
+		}
+
+		// the droplet deposits what it carries where it stops
+		const int i = std::min(int(x), width - 2);
+		const int j = std::min(int(y), height - 2);
+		deposit(i, j, x - i, y - j, sediments);
+	}
+
+	buffer.mark_synced();
+	PROFILE_COUNT("droplets.continuous_steps", steps);
+	return steps;
+}
+
+long erode_from_continuous_droplets(MultiLayerMap& layers, std::mt19937& gen, const int n, const DropletParameters& parameters)
+{
+	TerrainBuffer buffer(layers);
+	return erode_from_continuous_droplets(buffer, gen, n, parameters);
+}
@@ -0,0 +1,120 @@
+#include <Weather/Stratigraphy.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+Stratigraphy::Stratigraphy(const std::vector<double>& top_heights, const std::vector<double>& erodibilities)
+	: _tops(top_heights), _erodibilities(erodibilities), _slope(0, 0), _origin(0, 0), _amplitude(0), _wave(0, 0)
+{
+	if(_erodibilities.size() != _tops.size() + 1)
+	{
+		throw std::invalid_argument("the strata need one more erosion value than top heights");
+	}
+
+	if(!std::is_sorted(_tops.begin(), _tops.end()))
+	{
+		throw std::invalid_argument("the top heights of the strata must be increasing");
+	}
+}
+
+void Stratigraphy::set_tilt(const double slope_x, const double slope_y, const Eigen::Vector2d& origin)
+{
+	_slope = Eigen::Vector2d(slope_x, slope_y);
+	_origin = origin;
+}
+
+void Stratigraphy::set_fold(const double amplitude, const double wavelength, const double direction)
+{
+	if(amplitude != 0 && wavelength <= 0)
+	{
+		throw std::invalid_argument("the folds of the strata need a positive wavelength");
+	}
+
+	const double radians = M_PI * direction / 180.;
+	_amplitude = amplitude;
+	_wave = (amplitude != 0) ? Eigen::Vector2d(std::cos(radians), std::sin(radians)) * (2. * M_PI / wavelength) : Eigen::Vector2d(0, 0);
+}
+
+double Stratigraphy::offset(const double x, const double y) const
+{
+	const Eigen::Vector2d d(x - _origin(0), y - _origin(1));
+	double o = _slope.dot(d);
+
+	if(_amplitude != 0)
+	{
+		o += _amplitude * std::sin(_wave.dot(d));
+	}
+
+	return o;
+}
+
+int Stratigraphy::material(const double x, const double y, const double z) const
+{
+	return std::lower_bound(_tops.begin(), _tops.end(), z - offset(x, y)) - _tops.begin();
+}
+
+int Stratigraphy::search(const double z, const int guess) const
+{
+	// neighboring cells are usually in the same stratum
+	const int n = _tops.size();
+
+	if((guess == 0 || _tops[guess - 1] < z) && (guess == n || z <= _tops[guess]))
+	{
+		return guess;
+	}
+
+	return std::lower_bound(_tops.begin(), _tops.end(), z) - _tops.begin();
+}
+
+void Stratigraphy::materials_row(const DoubleField& heights, const int j, int* materials) const
+{
+	const int width = heights.grid_width();
+	const Eigen::Vector2d start = heights.world_position(0, j) - _origin;
+	const double step = heights.cell_size()(0);
+
+	// the tilt and the phase of the folds grow linearly along the row
+	const double tilt = _slope.dot(start);
+	const double phase = _wave.dot(start);
+	int guess = 0;
+
+	for(int i = 0; i < width; ++i)
+	{
+		double o = tilt + _slope(0) * step * i;
+
+		if(_amplitude != 0)
+		{
+			o += _amplitude * std::sin(phase + _wave(0) * step * i);
+		}
+
+		guess = search(heights.value(i, j) - o, guess);
+		materials[i] = guess;
+	}
+}
+
+void Stratigraphy::fill_stack(MaterialColumns& columns, const int stack, const DoubleField& heights, const double base) const
+{
+	for(int j = 0; j < heights.grid_height(); ++j)
+	{
+		for(int i = 0; i < heights.grid_width(); ++i)
+		{
+			const Eigen::Vector2d p = heights.world_position(i, j);
+			const double o = offset(p(0), p(1));
+			const double top = heights.value(i, j);
+			columns.remove(i, j, stack, columns.thickness(i, j, stack));
+
+			// the runs end at the tops of the strata crossed by the column
+			double z = base;
+			int m = material(p(0), p(1), base);
+
+			while(m < _tops.size() && _tops[m] + o < top)
+			{
+				columns.deposit(i, j, stack, m, _tops[m] + o - z);
+				z = _tops[m] + o;
+				++m;
+			}
+
+			columns.deposit(i, j, stack, m, top - z);
+		}
+	}
+}
@@ -0,0 +1,17 @@
+#include <Weather/TerrainBuffer.hpp>
+#include <Profiler.hpp>
+
+SimpleLayerMap& TerrainBuffer::terrain()
+{
+	const unsigned long version = _layers.version();
+
+	if(!_terrain || version != _version)
+	{
+		PROFILE_COUNT("terrain_buffer.sums", 1);
+		_terrain.reset(new SimpleLayerMap(_layers.generate_field()));
+		_version = version;
+		++_sums;
+	}
+
+	return *_terrain;
+}
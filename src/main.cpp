@@ -1,276 +1,164 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <random>
+#include <mutex>
+#include <sstream>
 #include <string>
-#include <MultiLayerMap.hpp>
-#include <SimpleLayerMap.hpp>
-#include <Noise/TerrainNoise.hpp>
-#include <Weather/Erosion.hpp>
-#include <Weather/Hydro.hpp>
-#include <Weather/Biome.hpp>
-#include <Vegetation/Vegetation.hpp>
+#include <thread>
+#include <vector>
 
-void test_thermal_erosion_transport_stair(unsigned int iterations = 101, unsigned int save_period = 10){
-	const int size = 10;
-
-	// setup a test MultiLayerMap with a stair terrain
-	MultiLayerMap mlm(size, size);
-	SimpleLayerMap& height = mlm.new_layer();
-
-	//height = stair_layer(size, size, 1.);
-	height = double_stair_layer(size, size, 1.);
-
-	mlm.get_field(0).export_as_obj("InitialTerrain.obj");
+#include <BatchScheduler.hpp>
+#include <Pipeline.hpp>
+#include <Profiler.hpp>
+#include <ThreadPool.hpp>
 
+void print_usage()
+{
+	std::cout << "Usage: genTerrain [-j jobs] [-t threads] [--profile trace.json] [--check] pipeline_file..." << std::endl;
+	std::cout << "  -j jobs    number of pipelines run at the same time (default 1)," << std::endl;
+	std::cout << "             pipelines run together should use different output prefixes" << std::endl;
+	std::cout << "  -t threads number of threads shared by all the pipelines (default all the cores)" << std::endl;
+	std::cout << "  --profile  write a Chrome trace of the run (chrome://tracing, Perfetto) and print a summary" << std::endl;
+	std::cout << "  --check    only read the pipeline files and report their errors" << std::endl;
+	std::cout << "A pipeline with a [sweep] section is run as a batch sharing the threads, after the other pipelines" << std::endl;
+}
 
-	for(int istep = 0; istep != iterations; ++istep){
-		std::string folder_name = "ErosionTransport" + std::to_string(istep);
-		std::string sys_cmd = "mkdir " + folder_name;
-		if(istep % save_period == 0){
-			system(sys_cmd.c_str());
+int main(int argc, char** argv)
+{
+	int jobs = 1;
+	bool check = false;
+	std::string trace;
+	std::vector<std::string> filenames;
+
+	for(int a = 1; a < argc; ++a)
+	{
+		if(std::strcmp(argv[a], "-j") == 0 && a + 1 < argc)
+		{
+			jobs = std::max(std::atoi(argv[++a]), 1);
 		}
-
-		std::cout << "===== STARTING ITERATION " << istep << " =====" << std::endl;
-		// testing erosion without transport
-		erode_constant(mlm, 0.1);
-		//erode_using_median_slope(mlm, 0.1);
-		//erode_using_mean_slope(mlm, 0.1);
-		//erode_using_median_double_slope(mlm, 0.1);
-		//erode_using_mean_double_slope(mlm, 0.1);
-
-		if(istep % save_period == 0){
-			mlm.get_field(0).export_as_obj("./" + folder_name + "/ThermalErosionTerrainBedrock.obj");
-			mlm.get_field(1).export_as_obj("./" + folder_name + "/ThermalErosionTerrainSediments.obj");
-			mlm.generate_field().export_as_obj("./" + folder_name + "/ThermalErosionTerrain.obj");
+		else if(std::strcmp(argv[a], "-t") == 0 && a + 1 < argc)
+		{
+			ThreadPool::instance().set_thread_number(std::max(std::atoi(argv[++a]), 1));
 		}
-
-		// transport on the previously eroded terrain
-		transport(mlm, 25.);
-		//transport_4connex(mlm, 25.);
-		if(istep % save_period == 0){
-			mlm.get_field(0).export_as_obj("./" + folder_name + "/ThermalTransportTerrainBedrock.obj");
-			mlm.get_field(1).export_as_obj("./" + folder_name + "/ThermalTransportTerrainSediments.obj");
-			mlm.generate_field().export_as_obj("./" + folder_name + "/ThermalTransportTerrain.obj");
+		else if(std::strcmp(argv[a], "--profile") == 0 && a + 1 < argc)
+		{
+			trace = argv[++a];
+			Profiler::enable();
+		}
+		else if(std::strcmp(argv[a], "--check") == 0)
+		{
+			check = true;
+		}
+		else if(argv[a][0] == '-')
+		{
+			print_usage();
+			return 1;
+		}
+		else
+		{
+			filenames.push_back(argv[a]);
 		}
-
-
-		MultiLayerMap normalized_mlm = normalized(mlm);
-		normalized_mlm.generate_field().export_as_obj("normalized.obj");
 	}
-}
-
-int main()
-{
-	MultiLayerMap mlm(100, 100);
-	std::ifstream input("./Save.mlm", std::ifstream::in);
-	input >> mlm;
-	input.close();
-
-	std::random_device rd;
-	std::mt19937 gen(rd());
-	int filter_size = 3;
-	SimpleLayerMap filter(filter_size, filter_size);
-	//filter.set_all(1.0/(double) (filter_size * filter_size));
-	filter.set_all(0.05);
-	filter.at(1, 1) = 0.6;
-	erode_from_droplets(mlm, gen, filter, 100000, 0.01, 0.01, 0.2);
-	mlm.export_as_obj("test_erode_drop.obj");
-	save_colorized(mlm);
-	simulate(mlm);
-	//test_thermal_erosion_transport_stair();
-
-	// std::random_device rd;
-	// std::mt19937 gen(rd());
-
-	// int size = 500;
-	// MultiLayerMap mlm(size, size, { -5, -5}, {5, 5});
-	// SimpleLayerMap &sf = mlm.new_layer();
-	// TerrainNoise t_noise(2.2, 0.004, 8);
-
-	// for(int j = 0; j < size; ++j)
-	// {
-	// 	for(int i = 0; i < size; i++)
-	// 	{
-	// 		sf.at(i, j) = t_noise.get_noise3(i, j);
-	// 	}
-	// }
 
-	// sf.export_as_obj("InitialTerrain.obj");
-	// sf.export_as_pgm("InitialTerrain.pgm", true);
-	// //SimpleLayerMap::generate_slope_map(sf).export_as_pgm("Slope.pgm", true);
-
-	// /*
-	// // determining layering
-	// std::vector<double> material_layers_top = {0.09, 0.15,
-	// 					0.29, 0.31,
-	// 					0.63, 0.71,
-	// 					0.79, 0.83};
-	// std::vector<double> material_resistances = {0.01, 0.00001,
-	// 					0.01, 0.00002,
-	// 					0.01, 0.00001,
-	// 					0.01, 0.00003,
-	// 					0.01};
-	// // --- ///
-	// std::vector<double> material_layers_top = {0.09, 0.11,
-	// 					0.19, 0.21,
-	// 					0.29, 0.31,
-	// 					0.39, 0.41,
-	// 					0.49, 0.51,
-	// 					0.59, 0.61,
-	// 					0.69, 0.71,
-	// 					0.79, 0.81,
-	// 					0.89, 0.91};
-	// std::vector<double> material_resistances = {0.01, 0.00001,
-	// 					0.01, 0.00001,
-	// 					0.01, 0.00001,
-	// 					0.01, 0.00001,
-	// 					0.01};
-	// std::vector<double> material_resistances = {0.01, 0.00001,
-	// 					0.01, 0.00001,
-	// 					0.01, 0.00001,
-	// 					0.01, 0.00001,
-	// 					0.01, 0.00001,
-	// 					0.01, 0.00001,
-	// 					0.01};
-	// */
-
-	// std::vector<double> material_layers_top;
-	// /*{0.09, 0.11,
-	// 					0.29, 0.31,
-	// 					0.39, 0.41,
-	// 					0.79, 0.81,
-	// 					0.84, 0.86};*/
-	// std::vector<double> material_resistances;
-	// /* = {0.01, 0.00001,
-	// 					0.01, 0.00001,
-	// 					0.01, 0.00001,
-	// 					0.01, 0.00001,
-	// 					0.01, 0.00001,
-	// 					0.01};*/
-	// int nb_layers = 100;
-	// double delta = 7.0/nb_layers;
-	// double current = -0.5;
-	// std::uniform_real_distribution<> layer_disp(0.0, delta);
-	// std::uniform_real_distribution<> layer_solid(0.0, 1.0);
-	// for(int i = 0; i < nb_layers; ++i)
-	// {
-	// 	material_layers_top.push_back(current += layer_disp(gen));
-	// 	if(i%2 == 0){
-	// 		material_resistances.push_back(0.005 + 0.01*layer_solid(gen));
-	// 	}else{
-	// 		material_resistances.push_back(0.00001 + 0.001*layer_solid(gen));
-	// 	}
-	// }
-	// material_resistances.push_back(0.005 + 0.01*layer_solid(gen));
-
-	// // rescaling layers to the whole height range
-	// const double bottom_height = sf.get_min();
-	// const double height_range = sf.get_max() - bottom_height;
-	// for(int ilayer = 0; ilayer != material_layers_top.size(); ++ilayer){
-	// 	material_layers_top[ilayer] = bottom_height + material_layers_top[ilayer] * height_range;
-	// }
-
-	// const int erosion_transport_iterations = 101;
-	// const int save_period = 5;
-	// for(int istep = 0; istep != erosion_transport_iterations; ++istep){
-	// 	std::cout << "iteration " << istep + 1 << "..." << std::endl;
-	// 	std::string folder_name = "ErosionTransport" + std::to_string(istep);
-	// 	std::string sys_cmd = "mkdir " + folder_name;
-	// 	if(istep % save_period == 0){
-	// 		system(sys_cmd.c_str());
-	// 	}
-
-	// 	// Thermal erosion
-	// 	//erode_constant(mlm, 0.01);
-	// 	//erode_using_mean_double_slope(mlm, 0.01);
-	// 	//erode_using_exposure(mlm, 0.01);
-	// 	erode_layered_materials_using_exposure(mlm, material_layers_top, material_resistances, 10);
-	// 	if(istep % save_period == 0){
-	// 		mlm.get_field(0).export_as_obj("./" + folder_name + "/ThermalErosionTerrainBedrock.obj");
-	// 		mlm.get_field(1).export_as_obj("./" + folder_name + "/ThermalErosionTerrainSediments.obj");
-	// 		mlm.generate_field().export_as_obj("./" + folder_name + "/ThermalErosionTerrain.obj");
-	// 	}
-
-	// 	// Thermal transport
-	// 	transport(mlm, 20);
-	// 	//transport_4connex(mlm, 30);
-	// 	if(istep % save_period == 0){
-	// 		mlm.get_field(0).export_as_obj("./" + folder_name + "/ThermalTransportTerrainBedrock.obj");
-	// 		mlm.get_field(1).export_as_obj("./" + folder_name + "/ThermalTransportTerrainSediments.obj");
-	// 		mlm.generate_field().export_as_obj("./" + folder_name + "/ThermalTransportTerrain.obj");
-	// 		save_colorized(mlm);
-	// 		std::ofstream output("./" + folder_name + "/Save.mlm");
-	// 		output << mlm;
-	// 		output.close();
-	// 	}
-
-	// 	// Water drop erosion
-	// 	/*
-	// 	water_drop_transport(mlm, gen, 1000, 0.01, 0.1);
-	// 	if(istep % save_period == 0){
-	// 		mlm.get_field(0).export_as_obj("./" + folder_name + "WaterDropTerrainBedrock.obj");
-	// 		mlm.get_field(1).export_as_obj("./" + folder_name + "WaterDropTerrainSediments.obj");
-	// 		mlm.generate_field().export_as_obj("./" + folder_name + "WaterDropTerrain.obj");
-	// 	}
-	// 	*/
+	if(filenames.empty())
+	{
+		print_usage();
+		return 1;
+	}
 
-	// 	std::cout << "done" << std::endl;
-	// }
+	// every file is read before running anything
+	std::vector<Pipeline> pipelines;
+	std::vector<BatchScheduler> batches;
+
+	for(const std::string& filename : filenames)
+	{
+		try
+		{
+			Pipeline pipeline = Pipeline::load(filename);
+
+			if(pipeline.sweep().keys().empty())
+			{
+				pipelines.push_back(pipeline);
+			}
+			else
+			{
+				batches.push_back(BatchScheduler(pipeline, ThreadPool::instance().thread_number()));
+			}
+		}
+		catch(const std::exception& e)
+		{
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+	}
 
-/*
-	// Hydraulic erosion, area visualization
-	mlm.new_layer();
+	if(check)
+	{
+		std::cout << pipelines.size() << " pipeline(s) and " << batches.size() << " batch(es) OK" << std::endl;
+		return 0;
+	}
 
-	SimpleLayerMap area_distributed = get_area(mlm.generate_field());
-	SimpleLayerMap area_steepest 		= get_area(mlm.generate_field(), false);
-	area_distributed.normalize();
-	area_steepest.normalize();
-	area_distributed.export_as_pgm("DistributedHydraulicArea.pgm", true);
-	area_steepest.export_as_pgm("OneWayHydraulicArea.pgm", true);
+	std::atomic<int> next(0);
+	std::atomic<int> failures(0);
+	std::mutex output_mutex;
+
+	auto worker = [&]()
+	{
+		for(int p = next++; p < pipelines.size(); p = next++)
+		{
+			// the logs of concurrent pipelines are printed when they end so that they are not mixed
+			std::ostringstream buffer;
+			std::ostream& log = (jobs == 1) ? std::cout : buffer;
+
+			try
+			{
+				pipelines[p].run(log);
+			}
+			catch(const std::exception& e)
+			{
+				log << pipelines[p].name() << ": " << e.what() << std::endl;
+				++failures;
+			}
+
+			std::lock_guard<std::mutex> lock(output_mutex);
+			std::cout << buffer.str() << std::flush;
+		}
+	};
 
-	int filter_size = 3;
-	SimpleLayerMap filter(filter_size, filter_size);
-	filter.set_all(1.0/(double) (filter_size * filter_size));
+	std::vector<std::thread> threads;
 
-	std::vector<std::pair<double, Eigen::Vector2i>> convoluted_values = area_steepest.full_convolution(filter);
-	area_steepest.import_list(convoluted_values);
-	area_steepest.export_as_pgm("OneWayConvolutedHydraulicArea.pgm", true);
+	for(int t = 1; t < std::min(jobs, static_cast<int>(pipelines.size())); ++t)
+	{
+		threads.push_back(std::thread(worker));
+	}
 
-	convoluted_values = area_distributed.full_convolution(filter);
-	area_distributed.import_list(convoluted_values);
-	area_distributed.export_as_pgm("DistributedConvolutedHydraulicArea.pgm", true);
+	worker();
 
-	// Hydraulic erosion, terrain visualization
-	MultiLayerMap mlmBis(mlm);
-	MultiLayerMap mlmTer(mlm);
-	MultiLayerMap mlmQua(mlm);
-	MultiLayerMap mlmQui(mlm);
-/*
-	// distributed erode
-	erode_from_area(mlm, area_distributed, 0.2);
-	mlm.generate_field().export_as_pgm("TerrainDistributedHydroErode.pgm", true);
-	mlm.generate_field().export_as_obj("TerrainDistributedHydroErode.obj");
+	for(std::thread& t : threads)
+	{
+		t.join();
+	}
 
-	// distributed erode and transport
-	erode_from_area(mlmBis, area_distributed, 0.2, true, 0.05);
-	mlmBis.generate_field().export_as_pgm("TerrainDistributedHydroErodeAndTransport.pgm", true);
-	mlmBis.generate_field().export_as_obj("TerrainDistributedHydroErodeAndTransport.obj");
+	for(const BatchScheduler& batch : batches)
+	{
+		try
+		{
+			failures += batch.run(std::cout);
+		}
+		catch(const std::exception& e)
+		{
+			std::cerr << e.what() << std::endl;
+			++failures;
+		}
+	}
 
-	// one way erode
-	erode_from_area(mlmTer, area_steepest, 0.2);
-	mlmTer.generate_field().export_as_pgm("TerrainOneWayHydroErode.pgm", true);
-	mlmTer.generate_field().export_as_obj("TerrainOneWayHydroErode.obj");
+	if(!trace.empty())
+	{
+		Profiler::write_trace(trace);
+		Profiler::write_summary(std::cout);
+	}
 
-	// one way erode and transport
-	erode_from_area(mlmQua, area_steepest, 0.2, true, 0.05);
-	mlmQua.generate_field().export_as_pgm("TerrainOneWayHydroErodeAndTransport.pgm", true);
-	mlmQua.generate_field().export_as_obj("TerrainOneWayHydroErodeAndTransport.obj");
-	// water drop
-	filter.set_all(0.05);
-	filter.at(1, 1) = 0.6;
-	erode_from_droplets(mlmQui, gen, filter, 100000, 0.01, 0.01, 0.1);
-	mlmQui.generate_field().export_as_pgm("TerrainWaterDropHydroErodeAndTransport.pgm", true);
-	mlmQui.generate_field().export_as_obj("TerrainWaterDropHydroErodeAndTransport.obj");
-*/
-	return 0;
+	return failures == 0 ? 0 : 1;
 }
-
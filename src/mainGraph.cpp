@@ -5,6 +5,11 @@
 #include <Weather/Biome.hpp>
 #include <Weather/Hydro.hpp>
 #include <Vegetation/Vegetation.hpp>
+#include <Mesh/LodMesh.hpp>
+#include <ThreadPool.hpp>
+#include <BackgroundJob.hpp>
+#include <TerrainPreview.hpp>
+#include <TerrainHistory.hpp>
 
 #include <ImGui/imgui.h>
 #include <GL/glew.h>
@@ -14,6 +19,20 @@
 #include <ImGui/imgui_impl_glfw.h>
 #include <ImGui/imgui_impl_opengl3.h>
 
+#include <cstdlib>
+#include <unistd.h>
+
+/**
+ * @brief Get the directory the history of the interface is written to, of its own in the temporary directory of the system
+ *
+ */
+std::string history_directory()
+{
+	const char* temporary = std::getenv("TMPDIR");
+	const std::string parent = (temporary && *temporary) ? temporary : "/tmp";
+	return parent + "/genTerrain_history_" + std::to_string(getpid()) + "/";
+}
+
 //SET UP RELATED FUNCITONS
 static void glfw_error_callback(int error, const char* description)
 {
@@ -80,11 +99,12 @@ struct Parameters
 	double wavelength = 2;
 	double height = 0.5;
 	bool direct = true;
+	int threads = ThreadPool::instance().thread_number();
 	Eigen::Vector2d posMin;//(-25, -25);
 	Eigen::Vector2d posMax;//(25, 25);
 };
 
-void prepare_generation(MultiLayerMap& mlm, Parameters& params)
+void prepare_generation(Parameters& params)
 {
 	if(params.direct)
 	{
@@ -99,8 +119,36 @@ void prepare_generation(MultiLayerMap& mlm, Parameters& params)
 	params.t_noise._base_noise.SetSeed(params.seed1);
 	params.t_noise._ridge_noise.SetSeed(params.seed2);
 	params.t_noise._biome_noise.SetSeed(params.seed1);
-	mlm = MultiLayerMap(params.cell_width_number, params.cell_height_number, params.posMin, params.posMax);
-	mlm.new_layer();
+}
+
+MultiLayerMap generate_terrain(const Parameters& params, const int noise)
+{
+	MultiLayerMap mlm(params.cell_width_number, params.cell_height_number, params.posMin, params.posMax);
+	SimpleLayerMap& bedrock = mlm.new_layer();
+	TerrainNoise t_noise = params.t_noise;
+
+	for(int j = 0; j < params.cell_height_number; ++j)
+	{
+		report_progress(j / double(params.cell_height_number));
+
+		for(int i = 0; i < params.cell_width_number; i++)
+		{
+			bedrock.at(i, j) = noise == 3 ? t_noise.get_noise3(i, j) : (noise == 2 ? t_noise.get_noise2(i, j) : t_noise.get_noise(i, j));
+		}
+	}
+
+	return mlm;
+}
+
+void start_generation(BackgroundJob& job, const MultiLayerMap& mlm, Parameters& params, const int noise)
+{
+	prepare_generation(params);
+	// the job keeps its own parameters, the interface can change them while it runs
+	const Parameters p = params;
+	job.start("Generate " + std::to_string(noise), mlm, [p, noise](MultiLayerMap& m)
+	{
+		m = generate_terrain(p, noise);
+	});
 }
 
 
@@ -114,6 +162,20 @@ void export_tab(const SimpleLayerMap& sf, const std::string& name)
 			sf.export_as_obj(name + ".obj");
 		}
 
+		if(ImGui::Button("Export as ply"))
+		{
+			sf.export_as_ply(name + ".ply");
+		}
+
+		static double lod_tolerance = 0.05;
+		ImGui::InputDouble("LOD tolerance", &lod_tolerance);
+
+		if(ImGui::Button("Export LOD as ply"))
+		{
+			PlyWriter writer(name + "_lod_" + ".ply");
+			generate_lod_mesh(sf, lod_tolerance).write(writer);
+		}
+
 		if(ImGui::Button("Export as pgm"))
 		{
 			sf.export_as_pgm(name + ".pgm");
@@ -141,10 +203,42 @@ void export_tab(const SimpleLayerMap& sf, const std::string& name)
 	}
 }
 
-void multi_layer_map_window(MultiLayerMap& mlm, Parameters& params)
+void job_status(BackgroundJob& job)
+{
+	if(job.is_running())
+	{
+		ImGui::Text("%s", job.name().c_str());
+		ImGui::ProgressBar(job.progress(), ImVec2(200, 0));
+		ImGui::SameLine();
+
+		if(ImGui::Button("Cancel"))
+		{
+			job.cancel();
+		}
+	}
+	else if(job.status() == BackgroundJob::Status::failed)
+	{
+		ImGui::Text("%s failed: %s", job.name().c_str(), job.error().c_str());
+	}
+}
+
+void multi_layer_map_window(MultiLayerMap& mlm, const BiomeInfo& biome, Parameters& params, BackgroundJob& job, TerrainHistory& history)
 {
 	ImGui::Begin("Terrain");                         // Create a window called "Hello, world!" and append into it.
 	ImGui::PushItemWidth(100);
+
+	// the result of the operation replaces the terrain between two frames, the operations run on a copy
+	if(job.is_pending())
+	{
+		const MultiLayerMap previous(mlm);
+
+		if(job.finish(mlm) && job.status() == BackgroundJob::Status::finished)
+		{
+			history.record(job.name(), previous, mlm);
+		}
+	}
+
+	job_status(job);
 	ImGui::InputText("export name", params.saveName, IM_ARRAYSIZE(params.saveName));
 
 	if(ImGui::CollapsingHeader("Presets"))
@@ -223,23 +317,25 @@ void multi_layer_map_window(MultiLayerMap& mlm, Parameters& params)
 			params.t_noise._octaves = 8;
 			params.seed1 = 0;
 			params.seed2 = 4;
-			std::cout << "generation" << std::endl;
-			//SimpleLayerMap sf(sizeWidth, sizeHeight, posMin, posMax);
-			prepare_generation(mlm, params);
-
-			for(int j = 0; j < params.cell_height_number; ++j)
+			prepare_generation(params);
+			const Parameters p = params;
+			job.start("Quick Test with veget", mlm, [p](MultiLayerMap& m)
 			{
-				for(int i = 0; i < params.cell_width_number; i++)
 				{
-					mlm.get_field(0).at(i, j) = params.t_noise.get_noise(i, j);
+					ProgressScope step(0, 0.2);
+					m = generate_terrain(p, 1);
 				}
-			}
-
-			// std::cout << "erotion" << std::endl;
-			erode_using_exposure(mlm, 0.1);
-			transport(mlm, 20);
-			std::cout << "vegetation" << std::endl;
-			simulate(mlm);
+				{
+					ProgressScope step(0.2, 0.4);
+					erode_using_exposure(m, 0.1);
+				}
+				{
+					ProgressScope step(0.4, 0.6);
+					transport(m, 20);
+				}
+				ProgressScope step(0.6, 1);
+				simulate(m);
+			});
 		}
 	}
 
@@ -285,68 +381,75 @@ void multi_layer_map_window(MultiLayerMap& mlm, Parameters& params)
 
 		if(ImGui::Button("Generate 1"))                             // Buttons return true when clicked (most widgets return true when edited/activated)
 		{
-			prepare_generation(mlm, params);
-
-			for(int j = 0; j < params.cell_height_number; ++j)
-			{
-				for(int i = 0; i < params.cell_width_number; i++)
-				{
-					mlm.get_field(0).at(i, j) = params.t_noise.get_noise(i, j);
-				}
-			}
+			start_generation(job, mlm, params, 1);
 		}
 
 		if(ImGui::Button("Generate 2"))                             // Buttons return true when clicked (most widgets return true when edited/activated)
 		{
-			prepare_generation(mlm, params);
-
-			for(int j = 0; j < params.cell_height_number; ++j)
-			{
-				for(int i = 0; i < params.cell_width_number; i++)
-				{
-					mlm.get_field(0).at(i, j) = params.t_noise.get_noise2(i, j);
-				}
-			}
+			start_generation(job, mlm, params, 2);
 		}
 
 		if(ImGui::Button("Generate 3"))                             // Buttons return true when clicked (most widgets return true when edited/activated)
 		{
-			prepare_generation(mlm, params);
-
-			for(int j = 0; j < params.cell_height_number; ++j)
-			{
-				for(int i = 0; i < params.cell_width_number; i++)
-				{
-					mlm.get_field(0).at(i, j) = params.t_noise.get_noise3(i, j);
-				}
-			}
+			start_generation(job, mlm, params, 3);
 		}
 	}
 
 	if(ImGui::CollapsingHeader("Operations"))
 	{
+		// the pool is restarted with the new number of threads, which must not happen while an operation uses it
+		if(job.is_running())
+		{
+			ImGui::Text("Threads: %d", params.threads);
+		}
+		else if(ImGui::InputInt("Threads", &params.threads))
+		{
+			params.threads = std::max(params.threads, 1);
+			ThreadPool::instance().set_thread_number(params.threads);
+		}
+
 		if(ImGui::TreeNode("Erosion"))
 		{
 			static double erosion_factor = 0.1;
 			static int iterations = 1;
 			static double rest_angle = 45;
+			static double convergence = 0;
 			ImGui::InputDouble("Erosion Factor", &erosion_factor);
 			ImGui::InputInt("Iterations", &iterations);
+			ImGui::InputDouble("Convergence", &convergence);
 			ImGui::InputDouble("Rest angle", &rest_angle);
 
+			// the iterations stop early when one moves less than the convergence fraction of the mass moved by the first
+			ConvergenceCriteria criteria;
+			criteria.max_iterations = std::max(iterations, 1);
+			criteria.relative_mass = convergence;
+
 			if(ImGui::Button("Erode median slope"))                             // Buttons return true when clicked (most widgets return true when edited/activated)
 			{
-				erode_using_median_slope(mlm, erosion_factor);
+				const double erosion_factor_value = erosion_factor;
+				job.start("Erode median slope", mlm, [erosion_factor_value, criteria](MultiLayerMap& m)
+				{
+					erode_until_converged(m, [erosion_factor_value](MultiLayerMap& l) { erode_using_median_slope(l, erosion_factor_value); }, criteria);
+				});
 			}
 
 			if(ImGui::Button("Erode exposure"))                             // Buttons return true when clicked (most widgets return true when edited/activated)
 			{
-				erode_using_exposure(mlm, erosion_factor);
+				const double erosion_factor_value = erosion_factor;
+				job.start("Erode exposure", mlm, [erosion_factor_value, criteria](MultiLayerMap& m)
+				{
+					TerrainBuffer buffer(m);
+					erode_until_converged(buffer, [erosion_factor_value](TerrainBuffer& b) { erode_using_exposure(b, erosion_factor_value); }, criteria);
+				});
 			}
 
 			if(ImGui::Button("transport"))
 			{
-				transport(mlm, rest_angle);
+				const double rest_angle_value = rest_angle;
+				job.start("Transport", mlm, [rest_angle_value](MultiLayerMap& m)
+				{
+					transport(m, rest_angle_value);
+				});
 			}
 
 			ImGui::TreePop();
@@ -356,12 +459,18 @@ void multi_layer_map_window(MultiLayerMap& mlm, Parameters& params)
 		{
 			if(ImGui::Button("Export density as ppm"))
 			{
-				generate_distribution(mlm);
+				job.start("Export density", mlm, [](MultiLayerMap& m)
+				{
+					generate_distribution(BiomeInfo(m));
+				}, false);
 			}
 
 			if(ImGui::Button("Simulate"))                             // Buttons return true when clicked (most widgets return true when edited/activated)
 			{
-				simulate(mlm);
+				job.start("Simulate", mlm, [](MultiLayerMap& m)
+				{
+					simulate(BiomeInfo(m));
+				}, false);
 			}
 
 			ImGui::TreePop();
@@ -369,11 +478,14 @@ void multi_layer_map_window(MultiLayerMap& mlm, Parameters& params)
 
 		if(ImGui::Button("Texturize"))
 		{
-			save_colorized(mlm);
+			job.start("Texturize", mlm, [](MultiLayerMap& m)
+			{
+				save_colorized(BiomeInfo(m));
+			}, false);
 		}
 	}
 
-	export_tab(mlm.generate_field(), std::string(params.saveName));
+	export_tab(biome.terrain(), std::string(params.saveName));
 
 	if(ImGui::Button("Save"))                             // Buttons return true when clicked (most widgets return true when edited/activated)
 	{
@@ -382,11 +494,86 @@ void multi_layer_map_window(MultiLayerMap& mlm, Parameters& params)
 		output << mlm;
 	}
 
-	if(ImGui::Button("Import"))                             // Buttons return true when clicked (most widgets return true when edited/activated)
+	// a running operation would replace the imported terrain
+	if(!job.is_running() && ImGui::Button("Import"))                             // Buttons return true when clicked (most widgets return true when edited/activated)
 	{
 		std::string filename = std::string(params.saveName) + ".mlm";
 		std::ifstream input(filename, std::ifstream::in);
+		const MultiLayerMap previous(mlm);
 		input >> mlm;
+		history.record("Import", previous, mlm);
+	}
+
+	// a running operation would also replace the restored terrain
+	if(!job.is_running() && history.can_undo() && ImGui::Button(("Undo " + history.undo_name()).c_str()))
+	{
+		history.undo(mlm);
+	}
+
+	if(!job.is_running() && history.can_redo() && ImGui::Button(("Redo " + history.redo_name()).c_str()))
+	{
+		history.redo(mlm);
+	}
+
+	ImGui::End();
+}
+
+void preview_window(const BiomeInfo& biome)
+{
+	static TerrainPreview preview;
+	static int mode = 0;
+	static GLuint texture = 0;
+	static int texture_width = 0;
+	static int texture_height = 0;
+	ImGui::Begin("Preview");
+	ImGui::RadioButton("Height", &mode, 0);
+	ImGui::SameLine();
+	ImGui::RadioButton("Slope", &mode, 1);
+	ImGui::SameLine();
+	ImGui::RadioButton("Exposure", &mode, 2);
+
+	// only the tiles rendered again are uploaded to the texture
+	if(preview.update(biome, TerrainPreview::Mode(mode)) > 0)
+	{
+		if(texture == 0)
+		{
+			glGenTextures(1, &texture);
+			glBindTexture(GL_TEXTURE_2D, texture);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		}
+
+		glBindTexture(GL_TEXTURE_2D, texture);
+
+		if(texture_width != preview.width() || texture_height != preview.height())
+		{
+			texture_width = preview.width();
+			texture_height = preview.height();
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, texture_width, texture_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		}
+
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, preview.width());
+
+		for(const TerrainPreview::Tile& t : preview.dirty_tiles())
+		{
+			glPixelStorei(GL_UNPACK_SKIP_PIXELS, t.x);
+			glPixelStorei(GL_UNPACK_SKIP_ROWS, t.y);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, t.x, t.y, t.width, t.height, GL_RGBA, GL_UNSIGNED_BYTE, preview.pixels());
+		}
+
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+		glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+		glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	}
+
+	ImGui::Text("%g to %g", preview.min(), preview.max());
+
+	if(texture != 0)
+	{
+		const float width = std::max(ImGui::GetContentRegionAvailWidth(), 64.f);
+		ImGui::Image((ImTextureID)(intptr_t)texture, ImVec2(width, width * texture_height / texture_width));
 	}
 
 	ImGui::End();
@@ -396,6 +583,10 @@ int main()
 {
 	Parameters params;
 	MultiLayerMap mlm(500, 500);
+	BiomeInfo biome(mlm);
+	BackgroundJob job;
+	const std::string history_files = history_directory();
+	TerrainHistory history(256L << 20, history_files);
 	GLFWwindow* window = set_up_window();
 	set_up_imgui(window);
 	ImGuiIO& io = ImGui::GetIO();
@@ -410,7 +601,8 @@ int main()
 		ImGui_ImplOpenGL3_NewFrame();
 		ImGui_ImplGlfw_NewFrame();
 		ImGui::NewFrame();
-		multi_layer_map_window(mlm, params);
+		multi_layer_map_window(mlm, biome, params, job, history);
+		preview_window(biome);
 		ImGui::Begin("Layers");
 
 		for(int l = 0; l < mlm.get_layer_number(); ++l)
@@ -437,6 +629,8 @@ int main()
 	}
 
 // Cleanup
+	history.clear();
+	rmdir(history_files.c_str());
 	ImGui_ImplOpenGL3_Shutdown();
 	ImGui_ImplGlfw_Shutdown();
 	ImGui::DestroyContext();
@@ -0,0 +1,177 @@
+#include "catch.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+#include <BackgroundJob.hpp>
+#include <MultiLayerMap.hpp>
+#include <ThreadPool.hpp>
+
+namespace
+{
+/**
+ * @brief Wait for the end of the operation of a job
+ *
+ */
+void wait(const BackgroundJob& job)
+{
+	while(job.is_running())
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+}
+
+TEST_CASE("Test progress", "[BackgroundJob]")
+{
+	Progress progress;
+
+	SECTION("Steps report on their part of the range")
+	{
+		ProgressScope scope(progress);
+		report_progress(0.5);
+		REQUIRE(progress.fraction() == Approx(0.5));
+		{
+			ProgressScope step(0.5, 1);
+			report_progress(0.5);
+			REQUIRE(progress.fraction() == Approx(0.75));
+			{
+				ProgressScope substep(0, 0.5);
+				report_progress(1);
+				REQUIRE(progress.fraction() == Approx(0.75));
+			}
+			report_progress(1);
+			REQUIRE(progress.fraction() == Approx(1));
+		}
+		report_progress(0.25);
+		REQUIRE(progress.fraction() == Approx(0.25));
+	}
+	SECTION("Reports are ignored without a progress")
+	{
+		report_progress(0.5);
+		REQUIRE(progress.fraction() == 0);
+	}
+	SECTION("A cancelled progress stops the operation")
+	{
+		ProgressScope scope(progress);
+		progress.cancel();
+		REQUIRE_THROWS_AS(report_progress(0.5), JobCancelled);
+	}
+	SECTION("The tasks of parallel loops report to the progress of the thread starting them")
+	{
+		ThreadPool& pool = ThreadPool::instance();
+		const int threads = pool.thread_number();
+		pool.set_thread_number(4);
+		const std::thread::id starter = std::this_thread::get_id();
+		std::atomic<int> reports(0);
+
+		// only the other threads report, so that the reports of the starting thread can't hide theirs
+		auto body = [&](int b, int e)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+			if(std::this_thread::get_id() != starter)
+			{
+				++reports;
+				report_progress(0.5);
+			}
+		};
+
+		ProgressScope scope(progress);
+		{
+			ProgressScope step(0.5, 1);
+			parallel_for(0, 64, body);
+		}
+		REQUIRE(reports > 0);
+		REQUIRE(progress.fraction() == Approx(0.75));
+
+		progress.cancel();
+		REQUIRE_THROWS_AS(parallel_for(0, 64, body), JobCancelled);
+		pool.set_thread_number(threads);
+	}
+}
+
+TEST_CASE("Test background job", "[BackgroundJob]")
+{
+	MultiLayerMap mlm(20, 10, {0, 0}, {1, 1});
+	mlm.new_layer().set_all(1);
+	BackgroundJob job;
+	REQUIRE(job.status() == BackgroundJob::Status::idle);
+	REQUIRE_FALSE(job.finish(mlm));
+
+	SECTION("The result replaces the terrain when the job is finished")
+	{
+		std::atomic<bool> go(false);
+		REQUIRE(job.start("add", mlm, [&go](MultiLayerMap& m)
+		{
+			while(!go)
+			{
+				std::this_thread::yield();
+			}
+
+			m.get_field(0) += 1;
+		}));
+		// a single operation at a time
+		REQUIRE_FALSE(job.start("other", [](){}));
+		REQUIRE(job.is_running());
+		REQUIRE_FALSE(job.finish(mlm));
+		go = true;
+		wait(job);
+		// the terrain is untouched until the job is finished
+		REQUIRE(mlm.get_field(0).value(3, 4) == 1);
+		REQUIRE(job.status() == BackgroundJob::Status::finished);
+		REQUIRE(job.finish(mlm));
+		REQUIRE(mlm.get_field(0).value(3, 4) == 2);
+		REQUIRE(mlm.statistics().sum == Approx(400));
+		REQUIRE_FALSE(job.finish(mlm));
+	}
+	SECTION("A cancelled job leaves the terrain untouched")
+	{
+		REQUIRE(job.start("endless", mlm, [](MultiLayerMap& m)
+		{
+			for(int k = 0; ; ++k)
+			{
+				m.get_field(0).at(0, 0) = k;
+				report_progress(0.5);
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		}));
+
+		while(job.progress() == 0)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+
+		REQUIRE(job.progress() == Approx(0.5));
+		job.cancel();
+		wait(job);
+		REQUIRE(job.status() == BackgroundJob::Status::cancelled);
+		REQUIRE(job.finish(mlm));
+		REQUIRE(mlm.get_field(0).value(0, 0) == 1);
+	}
+	SECTION("A failed job gives its error")
+	{
+		REQUIRE(job.start("fail", mlm, [](MultiLayerMap& m)
+		{
+			m.get_field(0).set_all(5);
+			throw std::invalid_argument("bad terrain");
+		}));
+		wait(job);
+		REQUIRE(job.status() == BackgroundJob::Status::failed);
+		REQUIRE(job.error() == "bad terrain");
+		REQUIRE(job.finish(mlm));
+		REQUIRE(mlm.get_field(0).value(0, 0) == 1);
+		// an other job can start after a failure
+		REQUIRE(job.start("read", mlm, [](MultiLayerMap& m)
+		{
+			m.get_field(0).set_all(3);
+		}, false));
+		wait(job);
+		REQUIRE(job.status() == BackgroundJob::Status::finished);
+		REQUIRE(job.error().empty());
+		REQUIRE(job.finish(mlm));
+		REQUIRE(mlm.get_field(0).value(0, 0) == 1);
+	}
+}
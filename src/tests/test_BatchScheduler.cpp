@@ -0,0 +1,123 @@
+#include "catch.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <BatchScheduler.hpp>
+
+TEST_CASE("Test batch sweep values", "[BatchScheduler]")
+{
+	REQUIRE(BatchScheduler::sweep_values("1 2 5") == std::vector<std::string>({"1", "2", "5"}));
+	REQUIRE(BatchScheduler::sweep_values("0:3") == std::vector<std::string>({"0", "1", "2", "3"}));
+	REQUIRE(BatchScheduler::sweep_values("0.1:0.3:0.1") == std::vector<std::string>({"0.1", "0.2", "0.3"}));
+	REQUIRE(BatchScheduler::sweep_values("exposure") == std::vector<std::string>({"exposure"}));
+	REQUIRE_THROWS_AS(BatchScheduler::sweep_values("3:1"), std::invalid_argument);
+	REQUIRE_THROWS_AS(BatchScheduler::sweep_values("1:a"), std::invalid_argument);
+}
+
+TEST_CASE("Test batch scheduling", "[BatchScheduler]")
+{
+	std::string description =
+	    "[pipeline]\n"
+	    "name = farm\n"
+	    "output = test_batch_\n"
+	    "[terrain]\n"
+	    "width = 20\n"
+	    "[erosion]\n"
+	    "method = constant\n"
+	    "[export]\n"
+	    "obj = false\n"
+	    "pgm = false\n"
+	    "[sweep]\n"
+	    "pipeline.seed = 1:3\n"
+	    "erosion.k = 0.1 0.2\n"
+	    "[batch]\n"
+	    "jobs = 2\n";
+
+	SECTION("The jobs cover every combination of the swept values")
+	{
+		std::istringstream input(description);
+		BatchScheduler scheduler(Pipeline::parse(input), 4);
+		REQUIRE(scheduler.job_number() == 6);
+		REQUIRE(scheduler.concurrent_jobs() == 2);
+		REQUIRE(scheduler.threads_per_job() == 2);
+
+		const BatchJob& job = scheduler.job(3);
+		REQUIRE(job.parameters.size() == 2);
+		REQUIRE(job.parameters[0].first == "erosion.k");
+		REQUIRE(job.parameters[0].second == "0.2");
+		REQUIRE(job.parameters[1].second == "1");
+		REQUIRE(job.pipeline.settings().get_int("seed") == 1);
+		REQUIRE(job.pipeline.stage(1).get_double("k") == 0.2);
+		REQUIRE(job.pipeline.settings().get_string("output") == "test_batch_job_3/");
+		REQUIRE(job.pipeline.name() == "farm_3");
+		REQUIRE(job.pipeline.settings().get_int("threads") == 2);
+		REQUIRE(job.memory == BatchScheduler::estimate_memory(job.pipeline));
+	}
+	SECTION("Every job adds a line to the summary")
+	{
+		std::istringstream input(description);
+		BatchScheduler scheduler(Pipeline::parse(input), 2);
+		std::ostringstream log;
+		REQUIRE(scheduler.run(log) == 0);
+
+		std::ifstream summary("test_batch_summary.csv");
+		std::string line;
+		int lines = 0;
+
+		while(std::getline(summary, line))
+		{
+			++lines;
+			REQUIRE(line.find("failed") == std::string::npos);
+		}
+
+		REQUIRE(lines == 7);
+	}
+	SECTION("The directories of the batch are created")
+	{
+		// removes what a previous run left, so the directories are new
+		auto clean = []()
+		{
+			for(int j = 0; j < 6; ++j)
+			{
+				rmdir(("test_batch_dir/sweep/job_" + std::to_string(j)).c_str());
+			}
+
+			std::remove("test_batch_dir/sweep/summary.csv");
+			rmdir("test_batch_dir/sweep");
+			rmdir("test_batch_dir");
+		};
+		clean();
+
+		std::istringstream input(description + "[pipeline]\noutput = test_batch_dir/sweep/\n");
+		BatchScheduler scheduler(Pipeline::parse(input), 2);
+		std::ostringstream log;
+		REQUIRE(scheduler.run(log) == 0);
+		REQUIRE(std::ifstream("test_batch_dir/sweep/summary.csv").good());
+		REQUIRE(log.str().find("failed") == std::string::npos);
+
+		struct stat info;
+		REQUIRE(stat("test_batch_dir/sweep/job_5", &info) == 0);
+		REQUIRE(S_ISDIR(info.st_mode));
+		clean();
+	}
+	SECTION("Jobs over the estimated memory allowed are refused")
+	{
+		std::istringstream input(description + "[batch]\nestimated_job_memory = 0.01\nsummary = test_batch_memory.csv\n");
+		BatchScheduler scheduler(Pipeline::parse(input), 2);
+		std::ostringstream log;
+		REQUIRE(scheduler.run(log) == 6);
+		REQUIRE(log.str().find("more than") != std::string::npos);
+	}
+	SECTION("Unknown swept parameters are errors")
+	{
+		std::istringstream unknown(description + "[sweep]\nerosion.kk = 1\n");
+		std::istringstream no_stage(description + "[sweep]\ntransport.rest_angle = 30 40\n");
+		REQUIRE_THROWS_AS(Pipeline::parse(unknown), std::invalid_argument);
+		Pipeline pipeline = Pipeline::parse(no_stage);
+		REQUIRE_THROWS_AS(BatchScheduler(pipeline), std::invalid_argument);
+	}
+}
@@ -0,0 +1,69 @@
+#include "catch.hpp"
+
+#include <Weather/Biome.hpp>
+
+#include <cmath>
+
+TEST_CASE("Test BiomeInfo cache", "[Biome]")
+{
+	MultiLayerMap mlm(40, 30, {0, 0}, {40, 30});
+	SimpleLayerMap& bedrock = mlm.new_layer();
+
+	for(int j = 0; j < 30; ++j)
+	{
+		for(int i = 0; i < 40; ++i)
+		{
+			bedrock.at(i, j) = 0.1 * i + 0.05 * std::sin(0.3 * j);
+		}
+	}
+
+	mlm.new_layer().set_all(0.5);
+	const BiomeInfo biome(mlm);
+
+	const double height = biome.terrain().value(20, 15);
+	const double slope = biome.raw_slope().value(20, 15);
+	REQUIRE(height == Approx(mlm.value(20, 15)));
+	REQUIRE(slope == Approx(mlm.slope(20, 15)));
+
+	SECTION("The maps are kept while the map is unchanged")
+	{
+		const SimpleLayerMap* terrain = &biome.terrain();
+		const unsigned long version = terrain->version();
+		REQUIRE(mlm.value(20, 15) == height);
+		REQUIRE(&biome.terrain() == terrain);
+		REQUIRE(biome.terrain().version() == version);
+		REQUIRE(biome.raw_slope().value(20, 15) == slope);
+	}
+	SECTION("The maps are refreshed when a layer is modified")
+	{
+		const unsigned long version = biome.terrain().version();
+		mlm.get_field(0).at(21, 15) += 3;
+
+		REQUIRE(biome.terrain().version() != version);
+		REQUIRE(biome.terrain().value(21, 15) == Approx(mlm.value(21, 15)));
+		REQUIRE(biome.raw_slope().value(20, 15) == Approx(mlm.slope(20, 15)));
+		REQUIRE(biome.raw_slope().value(20, 15) != Approx(slope));
+
+		const Eigen::Vector3d normal = mlm.normal(22, 15);
+		REQUIRE(biome.normals()[0].value(22, 15) == Approx(normal(0)));
+		REQUIRE(biome.normals()[2].value(22, 15) == Approx(normal(2)));
+	}
+	SECTION("The maps are refreshed when a layer is added")
+	{
+		mlm.new_layer().set_all(1);
+		REQUIRE(biome.terrain().value(20, 15) == Approx(height + 1));
+		REQUIRE(biome.raw_slope().value(20, 15) == Approx(slope));
+	}
+	SECTION("The sediments only depend on their layer")
+	{
+		const SimpleLayerMap* sediments = &biome.sediments();
+		const unsigned long version = sediments->version();
+		mlm.get_field(0).at(0, 0) = 10;
+		REQUIRE(biome.sediments().version() == version);
+
+		mlm.get_field(1).at(0, 0) = 2;
+		REQUIRE(biome.sediments().version() != version);
+		REQUIRE(biome.sediments().value(0, 0) == Approx(1));
+		REQUIRE(biome.sediments().value(1, 1) == Approx(0));
+	}
+}
@@ -0,0 +1,132 @@
+#include "catch.hpp"
+
+#include <BooleanField.hpp>
+#include <ActiveSet.hpp>
+
+#include <vector>
+
+TEST_CASE("Test BooleanField", "[BooleanField]")
+{
+	BooleanField bf(13, 11, false);
+
+	SECTION("Set and clear cells")
+	{
+		REQUIRE(bf.count() == 0);
+		REQUIRE(bf.words().size() == 3);
+
+		bf.at(12, 10) = true;
+		bf.set_value(0, 5, true);
+		REQUIRE(bf.value(12, 10));
+		REQUIRE(bf.value(Eigen::Vector2i(0, 5)));
+		REQUIRE(!bf.value(1, 5));
+		REQUIRE(bf.count() == 2);
+
+		REQUIRE(!bf.test_and_set(Eigen::Vector2i(3, 4)));
+		REQUIRE(bf.test_and_set(Eigen::Vector2i(3, 4)));
+		REQUIRE(bf.test_and_clear(Eigen::Vector2i(3, 4)));
+		REQUIRE(!bf.test_and_clear(Eigen::Vector2i(3, 4)));
+		REQUIRE(bf.count() == 2);
+
+		REQUIRE_THROWS_AS(bf.value(13, 10), std::invalid_argument);
+		REQUIRE_THROWS_AS(bf.at(-1, 0), std::invalid_argument);
+	}
+
+	SECTION("The bits past the last cell stay false")
+	{
+		bf.set_all(true);
+		REQUIRE(bf.count() == 13 * 11);
+		REQUIRE((bf.words().back() >> ((13 * 11) & 63)) == 0);
+
+		int unset = 0;
+		bf.for_each_unset([&unset](const int, const int) { ++unset; });
+		REQUIRE(unset == 0);
+	}
+
+	SECTION("Iterate row after row")
+	{
+		const std::vector<Eigen::Vector2i> cells = {{4, 0}, {12, 0}, {0, 6}, {7, 6}, {12, 10}};
+
+		for(const Eigen::Vector2i& c : cells)
+		{
+			bf.at(c) = true;
+		}
+
+		std::vector<Eigen::Vector2i> set;
+		bf.for_each_set([&set](const int i, const int j) { set.push_back({i, j}); });
+		REQUIRE(set == cells);
+
+		int unset = 0;
+		bf.for_each_unset([&](const int i, const int j)
+		{
+			REQUIRE(!bf.value(i, j));
+			++unset;
+		});
+		REQUIRE(unset == 13 * 11 - 5);
+	}
+
+	SECTION("Combine fields")
+	{
+		BooleanField other(13, 11, false);
+		bf.at(1, 1) = true;
+		bf.at(2, 2) = true;
+		other.at(2, 2) = true;
+		other.at(3, 3) = true;
+
+		BooleanField both(bf);
+		both &= other;
+		REQUIRE(both.count() == 1);
+		REQUIRE(both.value(2, 2));
+
+		bf |= other;
+		REQUIRE(bf.count() == 3);
+		REQUIRE(bf.value(3, 3));
+	}
+}
+
+TEST_CASE("Test ActiveSet", "[BooleanField]")
+{
+	ActiveSet active(20, 12, 8, false);
+	REQUIRE_THROWS_AS(ActiveSet(20, 12, 0), std::invalid_argument);
+	REQUIRE(active.block_number() == 3 * 2);
+	REQUIRE(active.empty());
+
+	SECTION("A cell activates the blocks of its neighbors")
+	{
+		active.activate(8, 3);
+		REQUIRE(active.empty());
+		active.advance();
+		REQUIRE(active.active_blocks() == 2);
+		REQUIRE(active.is_active(7, 0));
+		REQUIRE(active.is_active(15, 7));
+		REQUIRE(!active.is_active(16, 0));
+		REQUIRE(!active.is_active(0, 8));
+
+		active.activate(19, 11);
+		active.advance();
+		REQUIRE(active.active_blocks() == 1);
+		REQUIRE(active.is_active(16, 8));
+
+		active.advance();
+		REQUIRE(active.empty());
+	}
+
+	SECTION("The blocks are clipped to the grid")
+	{
+		active.activate_all();
+		active.advance();
+		REQUIRE(active.active_blocks() == 6);
+
+		int cells = 0;
+		std::vector<int> blocks;
+		active.for_each_block([&](const int i0, const int j0, const int i1, const int j1)
+		{
+			REQUIRE(i1 <= 20);
+			REQUIRE(j1 <= 12);
+			cells += (i1 - i0) * (j1 - j0);
+			blocks.push_back(active.block_index(i0, j0));
+		});
+		REQUIRE(cells == 20 * 12);
+		REQUIRE(blocks == std::vector<int>({0, 1, 2, 3, 4, 5}));
+		REQUIRE(active.block_index(19, 11) == 5);
+	}
+}
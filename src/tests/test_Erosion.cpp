@@ -0,0 +1,398 @@
+#include "catch.hpp"
+
+#include <Weather/Erosion.hpp>
+#include <Weather/Biome.hpp>
+#include <BucketQueue.hpp>
+#include <Profiler.hpp>
+
+#include <cmath>
+#include <vector>
+
+namespace
+{
+/**
+ * @brief Get the steepest slope of a cell with sediments above the rest angle, 0 if it is stable
+ *
+ */
+double max_excess(const MultiLayerMap& mlm, const double rest_angle)
+{
+	const double threshold = mlm.cell_size().x() * tan(rest_angle / 180. * 3.14);
+	SimpleLayerMap terrain = mlm.generate_field();
+	double values[8];
+	Eigen::Vector2i positions[8];
+	double slopes[8];
+	double excess = 0;
+
+	for(int j = 0; j < mlm.grid_height(); ++j)
+	{
+		for(int i = 0; i < mlm.grid_width(); ++i)
+		{
+			if(mlm.get_field(1).value(i, j) < 1e-9)
+			{
+				continue;
+			}
+
+			int neighbors = terrain.neighbors_info_filter(i, j, values, positions, slopes, - threshold, false);
+
+			for(int k = 0; k < neighbors; ++k)
+			{
+				excess = std::max(excess, - slopes[k] - threshold);
+			}
+		}
+	}
+
+	return excess;
+}
+}
+
+TEST_CASE("Test bucket queue", "[Erosion]")
+{
+	BucketQueue queue(10, 4);
+	REQUIRE_THROWS_AS(BucketQueue(10, 0), std::invalid_argument);
+	REQUIRE(queue.empty());
+
+	REQUIRE(queue.push(3, 1));
+	REQUIRE(queue.push(5, 2));
+	REQUIRE(queue.push(7, 8));
+	REQUIRE(!queue.push(5, 0));
+	REQUIRE(queue.push(3, 2));
+	REQUIRE(queue.size() == 3);
+	REQUIRE(queue.bucket(7) == 3);
+
+	REQUIRE(queue.pop() == 7);
+	REQUIRE(queue.pop() == 3);
+	REQUIRE(queue.pop() == 5);
+	REQUIRE(queue.empty());
+	REQUIRE(queue.bucket(3) == -1);
+	REQUIRE_THROWS_AS(queue.pop(), std::logic_error);
+
+	// a cell popped can be queued again, its old entries being skipped
+	REQUIRE(queue.push(3, 1));
+	REQUIRE(queue.pop() == 3);
+	REQUIRE(queue.empty());
+}
+
+TEST_CASE("Test transport scheduling", "[Erosion]")
+{
+	MultiLayerMap mlm(40, 30, {0, 0}, {40, 30});
+	mlm.new_layer();
+	SimpleLayerMap& sediments = mlm.new_layer();
+
+	for(int j = 12; j < 16; ++j)
+	{
+		for(int i = 18; i < 22; ++i)
+		{
+			sediments.at(i, j) = 6.;
+		}
+	}
+
+	sediments.at(5, 5) = 3.;
+	const double mass = 16 * 6. + 3.;
+
+	MultiLayerMap fifo(mlm);
+	MultiLayerMap unstable_first(mlm);
+	TransportStatistics fifo_statistics;
+	TransportStatistics unstable_first_statistics;
+	transport(fifo, 30, 1e-12, &fifo_statistics);
+	transport_unstable_first(unstable_first, 30, 1e-12, &unstable_first_statistics);
+
+	SECTION("Both schedulings keep the sediments")
+	{
+		REQUIRE(fifo.get_field(1).get_sum() == Approx(mass));
+		REQUIRE(unstable_first.get_field(1).get_sum() == Approx(mass));
+	}
+
+	SECTION("The cells around a cell that lost sediments are visited again")
+	{
+		REQUIRE(max_excess(unstable_first, 30) < 1e-6);
+	}
+
+	SECTION("Visiting the most unstable cells first visits less cells")
+	{
+		REQUIRE(fifo_statistics.cells >= 40 * 30);
+		REQUIRE(unstable_first_statistics.cells > 0);
+		REQUIRE(unstable_first_statistics.cells < fifo_statistics.cells);
+	}
+}
+
+TEST_CASE("Test stratigraphy", "[Erosion]")
+{
+	const std::vector<double> tops = {-1., 0., 0.5, 2.};
+	const std::vector<double> erodibilities = {0.1, 0.2, 0.3, 0.4, 0.5};
+	Stratigraphy strata(tops, erodibilities);
+
+	REQUIRE_THROWS_AS(Stratigraphy(tops, {0.1}), std::invalid_argument);
+	REQUIRE_THROWS_AS(Stratigraphy({1., 0.}, {0.1, 0.2, 0.3}), std::invalid_argument);
+	REQUIRE_THROWS_AS(strata.set_fold(1., 0.), std::invalid_argument);
+	REQUIRE(strata.material_number() == 5);
+
+	SECTION("A point on the top of a stratum is in that stratum")
+	{
+		REQUIRE(strata.material(3., 4., -2.) == 0);
+		REQUIRE(strata.material(3., 4., -1.) == 0);
+		REQUIRE(strata.material(3., 4., 0.25) == 2);
+		REQUIRE(strata.material(3., 4., 5.) == 4);
+		REQUIRE(strata.erodibility(strata.material(3., 4., 5.)) == 0.5);
+	}
+
+	SECTION("Tilted and folded strata")
+	{
+		strata.set_tilt(0.1, -0.2, {1., 1.});
+		REQUIRE(strata.offset(1., 1.) == Approx(0.));
+		REQUIRE(strata.offset(11., 1.) == Approx(1.));
+		REQUIRE(strata.material(11., 1., 1.) == 1);
+		REQUIRE(strata.material(11., 1., 1.01) == 2);
+
+		strata.set_fold(0.5, 4., 90.);
+		REQUIRE(strata.offset(1., 2.) == Approx(-0.2 + 0.5));
+		REQUIRE(strata.offset(1., 3.) == Approx(-0.4).margin(1e-12));
+	}
+
+	SECTION("The materials of a row are the materials of its cells")
+	{
+		MultiLayerMap mlm(30, 20, {-3, -2}, {3, 2});
+		SimpleLayerMap& bedrock = mlm.new_layer();
+
+		for(int j = 0; j < 20; ++j)
+		{
+			for(int i = 0; i < 30; ++i)
+			{
+				bedrock.at(i, j) = std::sin(i * 0.3) * 1.5 + std::cos(j * 0.7);
+			}
+		}
+
+		strata.set_tilt(0.3, 0.2, {0., 0.});
+		strata.set_fold(0.4, 2.5, 30.);
+		std::vector<int> materials(30);
+
+		for(int j = 0; j < 20; ++j)
+		{
+			strata.materials_row(bedrock, j, materials.data());
+
+			for(int i = 0; i < 30; ++i)
+			{
+				const Eigen::Vector2d p = bedrock.world_position(i, j);
+				REQUIRE(materials[i] == strata.material(p(0), p(1), bedrock.value(i, j)));
+			}
+		}
+	}
+}
+
+TEST_CASE("Test layered erosion", "[Erosion]")
+{
+	MultiLayerMap mlm(24, 18, {0, 0}, {2.4, 1.8});
+	SimpleLayerMap& bedrock = mlm.new_layer();
+
+	for(int j = 0; j < 18; ++j)
+	{
+		for(int i = 0; i < 24; ++i)
+		{
+			bedrock.at(i, j) = std::sin(i * 0.4) + std::cos(j * 0.3) * 0.5 + 0.013 * i * j;
+		}
+	}
+
+	const std::vector<double> tops = {-0.6, -0.1, 0.35, 0.8, 1.2};
+	const std::vector<double> erodibilities = {0.01, 0.05, 0.001, 0.1, 0.02, 0.07};
+	const double angle = 0.3;
+
+	// the erosion values found by the scan of the strata of each cell it replaces
+	MultiLayerMap expected(mlm);
+	expected.new_layer();
+	SimpleLayerMap exposure = get_light_exposure(expected);
+	exposure.normalize();
+	SimpleLayerMap terrain = expected.generate_field();
+
+	for(int h = 0; h < 18; ++h)
+	{
+		for(int w = 0; w < 24; ++w)
+		{
+			int ilayer = 0;
+
+			while(ilayer < tops.size() && terrain.at(w, h) > tops[ilayer] + tan(angle) * (h - 18 / 2) * mlm.cell_size().y())
+			{
+				++ilayer;
+			}
+
+			expected.get_field(0).at(w, h) -= erodibilities[ilayer] * exposure.at(w, h);
+			expected.get_field(1).at(w, h) += erodibilities[ilayer] * exposure.at(w, h);
+		}
+	}
+
+	erode_layered_materials_using_exposure(mlm, tops, erodibilities, angle);
+
+	for(int h = 0; h < 18; ++h)
+	{
+		for(int w = 0; w < 24; ++w)
+		{
+			REQUIRE(mlm.get_field(0).value(w, h) == Approx(expected.get_field(0).value(w, h)));
+			REQUIRE(mlm.get_field(1).value(w, h) == Approx(expected.get_field(1).value(w, h)));
+		}
+	}
+}
+
+TEST_CASE("Test erosion convergence", "[Erosion]")
+{
+	MultiLayerMap mlm(100, 80, {0, 0}, {100, 80});
+	mlm.new_layer();
+	mlm.new_layer();
+	SimpleLayerMap& bedrock = mlm.get_field(0);
+
+	for(int j = 0; j < 80; ++j)
+	{
+		for(int i = 0; i < 100; ++i)
+		{
+			bedrock.at(i, j) = 0.01 * i;
+		}
+	}
+
+	ConvergenceCriteria criteria;
+	criteria.max_iterations = 20;
+
+	SECTION("The changes are measured on the modified tiles")
+	{
+		MultiLayerMap before(mlm);
+		mlm.get_field(0).at(3, 4) -= 0.5;
+		mlm.get_field(1).at(3, 4) += 0.5;
+		mlm.get_field(1).at(90, 70) += 2.;
+		mlm.new_layer().at(90, 70) = 1e-14;
+
+		ErosionIteration iteration = measure_erosion(before, mlm, criteria);
+		REQUIRE(iteration.mass_moved == Approx(0.5 + 1.));
+		REQUIRE(iteration.changed_cells == 2);
+		REQUIRE(iteration.max_talus_violation == 0);
+
+		criteria.rest_angle = 30;
+		iteration = measure_erosion(before, mlm, criteria);
+		REQUIRE(iteration.max_talus_violation > 0);
+	}
+
+	SECTION("A constant erosion never converges")
+	{
+		ErosionStatistics statistics = erode_until_converged(mlm, [](MultiLayerMap& m) { erode_constant(m, 0.01); }, criteria);
+		REQUIRE(statistics.iterations == 20);
+		REQUIRE(!statistics.converged);
+		REQUIRE(statistics.history.size() == 20);
+		REQUIRE(statistics.history[3].changed_cells == 100 * 80);
+		REQUIRE(statistics.mass_moved == Approx(20 * 0.01 * 100 * 80));
+	}
+
+	SECTION("A transport stops when the sediments are stable")
+	{
+		for(int j = 30; j < 40; ++j)
+		{
+			for(int i = 40; i < 50; ++i)
+			{
+				mlm.get_field(1).at(i, j) = 8.;
+			}
+		}
+
+		criteria.relative_mass = 0.01;
+		criteria.rest_angle = 30;
+		ErosionStatistics statistics = erode_until_converged(mlm, [](MultiLayerMap& m) { transport_unstable_first(m, 30); }, criteria);
+		REQUIRE(statistics.converged);
+		REQUIRE(statistics.iterations < 20);
+		REQUIRE(statistics.history[0].mass_moved > 0);
+		REQUIRE(statistics.history.back().max_talus_violation <= criteria.talus_tolerance);
+	}
+
+	SECTION("The talus is only measured again around the changed cells")
+	{
+		// the pile is measured by the first iteration only, the next ones measuring the block of the cell they raise
+		mlm.get_field(1).at(10, 10) = 5.;
+		criteria.max_iterations = 3;
+		criteria.rest_angle = 30;
+
+		Profiler::reset();
+		Profiler::enable();
+		ErosionStatistics statistics = erode_until_converged(mlm, [](MultiLayerMap& m) { m.get_field(1).at(50, 40) += 1.; }, criteria);
+		Profiler::enable(false);
+		const long measured = Profiler::counter("erosion.talus_cells");
+		Profiler::reset();
+
+		REQUIRE(statistics.iterations == 3);
+		REQUIRE(measured == 100 * 80 + 2 * 16 * 16);
+		REQUIRE(statistics.history.back().max_talus_violation == Approx(measure_erosion(mlm, mlm, criteria).max_talus_violation));
+		REQUIRE(statistics.history.back().max_talus_violation == Approx(statistics.history.front().max_talus_violation));
+	}
+}
+
+TEST_CASE("Test terrain buffer", "[Erosion]")
+{
+	MultiLayerMap mlm(60, 50, {0, 0}, {60, 50});
+	mlm.new_layer();
+	mlm.new_layer();
+
+	for(int j = 0; j < 50; ++j)
+	{
+		for(int i = 0; i < 60; ++i)
+		{
+			mlm.get_field(0).at(i, j) = 0.2 * i + 3. * std::sin(0.3 * j);
+		}
+	}
+
+	TerrainBuffer buffer(mlm);
+	REQUIRE(buffer.sum_number() == 0);
+
+	SECTION("The steps given the buffer sum the layers once")
+	{
+		for(int k = 0; k < 3; ++k)
+		{
+			erode_using_exposure(buffer, 0.5);
+			transport_unstable_first(buffer, 30);
+		}
+
+		REQUIRE(buffer.sum_number() == 1);
+
+		SimpleLayerMap summed = mlm.generate_field();
+
+		for(int j = 0; j < 50; ++j)
+		{
+			for(int i = 0; i < 60; ++i)
+			{
+				REQUIRE(buffer.terrain().value(i, j) == Approx(summed.value(i, j)).margin(1e-9));
+			}
+		}
+
+		REQUIRE(buffer.sum_number() == 1);
+	}
+
+	SECTION("The buffered steps give the results of the plain ones")
+	{
+		MultiLayerMap plain(mlm);
+		erode_using_exposure(plain, 0.5);
+		transport_unstable_first(plain, 30);
+		erode_using_exposure(buffer, 0.5);
+		transport_unstable_first(buffer, 30);
+
+		for(int j = 0; j < 50; ++j)
+		{
+			for(int i = 0; i < 60; ++i)
+			{
+				REQUIRE(mlm.get_field(1).value(i, j) == Approx(plain.get_field(1).value(i, j)).margin(1e-9));
+			}
+		}
+	}
+
+	SECTION("The layers modified outside of the buffer are summed again")
+	{
+		const double height = buffer.terrain().value(10, 10);
+		mlm.get_field(1).at(10, 10) += 2.;
+		REQUIRE(buffer.terrain().value(10, 10) == Approx(height + 2.));
+		REQUIRE(buffer.sum_number() == 2);
+	}
+
+	SECTION("The convergence loop keeps the buffer")
+	{
+		ConvergenceCriteria criteria;
+		criteria.max_iterations = 4;
+		criteria.rest_angle = 30;
+		ErosionStatistics statistics = erode_until_converged(buffer, [](TerrainBuffer& b)
+		{
+			erode_using_exposure(b, 0.2);
+			transport(b, 30);
+		}, criteria);
+
+		REQUIRE(statistics.iterations == 4);
+		REQUIRE(buffer.sum_number() == 1);
+	}
+}
@@ -0,0 +1,152 @@
+#include "catch.hpp"
+
+#include <Eigen/Core>
+
+#include <FieldPyramid.hpp>
+#include <Noise/TerrainNoise.hpp>
+#include <Weather/Erosion.hpp>
+
+TEST_CASE("Test field pyramid", "[FieldPyramid]")
+{
+	SimpleLayerMap sf(65, 40, { -5, -5}, {5, 5});
+	TerrainNoise t_noise(10.0, 1.0 / 20.0, 4);
+
+	for(int j = 0; j < 40; ++j)
+	{
+		for(int i = 0; i < 65; i++)
+		{
+			sf.at(i, j) = t_noise.get_noise(i, j);
+		}
+	}
+
+	SECTION("Downsampling keeps the mass")
+	{
+		SimpleLayerMap coarse = SimpleLayerMap::generate_downsampled(sf);
+		REQUIRE(coarse.grid_width() == 33);
+		REQUIRE(coarse.grid_height() == 20);
+		REQUIRE(coarse.cell_size()[0] == Approx(2 * sf.cell_size()[0]));
+		REQUIRE(coarse.cell_size()[1] == Approx(2 * sf.cell_size()[1]));
+
+		double mass = 0;
+
+		for(int j = 0; j < coarse.grid_height(); ++j)
+		{
+			for(int i = 0; i < coarse.grid_width(); ++i)
+			{
+				mass += coarse.value(i, j) * SimpleLayerMap::downsampled_block_size(sf, i, j);
+			}
+		}
+
+		REQUIRE(mass == Approx(sf.get_sum()));
+		REQUIRE(coarse.value(32, 19) == Approx((sf.value(64, 38) + sf.value(64, 39)) / 2));
+	}
+	SECTION("Resampling on the same grid keeps the values")
+	{
+		SimpleLayerMap linear = SimpleLayerMap::generate_resampled(sf, sf);
+		SimpleLayerMap cubic = SimpleLayerMap::generate_resampled(sf, sf, true);
+
+		for(int j = 0; j < 40; ++j)
+		{
+			for(int i = 0; i < 65; ++i)
+			{
+				REQUIRE(linear.value(i, j) == Approx(sf.value(i, j)));
+				REQUIRE(cubic.value(i, j) == Approx(sf.value(i, j)));
+			}
+		}
+	}
+	SECTION("Levels stop at the minimal size")
+	{
+		FieldPyramid<SimpleLayerMap> pyramid(sf, 5, 8);
+		REQUIRE(pyramid.level_number() == 3);
+		REQUIRE(pyramid.level(2).grid_width() == 17);
+		REQUIRE(pyramid.level(2).grid_height() == 10);
+	}
+}
+
+TEST_CASE("Test coarse to fine erosion", "[FieldPyramid]")
+{
+	MultiLayerMap mlm(64, 64, { -5, -5}, {5, 5});
+	SimpleLayerMap& bedrock = mlm.new_layer();
+	TerrainNoise t_noise(10.0, 1.0 / 20.0, 4);
+
+	for(int j = 0; j < 64; ++j)
+	{
+		for(int i = 0; i < 64; i++)
+		{
+			bedrock.at(i, j) = 20 + t_noise.get_noise(i, j);
+		}
+	}
+
+	const double mass = mlm.statistics().sum;
+	erode_coarse_to_fine(mlm, [](MultiLayerMap & map)
+	{
+		erode_using_mean_slope(map, 0.05);
+		transport(map, 30);
+	}, {4, 2, 1});
+
+	REQUIRE(mlm.get_layer_number() == 2);
+	REQUIRE(mlm.get_field(1).get_min() > -1e-9);
+	REQUIRE(mlm.get_field(1).get_max() > 0);
+	REQUIRE(mlm.statistics().sum == Approx(mass).epsilon(1e-3));
+}
+
+TEST_CASE("Test coarse to fine layer masses", "[FieldPyramid]")
+{
+	SECTION("Each layer keeps the mass moved and the unchanged regions stay empty")
+	{
+		MultiLayerMap mlm(203, 203, {0, 0}, {10, 10});
+		mlm.new_layer().set_all(5);
+		const double bedrock_mass = mlm.get_field(0).statistics().sum;
+
+		// the sediments taken from the bedrock of a cell are moved to its neighbour a little at each iteration
+		erode_coarse_to_fine(mlm, [](MultiLayerMap & map)
+		{
+			if(map.get_layer_number() < 2)
+			{
+				map.new_layer();
+				map.get_field(0).at(4, 4) -= 1;
+				map.get_field(1).at(4, 4) += 1;
+			}
+
+			SimpleLayerMap& sediments = map.get_field(1);
+			const double moved = 0.5 * sediments.value(4, 4);
+			sediments.at(4, 4) -= moved;
+			sediments.at(5, 4) += moved;
+		}, {2, 1, 1});
+
+		const double sediments = mlm.get_field(1).statistics().sum;
+		REQUIRE(sediments == Approx(16));
+		REQUIRE(mlm.get_field(1).get_min() >= 0);
+		REQUIRE(mlm.get_field(0).statistics().sum - bedrock_mass == Approx(- sediments).epsilon(1e-12));
+
+		mlm.compact();
+		REQUIRE(mlm.get_field(1).storage().empty_tiles() == mlm.get_field(1).storage().tile_number() - 1);
+	}
+	SECTION("The sediments clamped at zero are taken from the bedrock")
+	{
+		MultiLayerMap mlm(64, 64, { -5, -5}, {5, 5});
+		SimpleLayerMap& bedrock = mlm.new_layer();
+		TerrainNoise t_noise(10.0, 1.0 / 20.0, 4);
+
+		for(int j = 0; j < 64; ++j)
+		{
+			for(int i = 0; i < 64; i++)
+			{
+				bedrock.at(i, j) = 20 + t_noise.get_noise(i, j);
+			}
+		}
+
+		const double mass = mlm.statistics().sum;
+
+		// the bicubic interpolation overshoots, removing sediments where there are none
+		erode_coarse_to_fine(mlm, [](MultiLayerMap & map)
+		{
+			erode_using_mean_slope(map, 0.05);
+			transport(map, 30);
+		}, {4, 2, 1}, true);
+
+		REQUIRE(mlm.get_field(1).get_min() > -1e-9);
+		REQUIRE(mlm.get_field(1).get_max() > 0);
+		REQUIRE(mlm.statistics().sum == Approx(mass).epsilon(1e-12));
+	}
+}
@@ -0,0 +1,231 @@
+#include "catch.hpp"
+
+#include <Weather/Hydro.hpp>
+#include <MassAudit.hpp>
+#include <Profiler.hpp>
+
+#include <cmath>
+#include <random>
+
+namespace
+{
+/**
+ * @brief Get a valley along the height of the grid, sloping down along it
+ *
+ */
+MultiLayerMap valley(const int width, const int height)
+{
+	MultiLayerMap mlm(width, height, {0, 0}, {double(width), double(height)});
+	SimpleLayerMap& bedrock = mlm.new_layer();
+
+	for(int j = 0; j < height; ++j)
+	{
+		for(int i = 0; i < width; ++i)
+		{
+			bedrock.at(i, j) = 0.05 * std::abs(i - width / 2) + 0.1 * j + 0.3 * std::sin(0.7 * i) * std::sin(0.5 * j);
+		}
+	}
+
+	return mlm;
+}
+
+/**
+ * @brief Get the root mean square of the differences between two terrains
+ *
+ */
+double rms_difference(const SimpleLayerMap& a, const SimpleLayerMap& b)
+{
+	double sum = 0;
+
+	for(int j = 0; j < a.grid_height(); ++j)
+	{
+		for(int i = 0; i < a.grid_width(); ++i)
+		{
+			sum += (a.value(i, j) - b.value(i, j)) * (a.value(i, j) - b.value(i, j));
+		}
+	}
+
+	return std::sqrt(sum / a.cell_number());
+}
+}
+
+TEST_CASE("Test continuous droplets", "[Hydro]")
+{
+	MultiLayerMap mlm = valley(64, 48);
+	const MassAudit before(mlm, 4, 1);
+	std::mt19937 gen(3);
+	DropletParameters parameters;
+
+	SECTION("The parameters are checked")
+	{
+		parameters.radius = 0;
+		REQUIRE_THROWS_AS(erode_from_continuous_droplets(mlm, gen, 10, parameters), std::invalid_argument);
+	}
+
+	SECTION("The droplets move sediments and keep the mass")
+	{
+		const long steps = erode_from_continuous_droplets(mlm, gen, 500, parameters);
+		REQUIRE(steps > 500);
+		REQUIRE(steps <= 500 * parameters.max_steps);
+		REQUIRE(mlm.get_layer_number() == 2);
+
+		const MassLeak leak = compare_mass(before, MassAudit(mlm, 4, 1));
+		REQUIRE(leak.layer_leak(0) < 0);
+		REQUIRE(leak.layer_leak(1) == Approx(- leak.layer_leak(0)));
+		REQUIRE(leak.total == Approx(0).margin(1e-9));
+
+		for(int j = 0; j < 48; ++j)
+		{
+			for(int i = 0; i < 64; ++i)
+			{
+				REQUIRE(mlm.get_field(1).value(i, j) >= -1e-12);
+			}
+		}
+	}
+
+	SECTION("The layers between the bedrock and the sediments are eroded")
+	{
+		mlm.new_layer().set_all(0.2);
+		mlm.new_layer();
+		const MassAudit layered(mlm, 4, 1);
+		erode_from_continuous_droplets(mlm, gen, 500, parameters);
+		REQUIRE(mlm.get_layer_number() == 3);
+		REQUIRE(mlm.get_field(1).get_min() >= 0);
+		REQUIRE(mlm.get_field(1).get_min() < 0.2);
+
+		const MassLeak leak = compare_mass(layered, MassAudit(mlm, 4, 1));
+		REQUIRE(leak.layer_leak(1) < 0);
+		REQUIRE(leak.total == Approx(0).margin(1e-9));
+	}
+
+	SECTION("Ten times fewer droplets give a terrain close to the cell droplets in ten times fewer steps")
+	{
+		// the valley is made steeper, the cell droplets not eroding slopes under about 0.5
+		mlm.get_field(0) *= 10.;
+		mlm.new_layer();
+		MultiLayerMap cells(mlm);
+		const SimpleLayerMap terrain = mlm.generate_field();
+		SimpleLayerMap square(3, 3);
+		square.set_all(0.05);
+		square.at(1, 1) = 0.6;
+
+		Profiler::reset();
+		Profiler::enable();
+		std::mt19937 cells_gen(3);
+		erode_from_droplets(cells, cells_gen, CompiledBrush(square), 5000, 0.01, 0.01, 0.2);
+		Profiler::enable(false);
+		const long cell_steps = Profiler::counter("droplets.steps");
+		Profiler::reset();
+		const long steps = erode_from_continuous_droplets(mlm, gen, 500, parameters);
+
+		const SimpleLayerMap cells_terrain = cells.generate_field();
+		REQUIRE(rms_difference(cells_terrain, terrain) > 0);
+		REQUIRE(steps * 10 <= cell_steps);
+		REQUIRE(rms_difference(mlm.generate_field(), cells_terrain) < 0.05 * (terrain.get_max() - terrain.get_min()));
+	}
+
+	SECTION("The buffered terrain follows the layers")
+	{
+		TerrainBuffer buffer(mlm);
+		erode_from_continuous_droplets(buffer, gen, 200, parameters);
+		erode_from_continuous_droplets(buffer, gen, 200, parameters);
+		REQUIRE(buffer.sum_number() == 1);
+
+		SimpleLayerMap summed = mlm.generate_field();
+
+		for(int j = 0; j < 48; ++j)
+		{
+			for(int i = 0; i < 64; ++i)
+			{
+				REQUIRE(buffer.terrain().value(i, j) == Approx(summed.value(i, j)).margin(1e-9));
+			}
+		}
+	}
+
+	SECTION("The same seed gives the same terrain")
+	{
+		MultiLayerMap other(mlm);
+		std::mt19937 other_gen(3);
+		erode_from_continuous_droplets(mlm, gen, 100, parameters);
+		erode_from_continuous_droplets(other, other_gen, 100, parameters);
+		REQUIRE(mlm.get_field(1).value(32, 20) == other.get_field(1).value(32, 20));
+		REQUIRE(mlm.get_field(0).value(30, 10) == other.get_field(0).value(30, 10));
+	}
+}
+
+TEST_CASE("Test compiled brush", "[Hydro]")
+{
+	SimpleLayerMap field(3, 3);
+	field.at(1, 0) = 0.1;
+	field.at(0, 1) = 0.1;
+	field.at(1, 1) = 0.6;
+	field.at(2, 1) = 0.1;
+	field.at(1, 2) = 0.1;
+
+	const CompiledBrush cross(field);
+	REQUIRE(cross.tap_number() == 5);
+	REQUIRE(cross.extent() == 1);
+	REQUIRE_THROWS_AS(CompiledBrush::cone(0), std::invalid_argument);
+	REQUIRE_THROWS_AS(CompiledBrush::gaussian(2, 0), std::invalid_argument);
+
+	SECTION("The radial brushes are round and sum to 1")
+	{
+		const CompiledBrush brushes[3] = {CompiledBrush::disk(2.5), CompiledBrush::cone(2.5), CompiledBrush::gaussian(2.5, 1)};
+
+		for(const CompiledBrush& brush : brushes)
+		{
+			double sum = 0;
+
+			for(int k = 0; k < brush.tap_number(); ++k)
+			{
+				REQUIRE(brush.tap_i(k) * brush.tap_i(k) + brush.tap_j(k) * brush.tap_j(k) < 2.5 * 2.5);
+				sum += brush.weight(k);
+			}
+
+			REQUIRE(brush.tap_number() == 21);
+			REQUIRE(brush.extent() == 2);
+			REQUIRE(sum == Approx(1.));
+		}
+	}
+
+	SECTION("The brush is applied inside the tiles, across them and across the borders")
+	{
+		const CompiledBrush brush = CompiledBrush::cone(3);
+		TileStorage values(100, 80);
+		TileStorage other(100, 80);
+		TileStorage expected(100, 80);
+		const int centers[4][2] = {{20, 20}, {63, 30}, {40, 64}, {1, 78}};
+		double outside = 0;
+
+		for(const auto& c : centers)
+		{
+			outside += brush.add(values, c[0], c[1], 2., &other);
+
+			for(int k = 0; k < brush.tap_number(); ++k)
+			{
+				const int i = c[0] + brush.tap_i(k);
+				const int j = c[1] + brush.tap_j(k);
+
+				if(i >= 0 && j >= 0 && i < 100 && j < 80)
+				{
+					expected.at(i, j) += 2. * brush.weight(k);
+				}
+			}
+		}
+
+		double sum = 0;
+
+		for(int j = 0; j < 80; ++j)
+		{
+			for(int i = 0; i < 100; ++i)
+			{
+				REQUIRE(values.get(i, j) == Approx(expected.get(i, j)));
+				REQUIRE(other.get(i, j) == values.get(i, j));
+				sum += values.get(i, j);
+			}
+		}
+
+		REQUIRE(outside > 0);
+		REQUIRE(sum + outside == Approx(4 * 2.));
+	}
+}
@@ -0,0 +1,118 @@
+#include "catch.hpp"
+
+#include <MassAudit.hpp>
+#include <Statistics.hpp>
+
+#include <vector>
+
+TEST_CASE("Test compensated sum", "[MassAudit]")
+{
+	CompensatedSum sum;
+	double plain = 1e16;
+	sum.add(1e16);
+
+	for(int k = 0; k < 10; ++k)
+	{
+		sum.add(1.);
+		plain += 1.;
+	}
+
+	REQUIRE(plain == 1e16);
+	REQUIRE(sum.value() == 1e16 + 10);
+
+	std::vector<double> values(1001, 0.1);
+	values[0] = -1e16;
+	CompensatedSum block;
+	block.add_values(values.data(), values.size());
+	block.merge(sum);
+	REQUIRE(block.value() == Approx(110.).epsilon(1e-9));
+}
+
+TEST_CASE("Test mass audit", "[MassAudit]")
+{
+	MultiLayerMap mlm(20, 10);
+	mlm.new_layer();
+	mlm.new_layer();
+	SimpleLayerMap& bedrock = mlm.get_field(0);
+	SimpleLayerMap& sediments = mlm.get_field(1);
+	const double area = mlm.cell_size()(0) * mlm.cell_size()(1);
+
+	for(int j = 0; j < 10; ++j)
+	{
+		for(int i = 0; i < 20; ++i)
+		{
+			bedrock.at(i, j) = 1.;
+			sediments.at(i, j) = 0.5;
+		}
+	}
+
+	MassAudit before(mlm, 2, 2);
+	REQUIRE_THROWS_AS(MassAudit(mlm, 0, 1), std::invalid_argument);
+	REQUIRE(before.layer_number() == 2);
+	REQUIRE(before.band_number() == 3);
+
+	SECTION("The cells are split in bands along the borders")
+	{
+		REQUIRE(before.mass(0, 0) == Approx(104 * area));
+		REQUIRE(before.mass(0, 1) == Approx(72 * area));
+		REQUIRE(before.mass(0, 2) == Approx(24 * area));
+		REQUIRE(before.layer_mass(1) == Approx(100 * area));
+		REQUIRE(before.total() == Approx(300 * area));
+	}
+
+	SECTION("The leaks are found in their layer and band")
+	{
+		bedrock.at(0, 5) -= 0.25;
+		bedrock.at(10, 5) -= 0.5;
+		sediments.at(10, 5) += 0.5;
+		MassLeak leak = compare_mass(before, MassAudit(mlm, 2, 2));
+
+		REQUIRE(leak.comparable);
+		REQUIRE(leak.leak(0, 0) == Approx(-0.25 * area));
+		REQUIRE(leak.leak(0, 1) == 0);
+		REQUIRE(leak.leak(0, 2) == Approx(-0.5 * area));
+		REQUIRE(leak.leak(1, 2) == Approx(0.5 * area));
+		REQUIRE(leak.layer_leak(1) == Approx(0.5 * area));
+		REQUIRE(leak.band_leak(0) == Approx(-0.25 * area));
+		REQUIRE(leak.band_leak(2) == Approx(0).margin(1e-9));
+		REQUIRE(leak.total == Approx(-0.25 * area));
+		REQUIRE(leak.relative == Approx(-0.25 / 300));
+	}
+
+	SECTION("Only the measures of the same grid and bands are comparable")
+	{
+		REQUIRE(!compare_mass(before, MassAudit(mlm, 2, 1)).comparable);
+		REQUIRE(!compare_mass(before, MassAudit(MultiLayerMap(20, 11), 2, 2)).comparable);
+
+		mlm.new_layer();
+		MassLeak leak = compare_mass(before, MassAudit(mlm, 2, 2));
+		REQUIRE(leak.comparable);
+		REQUIRE(leak.leaks.size() == 9);
+		REQUIRE(leak.total == 0);
+	}
+}
+
+TEST_CASE("Test mass audit on tiles", "[MassAudit]")
+{
+	// the interior tiles are summed row by row, the others cell by cell
+	MultiLayerMap mlm(300, 200);
+	SimpleLayerMap& layer = mlm.new_layer();
+	double inner = 0;
+	double border = 0;
+
+	for(int j = 0; j < 200; ++j)
+	{
+		for(int i = 0; i < 300; ++i)
+		{
+			layer.at(i, j) = (i * 7 + j * 13) % 17 * 0.1;
+			const bool outside = i < 8 || j < 8 || i >= 292 || j >= 192;
+			(outside ? border : inner) += layer.value(i, j);
+		}
+	}
+
+	MassAudit audit(mlm, 8, 1);
+	const double area = mlm.cell_size()(0) * mlm.cell_size()(1);
+	REQUIRE(audit.mass(0, 0) == Approx(border * area));
+	REQUIRE(audit.mass(0, 1) == Approx(inner * area));
+	REQUIRE(compare_mass(audit, MassAudit(mlm, 8, 1)).total == 0);
+}
@@ -0,0 +1,228 @@
+#include "catch.hpp"
+
+#include <MaterialColumns.hpp>
+#include <MultiLayerMap.hpp>
+#include <Weather/Erosion.hpp>
+#include <Weather/Stratigraphy.hpp>
+
+#include <cmath>
+#include <sstream>
+#include <vector>
+
+TEST_CASE("Test material columns", "[MaterialColumns]")
+{
+	MaterialColumns columns(4, 3, 2);
+	REQUIRE_THROWS_AS(MaterialColumns(4, 3, 0), std::invalid_argument);
+	REQUIRE_THROWS_AS(columns.thickness(4, 0, 0), std::out_of_range);
+	REQUIRE(columns.top_material(1, 1, 0) == -1);
+
+	SECTION("Deposits of the same material extend the top run")
+	{
+		columns.deposit(1, 2, 0, 3, 1.);
+		columns.deposit(1, 2, 0, 3, 0.5);
+		columns.deposit(1, 2, 0, 5, 2.);
+		columns.deposit(1, 2, 0, 5, -1.);
+		columns.deposit(1, 2, 1, 3, 4.);
+
+		REQUIRE(columns.run_number(1, 2, 0) == 2);
+		REQUIRE(columns.runs(1, 2, 0)[0].material == 3);
+		REQUIRE(columns.runs(1, 2, 0)[0].thickness == 1.5);
+		REQUIRE(columns.top_material(1, 2, 0) == 5);
+		REQUIRE(columns.thickness(1, 2, 0) == 3.5);
+		REQUIRE(columns.thickness(1, 2, 0, 3) == 1.5);
+		REQUIRE(columns.thickness(1, 2, 1) == 4.);
+		REQUIRE(columns.total_runs() == 3);
+	}
+
+	SECTION("Removing the top goes through the runs")
+	{
+		columns.deposit(0, 0, 0, 1, 1.);
+		columns.deposit(0, 0, 0, 2, 0.25);
+		columns.deposit(0, 0, 0, 3, 0.5);
+
+		std::vector<MaterialColumns::Run> removed;
+		REQUIRE(columns.remove(0, 0, 0, 1., &removed) == Approx(1.));
+		REQUIRE(removed.size() == 3);
+		REQUIRE(removed[0].material == 3);
+		REQUIRE(removed[1].material == 2);
+		REQUIRE(removed[2].material == 1);
+		REQUIRE(removed[2].thickness == Approx(0.25));
+		REQUIRE(columns.run_number(0, 0, 0) == 1);
+		REQUIRE(columns.thickness(0, 0, 0) == Approx(0.75));
+
+		REQUIRE(columns.remove(0, 0, 0, 2.) == Approx(0.75));
+		REQUIRE(columns.top_material(0, 0, 0) == -1);
+	}
+
+	SECTION("The stacks keep their runs when they move in the arena")
+	{
+		for(int k = 0; k < 40; ++k)
+		{
+			for(int j = 0; j < 3; ++j)
+			{
+				for(int i = 0; i < 4; ++i)
+				{
+					columns.deposit(i, j, k & 1, k, i + j + k + 1);
+				}
+			}
+		}
+
+		const long before = columns.memory();
+		columns.compact();
+		REQUIRE(columns.memory() <= before);
+		REQUIRE(columns.total_runs() == 40 * 12);
+
+		for(int j = 0; j < 3; ++j)
+		{
+			for(int i = 0; i < 4; ++i)
+			{
+				REQUIRE(columns.run_number(i, j, 0) == 20);
+				REQUIRE(columns.runs(i, j, 1)[19].material == 39);
+				REQUIRE(columns.runs(i, j, 1)[19].thickness == i + j + 40);
+			}
+		}
+	}
+
+	SECTION("The memory grows with the runs and not with the thickness")
+	{
+		MaterialColumns thin(64, 64);
+		MaterialColumns thick(64, 64);
+
+		for(int j = 0; j < 64; ++j)
+		{
+			for(int i = 0; i < 64; ++i)
+			{
+				thin.deposit(i, j, 0, 0, 0.001);
+				thick.deposit(i, j, 0, 0, 1000.);
+			}
+		}
+
+		REQUIRE(thin.memory() == thick.memory());
+	}
+}
+
+TEST_CASE("Test materials of a map", "[MaterialColumns]")
+{
+	MultiLayerMap mlm(20, 16, {0, 0}, {2, 1.6});
+	SimpleLayerMap& bedrock = mlm.new_layer();
+
+	for(int j = 0; j < 16; ++j)
+	{
+		for(int i = 0; i < 20; ++i)
+		{
+			bedrock.at(i, j) = std::sin(i * 0.3) + 0.1 * j;
+		}
+	}
+
+	REQUIRE(!mlm.has_materials());
+	REQUIRE_THROWS_AS(mlm.materials(), std::logic_error);
+	REQUIRE_THROWS_AS(mlm.set_materials(MaterialColumns(10, 16)), std::invalid_argument);
+
+	MultiLayerMap layered(mlm);
+	layered.new_layer();
+	layered.new_layer();
+	REQUIRE_THROWS_AS(layered.set_materials(MaterialColumns(20, 16, 2)), std::invalid_argument);
+
+	Stratigraphy strata({-0.5, 0., 0.6}, {0.02, 0.05, 0.01, 0.04});
+	strata.set_tilt(0.2, 0., {1., 0.8});
+	MaterialColumns columns(20, 16, 2);
+	strata.fill_stack(columns, 0, bedrock, -3.);
+	mlm.set_materials(std::move(columns));
+
+	SECTION("The stacks follow the strata up to the bedrock")
+	{
+		for(int j = 0; j < 16; ++j)
+		{
+			for(int i = 0; i < 20; ++i)
+			{
+				const Eigen::Vector2d p = mlm.world_position(i, j);
+				REQUIRE(mlm.materials().thickness(i, j, 0) == Approx(bedrock.value(i, j) + 3.));
+				REQUIRE(mlm.materials().top_material(i, j, 0) == strata.material(p(0), p(1), bedrock.value(i, j)));
+				REQUIRE(mlm.materials().runs(i, j, 0)[0].material == 0);
+			}
+		}
+	}
+
+	SECTION("The copies share the materials until they modify them")
+	{
+		MultiLayerMap copy(mlm);
+		REQUIRE(copy.shares_materials(mlm));
+		copy.mutable_materials().deposit(0, 0, 1, 2, 1.);
+		REQUIRE(!copy.shares_materials(mlm));
+		REQUIRE(mlm.materials().run_number(0, 0, 1) == 0);
+	}
+
+	SECTION("The eroded materials become sediments of the same material")
+	{
+		const std::vector<double> erodibilities = {0.02, 0.05, 0.01, 0.04};
+		MultiLayerMap before(mlm);
+		erode_materials_using_exposure(mlm, erodibilities);
+		REQUIRE(mlm.get_layer_number() == 2);
+		double eroded = 0;
+
+		for(int j = 0; j < 16; ++j)
+		{
+			for(int i = 0; i < 20; ++i)
+			{
+				const double sediments = mlm.get_field(1).value(i, j);
+				eroded += sediments;
+				REQUIRE(mlm.value(i, j) == Approx(before.value(i, j)));
+				REQUIRE(mlm.materials().thickness(i, j, 1) == Approx(sediments));
+				REQUIRE(mlm.materials().thickness(i, j, 0) == Approx(mlm.get_field(0).value(i, j) + 3.));
+
+				if(sediments > 0)
+				{
+					REQUIRE(mlm.materials().thickness(i, j, 1, before.materials().top_material(i, j, 0)) > 0);
+				}
+			}
+		}
+
+		REQUIRE(eroded > 0);
+		REQUIRE(before.materials().run_number(0, 0, 1) == 0);
+	}
+
+	SECTION("The transports move the materials with the sediments")
+	{
+		const std::vector<double> erodibilities = {0.2, 0.5, 0.1, 0.4};
+		erode_materials_using_exposure(mlm, erodibilities);
+		const MultiLayerMap eroded(mlm);
+		transport(mlm, 5.);
+		transport_unstable_first(mlm, 2.);
+		REQUIRE(!mlm.shares_materials(eroded));
+		double moved = 0;
+
+		for(int j = 0; j < 16; ++j)
+		{
+			for(int i = 0; i < 20; ++i)
+			{
+				moved += std::abs(mlm.get_field(1).value(i, j) - eroded.get_field(1).value(i, j));
+				REQUIRE(mlm.materials().thickness(i, j, 1) == Approx(mlm.get_field(1).value(i, j)).margin(1e-12));
+			}
+		}
+
+		REQUIRE(moved > 0);
+	}
+
+	SECTION("The materials are written and read with the map")
+	{
+		erode_materials_using_exposure(mlm, {0.02, 0.05, 0.01, 0.04});
+		std::stringstream stream;
+		stream.precision(17);
+		stream << mlm;
+
+		MultiLayerMap read(1, 1);
+		stream >> read;
+		REQUIRE(read.has_materials());
+		REQUIRE(read.materials().total_runs() == mlm.materials().total_runs());
+		REQUIRE(read.materials().thickness(7, 5, 0) == mlm.materials().thickness(7, 5, 0));
+		REQUIRE(read.materials().top_material(7, 5, 1) == mlm.materials().top_material(7, 5, 1));
+
+		// a map without materials forgets the ones of the map it is read into
+		MultiLayerMap plain(mlm);
+		plain.clear_materials();
+		std::stringstream plain_stream;
+		plain_stream << plain;
+		plain_stream >> read;
+		REQUIRE(!read.has_materials());
+	}
+}
@@ -0,0 +1,96 @@
+#include "catch.hpp"
+
+#include <Eigen/Core>
+#include <map>
+
+#include <SimpleLayerMap.hpp>
+#include <Noise/TerrainNoise.hpp>
+#include <Mesh/LodMesh.hpp>
+
+TEST_CASE("Test LOD mesh generation", "[Mesh]")
+{
+	SECTION("A flat field is two triangles")
+	{
+		SimpleLayerMap sf(65, 65, { -5, -5}, {5, 5});
+		sf.set_all(1.0);
+		Mesh mesh = generate_lod_mesh(sf, 0.01);
+		REQUIRE(mesh.vertex_number() == 4);
+		REQUIRE(mesh.triangle_number() == 2);
+	}
+	SECTION("A null tolerance keeps all the cells")
+	{
+		SimpleLayerMap sf(13, 9);
+		TerrainNoise t_noise(10.0, 1.0 / 5.0, 4);
+
+		for(int j = 0; j < 9; ++j)
+		{
+			for(int i = 0; i < 13; i++)
+			{
+				sf.at(i, j) = t_noise.get_noise(i, j);
+			}
+		}
+
+		Mesh mesh = generate_lod_mesh(sf, 0);
+		REQUIRE(mesh.vertex_number() == 13 * 9);
+		REQUIRE(mesh.triangle_number() == 2 * 12 * 8);
+	}
+	SECTION("The mesh covers the field without cracks")
+	{
+		SimpleLayerMap sf(50, 37, { -5, -5}, {5, 5});
+		TerrainNoise t_noise(10.0, 1.0 / 40.0, 6);
+
+		for(int j = 0; j < 37; ++j)
+		{
+			for(int i = 0; i < 50; i++)
+			{
+				sf.at(i, j) = t_noise.get_noise(i, j);
+			}
+		}
+
+		Mesh mesh = generate_lod_mesh(sf, 0.1);
+		REQUIRE(mesh.triangle_number() < 2 * 49 * 36);
+
+		// each edge is shared by two triangles with opposite directions, except on the border of the field
+		std::map<std::pair<unsigned int, unsigned int>, int> edges;
+		double area = 0;
+
+		for(int t = 0; t < mesh.triangle_number(); ++t)
+		{
+			const double* p[3];
+
+			for(int k = 0; k < 3; ++k)
+			{
+				unsigned int a = mesh.indices[3 * t + k];
+				unsigned int b = mesh.indices[3 * t + (k + 1) % 3];
+				++edges[std::make_pair(a, b)];
+				p[k] = &mesh.positions[3 * mesh.indices[3 * t + k]];
+			}
+
+			// the field is in the xz plane of the mesh
+			double signed_area = ((p[1][0] - p[0][0]) * (p[2][2] - p[0][2]) - (p[2][0] - p[0][0]) * (p[1][2] - p[0][2])) / 2;
+			REQUIRE(signed_area > 0);
+			area += signed_area;
+		}
+
+		Eigen::Vector2d cell = sf.cell_size();
+		REQUIRE(area == Approx(49 * 36 * cell[0] * cell[1]));
+
+		for(const auto& e : edges)
+		{
+			REQUIRE(e.second == 1);
+
+			if(edges.count(std::make_pair(e.first.second, e.first.first)) == 0)
+			{
+				const double* a = &mesh.positions[3 * e.first.first];
+				const double* b = &mesh.positions[3 * e.first.second];
+				bool border_x = (a[0] == b[0]) && (a[0] == Approx(-5) || a[0] == Approx(-5 + 49 * cell[0]));
+				bool border_z = (a[2] == b[2]) && (a[2] == Approx(-5) || a[2] == Approx(-5 + 36 * cell[1]));
+				REQUIRE((border_x || border_z));
+			}
+		}
+	}
+	SECTION("Screen space tolerance")
+	{
+		REQUIRE(screen_space_tolerance(1, 10, 2 * atan(0.5), 1000) == Approx(0.01));
+	}
+}
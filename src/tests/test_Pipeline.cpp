@@ -0,0 +1,115 @@
+#include "catch.hpp"
+
+#include <Eigen/Core>
+#include <sstream>
+
+#include <Pipeline.hpp>
+
+TEST_CASE("Test pipeline parsing", "[Pipeline]")
+{
+	SECTION("Stages and parameters are read in order")
+	{
+		std::istringstream input(
+		    "# a comment\n"
+		    "[pipeline]\n"
+		    "seed = 3\n"
+		    "[terrain]\n"
+		    "width = 20   # trailing comment\n"
+		    "[transport]\n"
+		    "rest_angle = 25.5\n"
+		    "[erosion]\n"
+		    "skip = yes\n"
+		    "[layered_erosion]\n"
+		    "top_heights = 0.1 0.5\n");
+		Pipeline pipeline = Pipeline::parse(input, "test");
+		REQUIRE(pipeline.name() == "test");
+		REQUIRE(pipeline.settings().get_int("seed") == 3);
+		REQUIRE(pipeline.stage_number() == 4);
+		REQUIRE(pipeline.stage(0).type() == "terrain");
+		REQUIRE(pipeline.stage(0).get_int("width") == 20);
+		REQUIRE(pipeline.stage(0).get_int("height", 7) == 7);
+		REQUIRE(pipeline.stage(1).get_double("rest_angle") == 25.5);
+		REQUIRE(pipeline.stage(2).get_bool("skip"));
+		REQUIRE(pipeline.stage(3).get_doubles("top_heights") == std::vector<double>({0.1, 0.5}));
+		REQUIRE_THROWS(pipeline.stage(1).get_int("rest_angle"));
+	}
+	SECTION("Errors are reported")
+	{
+		std::istringstream unknown_section("[teraain]\n");
+		std::istringstream unknown_key("[terrain]\nwidht = 3\n");
+		std::istringstream no_section("width = 3\n");
+		REQUIRE_THROWS_AS(Pipeline::parse(unknown_section), std::invalid_argument);
+		REQUIRE_THROWS_AS(Pipeline::parse(unknown_key), std::invalid_argument);
+		REQUIRE_THROWS_AS(Pipeline::parse(no_section), std::invalid_argument);
+	}
+}
+
+TEST_CASE("Test pipeline run", "[Pipeline]")
+{
+	std::string description =
+	    "[pipeline]\n"
+	    "output = test_pipeline_\n"
+	    "checkpoints = true\n"
+	    "[terrain]\n"
+	    "width = 30\n"
+	    "amplitude = 2\n"
+	    "frequency = 0.05\n"
+	    "[erosion]\n"
+	    "method = constant\n"
+	    "k = 0.1\n"
+	    "[transport]\n"
+	    "skip = true\n"
+	    "[export]\n"
+	    "obj = false\n"
+	    "pgm = false\n";
+	std::istringstream input(description);
+	Pipeline pipeline = Pipeline::parse(input);
+	MultiLayerMap mlm(2, 2);
+	std::ostringstream log;
+	std::vector<StageReport> reports = pipeline.run(mlm, log);
+
+	REQUIRE(reports.size() == 4);
+	REQUIRE(!reports[0].skipped);
+	REQUIRE(reports[2].skipped);
+	REQUIRE(mlm.grid_width() == 30);
+	REQUIRE(mlm.get_layer_number() == 2);
+	REQUIRE(mlm.get_field(1).value(4, 4) == Approx(0.1));
+	REQUIRE(reports[0].erosion.iterations == 0);
+	REQUIRE(reports[1].erosion.iterations == 1);
+	REQUIRE(reports[1].erosion.mass_moved == Approx(0.1 * 30 * 30));
+
+	SECTION("A resumed run starts after the last checkpoint")
+	{
+		std::istringstream resumed_input(description + "[pipeline]\noutput = test_pipeline_\nresume = true\n");
+		Pipeline resumed = Pipeline::parse(resumed_input);
+		MultiLayerMap resumed_mlm(2, 2);
+		reports = resumed.run(resumed_mlm, log);
+		REQUIRE(reports[0].resumed);
+		REQUIRE(reports[1].resumed);
+		REQUIRE(!reports[3].resumed);
+		REQUIRE(resumed_mlm.get_field(1).value(4, 4) == Approx(0.1));
+		REQUIRE(resumed_mlm.get_field(0).value(4, 4) == Approx(mlm.get_field(0).value(4, 4)));
+	}
+
+	SECTION("An audited run reports the mass leaks of each stage")
+	{
+		std::istringstream audited_input(description + "[pipeline]\noutput = test_pipeline_audit_\ncheckpoints = false\naudit = true\n");
+		Pipeline audited = Pipeline::parse(audited_input);
+		MultiLayerMap audited_mlm(2, 2);
+		std::ostringstream audit_log;
+		reports = audited.run(audited_mlm, audit_log);
+		const double area = audited_mlm.cell_size()(0) * audited_mlm.cell_size()(1);
+
+		REQUIRE(!reports[0].mass.comparable);
+		REQUIRE(reports[1].mass.comparable);
+		REQUIRE(reports[1].mass.layer_leak(0) == Approx(-0.1 * 30 * 30 * area));
+		REQUIRE(reports[1].mass.layer_leak(1) == Approx(0.1 * 30 * 30 * area));
+		REQUIRE(reports[1].mass.total == Approx(0).margin(1e-9));
+		REQUIRE(!reports[2].mass.comparable);
+		REQUIRE(reports[3].mass.total == 0);
+		REQUIRE(audit_log.str().find("mass leak") != std::string::npos);
+		// the bedrock eroded into sediments is a transfer between the layers, not a leak
+		REQUIRE(audit_log.str().find("net transfer [") != std::string::npos);
+		REQUIRE(audit_log.str().find("layer 0 [") == std::string::npos);
+	}
+}
@@ -0,0 +1,64 @@
+#include "catch.hpp"
+
+#include <fstream>
+#include <sstream>
+
+#include <Profiler.hpp>
+#include <ThreadPool.hpp>
+
+namespace
+{
+void profiled_function()
+{
+	PROFILE_SCOPE("test.scope");
+	PROFILE_COUNT("test.counter", 2);
+}
+}
+
+TEST_CASE("Test profiler", "[Profiler]")
+{
+	Profiler::reset();
+
+	SECTION("Nothing is recorded when disabled")
+	{
+		Profiler::enable(false);
+		profiled_function();
+		REQUIRE(Profiler::counter("test.counter") == 0);
+		std::ostringstream summary;
+		Profiler::write_summary(summary);
+		REQUIRE(summary.str().find("test.scope") == std::string::npos);
+	}
+	SECTION("Scopes and counters of all the threads are recorded")
+	{
+		Profiler::enable();
+		parallel_for(0, 10, [](int b, int e)
+		{
+			for(int k = b; k < e; ++k)
+			{
+				profiled_function();
+			}
+		});
+		{
+			ProfileScope scope(std::string("test.") + "computed");
+		}
+		Profiler::enable(false);
+		REQUIRE(Profiler::counter("test.counter") == 20);
+		REQUIRE(Profiler::counter("test.unknown") == 0);
+
+		std::ostringstream summary;
+		Profiler::write_summary(summary);
+		REQUIRE(summary.str().find("test.scope") != std::string::npos);
+		REQUIRE(summary.str().find("test.computed") != std::string::npos);
+
+		Profiler::write_trace("test_profiler.json");
+		std::ifstream input("test_profiler.json");
+		std::stringstream trace;
+		trace << input.rdbuf();
+		REQUIRE(trace.str().find("{\"traceEvents\":[") == 0);
+		REQUIRE(trace.str().find("\"name\":\"test.scope\",\"cat\":\"terrain\",\"ph\":\"X\"") != std::string::npos);
+		REQUIRE(trace.str().find("\"name\":\"test.counter\",\"ph\":\"C\"") != std::string::npos);
+
+		Profiler::reset();
+		REQUIRE(Profiler::counter("test.counter") == 0);
+	}
+}
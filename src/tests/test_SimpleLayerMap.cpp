@@ -2,6 +2,15 @@
 
 #include <Eigen/Core>
 
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <limits>
+#include <thread>
+
+#include <MultiLayerMap.hpp>
 #include <SimpleLayerMap.hpp>
 #include <Noise/TerrainNoise.hpp>
 
@@ -126,6 +135,117 @@ TEST_CASE("Test if Obj exporter", "[SimpleLayerMap]")
 	sf.set_value(2, 1, 1);
 	sf.set_value(2, 2, 1.5);
 	sf.export_as_obj("test3.obj");
+
+	SECTION("The faces are in the order of the first exporter")
+	{
+		std::ifstream obj("test3.obj");
+		std::vector<std::string> faces;
+		std::string line;
+
+		while(std::getline(obj, line))
+		{
+			if(line[0] == 'f')
+			{
+				faces.push_back(line);
+			}
+		}
+
+		// the faces as written by the stream based exporter, with indices starting at 1
+		std::vector<std::string> expected;
+
+		for(int j = 0; j < 2; ++j)
+		{
+			for(int i = 1; i < 3; ++i)
+			{
+				const int ids[6] = {j * 3 + i, j * 3 + i + 1, (j + 1) * 3 + i, j * 3 + i + 1, (j + 1) * 3 + i + 1, (j + 1) * 3 + i};
+
+				for(int t = 0; t < 2; ++t)
+				{
+					std::string face = "f";
+
+					for(int k = 3 * t; k < 3 * t + 3; ++k)
+					{
+						const std::string id = std::to_string(ids[k]);
+						face += " " + id + "/" + id + "/" + id;
+					}
+
+					expected.push_back(face);
+				}
+			}
+		}
+
+		REQUIRE(faces == expected);
+	}
+}
+
+TEST_CASE("Test mesh exporters", "[SimpleLayerMap]")
+{
+	SimpleLayerMap sf(70, 70, { -5, -5}, {5, 5});
+	TerrainNoise t_noise(10.0, 1.0 / 20.0, 4);
+
+	for(int j = 0; j < 70; ++j)
+	{
+		for(int i = 0; i < 70; i++)
+		{
+			sf.at(i, j) = t_noise.get_noise(i, j);
+		}
+	}
+
+	SECTION("Normals of rows are the same as the normals of cells")
+	{
+		std::vector<double> heights(3 * 70);
+		std::vector<double> normals(9 * 70);
+		sf.get_rows_normals(67, 70, heights.data(), normals.data());
+
+		for(int i = 0; i < 70; ++i)
+		{
+			Eigen::Vector3d n = sf.normal(i, 68);
+			REQUIRE(heights[70 + i] == sf.value(i, 68));
+			REQUIRE(normals[3 * (70 + i)] == Approx(n[0]));
+			REQUIRE(normals[3 * (70 + i) + 1] == Approx(n[1]));
+			REQUIRE(normals[3 * (70 + i) + 2] == Approx(n[2]));
+		}
+	}
+	SECTION("Binary files have the expected size")
+	{
+		sf.export_as_ply("test.ply");
+		sf.export_as_binary_mesh("test.tgm");
+		std::ifstream ply("test.ply", std::ifstream::binary | std::ifstream::ate);
+		std::ifstream tgm("test.tgm", std::ifstream::binary | std::ifstream::ate);
+		long vertices = 70 * 70;
+		long triangles = 2 * 69 * 69;
+		std::string header = "ply\nformat binary_little_endian 1.0\nelement vertex 4900\n"
+		                     "property float x\nproperty float y\nproperty float z\n"
+		                     "property float nx\nproperty float ny\nproperty float nz\n"
+		                     "property float s\nproperty float t\nelement face 9522\n"
+		                     "property list uchar uint vertex_indices\nend_header\n";
+		REQUIRE(ply.tellg() == header.size() + vertices * 32 + triangles * 13);
+		REQUIRE(tgm.tellg() == 20 + vertices * 18 + triangles * 3 * 2);
+	}
+	SECTION("Binary values are little endian")
+	{
+		sf.export_as_binary_mesh("test.tgm");
+		std::ifstream tgm("test.tgm", std::ifstream::binary);
+		std::vector<unsigned char> bytes(24);
+		tgm.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+
+		auto read_uint = [&bytes](const int offset)
+		{
+			return std::uint32_t(bytes[offset]) | std::uint32_t(bytes[offset + 1]) << 8
+			       | std::uint32_t(bytes[offset + 2]) << 16 | std::uint32_t(bytes[offset + 3]) << 24;
+		};
+
+		REQUIRE(std::string(bytes.begin(), bytes.begin() + 4) == "TGMB");
+		REQUIRE(read_uint(4) == 1);
+		REQUIRE(read_uint(8) == 4900);
+		REQUIRE(read_uint(12) == 6 * 69 * 69);
+		REQUIRE(read_uint(16) == 2);
+
+		const std::uint32_t bits = read_uint(20);
+		float x;
+		std::memcpy(&x, &bits, sizeof(x));
+		REQUIRE(x == -5.f);
+	}
 }
 
 TEST_CASE("Test if pgm exporter and slope_map getter works", "[ScalardField]")
@@ -145,4 +265,336 @@ TEST_CASE("Test if pgm exporter and slope_map getter works", "[ScalardField]")
 	sf.export_as_pgm("Test_pgm.pgm");
 	SimpleLayerMap::generate_slope_map(sf).export_as_pgm("Test_pgm_slope.pgm");
 	SimpleLayerMap::generate_slope_map(sf).export_as_obj("Test_pgm_slope.obj");
-}
\ No newline at end of file
+}
+TEST_CASE("Test SimpleLayerMap version", "[SimpleLayerMap]")
+{
+	SimpleLayerMap sf(2, 2);
+	unsigned long version = sf.version();
+
+	REQUIRE(sf.version() == version);
+	REQUIRE(sf.value(0, 0) == 0);
+	REQUIRE(sf.version() == version);
+
+	SECTION("Modifications give a new version")
+	{
+		sf.set_value(0, 0, 1.0);
+		REQUIRE(sf.version() > version);
+		version = sf.version();
+		sf += 1.0;
+		REQUIRE(sf.version() > version);
+	}
+	SECTION("Copies share the version until modified")
+	{
+		SimpleLayerMap sf2(sf);
+		REQUIRE(sf2.version() == version);
+		sf2.at(1, 1) = 2.0;
+		REQUIRE(sf2.version() > version);
+		REQUIRE(sf.version() == version);
+	}
+	SECTION("Readers on several threads all see the modification")
+	{
+		sf.at(0, 1) = 3.0;
+		std::vector<unsigned long> versions(8);
+		std::vector<std::thread> readers;
+
+		for(int t = 0; t < 8; ++t)
+		{
+			readers.emplace_back([&sf, &versions, t]()
+			{
+				versions[t] = sf.version();
+			});
+		}
+
+		for(std::thread& reader : readers)
+		{
+			reader.join();
+		}
+
+		const unsigned long renewed = sf.version();
+		REQUIRE(renewed > version);
+		REQUIRE(sf.version() == renewed);
+
+		for(const unsigned long v : versions)
+		{
+			REQUIRE(v > version);
+			REQUIRE(v <= renewed);
+		}
+	}
+}
+
+TEST_CASE("Test SimpleLayerMap tiles", "[SimpleLayerMap]")
+{
+	SimpleLayerMap sf(150, 70, {0, 0}, {1, 1});
+
+	for(int j = 0; j < 70; ++j)
+	{
+		for(int i = 0; i < 150; ++i)
+		{
+			sf.at(i, j) = i + 1000 * j;
+		}
+	}
+
+	REQUIRE(sf.storage().tile_number() == 3 * 2);
+	REQUIRE(sf.storage().shared_tiles() == 0);
+	REQUIRE(sf.storage().to_vector()[149 + 150 * 69] == 149 + 1000 * 69);
+	REQUIRE(sf.statistics().max == 149 + 1000 * 69);
+	REQUIRE(sf.statistics().sum == Approx(70 * 149 * 150 / 2. + 150 * 1000 * 69 * 70 / 2.));
+
+	SECTION("Copies share the tiles until modified")
+	{
+		SimpleLayerMap copy(sf);
+		REQUIRE(sf.storage().shared_tiles() == 6);
+		copy.at(100, 65) = -1;
+		REQUIRE(copy.storage().shared_tiles() == 5);
+		REQUIRE_FALSE(copy.storage().is_shared(copy.storage().tile_index(100, 65)));
+		REQUIRE(copy.value(100, 65) == -1);
+		REQUIRE(sf.value(100, 65) == 100 + 1000 * 65);
+		REQUIRE(copy.value(101, 65) == 101 + 1000 * 65);
+		copy += 1.0;
+		REQUIRE(copy.storage().shared_tiles() == 0);
+		REQUIRE(sf.value(0, 0) == 0);
+		REQUIRE(copy.value(0, 0) == 1);
+	}
+	SECTION("Positions past the end of a row are on the next row")
+	{
+		REQUIRE(sf.value(150, 3) == sf.value(0, 4));
+		REQUIRE(sf.value(-1, 3) == sf.value(149, 2));
+		REQUIRE_THROWS(sf.value(0, 70));
+		REQUIRE_THROWS(sf.value(-1, 0));
+	}
+	SECTION("Values given row after row are split in tiles")
+	{
+		SimpleLayerMap rebuilt(sf, sf.storage().to_vector());
+		REQUIRE(rebuilt.value(149, 69) == sf.value(149, 69));
+		REQUIRE(rebuilt.value(64, 64) == sf.value(64, 64));
+		REQUIRE_THROWS_AS(SimpleLayerMap(sf, std::vector<double>(10)), std::invalid_argument);
+	}
+}
+
+TEST_CASE("Test SimpleLayerMap surface maps", "[SimpleLayerMap]")
+{
+	// wider than a tile, with a last tile partly covered, and not square
+	MultiLayerMap mlm(130, 67, {0, 0}, {65, 100});
+	TerrainNoise t_noise(10.0, 1.0 / 20.0, 4);
+	SimpleLayerMap& bedrock = mlm.new_layer();
+
+	for(int j = 0; j < 67; ++j)
+	{
+		for(int i = 0; i < 130; i++)
+		{
+			bedrock.at(i, j) = t_noise.get_noise(i, j);
+		}
+	}
+
+	SimpleLayerMap& sand = mlm.new_layer();
+	sand.at(70, 30) = 2;
+	sand.at(0, 66) = 1;
+	const SimpleLayerMap terrain = mlm.generate_field();
+
+	SECTION("Rows are read from the tiles and summed over the layers")
+	{
+		std::vector<double> row(130);
+		std::vector<double> summed(130);
+
+		for(int j : {0, 30, 66})
+		{
+			terrain.get_row(j, row.data());
+			mlm.get_row(j, summed.data());
+
+			for(int i = 0; i < 130; ++i)
+			{
+				REQUIRE(row[i] == terrain.value(i, j));
+				REQUIRE(summed[i] == mlm.value(i, j));
+			}
+		}
+	}
+	SECTION("The maps are the same as the values of the cells, borders included")
+	{
+		const SurfaceMaps maps = SimpleLayerMap::generate_surface_maps(mlm);
+		const SimpleLayerMap slopes = SimpleLayerMap::generate_slope_map(terrain);
+		const std::vector<SimpleLayerMap> normals = SimpleLayerMap::generate_normal_maps(terrain);
+
+		for(int j = 0; j < 67; ++j)
+		{
+			for(int i = 0; i < 130; ++i)
+			{
+				const Eigen::Vector2d g = terrain.gradient(i, j);
+				const Eigen::Vector3d n = terrain.normal(i, j);
+				REQUIRE(maps.gradient_x.value(i, j) == Approx(g[0]).margin(1e-12));
+				REQUIRE(maps.gradient_y.value(i, j) == Approx(g[1]).margin(1e-12));
+				REQUIRE(maps.slope.value(i, j) == Approx(terrain.slope(i, j)).margin(1e-12));
+				REQUIRE(slopes.value(i, j) == Approx(terrain.slope(i, j)).margin(1e-12));
+				REQUIRE(maps.aspect.value(i, j) == Approx(std::atan2(- g[1], - g[0])).margin(1e-9));
+				REQUIRE(maps.normal_x.value(i, j) == Approx(n[0]).margin(1e-12));
+				REQUIRE(maps.normal_y.value(i, j) == Approx(n[1]).margin(1e-12));
+				REQUIRE(maps.normal_z.value(i, j) == Approx(n[2]));
+				REQUIRE(normals[0].value(i, j) == Approx(n[0]).margin(1e-12));
+				REQUIRE(normals[2].value(i, j) == Approx(n[2]));
+			}
+		}
+	}
+	SECTION("Flat cells have no aspect")
+	{
+		SimpleLayerMap flat(10, 10);
+		flat.set_all(3);
+		const SimpleLayerMap aspect = SimpleLayerMap::generate_aspect_map(flat);
+		REQUIRE(aspect.value(0, 0) == 0);
+		REQUIRE(aspect.value(5, 5) == 0);
+	}
+}
+
+TEST_CASE("Test layer aggregation", "[MultiLayerMap]")
+{
+	// six layers, so a block of four tiles and two single tiles, on a grid ending inside its last tiles
+	MultiLayerMap mlm(100, 70, {0, 0}, {1, 1});
+	TerrainNoise t_noise(10.0, 1.0 / 20.0, 4);
+
+	for(int l = 0; l < 6; ++l)
+	{
+		SimpleLayerMap& layer = mlm.new_layer();
+
+		for(int j = 0; j < 70; ++j)
+		{
+			for(int i = 0; i < 100; i++)
+			{
+				layer.at(i, j) = (l == 0) ? t_noise.get_noise(i, j) : 0.01 * ((i * (l + 3) + j) % 7);
+			}
+		}
+	}
+
+	SECTION("The terrain is the sum of the layers of each cell")
+	{
+		const SimpleLayerMap terrain = mlm.generate_field();
+
+		for(int j = 0; j < 70; ++j)
+		{
+			for(int i = 0; i < 100; ++i)
+			{
+				REQUIRE(terrain.value(i, j) == mlm.value(i, j));
+			}
+		}
+	}
+	SECTION("The normalized layers are translated and scaled together")
+	{
+		const SimpleLayerMap terrain = mlm.generate_field();
+		const double min = mlm.get_field(0).get_min();
+		const double range = terrain.get_max() - min;
+		const MultiLayerMap output = normalized(mlm);
+
+		REQUIRE(output.get_field(0).value(0, 0) == Approx((mlm.get_field(0).value(0, 0) - min) / range));
+		REQUIRE(output.get_field(5).value(99, 69) == Approx(mlm.get_field(5).value(99, 69) / range));
+		REQUIRE(output.generate_field().get_max() == Approx(1.));
+		REQUIRE(output.get_field(0).get_min() == Approx(0.).margin(1e-12));
+		REQUIRE(mlm.get_field(3).value(64, 64) == Approx(0.01 * ((64 * 6 + 64) % 7)));
+	}
+}
+
+TEST_CASE("Test SimpleLayerMap empty tiles", "[SimpleLayerMap]")
+{
+	MultiLayerMap mlm(150, 70, {0, 0}, {1, 1});
+	mlm.new_layer().set_all(2);
+	SimpleLayerMap& sediments = mlm.new_layer();
+	sediments.at(10, 10) = 0.5;
+	sediments.at(140, 69) = 0.25;
+
+	REQUIRE(sediments.storage().empty_tiles() == 4);
+	REQUIRE(sediments.storage().shared_tiles() == 0);
+	REQUIRE(sediments.value(100, 10) == 0);
+
+	SECTION("The empty tiles are copied when written and released when back to zero")
+	{
+		SimpleLayerMap copy(mlm.get_field(1));
+		copy.at(100, 10) = 1;
+		REQUIRE(copy.storage().empty_tiles() == 3);
+		REQUIRE(mlm.get_field(1).value(100, 10) == 0);
+		REQUIRE(SimpleLayerMap(static_cast<Grid2d>(copy)).value(100, 10) == 0);
+
+		const unsigned long version = copy.version();
+		copy.at(100, 10) = 0;
+		copy.at(10, 10) = 0;
+		const unsigned long zeroed = copy.version();
+		REQUIRE(zeroed != version);
+		REQUIRE(copy.compact() == 2);
+		REQUIRE(copy.storage().empty_tiles() == 5);
+		REQUIRE(copy.version() == zeroed);
+		REQUIRE(copy.value(140, 69) == 0.25);
+	}
+	SECTION("The arithmetic mixes empty and allocated tiles")
+	{
+		SimpleLayerMap sum = mlm.get_field(0) + mlm.get_field(1);
+		REQUIRE(sum.value(10, 10) == 2.5);
+		REQUIRE(sum.value(100, 10) == 2);
+
+		SimpleLayerMap product(mlm.get_field(1));
+		product *= mlm.get_field(0);
+		product *= 3.;
+		REQUIRE(product.value(10, 10) == 3);
+		REQUIRE(product.storage().empty_tiles() == 4);
+
+		SimpleLayerMap masked(mlm.get_field(0));
+		masked *= mlm.get_field(1);
+		REQUIRE(masked.storage().empty_tiles() == 4);
+		REQUIRE(masked.value(140, 69) == 0.5);
+		REQUIRE(masked.value(0, 0) == 0);
+	}
+	SECTION("The products of the empty tiles keep NaN and infinite values")
+	{
+		SimpleLayerMap scaled(mlm.get_field(1));
+		scaled *= std::numeric_limits<double>::infinity();
+		REQUIRE(std::isinf(scaled.value(10, 10)));
+		REQUIRE(std::isnan(scaled.value(100, 10)));
+		REQUIRE(scaled.storage().empty_tiles() == 0);
+
+		SimpleLayerMap nan(mlm.get_field(0));
+		nan.at(100, 10) = std::numeric_limits<double>::quiet_NaN();
+		SimpleLayerMap product(mlm.get_field(1));
+		product *= nan;
+		REQUIRE(std::isnan(product.value(100, 10)));
+		REQUIRE(product.value(101, 10) == 0);
+		REQUIRE(product.storage().empty_tiles() == 3);
+
+		nan *= mlm.get_field(1);
+		REQUIRE(std::isnan(nan.value(100, 10)));
+		REQUIRE(nan.value(10, 10) == 1);
+		REQUIRE(nan.storage().empty_tiles() == 3);
+	}
+	SECTION("The cells past the border of the grid do not keep the products from being empty")
+	{
+		SimpleLayerMap padded(mlm.get_field(0));
+		TileStorage& storage = padded.mutable_storage();
+		storage.mutable_tile(storage.tile_index(160, 10))[storage.tile_offset(160, 10)] = std::numeric_limits<double>::quiet_NaN();
+		SimpleLayerMap product(mlm.get_field(1));
+		product *= padded;
+		REQUIRE(product.storage().empty_tiles() == 4);
+	}
+	SECTION("The normalized layers of a flat terrain keep no empty tile")
+	{
+		MultiLayerMap flat(150, 70, {0, 0}, {1, 1});
+		flat.new_layer().set_all(2);
+		flat.new_layer();
+		const MultiLayerMap output = normalized(flat);
+		REQUIRE(std::isnan(output.get_field(0).value(0, 0)));
+		REQUIRE(std::isnan(output.get_field(1).value(0, 0)));
+		REQUIRE(output.get_field(1).storage().empty_tiles() == 0);
+	}
+	SECTION("The sums of the layers skip the empty tiles")
+	{
+		const SimpleLayerMap terrain = mlm.generate_field();
+		REQUIRE(terrain.value(10, 10) == 2.5);
+		REQUIRE(terrain.value(100, 10) == 2);
+		REQUIRE(terrain.storage().empty_tiles() == 0);
+
+		MultiLayerMap empty(150, 70, {0, 0}, {1, 1});
+		empty.new_layer();
+		empty.new_layer();
+		REQUIRE(empty.generate_field().storage().empty_tiles() == 6);
+	}
+	SECTION("The values given row after row keep the tiles of zeros empty")
+	{
+		const SimpleLayerMap rebuilt(sediments, sediments.storage().to_vector());
+		REQUIRE(rebuilt.storage().empty_tiles() == 4);
+		REQUIRE(rebuilt.value(10, 10) == 0.5);
+		sediments.set_all(0);
+		REQUIRE(sediments.storage().empty_tiles() == 6);
+	}
+}
@@ -0,0 +1,102 @@
+#include "catch.hpp"
+
+#include <Eigen/Core>
+
+#include <limits>
+
+#include <SimpleLayerMap.hpp>
+#include <MultiLayerMap.hpp>
+
+TEST_CASE("Test field statistics", "[Statistics]")
+{
+	SimpleLayerMap sf(3, 3);
+
+	for(int j = 0; j < 3; ++j)
+	{
+		for(int i = 0; i < 3; ++i)
+		{
+			sf.set_value(i, j, i + 3 * j);
+		}
+	}
+
+	SECTION("Single pass statistics are correct")
+	{
+		FieldStatistics stats = sf.statistics();
+		REQUIRE(stats.count == 9);
+		REQUIRE(stats.min == 0);
+		REQUIRE(stats.max == 8);
+		REQUIRE(stats.sum == 36);
+		REQUIRE(stats.mean == Approx(4));
+		REQUIRE(stats.variance == Approx(60. / 9.));
+		REQUIRE(sf.get_range() == 8);
+	}
+	SECTION("Merged statistics are the same as the statistics of all the values")
+	{
+		std::vector<double> values = {0, 1, 2, 3, 4, 5, 6, 7, 8};
+		FieldStatistics first;
+		FieldStatistics second;
+		first.add_values(values.data(), 4);
+		second.add_values(values.data() + 4, 5);
+		first.merge(second);
+		REQUIRE(first.count == 9);
+		REQUIRE(first.mean == Approx(4));
+		REQUIRE(first.variance == Approx(60. / 9.));
+	}
+	SECTION("Generic statistics match the layer ones")
+	{
+		MultiLayerMap mlm(3, 3);
+		mlm.add_field(sf);
+		mlm.add_field(sf);
+		FieldStatistics stats = mlm.statistics();
+		REQUIRE(stats.min == 0);
+		REQUIRE(stats.max == 16);
+		REQUIRE(stats.sum == 72);
+	}
+	SECTION("Normalization uses the range")
+	{
+		sf.normalize();
+		REQUIRE(sf.value(0, 0) == 0);
+		REQUIRE(sf.value(2, 2) == 1);
+		REQUIRE(sf.value(1, 1) == 0.5);
+	}
+}
+
+TEST_CASE("Test histogram percentiles", "[Statistics]")
+{
+	SimpleLayerMap sf(10, 10);
+
+	for(int j = 0; j < 10; ++j)
+	{
+		for(int i = 0; i < 10; ++i)
+		{
+			sf.set_value(i, j, i + 10 * j);
+		}
+	}
+
+	Histogram hist = sf.histogram(0, 100, 100);
+	REQUIRE(hist.count() == 100);
+	REQUIRE(hist.bin(42) == 1);
+	REQUIRE(hist.percentile(0.5) == Approx(50));
+	REQUIRE(hist.percentile(0) == Approx(0));
+	REQUIRE(hist.percentile(1) == Approx(100));
+
+	std::pair<double, double> range = sf.percentile_range(0.1, 0.9, 99);
+	REQUIRE(range.first == Approx(10).margin(1));
+	REQUIRE(range.second == Approx(90).margin(1));
+
+	Histogram other(0, 1, 100);
+	REQUIRE_THROWS(hist.merge(other));
+
+	SECTION("Values out of the range are clamped and non finite values are ignored")
+	{
+		const double values[] = {std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::infinity(),
+		                         -std::numeric_limits<double>::infinity(), 1e300, -1e300, 1e10};
+		hist.add(values, 6);
+		hist.add(std::numeric_limits<double>::quiet_NaN());
+		hist.add(-1e18);
+
+		REQUIRE(hist.count() == 104);
+		REQUIRE(hist.bin(99) == 3);
+		REQUIRE(hist.bin(0) == 3);
+	}
+}
@@ -0,0 +1,283 @@
+#include "catch.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+
+#include <TerrainHistory.hpp>
+#include <MultiLayerMap.hpp>
+
+namespace
+{
+/**
+ * @brief Tells if both terrains have the same layers and values
+ *
+ */
+bool same_values(const MultiLayerMap& a, const MultiLayerMap& b)
+{
+	if(a.get_layer_number() != b.get_layer_number() || a.grid_width() != b.grid_width() || a.grid_height() != b.grid_height())
+	{
+		return false;
+	}
+
+	for(int l = 0; l < a.get_layer_number(); ++l)
+	{
+		if(a.get_field(l).storage().to_vector() != b.get_field(l).storage().to_vector())
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+}
+
+TEST_CASE("Test tile deltas", "[TerrainHistory]")
+{
+	std::vector<double> a(TileStorage::tile_cells);
+	std::vector<double> b(TileStorage::tile_cells);
+
+	for(int k = 0; k < a.size(); ++k)
+	{
+		a[k] = std::sin(k * 0.01) * 3;
+		b[k] = a[k];
+	}
+
+	REQUIRE(TerrainHistory::encode(a.data(), b.data()).empty());
+	b[100] += 0.001;
+	b[2000] = -7;
+	std::vector<unsigned char> delta = TerrainHistory::encode(a.data(), b.data());
+	// a few modified values only cost a few bytes
+	REQUIRE(!delta.empty());
+	REQUIRE(delta.size() < 100);
+	std::vector<double> c = a;
+	TerrainHistory::decode(delta, c.data());
+	REQUIRE(c == b);
+	TerrainHistory::decode(delta, c.data());
+	REQUIRE(c == a);
+	// the values themselves against zeros
+	std::vector<double> zeros(TileStorage::tile_cells, 0);
+	TerrainHistory::decode(TerrainHistory::encode(a.data(), nullptr), zeros.data());
+	REQUIRE(zeros == a);
+	REQUIRE_THROWS_AS(TerrainHistory::decode(std::vector<unsigned char>(1, 0xff), c.data()), std::runtime_error);
+	// a number past 32 bits
+	REQUIRE_THROWS_AS(TerrainHistory::decode({0xff, 0xff, 0xff, 0xff, 0x7f, 0}, c.data()), std::runtime_error);
+}
+
+TEST_CASE("Test terrain history", "[TerrainHistory]")
+{
+	MultiLayerMap mlm(200, 150, {0, 0}, {2, 1.5});
+	SimpleLayerMap& bedrock = mlm.new_layer();
+
+	for(int j = 0; j < 150; ++j)
+	{
+		for(int i = 0; i < 200; ++i)
+		{
+			bedrock.at(i, j) = std::sin(i * 0.05) + std::cos(j * 0.03);
+		}
+	}
+
+	const MultiLayerMap original(mlm);
+	TerrainHistory history(1 << 20);
+	REQUIRE_FALSE(history.can_undo());
+	REQUIRE_THROWS_AS(history.undo(mlm), std::logic_error);
+
+	SECTION("A local operation only keeps its tiles")
+	{
+		MultiLayerMap before(mlm);
+		mlm.get_field(0).at(10, 10) += 1;
+		mlm.get_field(0).at(190, 140) -= 1;
+		REQUIRE(history.record("edit", before, mlm));
+		REQUIRE(history.memory() < 200);
+		REQUIRE(history.undo_name() == "edit");
+		const MultiLayerMap edited(mlm);
+
+		history.undo(mlm);
+		REQUIRE(same_values(mlm, original));
+		REQUIRE_FALSE(history.can_undo());
+		REQUIRE(history.redo_name() == "edit");
+		// the tiles not modified are still shared
+		REQUIRE(mlm.get_field(0).storage().shares_tile(1, original.get_field(0).storage()));
+
+		history.redo(mlm);
+		REQUIRE(same_values(mlm, edited));
+		REQUIRE_THROWS_AS(history.redo(mlm), std::logic_error);
+	}
+	SECTION("A terrain modified outside of the history is not undone")
+	{
+		MultiLayerMap before(mlm);
+		mlm.get_field(0).at(10, 10) += 1;
+		REQUIRE(history.record("edit", before, mlm));
+
+		mlm.get_field(0).at(20, 20) = 5;
+		const MultiLayerMap modified(mlm);
+		REQUIRE_THROWS_AS(history.undo(mlm), std::logic_error);
+		REQUIRE(same_values(mlm, modified));
+		REQUIRE(history.can_undo());
+
+		// the tiles the operation did not modify can change
+		mlm.get_field(0).at(20, 20) = original.get_field(0).value(20, 20);
+		mlm.get_field(0).at(150, 100) = 5;
+		history.undo(mlm);
+		REQUIRE(mlm.get_field(0).value(10, 10) == original.get_field(0).value(10, 10));
+		REQUIRE(mlm.get_field(0).value(150, 100) == 5);
+	}
+	SECTION("An unchanged terrain is not recorded")
+	{
+		REQUIRE_FALSE(history.record("nothing", MultiLayerMap(mlm), mlm));
+		REQUIRE_FALSE(history.can_undo());
+	}
+	SECTION("New layers and new grids are undone")
+	{
+		MultiLayerMap before(mlm);
+		mlm.new_layer().set_all(0.5);
+		REQUIRE(history.record("sediments", before, mlm));
+		const MultiLayerMap layered(mlm);
+
+		before = mlm;
+		mlm = MultiLayerMap(50, 40, {0, 0}, {1, 1});
+		mlm.new_layer().set_all(2);
+		REQUIRE(history.record("generate", before, mlm));
+		const MultiLayerMap generated(mlm);
+
+		history.undo(mlm);
+		REQUIRE(same_values(mlm, layered));
+		history.undo(mlm);
+		REQUIRE(same_values(mlm, original));
+		history.redo(mlm);
+		history.redo(mlm);
+		REQUIRE(same_values(mlm, generated));
+		// the terrain must be the one the operation ended with
+		REQUIRE_THROWS_AS(history.undo(mlm = original), std::logic_error);
+	}
+	SECTION("A new operation forgets the operations undone")
+	{
+		MultiLayerMap before(mlm);
+		mlm.get_field(0) += 1;
+		history.record("raise", before, mlm);
+		history.undo(mlm);
+		before = mlm;
+		mlm.get_field(0) *= 2;
+		history.record("scale", before, mlm);
+		REQUIRE_FALSE(history.can_redo());
+		REQUIRE(history.undo_number() == 1);
+		REQUIRE(history.undo_name() == "scale");
+	}
+	SECTION("The materials are undone with the layers")
+	{
+		MaterialColumns columns(200, 150);
+		columns.deposit(5, 5, 0, 1, 2.);
+		mlm.set_materials(columns);
+		MultiLayerMap before(mlm);
+		mlm.mutable_materials().remove(5, 5, 0, 0.5);
+		mlm.get_field(0).at(5, 5) -= 0.5;
+		REQUIRE(history.record("erode", before, mlm));
+
+		history.undo(mlm);
+		REQUIRE(mlm.materials().thickness(5, 5, 0) == 2.);
+		history.redo(mlm);
+		REQUIRE(mlm.materials().thickness(5, 5, 0) == 1.5);
+	}
+}
+
+TEST_CASE("Test terrain history budget", "[TerrainHistory]")
+{
+	MultiLayerMap mlm(130, 130, {0, 0}, {1, 1});
+	mlm.new_layer();
+	std::vector<MultiLayerMap> states(1, mlm);
+
+	auto operation = [&](TerrainHistory& history, const int k)
+	{
+		MultiLayerMap before(mlm);
+		// every value changes, so each operation keeps the whole terrain
+		mlm.get_field(0) += std::sqrt(k + 2.);
+		history.record("operation " + std::to_string(k), before, mlm);
+		states.push_back(mlm);
+	};
+
+	SECTION("The oldest operations are forgotten without a spill directory")
+	{
+		TerrainHistory history(600000);
+
+		for(int k = 0; k < 6; ++k)
+		{
+			operation(history, k);
+		}
+
+		REQUIRE(history.memory() <= 600000);
+		REQUIRE(history.undo_number() < 6);
+		REQUIRE(history.undo_number() >= 1);
+		const int n = history.undo_number();
+
+		for(int k = 0; k < n; ++k)
+		{
+			history.undo(mlm);
+		}
+
+		REQUIRE(same_values(mlm, states[6 - n]));
+	}
+	SECTION("Only the ends of the history are forgotten")
+	{
+		TerrainHistory history(600000);
+
+		// an empty layer keeps no tile, so its operation has no size
+		MultiLayerMap before(mlm);
+		mlm.new_layer();
+		REQUIRE(history.record("sediments", before, mlm));
+		states.push_back(mlm);
+		REQUIRE(history.memory() == 0);
+
+		for(int k = 0; k < 6; ++k)
+		{
+			operation(history, k);
+		}
+
+		REQUIRE(history.memory() <= 600000);
+		const int n = history.undo_number();
+		REQUIRE(n < 7);
+
+		for(int k = 0; k < n; ++k)
+		{
+			history.undo(mlm);
+			REQUIRE(same_values(mlm, states[6 - k]));
+		}
+
+		for(int k = 0; k < n; ++k)
+		{
+			history.redo(mlm);
+		}
+
+		REQUIRE(same_values(mlm, states[7]));
+	}
+	SECTION("The oldest operations are written to the spill directory")
+	{
+		{
+			TerrainHistory history(600000, "history_test");
+
+			for(int k = 0; k < 6; ++k)
+			{
+				operation(history, k);
+			}
+
+			REQUIRE(history.memory() <= 600000);
+			REQUIRE(history.spilled() > 0);
+			REQUIRE(history.undo_number() == 6);
+
+			for(int k = 0; k < 6; ++k)
+			{
+				history.undo(mlm);
+				REQUIRE(same_values(mlm, states[5 - k]));
+			}
+
+			for(int k = 0; k < 6; ++k)
+			{
+				history.redo(mlm);
+			}
+
+			REQUIRE(same_values(mlm, states[6]));
+		}
+
+		// the files are removed with the history
+		REQUIRE(std::remove("history_test") == 0);
+	}
+}
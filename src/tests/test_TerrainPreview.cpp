@@ -0,0 +1,117 @@
+#include "catch.hpp"
+
+#include <TerrainPreview.hpp>
+#include <MultiLayerMap.hpp>
+
+TEST_CASE("Test terrain preview", "[TerrainPreview]")
+{
+	MultiLayerMap mlm(100, 70, {0, 0}, {10, 7});
+	SimpleLayerMap& bedrock = mlm.new_layer();
+
+	for(int j = 0; j < 70; ++j)
+	{
+		for(int i = 0; i < 100; ++i)
+		{
+			bedrock.at(i, j) = i * 0.01 + j * 0.02;
+		}
+	}
+
+	BiomeInfo biome(mlm);
+	TerrainPreview preview(32);
+	REQUIRE_THROWS_AS(TerrainPreview(0), std::invalid_argument);
+
+	SECTION("An empty terrain has an empty image")
+	{
+		REQUIRE(preview.update(biome, TerrainPreview::Mode::height) == 12);
+		MultiLayerMap empty(0, 0, {0, 0}, {1, 1});
+		empty.new_layer();
+		BiomeInfo empty_biome(empty);
+		REQUIRE(preview.update(empty_biome, TerrainPreview::Mode::slope) == 0);
+		REQUIRE(preview.width() == 0);
+		REQUIRE(preview.height() == 0);
+		REQUIRE(preview.dirty_tiles().empty());
+		REQUIRE(preview.update(biome, TerrainPreview::Mode::height) == 12);
+	}
+	SECTION("The first update renders every tile")
+	{
+		REQUIRE(preview.update(biome, TerrainPreview::Mode::height) == 4 * 3);
+		REQUIRE(preview.width() == 100);
+		REQUIRE(preview.height() == 70);
+		REQUIRE(preview.min() == Approx(0));
+		REQUIRE(preview.max() == Approx(0.99 + 1.38));
+		const TerrainPreview::Tile& last = preview.dirty_tiles().back();
+		REQUIRE(last.x == 96);
+		REQUIRE(last.y == 64);
+		REQUIRE(last.width == 4);
+		REQUIRE(last.height == 6);
+		// the lowest cell gets the first color, opaque
+		REQUIRE(preview.pixels()[3] == 255);
+		REQUIRE(preview.pixels()[1] < preview.pixels()[(69 * 100 + 99) * 4 + 1]);
+		// nothing changed
+		REQUIRE(preview.update(biome, TerrainPreview::Mode::height) == 0);
+		REQUIRE(preview.dirty_tiles().empty());
+	}
+	SECTION("A local change renders its tile")
+	{
+		preview.update(biome, TerrainPreview::Mode::height);
+		const std::vector<unsigned char> before(preview.pixels(), preview.pixels() + 100 * 70 * 4);
+		mlm.get_field(0).at(40, 50) += 0.5;
+		REQUIRE(preview.update(biome, TerrainPreview::Mode::height) == 1);
+		REQUIRE(preview.dirty_tiles()[0].x == 32);
+		REQUIRE(preview.dirty_tiles()[0].y == 32);
+		const std::vector<unsigned char> after(preview.pixels(), preview.pixels() + 100 * 70 * 4);
+		REQUIRE(before != after);
+		REQUIRE(std::equal(before.begin(), before.begin() + 32 * 100 * 4, after.begin()));
+	}
+	SECTION("A slope change renders the neighboring tiles")
+	{
+		// a flat area and a peak away from the change give a range wide enough
+		for(int j = 5; j < 10; ++j)
+		{
+			for(int i = 80; i < 85; ++i)
+			{
+				mlm.get_field(0).at(i, j) = 1;
+			}
+		}
+
+		mlm.get_field(0).at(90, 60) += 2;
+		preview.update(biome, TerrainPreview::Mode::slope);
+		mlm.get_field(0).at(32, 32) += 0.05;
+		const int tiles = preview.update(biome, TerrainPreview::Mode::slope);
+		REQUIRE(tiles >= 2);
+		REQUIRE(tiles <= 4);
+	}
+	SECTION("The rows computed again are the same as the maps of the biome")
+	{
+		const TerrainPreview::Mode modes[3] = {TerrainPreview::Mode::height, TerrainPreview::Mode::slope, TerrainPreview::Mode::exposure};
+
+		for(const TerrainPreview::Mode mode : modes)
+		{
+			preview.update(biome, mode);
+			mlm.get_field(0).at(50, 40) += 0.3;
+			mlm.get_field(0).at(10, 3) -= 0.2;
+			preview.update(biome, mode);
+
+			const SimpleLayerMap& expected = (mode == TerrainPreview::Mode::slope) ? biome.raw_slope()
+			                                 : (mode == TerrainPreview::Mode::exposure) ? biome.raw_exposure() : biome.terrain();
+
+			for(int j = 0; j < 70; ++j)
+			{
+				for(int i = 0; i < 100; ++i)
+				{
+					REQUIRE(preview.value(i, j) == expected.value(i, j));
+				}
+			}
+		}
+	}
+	SECTION("A wider range or an other mode renders everything")
+	{
+		preview.update(biome, TerrainPreview::Mode::height);
+		mlm.get_field(0).at(0, 0) = -1;
+		REQUIRE(preview.update(biome, TerrainPreview::Mode::height) == 12);
+		REQUIRE(preview.min() == Approx(-1));
+		REQUIRE(preview.update(biome, TerrainPreview::Mode::slope) == 12);
+		preview.reset();
+		REQUIRE(preview.update(biome, TerrainPreview::Mode::slope) == 12);
+	}
+}
@@ -0,0 +1,199 @@
+#include "catch.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+#include <ThreadPool.hpp>
+#include <SimpleLayerMap.hpp>
+#include <MultiLayerMap.hpp>
+
+TEST_CASE("Test thread pool", "[ThreadPool]")
+{
+	ThreadPool& pool = ThreadPool::instance();
+	const int threads = pool.thread_number();
+	pool.set_thread_number(4);
+	REQUIRE(pool.thread_number() == 4);
+
+	SECTION("Every index is visited once")
+	{
+		std::vector<int> visits(1000, 0);
+		parallel_for(0, 1000, [&](int b, int e)
+		{
+			for(int k = b; k < e; ++k)
+			{
+				++visits[k];
+			}
+		}, 7);
+		REQUIRE(std::count(visits.begin(), visits.end(), 1) == 1000);
+	}
+	SECTION("Rows and tiles cover the grid")
+	{
+		Grid2d grid(37, 23, {0, 0}, {1, 1});
+		std::vector<std::atomic<int>> rows(grid.grid_height());
+		std::vector<std::atomic<int>> cells(grid.cell_number());
+
+		for(auto& r : rows)
+		{
+			r = 0;
+		}
+
+		for(auto& c : cells)
+		{
+			c = 0;
+		}
+
+		parallel_for_rows(grid, [&](int b, int e)
+		{
+			for(int j = b; j < e; ++j)
+			{
+				++rows[j];
+			}
+		}, 2);
+		parallel_for_tiles(grid, 8, [&](int i0, int j0, int i1, int j1)
+		{
+			for(int j = j0; j < j1; ++j)
+			{
+				for(int i = i0; i < i1; ++i)
+				{
+					++cells[j * grid.grid_width() + i];
+				}
+			}
+		});
+
+		for(auto& r : rows)
+		{
+			REQUIRE(r == 1);
+		}
+
+		for(auto& c : cells)
+		{
+			REQUIRE(c == 1);
+		}
+	}
+	SECTION("Reductions do not depend on the number of threads")
+	{
+		auto sum = [](int b, int e)
+		{
+			double s = 0;
+
+			for(int k = b; k < e; ++k)
+			{
+				s += 1.0 / (k + 1);
+			}
+
+			return s;
+		};
+		auto add = [](double a, double b)
+		{
+			return a + b;
+		};
+		double parallel = parallel_reduce(0, 100000, 100, 0.0, sum, add);
+		pool.set_thread_number(1);
+		REQUIRE(parallel_reduce(0, 100000, 100, 0.0, sum, add) == parallel);
+	}
+	SECTION("Nested loops and limits")
+	{
+		std::atomic<int> count(0);
+		ConcurrencyLimit limit(2);
+		REQUIRE(pool.concurrency() == 2);
+		parallel_for(0, 16, [&](int b, int e)
+		{
+			parallel_for(0, 16, [&](int b2, int e2)
+			{
+				count += e2 - b2;
+			});
+		});
+		REQUIRE(count == 256);
+	}
+	SECTION("Nested loops share the limit of the thread that started them")
+	{
+		std::atomic<int> running(0);
+		std::atomic<int> most(0);
+		ConcurrencyLimit limit(2);
+		parallel_for(0, 8, [&](int b, int e)
+		{
+			parallel_for(0, 8, [&](int b2, int e2)
+			{
+				const int now = ++running;
+				int previous = most;
+
+				while(previous < now && !most.compare_exchange_weak(previous, now))
+				{
+				}
+
+				std::this_thread::sleep_for(std::chrono::milliseconds(2));
+				--running;
+			});
+		});
+		REQUIRE(most <= 2);
+
+		ConcurrencyLimit nested(3);
+		REQUIRE(pool.concurrency() == 2);
+	}
+	SECTION("Exceptions and cancellation")
+	{
+		REQUIRE_THROWS_AS(parallel_for(0, 100, [](int b, int e)
+		{
+			if(b <= 50 && 50 < e)
+			{
+				throw std::runtime_error("failure");
+			}
+		}), std::runtime_error);
+
+		std::atomic<int> runs(0);
+		TaskGroup group;
+		group.cancel();
+
+		for(int t = 0; t < 10; ++t)
+		{
+			group.run([&]()
+			{
+				++runs;
+			});
+		}
+
+		group.wait();
+		REQUIRE(runs == 0);
+		REQUIRE(group.is_cancelled());
+	}
+	SECTION("Parallel kernels give the same fields")
+	{
+		MultiLayerMap mlm(300, 200);
+		mlm.new_layer();
+		mlm.new_layer();
+		SimpleLayerMap& bedrock = mlm.get_field(0);
+		SimpleLayerMap& sediments = mlm.get_field(1);
+
+		for(int j = 0; j < 200; ++j)
+		{
+			for(int i = 0; i < 300; ++i)
+			{
+				bedrock.at(i, j) = std::sin(0.05 * i) * std::cos(0.03 * j);
+				sediments.at(i, j) = 0.01 * ((i * j) % 7);
+			}
+		}
+
+		SimpleLayerMap field = mlm.generate_field();
+		SimpleLayerMap slope = SimpleLayerMap::generate_slope_map(field);
+		FieldStatistics stats = field.statistics();
+		pool.set_thread_number(1);
+		SimpleLayerMap serial_slope = SimpleLayerMap::generate_slope_map(mlm.generate_field());
+		FieldStatistics serial_stats = field.statistics();
+
+		for(int j = 0; j < 200; ++j)
+		{
+			for(int i = 0; i < 300; ++i)
+			{
+				REQUIRE(field.value(i, j) == mlm.value(i, j));
+				REQUIRE(slope.value(i, j) == serial_slope.value(i, j));
+			}
+		}
+
+		REQUIRE(stats.mean == serial_stats.mean);
+		REQUIRE(stats.variance == serial_stats.variance);
+	}
+
+	pool.set_thread_number(threads);
+}